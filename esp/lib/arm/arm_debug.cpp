@@ -28,17 +28,101 @@
 #include "arm_kinetis_reg.h"  // Actually we just want ARM
 #include "../../src/event_logger.h"
 
+// Default SWD clock phases in microseconds, as seen in J-LINK Segger Traffic Capture.
+// Can be changed at runtime with setClockDelay().
+
 //This works fine
 //#define LOW_DELAY 4
 //#define HIGH_DELAY 5
 
 //This is much faster and works fine, too, but perhaps not that stable
+#ifndef LOW_DELAY
 #define LOW_DELAY 1
+#endif
+#ifndef HIGH_DELAY
 #define HIGH_DELAY 2
+#endif
 
 ARMDebug::ARMDebug(unsigned clockPin, unsigned dataPin, LogLevel logLevel)
     : clockPin(clockPin), dataPin(dataPin), logLevel(logLevel)
-{}
+{
+    // GPIO0-15 can be driven through the GPOS/GPOC registers, GPIO16 lives in the RTC block
+    fastPins = clockPin < 16 && dataPin < 16;
+    clockMask = fastPins ? 1 << clockPin : 0;
+    dataMask = fastPins ? 1 << dataPin : 0;
+
+    setClockDelay(LOW_DELAY, HIGH_DELAY);
+}
+
+void ARMDebug::setClockDelay(unsigned lowDelay, unsigned highDelay)
+{
+    this->lowDelay = lowDelay;
+    this->highDelay = highDelay;
+}
+
+inline void ARMDebug::clockLow()
+{
+    if (fastPins) {
+        GPOC = clockMask;
+    } else {
+        digitalWrite(clockPin, LOW);
+    }
+    if (lowDelay) {
+        delayMicroseconds(lowDelay);
+    }
+}
+
+inline void ARMDebug::clockHigh()
+{
+    if (fastPins) {
+        GPOS = clockMask;
+    } else {
+        digitalWrite(clockPin, HIGH);
+    }
+    if (highDelay) {
+        delayMicroseconds(highDelay);
+    }
+}
+
+inline void ARMDebug::dataWrite(bool value)
+{
+    if (fastPins) {
+        if (value) {
+            GPOS = dataMask;
+        } else {
+            GPOC = dataMask;
+        }
+    } else {
+        digitalWrite(dataPin, value);
+    }
+}
+
+inline bool ARMDebug::dataRead()
+{
+    if (fastPins) {
+        return (GPI & dataMask) != 0;
+    }
+    return digitalRead(dataPin);
+}
+
+inline void ARMDebug::dataOutput()
+{
+    // The pull-up configured in begin() stays enabled, only the output driver is switched
+    if (fastPins) {
+        GPES = dataMask;
+    } else {
+        pinMode(dataPin, OUTPUT);
+    }
+}
+
+inline void ARMDebug::dataInput()
+{
+    if (fastPins) {
+        GPEC = dataMask;
+    } else {
+        pinMode(dataPin, INPUT_PULLUP);
+    }
+}
 
 bool ARMDebug::begin()
 {
@@ -266,82 +350,113 @@ bool ARMDebug::memStoreAndVerify(uint32_t addr, const uint32_t *data, unsigned c
     if (!memStore(addr, data, count))
         return false;
 
-    if (!memWait())
-        return false;
-    if (!apWrite(MEM_TAR, addr))
-        return false;
-
     while (count) {
-        uint32_t readback;
+        uint32_t readback[16];
+        unsigned chunk = count < 16 ? count : 16;
 
-        if (!memWait())
-            return false;
-        if (!apRead(MEM_DRW, readback))
+        if (!memLoad(addr, readback, chunk))
             return false;
 
-        log(readback == *data ? LOG_TRACE_MEM : LOG_ERROR,
-            "MEM Verif [%08x] %08x (expected %08x)", addr, readback, *data);
+        for (unsigned i = 0; i < chunk; i++) {
+            log(readback[i] == *data ? LOG_TRACE_MEM : LOG_ERROR,
+                "MEM Verif [%08x] %08x (expected %08x)", addr, readback[i], *data);
 
-        if (readback != *data)
-            return false;
+            if (readback[i] != *data)
+                return false;
 
-        data++;
-        addr++;
-        count--;
+            data++;
+            addr += 4;
+            count--;
+        }
     }
 
     return true;
 }
 
+unsigned ARMDebug::memBlockCount(uint32_t addr, unsigned count)
+{
+    // Number of words that can be transferred before TAR has to be written again
+
+    unsigned remaining = (kAutoIncrementBlockSize - (addr & (kAutoIncrementBlockSize - 1))) >> 2;
+    return count < remaining ? count : remaining;
+}
+
 bool ARMDebug::memStore(uint32_t addr, const uint32_t *data, unsigned count)
 {
+    /*
+     * Block transfer: TAR is written once per 1 KB block and DRW writes are posted
+     * back to back. If the bus is still busy with the previous word the target answers
+     * WAIT and dpWrite() retries, so there is no need to poll CSW for every word.
+     */
+
     if (!memWait())
         return false;
     if (!memWriteCSW(CSW_32BIT | CSW_ADDRINC_SINGLE))
         return false;
-    if (!apWrite(MEM_TAR, addr))
-        return false;
 
     while (count) {
-        ESP.wdtFeed();
+        unsigned blockCount = memBlockCount(addr, count);
 
-        log(LOG_TRACE_MEM, "MEM Store [%08x] %08x", addr, *data);
-
-        if (!memWait())
+        if (!apWrite(MEM_TAR, addr))
             return false;
-        if (!apWrite(MEM_DRW, *data))
+        if (!dpSelect(MEM_DRW))
             return false;
 
-        data++;
-        addr++;
-        count--;
+        while (blockCount--) {
+            log(LOG_TRACE_MEM, "MEM Store [%08x] %08x", addr, *data);
+
+            if (!dpWrite(MEM_DRW, true, *data))
+                return false;
+
+            data++;
+            addr += 4;
+            count--;
+        }
     }
 
-    return true;
+    // Wait for the last posted write to complete
+    return memWait();
 }
 
 bool ARMDebug::memLoad(uint32_t addr, uint32_t *data, unsigned count)
 {
+    /*
+     * Block transfer with pipelined AP reads: each DRW read returns the result of
+     * the previous one, the first one only starts the transfer and the last word
+     * is collected from RDBUFF so we never read past the end of the block.
+     */
+
     if (!memWait())
         return false;
     if (!memWriteCSW(CSW_32BIT | CSW_ADDRINC_SINGLE))
         return false;
-    if (!apWrite(MEM_TAR, addr))
-        return false;
 
     while (count) {
-        ESP.wdtFeed();
+        unsigned blockCount = memBlockCount(addr, count);
+        uint32_t dummyData;
 
-        if (!memWait())
+        if (!apWrite(MEM_TAR, addr))
+            return false;
+        if (!dpSelect(MEM_DRW))
             return false;
-        if (!apRead(MEM_DRW, *data))
+        if (!dpRead(MEM_DRW, true, dummyData))
             return false;
 
-        log(LOG_TRACE_MEM, "MEM Load  [%08x] %08x", addr, *data);
+        while (blockCount--) {
+            if (blockCount) {
+                if (!dpRead(MEM_DRW, true, *data))
+                    return false;
+            } else {
+                if (!dpRead(RDBUFF, false, *data))
+                    return false;
+            }
+
+            log(LOG_TRACE_MEM, "MEM Load  [%08x] %08x", addr, *data);
 
-        data++;
-        addr++;
-        count--;
+            data++;
+            addr += 4;
+            count--;
+        }
     }
 
     return true;
@@ -724,12 +839,10 @@ void ARMDebug::wireWrite(uint32_t data, unsigned nBits)
     log(LOG_TRACE_SWD, "SWD Write %08x (%d)", data, nBits);
 
     while (nBits--) {
-        digitalWrite(dataPin, data & 1);
-        digitalWrite(clockPin, LOW);
-        delayMicroseconds(LOW_DELAY);       // As seen in J-LINK Segger Traffic Capture
+        dataWrite(data & 1);
+        clockLow();
         data >>= 1;
-        digitalWrite(clockPin, HIGH);
-        delayMicroseconds(HIGH_DELAY);       // As seen in J-LINK Segger Traffic Capture
+        clockHigh();
     }
 }
 
@@ -746,14 +859,12 @@ uint32_t ARMDebug::wireRead(unsigned nBits)
     unsigned count = nBits;
 
     while (count--) {
-        if (digitalRead(dataPin)) {
+        if (dataRead()) {
             result |= mask;
         }
-        digitalWrite(clockPin, LOW);
-        delayMicroseconds(LOW_DELAY);       // As seen in J-LINK Segger Traffic Capture
+        clockLow();
         mask <<= 1;
-        digitalWrite(clockPin, HIGH);
-        delayMicroseconds(HIGH_DELAY);       // As seen in J-LINK Segger Traffic Capture
+        clockHigh();
     }
 
     log(LOG_TRACE_SWD, "SWD Read  %08x (%d)", result, nBits);
@@ -764,25 +875,21 @@ void ARMDebug::wireWriteTurnaround()
 {
     log(LOG_TRACE_SWD, "SWD Write trn");
 
-    digitalWrite(dataPin, HIGH);
-    pinMode(dataPin, INPUT_PULLUP);
-    digitalWrite(clockPin, LOW);
-    delayMicroseconds(LOW_DELAY);       // As seen in J-LINK Segger Traffic Capture
-    digitalWrite(clockPin, HIGH);
-    delayMicroseconds(HIGH_DELAY);       // As seen in J-LINK Segger Traffic Capture
-    pinMode(dataPin, OUTPUT);
+    dataWrite(HIGH);
+    dataInput();
+    clockLow();
+    clockHigh();
+    dataOutput();
 }
 
 void ARMDebug::wireReadTurnaround()
 {
     log(LOG_TRACE_SWD, "SWD Read  trn");
 
-    digitalWrite(dataPin, HIGH);
-    pinMode(dataPin, INPUT_PULLUP);
-    digitalWrite(clockPin, LOW);
-    delayMicroseconds(LOW_DELAY);       // As seen in J-LINK Segger Traffic Capture
-    digitalWrite(clockPin, HIGH);
-    delayMicroseconds(HIGH_DELAY);       // As seen in J-LINK Segger Traffic Capture
+    dataWrite(HIGH);
+    dataInput();
+    clockLow();
+    clockHigh();
 }
 
 void ARMDebug::log(int level, const char *fmt, ...)
@@ -92,6 +92,9 @@ public:
     void setLogLevel(LogLevel newLevel);
     void setLogLevel(LogLevel newLevel, LogLevel &prevLevel);
 
+    // Change the SWD clock timing, in microseconds spent in each clock phase (0 = as fast as possible)
+    void setClockDelay(unsigned lowDelay, unsigned highDelay);
+
     //////////////// Lower level API
 
     // Low-level wire interface (LSB-first)
@@ -124,6 +127,7 @@ public:
     // Internal MEM-AP functions
     bool memWait();
     bool memWriteCSW(uint32_t data);
+    unsigned memBlockCount(uint32_t addr, unsigned count);
 
     // Poll for an expected value
     bool dpReadPoll(unsigned addr, uint32_t &data, uint32_t mask, uint32_t expected, unsigned retries = DEFAULT_RETRIES);
@@ -184,8 +188,18 @@ public:
 
 private:
     uint8_t clockPin, dataPin, fastPins;
+    unsigned lowDelay, highDelay;
+    uint32_t clockMask, dataMask;
     LogLevel logLevel;
 
+    // Pin access, using the GPIO set/clear registers directly when fastPins is set
+    void clockLow();
+    void clockHigh();
+    void dataWrite(bool value);
+    bool dataRead();
+    void dataOutput();
+    void dataInput();
+
     // Cached versions of ARM debug registers
     struct {
         uint32_t select;
@@ -194,4 +208,7 @@ private:
 
     // Relevant bits in cache.select
     const uint32_t kSelectMask = 0xFF0000F0;
+
+    // TAR auto-increment is only guaranteed within a 1 KB address block
+    const uint32_t kAutoIncrementBlockSize = 0x400;
 };
@@ -35,11 +35,12 @@
 #include <Arduino.h>
 #include "arm_kinetis_debug.h"
 #include "arm_kinetis_reg.h"
+#include "arm_kinetis_loader.h"
 
 
 
 ARMKinetisDebug::ARMKinetisDebug(unsigned clockPin, unsigned dataPin, LogLevel logLevel)
-    : ARMDebug(clockPin, dataPin, logLevel)
+    : ARMDebug(clockPin, dataPin, logLevel), flashLoaderSlot(0)
 {}
 
 bool ARMKinetisDebug::startup()
@@ -358,6 +359,93 @@ bool ARMKinetisDebug::flashSectorErase(uint32_t address)
         ftfl_handleCommandStatus("FLASH: Error erasing sector! (FSTAT: %08x)");
 }
 
+bool ARMKinetisDebug::flashLoaderBegin()
+{
+    // Upload the loader while the core is halted, then point it at the mailbox and let it run
+    const uint32_t zero[4] = { FLASH_LOADER_EMPTY, 0, 0, 0 };
+
+    flashLoaderSlot = 0;
+
+    if (!memStoreAndVerify(FLASH_LOADER_CODE_ADDRESS, kFlashLoaderCode, sizeof(kFlashLoaderCode)/4) ||
+        !memStore(FLASH_LOADER_MAILBOX, zero, 4) ||
+        !memStore(FLASH_LOADER_MAILBOX + FLASH_LOADER_SLOT_SIZE, zero, 4))
+    {
+        log(LOG_ERROR, "FLASH: Failed to upload flash loader");
+        return false;
+    }
+
+    if (!regWrite(0, FLASH_LOADER_MAILBOX) ||
+        !regWrite(13, FLASH_LOADER_MAILBOX) ||
+        !regWrite(15, FLASH_LOADER_CODE_ADDRESS) ||
+        !regWrite(16, 0x01000000))           // xPSR, Thumb state
+    {
+        log(LOG_ERROR, "FLASH: Failed to set up flash loader registers");
+        return false;
+    }
+
+    // Keep debug enabled, release the halt
+    if (!memStore(REG_SCB_DHCSR, 0xA05F0001))
+        return false;
+
+    log(LOG_NORMAL, "FLASH: Flash loader running");
+    return true;
+}
+
+bool ARMKinetisDebug::flashLoaderWaitSlot(unsigned slot)
+{
+    uint32_t mailbox = FLASH_LOADER_MAILBOX + slot * FLASH_LOADER_SLOT_SIZE;
+    uint32_t startTime = millis();
+    uint32_t state;
+
+    do {
+        ESP.wdtFeed();
+        if (!memLoad(mailbox, state))
+            return false;
+        if (millis() - startTime > FLASH_LOADER_TIMEOUT) {
+            log(LOG_ERROR, "FLASH: Flash loader timed out");
+            return false;
+        }
+    } while (state == FLASH_LOADER_READY);
+
+    if (state == FLASH_LOADER_ERROR) {
+        uint32_t header[4];
+        memLoad(mailbox, header, 4);
+        log(LOG_ERROR, "FLASH: Flash loader failed at %08x (FSTAT: %08x)", header[1], header[3]);
+        return false;
+    }
+
+    return true;
+}
+
+bool ARMKinetisDebug::flashLoaderQueue(uint32_t address, const uint32_t *data, uint32_t flags)
+{
+    uint32_t mailbox = FLASH_LOADER_MAILBOX + flashLoaderSlot * FLASH_LOADER_SLOT_SIZE;
+    const uint32_t header[3] = { address, flags, 0 };
+
+    if (!flashLoaderWaitSlot(flashLoaderSlot))
+        return false;
+
+    // Data first, the state word last so the loader never sees a half written slot
+    if ((flags & FLASH_LOADER_PROGRAM) && !memStore(mailbox + 16, data, kFlashSectorSize/4))
+        return false;
+    if (!memStore(mailbox + 4, header, 3) || !memStore(mailbox, FLASH_LOADER_READY))
+        return false;
+
+    flashLoaderSlot ^= 1;
+    return true;
+}
+
+bool ARMKinetisDebug::flashLoaderWait()
+{
+    // Slots are processed in order, the current one was queued first
+    return flashLoaderWaitSlot(flashLoaderSlot) && flashLoaderWaitSlot(flashLoaderSlot ^ 1);
+}
+
+bool ARMKinetisDebug::flashLoaderEnd()
+{
+    return flashLoaderWait() && debugHalt();
+}
+
 bool ARMKinetisDebug::setProtectionBits(bool protect)
 {
 /*    if (!ftfl_busyWait())
@@ -650,46 +738,35 @@ target(target)
 {
     sectorSizeInBytes = 1024;
 	byteAlignment = 8;
+	deltaMode = true;
+	loaderMode = true;
+	useLoader = false;
 }
 
 bool ARMKinetisDebug::Flasher::installFirmware(File *file)
 {
-    this->file = file;
-
     target.log(LOG_NORMAL,"Initialize flash process");
     if (!begin()) return false;
     ESP.wdtFeed();
 
     target.log(LOG_NORMAL,"Begin Flashing");
-/*    while (next())
+
+    uint8_t chunk[256];
+    while (file->available())
     {
-        address += sectorSizeInBytes;
-    }*/
+        int size = file->read(chunk, sizeof(chunk));
+        if (size <= 0) break;
+        if (!write(chunk, size)) return false;
+    }
 
-	next();
+    if (!finish()) return false;
     ESP.wdtFeed();
 
     target.log(LOG_NORMAL,"End flashing");
 
-/*	if (!target.reset())
-	{
-		target.log(LOG_ERROR,"Failed to reset device");
-		return false;
-	}
-
-	if (!target.debugHalt())
-	{
-		target.log(LOG_ERROR,"Failed to debug halt device");
-		return false;
-	}*/
-
 	target.log(LOG_NORMAL,"Resetting FlexRAM");
 	if (!end()) return false;
 
-    //target.log(LOG_NORMAL,"Setting protection bits");
-    //target.setProtectionBits(false);
-
-
 	target.log(LOG_NORMAL,"Firmware update complete");
     ESP.wdtFeed();
 
@@ -715,6 +792,12 @@ bool ARMKinetisDebug::dumpSector(uint32_t address)
 
 bool ARMKinetisDebug::Flasher::begin()
 {
+    bufferOffset = 0;
+    imageHash = kHashSeed;
+    sectorsProgrammed = 0;
+    sectorsSkipped = 0;
+    memset(buffer, 0xFF, kEraseSectorSize);
+
 /*	// Start with a mass-erase
 	target.log(LOG_NORMAL,"Erasing chip");
 	if (!target.flashMassErase())
@@ -732,6 +815,14 @@ bool ARMKinetisDebug::Flasher::begin()
 
     address = 0;
 
+    // Fall back to driving the flash controller over SWD if the loader can't be started
+    useLoader = loaderMode && target.flashLoaderBegin();
+    if (loaderMode && !useLoader)
+    {
+        target.log(LOG_ERROR,"Flash loader not available, programming via SWD");
+        if (!target.debugHalt()) return false;
+    }
+
     return true;
 }
 
@@ -769,247 +860,176 @@ bool ARMKinetisDebug::Flasher::end()
 	return true;
 }
 
-bool ARMKinetisDebug::Flasher::next()
+uint32_t ARMKinetisDebug::Flasher::hash(uint32_t value, const uint8_t *data, uint32_t size)
 {
-	uint32_t address = 0;
-	uint8_t word[4];
-	memset(word,0,4);
+    // 32-bit FNV-1a
+    for (uint32_t i = 0; i < size; i++) {
+        value ^= data[i];
+        value *= 16777619UL;
+    }
+    return value;
+}
 
-	uint32_t buffer[kFlashSectorSize/4];
-	memset(buffer,0,sizeof(uint32_t)*(kFlashSectorSize/4));
-	uint32_t bufferAddress = 0;
-	int sector = 0;
-    bool rest = true;
+bool ARMKinetisDebug::Flasher::isErased(const uint32_t *data, uint32_t size)
+{
+    for (uint32_t i = 0; i < size/4; i++)
+    {
+        if (data[i] != 0xFFFFFFFF) return false;
+    }
+    return true;
+}
 
-	for (address=0;address<file->size();address=address+1)
-	{
+bool ARMKinetisDebug::Flasher::readHash(uint32_t flashAddress, uint32_t size, uint32_t &value)
+{
+    // Read back flash content in small chunks and continue the hash in value
+    uint32_t chunk[64];
+    for (uint32_t offset = 0; offset < size; offset += sizeof(chunk))
+    {
+        // Comparing a sector takes a few SWD transactions, keep the watchdog happy
         ESP.wdtFeed();
+        if (!target.memLoad(flashAddress + offset, chunk, sizeof(chunk)/4))
+        {
+            target.log(LOG_ERROR, "FLASH: Failed to read flash at %08x", flashAddress + offset);
+            return false;
+        }
+        value = hash(value, (const uint8_t *) chunk, sizeof(chunk));
+    }
+    return true;
+}
 
-		uint8_t byte = file->read();
-		if (address > 0 && address % 4 == 0)
-		{
-			uint32_t data = (word[3] << 24) + (word[2] << 16) + (word[1] << 8) + word[0];
-			buffer[bufferAddress] = data;
-			//target.log(LOG_NORMAL, "FLASH: Wrote longword to buffer at %08x, 0: %02x, 1: %02x, 2: %02x, 3: %02x, Word: %08x",address,word[0],word[1],word[2],word[3],data);
-			bufferAddress++;
-            rest = true;
-
-			if (bufferAddress >= kFlashSectorSize/4)
-			{
-				//Sector size is 2KB, buffer only 1KB, so we have to erase the section every second time
-				if (sector % 2 == 0)
-				{
-					target.log(LOG_NORMAL, "FLASH: flashSectorErase");
-					if (!target.flashSectorErase((sector*kFlashSectorSize)+REG_APPLICATION_BASE))
-					{
-						target.log(LOG_NORMAL, "FLASH: flashSectorErase failed");
-						return false;
-					}
-					else
-					{
-						target.log(LOG_NORMAL, "Sector %08x erased", (sector*kFlashSectorSize)+REG_APPLICATION_BASE);
-					}
-				}
-
-				//Write buffer to device
-				target.log(LOG_NORMAL,"Writing buffer to FlexRAM");
-				if (!target.flashSectorBufferWrite(0,buffer,kFlashSectorSize/4))
-				{
-					target.log(LOG_ERROR,"Failed to write buffer to FlexRAM");
-					return false;
-				}
-
-				target.log(LOG_NORMAL, "FLASH: flashSectorProgram: %08x",(sector*kFlashSectorSize)+REG_APPLICATION_BASE);
-				if (!target.ftfl_programSection((sector*kFlashSectorSize)+REG_APPLICATION_BASE, sectorSizeInBytes/8))
-				{
-					target.log(LOG_ERROR,"FLASH: flashSectorProgram failed 20 times in series - giving up.");
-					return false;
-				}
-
-				memset(buffer,0,sizeof(uint32_t)*(kFlashSectorSize/4));
-				bufferAddress = 0;
-				sector++;
-                rest = false;
-			}
-
-			memset(word,0,4);
-		}
-
-		//target.log(LOG_NORMAL,"Read byte %02x, position in word %i, Address %i",byte,address%4,address);
-		word[address % 4] = byte;
-
-		ESP.wdtFeed();
-	}
-
-    target.log(LOG_NORMAL, "Last sector");
+bool ARMKinetisDebug::Flasher::programSection(uint32_t flashAddress, const uint32_t *data)
+{
+    if (!target.flashSectorBufferWrite(0, data, kFlashSectorSize/4))
+    {
+        target.log(LOG_ERROR, "Failed to write buffer to FlexRAM");
+        return false;
+    }
 
-    //Sector size is 2KB, buffer only 1KB, so we have to erase the section every second time
-    if (sector % 2 == 0)
+    int retries = 0;
+    while (!target.ftfl_programSection(flashAddress, sectorSizeInBytes/8))
     {
-        target.log(LOG_NORMAL, "FLASH: flashSectorErase");
-        if (!target.flashSectorErase((sector*kFlashSectorSize)+REG_APPLICATION_BASE))
+        if (++retries > 20)
         {
-            target.log(LOG_NORMAL, "FLASH: flashSectorErase failed");
+            target.log(LOG_ERROR, "FLASH: flashSectorProgram failed 20 times in series - giving up.");
             return false;
         }
-        else
-        {
-            target.log(LOG_NORMAL, "Sector %08x erased", (sector*kFlashSectorSize)+REG_APPLICATION_BASE);
-        }
+        delay(25);
     }
 
-	//Write buffer to device
-	target.log(LOG_NORMAL,"Writing buffer to FlexRAM");
-	if (!target.flashSectorBufferWrite(0,buffer,kFlashSectorSize/4))
-	{
-		target.log(LOG_ERROR,"Failed to write buffer to FlexRAM");
-		return false;
-	}
-
-	target.log(LOG_NORMAL, "FLASH: flashSectorProgram: %08x",(sector*kFlashSectorSize)+REG_APPLICATION_BASE);
-	if (!target.ftfl_programSection((sector*kFlashSectorSize)+REG_APPLICATION_BASE, sectorSizeInBytes/8))
-	{
-		target.log(LOG_ERROR,"FLASH: flashSectorProgram failed 20 times in series - giving up.");
-		return false;
-	}
-
-	return false;
+    return true;
 }
 
-bool ARMKinetisDebug::Flasher::next2()
+bool ARMKinetisDebug::Flasher::programSector()
 {
-/*    target.log(LOG_NORMAL, "FLASH: flashSectorErase");
-    if (!target.flashSectorErase(address+REG_APPLICATION_BASE))
+    uint32_t flashAddress = address + REG_APPLICATION_BASE;
+    uint32_t sectorHash = hash(kHashSeed, (const uint8_t *) buffer, kEraseSectorSize);
+
+    bool changed = true;
+    if (deltaMode)
     {
-        target.log(LOG_NORMAL, "FLASH: flashSectorErase failed");
-        return false;
+        //Flash can't be read while the loader is still programming the previous sector
+        if (useLoader && !target.flashLoaderWait()) return false;
+
+        uint32_t flashHash = kHashSeed;
+        if (!readHash(flashAddress, kEraseSectorSize, flashHash)) return false;
+        changed = flashHash != sectorHash;
     }
-    else
-    {
-        target.log(LOG_NORMAL, "Sector %08x erased", address+REG_APPLICATION_BASE);
-    }*/
 
-    bool result = true;
-    uint32_t bufferAddress = 0;
-    uint8_t word[4];
-    uint16_t i = 0;
-    memset(word,0,4);
-	uint32_t buffer[kFlashSectorSize/4];
-	memset(buffer,0,sizeof(uint32_t)*(kFlashSectorSize/4));
-    while(bufferAddress < (sectorSizeInBytes/4))
+    if (changed && useLoader)
     {
-        if (i > 0 && i % 4 == 0)
+        //The loader erases the sector with the first section and programs while we fill the next slot
+        for (uint32_t offset = 0; offset < kEraseSectorSize; offset += kFlashSectorSize)
         {
-            //uint32_t data = (word[0] << 24) + (word[1] << 16) + (word[2] << 8) + word[3];
-	        uint32_t data = (word[3] << 24) + (word[2] << 16) + (word[1] << 8) + word[0];
-/*            if (!target.memStore(bufferAddress + REG_FLEXRAM_BASE,data))
-            {
-                target.log(LOG_NORMAL, "FLASH: Failed to write longword at %08x, 0: %02x, 1: %02x, 2: %02x, 3: %02x, Word: %08x",bufferAddress,word[0],word[1],word[2],word[3],data);
-            }
-            else
-            {
-                target.log(LOG_NORMAL, "FLASH: Wrote longword at %08x, 0: %02x, 1: %02x, 2: %02x, 3: %02x, Word: %08x",bufferAddress,word[0],word[1],word[2],word[3],data);
-            }*/
-
-	        if (address == 0 && bufferAddress < 4)
-	        {
-		        //data = 0xFFFFFFFF;
-	        }
+            const uint32_t *section = buffer + offset/4;
+            uint32_t flags = isErased(section, kFlashSectorSize) ? 0 : FLASH_LOADER_PROGRAM;
+            if (offset == 0) flags |= FLASH_LOADER_ERASE;
 
-	        target.log(LOG_NORMAL, "FLASH: Wrote longword at %08x, 0: %02x, 1: %02x, 2: %02x, 3: %02x, Word: %08x",bufferAddress,word[0],word[1],word[2],word[3],data);
-	        buffer[bufferAddress] = data;
-
-            memset(word,0,4);
-            bufferAddress++;
+            if (flags && !target.flashLoaderQueue(flashAddress + offset, section, flags)) return false;
         }
 
-        int byte = file->read();
-        if (byte == -1)
+        sectorsProgrammed++;
+    }
+    else if (changed)
+    {
+        //Sector size is 2KB, FlexRAM buffer only 1KB, so each sector is programmed in two sections
+        if (!target.flashSectorErase(flashAddress))
         {
-            result = false;
-            break;
+            target.log(LOG_ERROR, "FLASH: flashSectorErase failed at %08x", flashAddress);
+            return false;
         }
-        else
+
+        for (uint32_t offset = 0; offset < kEraseSectorSize; offset += kFlashSectorSize)
         {
-/*            if (address+i >=0x400 && address+i <= 0x40F)
-            {
-                target.log(LOG_NORMAL,"Overriding flash security bit");
-                byte = 0xFF;
-            }*/
-            word[i % 4] = byte;
+            const uint32_t *section = buffer + offset/4;
+
+            //Erased flash is already 0xFF, no need to program the padding after the image
+            if (isErased(section, kFlashSectorSize)) continue;
+            if (!programSection(flashAddress + offset, section)) return false;
         }
 
-        ESP.wdtFeed();
-        i++;
+        sectorsProgrammed++;
     }
-
-    if (result == false && i % 4 != 0)
+    else
     {
-        Serial.println("Packing last word");
+        sectorsSkipped++;
+    }
 
-	    //uint32_t data = (word[0] << 24) + (word[1] << 16) + (word[2] << 8) + word[3];
-	    uint32_t data = (word[3] << 24) + (word[2] << 16) + (word[1] << 8) + word[0];
-/*        if (!target.memStore(bufferAddress+REG_FLEXRAM_BASE,data))
-        {
-            target.log(LOG_NORMAL, "FLASH: Failed to write longword at %08x, 0: %02x, 1: %02x, 2: %02x, 3: %02x, Word: %08x",bufferAddress,word[0],word[1],word[2],word[3],data);
-        }
-        else
-        {
-            const uint8_t* bytes = &word[0];
-            uint8_t byte0 = *(bytes+(3*sizeof(uint8_t)));
-            uint8_t byte1 = *(bytes+(2*sizeof(uint8_t)));
-            uint8_t byte2 = *(bytes+(1*sizeof(uint8_t)));
-            uint8_t byte3 = *(bytes+(0*sizeof(uint8_t)));
-            target.log(LOG_NORMAL, "FLASH: Wrote longword at %08x, 0: %02x, 1: %02x, 2: %02x, 3: %02x, Word: %08x",bufferAddress,byte0,byte1,byte2,byte3,data);
-        }*/
+    imageHash = hash(imageHash, (const uint8_t *) buffer, kEraseSectorSize);
+    address += kEraseSectorSize;
+    bufferOffset = 0;
+    memset(buffer, 0xFF, kEraseSectorSize);
+    ESP.wdtFeed();
+
+    return true;
+}
 
-	    target.log(LOG_NORMAL, "FLASH: Wrote longword at %08x, 0: %02x, 1: %02x, 2: %02x, 3: %02x, Word: %08x",bufferAddress,word[0],word[1],word[2],word[3],data);
+bool ARMKinetisDebug::Flasher::write(const uint8_t *data, uint32_t size)
+{
+    // Both ESP8266 and Kinetis are little endian, so bytes can be copied into the longword buffer
+    while (size > 0)
+    {
+        uint32_t count = kEraseSectorSize - bufferOffset;
+        if (count > size) count = size;
 
-	    buffer[bufferAddress] = data;
+        memcpy(((uint8_t *) buffer) + bufferOffset, data, count);
+        bufferOffset += count;
+        data += count;
+        size -= count;
 
-	    bufferAddress++;
+        if (bufferOffset == kEraseSectorSize && !programSector()) return false;
     }
-/*
-	//Fill rest of section with 0 bytes
-	while(bufferAddress < (sectorSizeInBytes/4))
-	{
-		uint32_t data = 0;
-		if (!target.memStore(bufferAddress + REG_FLEXRAM_BASE,data))
-		{
-			target.log(LOG_NORMAL, "FLASH: Failed to write longword at %08x, 0: %02x, 1: %02x, 2: %02x, 3: %02x, Word: %08x",bufferAddress,word[0],word[1],word[2],word[3],data);
-		}
-		else
-		{
-			target.log(LOG_NORMAL, "FLASH: Wrote longword at %08x, 0: %02x, 1: %02x, 2: %02x, 3: %02x, Word: %08x",bufferAddress,word[0],word[1],word[2],word[3],data);
-		}
 
-		bufferAddress++;
-	}*/
+    return true;
+}
 
-	//Write buffer to device
-	target.log(LOG_NORMAL,"Writing buffer to FlexRAM");
-	if (!target.flashSectorBufferWrite(0,buffer,kFlashSectorSize/4))
-	{
-		target.log(LOG_ERROR,"Failed to write buffer to FlexRAM");
-		return false;
-	}
+bool ARMKinetisDebug::Flasher::finish()
+{
+    // Program the last, partially filled sector. The rest stays 0xFF like erased flash
+    if (bufferOffset > 0 && !programSector()) return false;
 
-    i = 0;
-    target.log(LOG_NORMAL, "FLASH: flashSectorProgram: %08x",address+REG_APPLICATION_BASE);
-    while (!target.ftfl_programSection(address+REG_APPLICATION_BASE, sectorSizeInBytes/8))
-    {
-        i++;
-        if (i > 20)
-        {
-            target.log(LOG_ERROR,"FLASH: flashSectorProgram failed 20 times in series - giving up.");
-            return false;
-        }
+    // Wait for the loader to program the last sections and halt the core again
+    if (useLoader && !target.flashLoaderEnd()) return false;
+    useLoader = false;
 
-        target.log(LOG_NORMAL, "FLASH: flashSectorProgram failed");
-        delay(25);
+    target.log(LOG_NORMAL, "FLASH: %d bytes processed, %d sectors programmed, %d unchanged, hash: %08x",
+               address, sectorsProgrammed, sectorsSkipped, imageHash);
+    return true;
+}
+
+bool ARMKinetisDebug::Flasher::verify()
+{
+    // Read back all processed sectors and compare the hash with the one of the data we received
+    uint32_t value = kHashSeed;
+    if (!readHash(REG_APPLICATION_BASE, address, value)) return false;
+
+    if (value != imageHash)
+    {
+        target.log(LOG_ERROR, "FLASH: Verify failed, expected hash %08x, actual %08x", imageHash, value);
+        return false;
     }
 
-    return result;
+    target.log(LOG_NORMAL, "FLASH: Verify successful");
+    return true;
 }
 
 ARMKinetisDebug::FlashProgrammer::FlashProgrammer(
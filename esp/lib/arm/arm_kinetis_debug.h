@@ -78,12 +78,24 @@ public:
     // Write one flash sector from the buffer
     bool flashSectorProgram(uint32_t address);
 
+    /*
+     * RAM-resident flash loader. The loader is copied to target SRAM and runs on the
+     * MK20 itself, erasing and programming sections from a double buffered mailbox.
+     * flashLoaderQueue() only waits if both mailbox slots are still busy.
+     */
+    bool flashLoaderBegin();
+    bool flashLoaderQueue(uint32_t address, const uint32_t *data, uint32_t flags);
+    bool flashLoaderWait();
+    bool flashLoaderEnd();
+
     bool eraseEverything();
 
     bool setProtectionBits(bool protect);
 
     bool dumpSector(uint32_t address);
 
+    static const uint32_t kFlashSectorSize = 1024;
+
     /*
      * High-level flash programming manager. Handles the entire programming process,
      * including protection resets and verification.
@@ -110,21 +122,48 @@ public:
         Flasher(ARMKinetisDebug &target);
         bool installFirmware(File* file);
 
-    private:
-        ARMKinetisDebug &target;
-        File* file;
+        /*
+         * Streaming interface. Firmware data is passed in arbitrary chunks with write(),
+         * each erase sector is programmed as soon as the buffer is full. A hash of all
+         * programmed sectors is kept so verify() can check the flash content without
+         * having the complete image.
+         *
+         * In delta mode (the default) the current flash content of each sector is read
+         * back and hashed first, sectors that did not change are neither erased nor
+         * programmed. In loader mode (the default) sections are handed to the flash
+         * loader running on the target instead of driving the flash controller over SWD.
+         */
         bool begin();
+        bool write(const uint8_t *data, uint32_t size);
+        bool finish();
         bool end();
-        bool next();
-        bool next2();
+        bool verify();
+        void setDeltaMode(bool enable) { deltaMode = enable; }
+        void setLoaderMode(bool enable) { loaderMode = enable; }
+        uint32_t bytesProgrammed() const { return address; }
+
+    private:
+        ARMKinetisDebug &target;
+        bool programSector();
+        bool programSection(uint32_t flashAddress, const uint32_t *data);
+        bool readHash(uint32_t flashAddress, uint32_t size, uint32_t &value);
+        static bool isErased(const uint32_t *data, uint32_t size);
+        static uint32_t hash(uint32_t value, const uint8_t *data, uint32_t size);
+        static const uint32_t kHashSeed = 2166136261UL;
+        static const uint32_t kEraseSectorSize = 2 * kFlashSectorSize;
         uint32_t address;
-        uint8_t sector;
         int sectorSizeInBytes;
         int byteAlignment;
+        bool deltaMode;
+        bool loaderMode;
+        bool useLoader;
+        uint16_t sectorsProgrammed;
+        uint16_t sectorsSkipped;
+        uint32_t buffer[kEraseSectorSize/4];
+        uint32_t bufferOffset;
+        uint32_t imageHash;
     };
 
-    static const uint32_t kFlashSectorSize = 1024;
-
     // Port constants. (Corresponds to PCR address base)
     enum Port {
         PTA = 0x0000,
@@ -186,6 +225,10 @@ public:
 protected:
     bool testMemoryAccess();
 
+    // Flash loader mailbox handling
+    unsigned flashLoaderSlot;
+    bool flashLoaderWaitSlot(unsigned slot);
+
 
 
     // Low-level flash interface
@@ -0,0 +1,142 @@
+/*
+ * RAM-resident flash loader for the MK20, uploaded and started via SWD by ARMKinetisDebug.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+#include <stdint.h>
+
+/*
+ * The loader is position independent Thumb-2 code. It is started with r0 pointing
+ * to the first of two mailbox slots and never returns. It disables the watchdog and
+ * then processes both slots in turn:
+ *
+ *   +0   state    written by the ESP (READY), answered by the loader (DONE or ERROR)
+ *   +4   address  flash address of the 1 KB section
+ *   +8   flags    FLASH_LOADER_ERASE erases the 2 KB sector first,
+ *                 FLASH_LOADER_PROGRAM copies data to FlexRAM and programs the section
+ *   +12  status   FSTAT error bits of the failed command
+ *   +16  data     1 KB section data
+ *
+ * While the loader erases and programs one slot, the ESP fills the other one.
+ *
+ *     @ r0 = address of slot 0, slot 1 follows after 16 + 1024 bytes
+ * entry:
+ *     ldr     r1, =0x40052000         @ WDOG
+ *     movw    r2, #0xC520
+ *     movw    r3, #0xD928
+ *     strh    r2, [r1, #0xE]          @ WDOG_UNLOCK
+ *     strh    r3, [r1, #0xE]
+ *     movs    r2, #0x10               @ ALLOWUPDATE, watchdog disabled
+ *     strh    r2, [r1]                @ WDOG_STCTRLH
+ *     cpsid   i
+ *     ldr     r4, =0x40020000         @ FTFL
+ *     mov     r8, r0                  @ slot 0
+ *     add     r9, r0, #1040           @ slot 1
+ *     mov     r5, r8
+ * next:
+ *     ldr     r1, [r5]
+ *     cmp     r1, #1                  @ wait for READY
+ *     bne     next
+ *     ldr     r6, [r5, #4]            @ flash address
+ *     ldr     r7, [r5, #8]            @ flags
+ *     movs    r0, #0
+ *     tst     r7, #1                  @ erase sector
+ *     beq     noerase
+ *     movs    r1, #0x09
+ *     bl      command
+ *     cbnz    r0, done
+ * noerase:
+ *     tst     r7, #2                  @ program section
+ *     beq     done
+ *     add     r1, r5, #16
+ *     ldr     r2, =0x14000000         @ FlexRAM
+ *     mov     r3, #1024
+ * copy:
+ *     ldr     r0, [r1], #4
+ *     str     r0, [r2], #4
+ *     subs    r3, #4
+ *     bne     copy
+ *     movs    r1, #0x0B
+ *     bl      command
+ * done:
+ *     str     r0, [r5, #12]           @ status = FSTAT error bits
+ *     cmp     r0, #0
+ *     ite     eq
+ *     moveq   r1, #2                  @ DONE
+ *     movne   r1, #3                  @ ERROR
+ *     str     r1, [r5]
+ *     cmp     r5, r8                  @ switch slot
+ *     ite     eq
+ *     moveq   r5, r9
+ *     movne   r5, r8
+ *     b       next
+ *     @ r1 = command, r6 = address, returns FSTAT error bits in r0
+ * command:
+ *     ldrb    r2, [r4]
+ *     tst     r2, #0x80               @ wait for CCIF
+ *     beq     command
+ *     strb    r1, [r4, #7]            @ FCCOB0
+ *     lsrs    r2, r6, #16
+ *     strb    r2, [r4, #6]            @ FCCOB1
+ *     lsrs    r2, r6, #8
+ *     strb    r2, [r4, #5]            @ FCCOB2
+ *     strb    r6, [r4, #4]            @ FCCOB3
+ *     movs    r2, #0
+ *     strb    r2, [r4, #0xB]          @ FCCOB4, number of phrases high byte
+ *     movs    r2, #128
+ *     strb    r2, [r4, #0xA]          @ FCCOB5, 128 phrases = 1 KB
+ *     movs    r2, #0x30
+ *     strb    r2, [r4]                @ clear ACCERR and FPVIOL
+ *     movs    r2, #0x80
+ *     strb    r2, [r4]                @ launch
+ * wait:
+ *     ldrb    r2, [r4]
+ *     tst     r2, #0x80
+ *     beq     wait
+ *     and     r0, r2, #0x71           @ RDCOLERR, ACCERR, FPVIOL, MGSTAT0
+ *     bx      lr
+ */
+
+#define FLASH_LOADER_CODE_ADDRESS   0x20000000
+#define FLASH_LOADER_MAILBOX        0x20000400
+#define FLASH_LOADER_SLOT_SIZE      (16 + 1024)
+#define FLASH_LOADER_TIMEOUT        2000
+
+#define FLASH_LOADER_EMPTY          0
+#define FLASH_LOADER_READY          1
+#define FLASH_LOADER_DONE           2
+#define FLASH_LOADER_ERROR          3
+
+#define FLASH_LOADER_ERASE          0x01
+#define FLASH_LOADER_PROGRAM        0x02
+
+static const uint32_t kFlashLoaderCode[] = {
+    0xf24c4928, 0xf64d5220, 0x81ca1328, 0x221081cb, 0xb672800a, 0x46804c24,
+    0x6982f500, 0x68294645, 0xd1fc2901, 0x68af686e, 0xf0172000, 0xd0030f01,
+    0xf0002109, 0xb988f81e, 0x0f02f017, 0xf105d00e, 0xf04f0110, 0xf24052a0,
+    0xf8514300, 0xf8420b04, 0x3b040b04, 0x210bd1f9, 0xf80bf000, 0x280060e8,
+    0x2102bf0c, 0x60292103, 0xbf0c4545, 0x4645464d, 0x7822e7d5, 0x0f80f012,
+    0x71e1d0fb, 0x71a20c32, 0x71620a32, 0x22007126, 0x228072e2, 0x223072a2,
+    0x22807022, 0x78227022, 0x0f80f012, 0xf002d0fb, 0x47700071, 0x40052000,
+    0x40020000,
+};
@@ -41,7 +41,9 @@
 #include <EEPROM.h>
 #include <controllers/ESPFirmwareUpdate.h>
 #include <controllers/MK20FirmwareUpdate.h>
+#include "controllers/MK20FirmwareStreamUpdate.h"
 #include "event_logger.h"
+#include "web_server.h"
 #include "controllers/CheckForFirmwareUpdates.h"
 #include "controllers/DownloadFileToSPIFFs.h"
 #include "controllers/Idle.h"
@@ -49,6 +51,7 @@
 
 Config config;
 ApplicationClass Application;
+extern WebServer webserver;
 
 ApplicationClass::ApplicationClass() {
   _firstModeLoop = true;
@@ -66,6 +69,9 @@ ApplicationClass::ApplicationClass() {
 
   //Clear system info
   memset(&_systemInfo, 0, sizeof(SystemInfo));
+  memset(&_printerState, 0, sizeof(PrinterState));
+  memset(&_metrics, 0, sizeof(Metrics));
+  _metricsTime = 0;
   _systemInfo.buildNr = FIRMWARE_BUILDNR;
   strcpy(_systemInfo.firmwareVersion, FIRMWARE_VERSION);
 }
@@ -281,6 +287,9 @@ void ApplicationClass::loop() {
 	_lastTime = millis();
 	_firstModeLoop = false;
   }
+
+  //Send log messages collected during this loop to /events clients
+  EventLogger::flush();
 }
 
 void ApplicationClass::idle() {
@@ -308,10 +317,9 @@ void ApplicationClass::startFirmwareUpdate() {
   String mk20FirmwareFile("/mk20.bin");
   String mk20UIFile("/ui.min");
 
-  //Define modes
-  DownloadFileToSPIFFs
-	  *downloadMK20Firmware = new DownloadFileToSPIFFs(_firmwareUpdateInfo->mk20_url, mk20FirmwareFile);
-  MK20FirmwareUpdate *mk20UpdateFirmware = new MK20FirmwareUpdate(mk20FirmwareFile);
+  //Define modes, MK20 firmware is flashed while downloading and only stored in SPIFFS if that fails
+  MK20FirmwareStreamUpdate
+	  *mk20UpdateFirmware = new MK20FirmwareStreamUpdate(_firmwareUpdateInfo->mk20_url, mk20FirmwareFile);
   DownloadFileToSPIFFs *downloadUI = new DownloadFileToSPIFFs(_firmwareUpdateInfo->mk20_ui_url, mk20UIFile);
   PushFileToSDCard *pushUIToSDCard = new PushFileToSDCard(mk20UIFile, mk20UIFile, false, Compression::RLE16);
   ESPFirmwareUpdate *espUpdateFirmware = new ESPFirmwareUpdate(_firmwareUpdateInfo->esp_url);
@@ -322,18 +330,15 @@ void ApplicationClass::startFirmwareUpdate() {
 	EventLogger::log("Skipping UI update as MK20 is not alive");
 	firstMode = downloadUI;
 	downloadUI->setNextMode(pushUIToSDCard);
-	pushUIToSDCard->setNextMode(downloadMK20Firmware);
+	pushUIToSDCard->setNextMode(mk20UpdateFirmware);
   }
 
-  //2) Download MK20 firmware and flash MK20
-  downloadMK20Firmware->setNextMode(mk20UpdateFirmware);
-
-  //3) Download ESP firmware and update ESP
+  //2) Download MK20 firmware and flash MK20, then 3) download ESP firmware and update ESP
   mk20UpdateFirmware->setNextMode(espUpdateFirmware);
 
   //Start with MK20 firmware update if no steps before have been defined
   if (firstMode == NULL) {
-	firstMode = downloadMK20Firmware;
+	firstMode = mk20UpdateFirmware;
   }
 
   //Let's get started
@@ -361,6 +366,18 @@ bool ApplicationClass::runTask(CommHeader &header, const uint8_t *data, size_t d
 	  //Initiate mode for file download
 	  EventLogger::log("Download-URL: %s", _url);
 	  DownloadFileToSDCard * df = new DownloadFileToSDCard(String(_url));
+
+	  //MK20 may append a zero terminator, the number of bytes it already has and the ETag of the partial file to
+	  //continue an interrupted download
+	  size_t urlLength = strlen(_url);
+	  if (header.contentLength >= urlLength + 1 + sizeof(uint32_t)) {
+		uint32_t offset;
+		memcpy(&offset, data + urlLength + 1, sizeof(uint32_t));
+		String etag(_url + urlLength + 1 + sizeof(uint32_t));
+		EventLogger::log("Resuming download at %d, ETag: %s", offset, etag.c_str());
+		df->setResumeOffset(offset, etag);
+	  }
+
 	  Application.pushMode(df);
 	}
   } else if (taskID == TaskID::Ping) {
@@ -424,7 +441,66 @@ bool ApplicationClass::runTask(CommHeader &header, const uint8_t *data, size_t d
 
 	*sendResponse = false;
   } else if (taskID == TaskID::DebugLog) {
-	//Just ignore it and don't send a response
+	//MK20 sends batches of log lines, pass them on to /events clients
+	char buffer[256];
+	size_t size = dataSize < sizeof(buffer) - 1 ? dataSize : sizeof(buffer) - 1;
+	memcpy(buffer, data, size);
+	buffer[size] = 0;
+
+	char *line = strtok(buffer, "\r\n");
+	while (line != NULL) {
+	  EventLogger::log("MK20 %s", line);
+	  line = strtok(NULL, "\r\n");
+	}
+
+	//Don't send a response
+	*sendResponse = false;
+  } else if (taskID == TaskID::PrinterState) {
+	//MK20 only sends the fields that changed, in the order of their bits, followed by the job name
+	const uint8_t *end = data + dataSize;
+	const uint8_t *pos = data + 1;
+	uint8_t fields = dataSize > 0 ? data[0] : 0;
+	PrinterState state = _printerState;
+
+	uint8_t *members[] = {&state.printing, &state.stat, (uint8_t *) &state.progress, (uint8_t *) &state.nozzleTemperature, (uint8_t *) &state.line, (uint8_t *) &state.totalLines};
+	size_t sizes[] = {sizeof(state.printing), sizeof(state.stat), sizeof(state.progress), sizeof(state.nozzleTemperature), sizeof(state.line), sizeof(state.totalLines)};
+	bool valid = dataSize > 0;
+	for (int i = 0; i < 6 && valid; i++) {
+	  if (!(fields & (1 << i))) continue;
+	  if (pos + sizes[i] > end) {
+		valid = false;
+		break;
+	  }
+	  memcpy(members[i], pos, sizes[i]);
+	  pos += sizes[i];
+	}
+	if (valid && (fields & PRINTER_STATE_JOB)) {
+	  size_t length = strnlen((const char *) pos, end - pos);
+	  if (length >= (size_t) (end - pos) || length >= sizeof(state.job)) {
+		valid = false;
+	  } else {
+		memcpy(state.job, pos, length + 1);
+	  }
+	}
+
+	if (valid) {
+	  _printerState = state;
+	  webserver.sendPrinterState(fields);
+	} else {
+	  EventLogger::log("Invalid printer state package with %d bytes", (int) dataSize);
+	}
+
+	//Don't send a response
+	*sendResponse = false;
+  } else if (taskID == TaskID::Metrics) {
+	if (dataSize == sizeof(Metrics)) {
+	  memcpy(&_metrics, data, sizeof(Metrics));
+	  _metricsTime = millis();
+	} else {
+	  EventLogger::log("Invalid metrics package with %d bytes", (int) dataSize);
+	}
+
+	//Don't send a response
 	*sendResponse = false;
   } else if (taskID == TaskID::GetSystemInfo) {
 	EventLogger::log("Got SystemInfo Request");
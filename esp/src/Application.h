@@ -37,6 +37,8 @@
 
 #include <Arduino.h>
 #include "core/CommStack.h"
+//Profiler metrics pushed by the MK20 with TaskID::Metrics, the header is shared with its Profiler
+#include "../../mk20/src/framework/core/ProfileMetrics.h"
 #include <FS.h>
 #include "event_logger.h"
 #include "MK20.h"
@@ -72,6 +74,26 @@ struct SystemInfo {
   bool hasPassword;
 };
 
+//Fields of PrinterState that changed, the MK20 only sends flagged fields (in bit order) after a leading fields byte
+#define PRINTER_STATE_PRINTING 0x01
+#define PRINTER_STATE_STAT 0x02
+#define PRINTER_STATE_PROGRESS 0x04
+#define PRINTER_STATE_NOZZLE_TEMP 0x08
+#define PRINTER_STATE_LINE 0x10
+#define PRINTER_STATE_TOTAL_LINES 0x20
+#define PRINTER_STATE_JOB 0x40
+#define PRINTER_STATE_ALL 0x7F
+
+struct PrinterState {
+  uint8_t printing;
+  uint8_t stat;
+  uint16_t progress;          //0.01%
+  int16_t nozzleTemperature;  //0.1 degrees celsius
+  int32_t line;
+  int32_t totalLines;
+  char job[32];
+};
+
 class ApplicationClass : CommStackDelegate {
 
  public:
@@ -103,6 +125,9 @@ class ApplicationClass : CommStackDelegate {
   bool firmwareUpdateAvailable() { return _firmwareUpdateInfo != NULL; };
   FirmwareUpdateInfo *getFirmwareUpdateInfo() { return _firmwareUpdateInfo; };
   SystemInfo *getSystemInfo() { return &_systemInfo; };
+  PrinterState *getPrinterState() { return &_printerState; };
+  Metrics *getMetrics() { return _metricsTime > 0 ? &_metrics : NULL; };
+  unsigned long getMetricsTime() { return _metricsTime; };
 
  private:
   void initializeHub();
@@ -125,6 +150,9 @@ class ApplicationClass : CommStackDelegate {
   int _buildNumber;
   FirmwareUpdateInfo *_firmwareUpdateInfo;
   SystemInfo _systemInfo;
+  PrinterState _printerState;
+  Metrics _metrics;
+  unsigned long _metricsTime;
   bool _firmwareChecked;
 };
 
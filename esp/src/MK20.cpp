@@ -54,7 +54,7 @@ void MK20::reset() {
   pinMode(MK20_RESET_PIN, INPUT);
 }
 
-bool MK20::writeFirmware(File &firmware_file) {
+bool MK20::beginFirmwareUpdate(ARMKinetisDebug &target) {
   EventLogger::log("Reseting Teensy - the hard way");
 
   //Reset MK20
@@ -65,8 +65,6 @@ bool MK20::writeFirmware(File &firmware_file) {
 
   EventLogger::log("Flashing");
 
-  // flash here
-  ARMKinetisDebug target(MK20_SWD_CLK, MK20_SWD_IO, ARMDebug::LOG_NORMAL);
   uint32_t idcode;
   if (target.begin() && target.getIDCODE(idcode)) {
 	char result[128];
@@ -112,8 +110,22 @@ bool MK20::writeFirmware(File &firmware_file) {
   delay(200);
   ESP.wdtFeed();
 
-  ARMKinetisDebug::Flasher programmer(target);
-  if (!programmer.installFirmware(&firmware_file)) {
+  return true;
+}
+
+bool MK20::writeFirmware(File &firmware_file) {
+  // flash here
+  ARMKinetisDebug target(MK20_SWD_CLK, MK20_SWD_IO, ARMDebug::LOG_NORMAL);
+  if (!beginFirmwareUpdate(target)) {
+	return false;
+  }
+
+  //The flasher buffers a complete 2KB flash sector, keep it off the stack
+  ARMKinetisDebug::Flasher *programmer = new ARMKinetisDebug::Flasher(target);
+  bool result = programmer->installFirmware(&firmware_file);
+  delete programmer;
+
+  if (!result) {
 	EventLogger::log("Failed to flash");
 
 	//Sometimes, it's just the soft reset that fails after flashing, so do a hard reset and hope for the best
@@ -195,8 +207,13 @@ bool MK20::sendSDFileData(uint8_t *data, size_t size) {
   return true;
 }
 
-bool MK20::closeSDFile() {
-  Application.getMK20Stack()->requestTask(TaskID::FileClose);
+bool MK20::closeSDFile(bool discard) {
+  if (discard) {
+	uint8_t discardFile = 1;
+	Application.getMK20Stack()->requestTask(TaskID::FileClose, sizeof(discardFile), &discardFile);
+  } else {
+	Application.getMK20Stack()->requestTask(TaskID::FileClose);
+  }
 
   return true;
 }
@@ -37,12 +37,15 @@
 #include "config.h"
 #include <FS.h>
 
+class ARMKinetisDebug;
+
 class MK20 : public CommStack {
  public:
   MK20(Stream *port, CommStackDelegate *delegate);
   ~MK20();
 
   void reset();
+  bool beginFirmwareUpdate(ARMKinetisDebug &target);
   bool writeFirmware(File &file);
   bool updateFirmware(String localFilePath);
   void showUpdateFirmwareNotification();
@@ -65,7 +68,8 @@ class MK20 : public CommStack {
   bool needsUpdate() { return FIRMWARE_BUILDNR > _buildNumber; };
   bool openSDFileForWrite(String targetFilePath, size_t bytesToSend, bool showUI = false, Compression compression = Compression::None);
   bool sendSDFileData(uint8_t *data, size_t size);
-  bool closeSDFile();
+  //Discarding asks MK20 to remove the file, i.e. after an aborted transfer
+  bool closeSDFile(bool discard = false);
   void showWiFiInfo();
 
  private:
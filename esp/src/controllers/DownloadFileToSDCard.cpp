@@ -49,8 +49,19 @@ String DownloadFileToSDCard::getName() {
 }
 
 bool DownloadFileToSDCard::onBeginDownload(uint32_t expectedSize) {
-  Application.getMK20Stack()->responseTask(TaskID::DownloadFile, sizeof(uint32_t), (uint8_t *) &expectedSize, true);
+  //Response contains the file size, the offset of the first byte we will send (0 if the server did not accept the resume
+  //request) and the ETag MK20 stores to resume the download later
+  uint8_t response[2 * sizeof(uint32_t) + DOWNLOADURL_MAX_ETAG_LENGTH];
+  uint32_t offset = getResumeOffset();
+  String etag = isResumable() ? getETag() : String("");
+  memcpy(response, &expectedSize, sizeof(uint32_t));
+  memcpy(response + sizeof(uint32_t), &offset, sizeof(uint32_t));
+  memcpy(response + 2 * sizeof(uint32_t), etag.c_str(), etag.length());
+
+  Application.getMK20Stack()->responseTask(TaskID::DownloadFile, 2 * sizeof(uint32_t) + etag.length(), response, true);
   _errorTime = 0;
+
+  return true;
 }
 
 bool DownloadFileToSDCard::onDataReceived(uint8_t *data, uint16_t size) {
@@ -35,7 +35,13 @@
 
 DownloadFileToSPIFFs::DownloadFileToSPIFFs(String url, String localFilePath) :
 	DownloadURL(url),
-	_localFilePath(localFilePath) {}
+	_localFilePath(localFilePath),
+	_sidecarFilePath(localFilePath + DOWNLOAD_SIDECAR_EXTENSION),
+	_urlHash(hashUrl(url)),
+	_validBytes(0),
+	_bytesSinceSidecar(0) {
+  loadSidecar();
+}
 
 DownloadFileToSPIFFs::~DownloadFileToSPIFFs() {
 }
@@ -44,10 +50,81 @@ String DownloadFileToSPIFFs::getName() {
   return "DownloadFileToSPIFFs";
 }
 
+uint32_t DownloadFileToSPIFFs::hashUrl(const String &url) {
+  //32 bit FNV-1a
+  uint32_t hash = 2166136261UL;
+  for (unsigned int i = 0; i < url.length(); i++) {
+	hash ^= (uint8_t) url.charAt(i);
+	hash *= 16777619UL;
+  }
+  return hash;
+}
+
+void DownloadFileToSPIFFs::loadSidecar() {
+  if (!SPIFFS.exists(_sidecarFilePath) || !SPIFFS.exists(_localFilePath)) {
+	return;
+  }
+
+  DownloadSidecar sidecar;
+  File file = SPIFFS.open(_sidecarFilePath, "r");
+  size_t size = file.read((uint8_t *) &sidecar, sizeof(DownloadSidecar));
+  file.close();
+
+  //We can only append, so the partial file must end exactly where the validated data ends
+  File partialFile = SPIFFS.open(_localFilePath, "r");
+  size_t partialSize = partialFile.size();
+  partialFile.close();
+
+  sidecar.etag[DOWNLOADURL_MAX_ETAG_LENGTH] = 0;
+  if (size != sizeof(DownloadSidecar) || sidecar.urlHash != _urlHash || sidecar.validBytes != partialSize
+	  || strlen(sidecar.etag) == 0) {
+	EventLogger::log("Discarding partial download of %s", _localFilePath.c_str());
+	removeSidecar();
+	return;
+  }
+
+  EventLogger::log("Found partial download of %s with %d bytes", _localFilePath.c_str(), sidecar.validBytes);
+  setResumeOffset(sidecar.validBytes, String(sidecar.etag));
+}
+
+void DownloadFileToSPIFFs::writeSidecar() {
+  //Without an ETag we could not tell if the file on the server changed, so we don't resume
+  String etag = getETag();
+  if (etag.length() == 0) {
+	return;
+  }
+
+  DownloadSidecar sidecar;
+  memset(&sidecar, 0, sizeof(DownloadSidecar));
+  sidecar.urlHash = _urlHash;
+  sidecar.validBytes = _validBytes;
+  strncpy(sidecar.etag, etag.c_str(), DOWNLOADURL_MAX_ETAG_LENGTH);
+
+  File file = SPIFFS.open(_sidecarFilePath, "w");
+  file.write((uint8_t *) &sidecar, sizeof(DownloadSidecar));
+  file.close();
+}
+
+void DownloadFileToSPIFFs::removeSidecar() {
+  if (SPIFFS.exists(_sidecarFilePath)) {
+	SPIFFS.remove(_sidecarFilePath);
+  }
+}
+
 bool DownloadFileToSPIFFs::onBeginDownload(uint32_t expectedSize) {
   //_file = SPIFFS.open("/download.tmp", "w");
-  EventLogger::log("Saving downloaded file in path %s", _localFilePath.c_str());
-  _file = SPIFFS.open(_localFilePath, "w");
+  _validBytes = getResumeOffset();
+  _bytesSinceSidecar = 0;
+
+  if (_validBytes > 0) {
+	EventLogger::log("Continuing download in path %s at %d", _localFilePath.c_str(), _validBytes);
+	_file = SPIFFS.open(_localFilePath, "a");
+  } else {
+	EventLogger::log("Saving downloaded file in path %s", _localFilePath.c_str());
+	removeSidecar();
+	_file = SPIFFS.open(_localFilePath, "w");
+  }
+
   if (!_file) {
 	EventLogger::log("Failed to open file %s", _localFilePath.c_str());
 	return false;
@@ -57,23 +134,39 @@ bool DownloadFileToSPIFFs::onBeginDownload(uint32_t expectedSize) {
 }
 
 bool DownloadFileToSPIFFs::onDataReceived(uint8_t *data, uint16_t size) {
-  _file.write(data, size);
+  _validBytes += _file.write(data, size);
+
+  //Record the progress from time to time so we can continue from here if the connection drops
+  _bytesSinceSidecar += size;
+  if (_bytesSinceSidecar >= DOWNLOAD_SIDECAR_INTERVAL) {
+	_file.flush();
+	writeSidecar();
+	_bytesSinceSidecar = 0;
+  }
 
   return true;
 }
 
 void DownloadFileToSPIFFs::onError(DownloadError errorCode) {
+  //Keep what we have, the next attempt continues from here
+  if (_file) {
+	_file.close();
+	writeSidecar();
+  }
+
   HandleDownloadError *error = new HandleDownloadError(errorCode);
   Application.pushMode(error);
 }
 
 void DownloadFileToSPIFFs::onCancelled() {
   _file.close();
+  removeSidecar();
   exit();
 }
 
 void DownloadFileToSPIFFs::onFinished() {
   _file.close();
+  removeSidecar();
 
   //Delete existing file and rename downloaded file
 /*    if (SPIFFS.exists(_localFilePath)) {
@@ -34,6 +34,17 @@
 
 #include "DownloadURL.h"
 
+//Partial downloads are kept together with a small sidecar file (file path + extension) so they can be continued later
+#define DOWNLOAD_SIDECAR_EXTENSION ".part"
+//Number of bytes written between two sidecar updates
+#define DOWNLOAD_SIDECAR_INTERVAL 8192
+
+typedef struct DownloadSidecar {
+  uint32_t urlHash;
+  uint32_t validBytes;
+  char etag[DOWNLOADURL_MAX_ETAG_LENGTH + 1];
+};
+
 class DownloadFileToSPIFFs : public DownloadURL {
  public:
   DownloadFileToSPIFFs(String url, String localFilePath);
@@ -49,8 +60,19 @@ class DownloadFileToSPIFFs : public DownloadURL {
 #pragma mark Mode
   virtual String getName();
 
+#pragma mark Resuming downloads
+ private:
+  static uint32_t hashUrl(const String &url);
+  void loadSidecar();
+  void writeSidecar();
+  void removeSidecar();
+
  private:
   String _localFilePath;
+  String _sidecarFilePath;
+  uint32_t _urlHash;
+  uint32_t _validBytes;
+  uint32_t _bytesSinceSidecar;
   File _file;
 };
 
@@ -39,14 +39,22 @@
 
 // Number of milliseconds to wait without receiving any data before we give up
 const int kNetworkTimeout = 10 * 1000;
-// Number of milliseconds to wait if no data is available before trying again
+// Number of milliseconds to wait before a lost connection is opened again
 const int kNetworkDelay = 100;
 
 DownloadURL::DownloadURL(String url) :
 	Mode(),
 	mode(StateRequest),
 	_url(url),
-	_stream(NULL) {
+	_stream(NULL),
+	_ringBufferHead(0),
+	_ringBufferTail(0),
+	_ringBufferFill(0),
+	_resumeOffset(0),
+	_bytesReceived(0),
+	_resumeAttempts(0),
+	_resumable(false),
+	_reconnectTimeStamp(0) {
   memset(_buffer, 0, _bufferSize);
   _numChunks = 0;
 }
@@ -71,7 +79,7 @@ bool DownloadURL::parseUrl() {
   i = _host.indexOf(':');
   if (i > 0) {
 	EventLogger::log("EXTRACTING PORT");
-	EventLogger::log(_host.substring(i + 1).c_str());
+	EventLogger::log("%s", _host.substring(i + 1).c_str());
 	_port = _host.substring(i + 1).toInt();
 	_host.remove(i);
   } else {
@@ -80,13 +88,13 @@ bool DownloadURL::parseUrl() {
   // parse path
   _path = _url;
 
-  EventLogger::log(_protocol.c_str());
-  EventLogger::log(_host.c_str());
-  EventLogger::log(_url.c_str());
+  EventLogger::log("%s", _protocol.c_str());
+  EventLogger::log("%s", _host.c_str());
+  EventLogger::log("%s", _url.c_str());
 
   char _p[6];
   sprintf(_p, "%05i", _port);
-  EventLogger::log(_p);
+  EventLogger::log("%s", _p);
 
   return true;
 }
@@ -95,9 +103,94 @@ bool DownloadURL::readNextData() {
   return true;
 }
 
+void DownloadURL::setResumeOffset(uint32_t offset, String etag) {
+  _resumeOffset = offset;
+  _etag = etag;
+}
+
+bool DownloadURL::resumeDownload() {
+  //Chunked responses don't tell us how much is missing, and without range support we would get the whole file again
+  if (!_resumable || _bytesToDownload <= 0 || _resumeAttempts >= DOWNLOADURL_MAX_RESUME_ATTEMPTS) {
+	return false;
+  }
+
+  _resumeAttempts++;
+  EventLogger::log("Connection lost, resuming download at %d (attempt %d)", _resumeOffset + _bytesReceived, _resumeAttempts);
+
+  //Data already in the ring buffer is kept, the new request continues right after it. The request is sent again by a
+  //later run loop, so the rest of the application keeps running while we wait
+  _httpClient.end();
+  _stream = NULL;
+  _reconnectTimeStamp = millis();
+  mode = StateReconnect;
+  return true;
+}
+
+bool DownloadURL::fillRingBuffer() {
+  //Read everything the stream has available until the ring buffer is full. Data is written in up to two contiguous
+  //blocks as the free space may wrap around the end of the buffer
+  while (_ringBufferFill < _ringBufferSize && _bytesToDownload != 0) {
+	int size = _stream->available();
+	if (size <= 0) {
+	  break;
+	}
+
+	int contiguous = _ringBufferSize - _ringBufferHead;
+	if (contiguous > (_ringBufferSize - _ringBufferFill)) contiguous = _ringBufferSize - _ringBufferFill;
+	if (size > contiguous) size = contiguous;
+	if (_bytesToDownload > 0 && size > _bytesToDownload) size = _bytesToDownload;
+
+	int c = _stream->readBytes(&_ringBuffer[_ringBufferHead], size);
+	if (c <= 0) {
+	  break;
+	}
+
+	_ringBufferHead = (_ringBufferHead + c) % _ringBufferSize;
+	_ringBufferFill += c;
+	if (_bytesToDownload > 0) {
+	  _bytesToDownload -= c;
+	}
+	_bytesReceived += c;
+
+	_lastBytesReadTimeStamp = millis();
+  }
+
+  //We are waiting for the consumer, not for the network, so this does not count against the timeout
+  if (_ringBufferFill >= _ringBufferSize) {
+	_lastBytesReadTimeStamp = millis();
+  }
+
+  return _ringBufferFill > 0;
+}
+
+uint16_t DownloadURL::readRingBuffer(uint8_t *data, uint16_t size) {
+  if (size > _ringBufferFill) size = _ringBufferFill;
+
+  uint16_t contiguous = _ringBufferSize - _ringBufferTail;
+  if (size <= contiguous) {
+	memcpy(data, &_ringBuffer[_ringBufferTail], size);
+  } else {
+	memcpy(data, &_ringBuffer[_ringBufferTail], contiguous);
+	memcpy(&data[contiguous], _ringBuffer, size - contiguous);
+  }
+
+  _ringBufferTail = (_ringBufferTail + size) % _ringBufferSize;
+  _ringBufferFill -= size;
+
+  return size;
+}
+
 void DownloadURL::loop() {
   int err = 0;
 
+  //Give the network a moment before a lost connection is opened again
+  if (mode == StateReconnect) {
+	if ((millis() - _reconnectTimeStamp) < kNetworkDelay) {
+	  return;
+	}
+	mode = StateRequest;
+  }
+
   //In this mode ESP will try to initiate the download of the requested file and will send the response with number of bytes to download
   if (mode == StateRequest) {
 	if (!_httpClient.begin(_url)) {
@@ -105,22 +198,94 @@ void DownloadURL::loop() {
 	  mode = StateError;
 	  _error = DownloadError::ConnectionFailed;
 	} else {
+	  //If we continue a download only request the missing part. With If-Range the server sends the whole file (200)
+	  //instead of the requested range (206) if the file changed
+	  //Without an ETag we can't tell if the file changed, so we never resume without one
+	  bool reconnect = _bytesReceived > 0;
+	  if (_etag.length() == 0) {
+		_resumeOffset = 0;
+	  }
+	  uint32_t offset = _resumeOffset + _bytesReceived;
+	  if (offset > 0) {
+		_httpClient.addHeader("Range", "bytes=" + String(offset) + "-");
+		_httpClient.addHeader("If-Range", _etag);
+	  }
+
+	  const char *headerKeys[] = {"ETag", "Accept-Ranges", "Content-Range"};
+	  _httpClient.collectHeaders(headerKeys, 3);
+
 	  err = _httpClient.GET();
-	  if (err >= 200 && err <= 299) {
+	  if (err == 416 && offset > 0 && !reconnect) {
+		//If-Range matched, so the file did not change. If it ends where our copy ends ("bytes */<size>") we already
+		//have all of it, otherwise the requested range is not valid (anymore) and we start over
+		String contentRange = _httpClient.header("Content-Range");
+		int sizeIndex = contentRange.indexOf('/');
+		_httpClient.end();
+		if (sizeIndex > 0 && (uint32_t) contentRange.substring(sizeIndex + 1).toInt() == offset) {
+		  EventLogger::log("File is unchanged, nothing to download");
+		  _resumable = true;
+		  _bytesToDownload = 0;
+		  if (!onBeginDownload(offset)) {
+			mode = StateError;
+			_error = DownloadError::UnknownError;
+		  } else {
+			mode = StateSuccess;
+		  }
+		} else {
+		  EventLogger::log("Resume request not satisfiable, downloading complete file");
+		  _resumeOffset = 0;
+		  _etag = "";
+		  return;
+		}
+	  } else if (err >= 200 && err <= 299) {
 		_stream = _httpClient.getStreamPtr();
 		_bytesToDownload = _httpClient.getSize();
 
-		EventLogger::log("Begin Download from %s, size: %d", _url.c_str(), _bytesToDownload);
+		String etag = _httpClient.header("ETag");
+		_resumable = etag.length() > 0 && etag.length() <= DOWNLOADURL_MAX_ETAG_LENGTH && _httpClient.header("Accept-Ranges") != "none";
 
 		if (_stream == NULL || _bytesToDownload == 0) {
 		  mode = StateError;
 		  _error = DownloadError::UnknownError;
+		} else if (reconnect) {
+		  if (err != 206) {
+			//Server sent the complete file, but we already handed over the first part of it
+			EventLogger::log("Server did not accept resume request, Status-Code: %d", err);
+			mode = StateError;
+			_error = DownloadError::UnknownError;
+		  } else {
+			EventLogger::log("Download resumed, bytes left: %d", _bytesToDownload);
+			mode = StateDownload;
+			_lastBytesReadTimeStamp = millis();
+		  }
 		} else {
-		  onBeginDownload(_bytesToDownload);
-
-		  mode = StateDownload;
-		  _lastBytesReadTimeStamp = millis();
+		  if (err != 206) {
+			_resumeOffset = 0;
+		  }
+		  _etag = etag.length() <= DOWNLOADURL_MAX_ETAG_LENGTH ? etag : "";
+
+		  EventLogger::log("Begin Download from %s, size: %d, offset: %d", _url.c_str(), _bytesToDownload, _resumeOffset);
+
+		  if (!onBeginDownload(_resumeOffset + _bytesToDownload)) {
+			//Subclass could not prepare for the data (i.e. file could not be opened)
+			mode = StateError;
+			_error = DownloadError::UnknownError;
+		  } else {
+			mode = StateDownload;
+			_ringBufferHead = 0;
+			_ringBufferTail = 0;
+			_ringBufferFill = 0;
+			_lastBytesReadTimeStamp = millis();
+		  }
+		}
+	  } else if (reconnect) {
+		//Server could not be reached again, try once more until we run out of attempts
+		_httpClient.end();
+		if (!resumeDownload()) {
+		  mode = StateError;
+		  _error = DownloadError::ConnectionFailed;
 		}
+		return;
 	  } else if (err >= 300 && err <= 399) {
 		mode = StateError;
 		_error = DownloadError::Forbidden;
@@ -137,50 +302,47 @@ void DownloadURL::loop() {
 	}
   }
 
-  //In this mode ESP will download the file by chunks of _bufferSize (32 bytes) and will then leave the loop to allow for responses
+  //In this mode ESP will download the file into the ring buffer and hand it over in chunks of _bufferSize (60 bytes).
+  //The stream is read in every run loop, also while the subclass is still waiting for the last chunk to be processed,
+  //so receiving data from the network overlaps with sending data to MK20 and writing to SD card
   if (mode == StateDownload) {
-	//Check if we have to wait until the last data have been processed
-	if (!readNextData()) {
-	  return;
-	}
-
-	while (_httpClient.connected() && (_bytesToDownload > 0 || _bytesToDownload == -1)) {
-	  // get available data size
-	  size_t size = _stream->available();
-	  if (size) {
-		// read up to 128 byte
-		int c = _stream->readBytes(_buffer, ((size > _bufferSize) ? _bufferSize : size));
-
-		//EventLogger::log("Data received, size: %d, bytes left: %d",c,_bytesToDownload);
-		if (c > 0) {
-		  onDataReceived(_buffer, c);
-		  _bytesToDownload -= c;
-		}
-
-		_lastBytesReadTimeStamp = millis();
+	fillRingBuffer();
 
-		//Close this run loop now to keep up the rest of the application loop and to wait for the response
-		return;
-	  } else {
-		//Check for timeout
-		if ((millis() - _lastBytesReadTimeStamp) > kNetworkTimeout) {
-		  EventLogger::log("Download failed, timeout");
+	//Hand over chunks as long as the subclass is ready for new data
+	while (mode == StateDownload && _ringBufferFill > 0 && readNextData()) {
+	  uint16_t c = readRingBuffer(_buffer, _bufferSize);
+	  onDataReceived(_buffer, c);
 
-		  LOG("Connection timeout");
-		  mode = StateError;
-		  _error = DownloadError::Timeout;
-		  return;
-		}
+	  //Top up the ring buffer with data that arrived in the meantime
+	  fillRingBuffer();
+	}
 
-		delay(1);
-	  }
+	//Check if we have to wait until the last data have been processed
+	if (mode != StateDownload) {
+	  return;
+	}
+	if (_ringBufferFill > 0 || !readNextData()) {
+	  return;
 	}
 
 	if (_bytesToDownload == 0) {
 	  mode = StateSuccess;
+	} else if (!_httpClient.connected() && _stream->available() <= 0) {
+	  if (!resumeDownload()) {
+		mode = StateError;
+		_error = DownloadError::Timeout;
+	  }
+	} else if ((millis() - _lastBytesReadTimeStamp) > kNetworkTimeout) {
+	  EventLogger::log("Download failed, timeout");
+
+	  LOG("Connection timeout");
+	  if (!resumeDownload()) {
+		mode = StateError;
+		_error = DownloadError::Timeout;
+	  }
 	} else {
-	  mode = StateError;
-	  _error = DownloadError::Timeout;
+	  //Close this run loop now to keep up the rest of the application loop
+	  return;
 	}
   }
 
@@ -38,10 +38,24 @@
 #include <ESP8266HTTPClient.h>
 #include "../errors.h"
 
-//This is the size of the download buffer. Typically this buffer is filled before onDataReceived is called (but not necessarily)
-//and as we often need to send data using UART (CommStack) we want to keep packets so small that they fit in Serial buffers which
-//are typically 64 bytes.
-#define DOWNLOADURL_BUFFER_SIZE 60
+//This is the size of the download buffer. Typically this buffer is filled before onDataReceived is called (but not necessarily).
+//SD card downloads send each chunk to MK20 in one CommStack packet and wait for the response, so chunks are as large as a
+//packet allows (247 bytes of data, the encoded packet has to fit in COMM_STACK_BUFFER_SIZE). MK20 enlarges its Serial3
+//receive buffer so it holds a complete packet
+#ifndef DOWNLOADURL_BUFFER_SIZE
+#define DOWNLOADURL_BUFFER_SIZE 240
+#endif
+
+//Incoming TCP data is buffered in this ring buffer while earlier chunks are still being processed (i.e. sent to MK20 and
+//written to SD card). If the ring buffer is full we stop reading from the stream and TCP flow control throttles the server
+#define DOWNLOADURL_RING_BUFFER_SIZE 4096
+
+//If the connection drops during a download the request is sent again with a Range header to continue where we stopped.
+//This only works if the server announced that it supports ranges (ETag or Accept-Ranges)
+#define DOWNLOADURL_MAX_RESUME_ATTEMPTS 5
+
+//Maximum length of the ETag stored for resumable downloads, longer ETags are not used
+#define DOWNLOADURL_MAX_ETAG_LENGTH 63
 
 class DownloadURL : public Mode {
  private:
@@ -50,7 +64,8 @@ class DownloadURL : public Mode {
 	StateDownload = 1,
 	StateSuccess = 2,
 	StateError = 3,
-	StateCancelled = 4
+	StateCancelled = 4,
+	StateReconnect = 5
   };
 
 #pragma mark Constructor
@@ -79,18 +94,41 @@ class DownloadURL : public Mode {
 
 #pragma mark Getter and Setter
   uint8_t *getBuffer() { return _buffer; };
+  //Continue a previous download at offset. The ETag of the previous download is sent with If-Range so the server sends
+  //the complete file if it has changed in the meantime. Must be called before the first loop
+  void setResumeOffset(uint32_t offset, String etag);
+  //Offset of the first byte handed to onDataReceived. This is 0 if the server did not accept the resume request
+  uint32_t getResumeOffset() const { return _resumeOffset; };
+  String getETag() const { return _etag; };
+  bool isResumable() const { return _resumable; };
 
-#pragma mark private member variables
+#pragma mark Ring buffer
  private:
+  bool resumeDownload();
+  bool fillRingBuffer();
+  uint16_t readRingBuffer(uint8_t *data, uint16_t size);
+
+#pragma mark private member variables
   State mode;
   DownloadError _error;
   WiFiClient *_stream;
   HTTPClient _httpClient;
   static const int _bufferSize = DOWNLOADURL_BUFFER_SIZE;
   uint8_t _buffer[_bufferSize];
+  static const int _ringBufferSize = DOWNLOADURL_RING_BUFFER_SIZE;
+  uint8_t _ringBuffer[_ringBufferSize];
+  uint16_t _ringBufferHead;
+  uint16_t _ringBufferTail;
+  uint16_t _ringBufferFill;
+  uint32_t _resumeOffset;
+  uint32_t _bytesReceived;
+  uint8_t _resumeAttempts;
+  bool _resumable;
+  String _etag;
   int _numChunks;
   int _bytesToDownload;
   unsigned long _lastBytesReadTimeStamp;
+  unsigned long _reconnectTimeStamp;
 
   int _port;
   String _url;
@@ -0,0 +1,123 @@
+/*
+ * Downloads the MK20 firmware and programs it section by section via SWD while
+ * it is received, without storing it in SPIFFS first. Flash content is verified
+ * against a hash of the received data, if anything fails the firmware is
+ * downloaded to SPIFFS and flashed from there.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "MK20FirmwareStreamUpdate.h"
+#include "MK20FirmwareUpdate.h"
+#include "DownloadFileToSPIFFs.h"
+#include "../hal.h"
+#include "../event_logger.h"
+
+MK20FirmwareStreamUpdate::MK20FirmwareStreamUpdate(String url, String fallbackFilePath) :
+	DownloadURL(url),
+	_url(url),
+	_fallbackFilePath(fallbackFilePath),
+	_target(MK20_SWD_CLK, MK20_SWD_IO, ARMDebug::LOG_NORMAL),
+	_flasher(NULL),
+	_expectedSize(0) {
+}
+
+MK20FirmwareStreamUpdate::~MK20FirmwareStreamUpdate() {
+  if (_flasher != NULL) {
+	delete _flasher;
+  }
+}
+
+String MK20FirmwareStreamUpdate::getName() {
+  return "MK20FirmwareStreamUpdate";
+}
+
+bool MK20FirmwareStreamUpdate::onBeginDownload(uint32_t expectedSize) {
+  EventLogger::log("Streaming MK20 firmware, size: %d", expectedSize);
+  _expectedSize = expectedSize;
+
+  //Returning false ends the download with an error, which triggers the fallback
+  if (!Application.getMK20Stack()->beginFirmwareUpdate(_target)) {
+	EventLogger::log("Could not connect to MK20 via SWD");
+	return false;
+  }
+
+  _flasher = new ARMKinetisDebug::Flasher(_target);
+  if (!_flasher->begin()) {
+	EventLogger::log("Could not prepare MK20 for flashing");
+	return false;
+  }
+
+  return true;
+}
+
+bool MK20FirmwareStreamUpdate::onDataReceived(uint8_t *data, uint16_t size) {
+  if (_flasher == NULL) {
+	return false;
+  }
+
+  if (!_flasher->write(data, size)) {
+	EventLogger::log("Programming MK20 failed at %d", _flasher->bytesProgrammed());
+	cancelDownload();
+	return false;
+  }
+
+  return true;
+}
+
+void MK20FirmwareStreamUpdate::onError(DownloadError errorCode) {
+  EventLogger::log("Download of MK20 firmware failed, Error-Code: %d", errorCode);
+  fallback();
+}
+
+void MK20FirmwareStreamUpdate::onCancelled() {
+  fallback();
+}
+
+void MK20FirmwareStreamUpdate::onFinished() {
+  //Program the last section, reset into debug halt and compare flash content with what we received
+  bool result = _flasher != NULL && _flasher->finish() && _flasher->end() && _flasher->verify();
+
+  //Start the new firmware
+  Application.getMK20Stack()->reset();
+
+  if (!result) {
+	EventLogger::log("Verifying MK20 firmware failed");
+	fallback();
+	return;
+  }
+
+  Application.sendPulse(5, 4);
+  EventLogger::log("MK20 successfully flashed");
+  exit();
+}
+
+void MK20FirmwareStreamUpdate::fallback() {
+  //Partially written or corrupt firmware, download the file to SPIFFS and flash it from there
+  EventLogger::log("Falling back to flashing MK20 from SPIFFS");
+  Application.getMK20Stack()->reset();
+
+  DownloadFileToSPIFFs *downloadMK20Firmware = new DownloadFileToSPIFFs(_url, _fallbackFilePath);
+  MK20FirmwareUpdate *mk20UpdateFirmware = new MK20FirmwareUpdate(_fallbackFilePath);
+  downloadMK20Firmware->setNextMode(mk20UpdateFirmware);
+  mk20UpdateFirmware->setNextMode(getNextMode());
+  Application.pushMode(downloadMK20Firmware);
+}
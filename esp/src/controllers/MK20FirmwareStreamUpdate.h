@@ -0,0 +1,60 @@
+/*
+ * Downloads the MK20 firmware and programs it section by section via SWD while
+ * it is received, without storing it in SPIFFS first. Flash content is verified
+ * against a hash of the received data, if anything fails the firmware is
+ * downloaded to SPIFFS and flashed from there.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ESP_MK20FIRMWARESTREAMUPDATE_H
+#define ESP_MK20FIRMWARESTREAMUPDATE_H
+
+#include "DownloadURL.h"
+#include "arm_kinetis_debug.h"
+
+class MK20FirmwareStreamUpdate : public DownloadURL {
+ public:
+  MK20FirmwareStreamUpdate(String url, String fallbackFilePath);
+  ~MK20FirmwareStreamUpdate();
+
+#pragma mark DownloadURL prototcol
+  virtual bool onBeginDownload(uint32_t expectedSize);
+  virtual bool onDataReceived(uint8_t *data, uint16_t size);
+  virtual void onError(DownloadError errorCode);
+  virtual void onFinished();
+  virtual void onCancelled();
+
+#pragma mark Mode
+  virtual String getName();
+
+ private:
+  void fallback();
+
+ private:
+  String _url;
+  String _fallbackFilePath;
+  ARMKinetisDebug _target;
+  ARMKinetisDebug::Flasher *_flasher;
+  uint32_t _expectedSize;
+};
+
+#endif //ESP_MK20FIRMWARESTREAMUPDATE_H
@@ -40,7 +40,8 @@
 MK20FirmwareUpdate::MK20FirmwareUpdate(String localFilePath) :
 	Mode(),
 	target(MK20_SWD_CLK, MK20_SWD_IO, ARMDebug::LOG_NORMAL),
-	_localFilePath(localFilePath) {
+	_localFilePath(localFilePath),
+	_mk20(Application.getMK20Stack()) {
 
 }
 
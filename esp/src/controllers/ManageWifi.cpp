@@ -97,7 +97,7 @@ void ManageWifi::loop() {
 	  for (int i = 0; i < n; ++i) {
 		//netfile.write(WiFi.SSID(i).c_str());
 		data.add(String(WiFi.SSID(i)));
-		EventLogger::log(WiFi.SSID(i).c_str());
+		EventLogger::log("%s", WiFi.SSID(i).c_str());
 		delay(10);
 	  }
 	}
@@ -103,7 +103,7 @@ void PushFileToSDCard::loop() {
   int numReadBytes = _localFile.read(buffer, _bytesLeft > chunkSize ? chunkSize : _bytesLeft);
   _bytesLeft -= numReadBytes;
 
-  EventLogger::log("Sending %d bytes to SD card, bytes left: %d", numReadBytes, _bytesLeft);
+  EVENT_LOG(Transfer, Debug, "Sending %d bytes to SD card, bytes left: %d", numReadBytes, _bytesLeft);
 
   //Send bytes
   _requestTime = millis();
@@ -0,0 +1,299 @@
+/*
+ * Receives a file uploaded to the web server and streams it to SD card via
+ * CommStack. Data is buffered in a ring buffer and TCP data is only acknowledged
+ * once it has been sent to MK20, so the TCP receive window throttles the client.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "UploadFileToSDCard.h"
+#include "../event_logger.h"
+
+//Number of milliseconds to wait for new data or a response of MK20 before we give up
+const int kUploadTimeout = 20 * 1000;
+
+UploadFileToSDCard *UploadFileToSDCard::_activeUpload = NULL;
+
+UploadFileToSDCard::UploadFileToSDCard(AsyncWebServerRequest *request, const String &targetFilePath, size_t fileSize) :
+	Mode(),
+	_targetFilePath(targetFilePath),
+	_fileSize(fileSize),
+	_compression(Compression::None),
+	_bytesReceived(0),
+	_waitForResponse(false),
+	_fileRequested(false),
+	_fileOpen(false),
+	_closing(false),
+	_finished(false),
+	_failed(false),
+	_responsePending(false),
+	_request(request),
+	_ringBufferHead(0),
+	_ringBufferTail(0),
+	_ringBufferFill(0),
+	_requestTime(millis()) {
+  _activeUpload = this;
+
+  if (_targetFilePath.endsWith(UPLOAD_LZ_SUFFIX)) {
+	_compression = Compression::LZ;
+	_targetFilePath.remove(_targetFilePath.length() - strlen(UPLOAD_LZ_SUFFIX));
+  }
+}
+
+UploadFileToSDCard::~UploadFileToSDCard() {
+  //Open the receive window again, otherwise the connection would stall
+  if (_request != NULL) {
+	_request->client()->ack(UPLOAD_RING_BUFFER_SIZE);
+  }
+
+  if (_activeUpload == this) {
+	_activeUpload = NULL;
+  }
+}
+
+String UploadFileToSDCard::getName() {
+  return "UploadFileToSDCard";
+}
+
+bool UploadFileToSDCard::isValidTargetPath(const String &path) {
+  String filePath = path;
+  if (filePath.endsWith(UPLOAD_LZ_SUFFIX)) {
+	filePath.remove(filePath.length() - strlen(UPLOAD_LZ_SUFFIX));
+  }
+
+  if (!filePath.startsWith("/") || filePath.endsWith("/")) {
+	return false;
+  }
+
+  //Same rules as make83Name of the SD library on MK20: up to 8 characters, one optional dot with an extension of up
+  //to 3 characters, printable ASCII without FAT reserved characters. Case doesn't matter, MK20 converts to upper case
+  int nameLength = 0;
+  int extensionLength = -1;
+  for (unsigned int i = 1; i <= filePath.length(); i++) {
+	char c = i < filePath.length() ? filePath.charAt(i) : '/';
+	if (c == '/') {
+	  if (nameLength == 0) {
+		return false;
+	  }
+	  nameLength = 0;
+	  extensionLength = -1;
+	} else if (c == '.') {
+	  if (extensionLength >= 0) {
+		return false;
+	  }
+	  extensionLength = 0;
+	} else if (c < 0x21 || c > 0x7E || strchr("|<>^+=?[];,*\"\\", c) != NULL) {
+	  return false;
+	} else if (extensionLength >= 0) {
+	  if (++extensionLength > 3) {
+		return false;
+	  }
+	} else if (++nameLength > 8) {
+	  return false;
+	}
+  }
+
+  return true;
+}
+
+void UploadFileToSDCard::onWillStart() {
+  EventLogger::log("Request SD file write for upload with path: %s, size: %d, compression: %d", _targetFilePath.c_str(), _fileSize, (int) _compression);
+
+  //Request MK20 to store a file on SD card. LZ uploads are inflated by MK20 as they arrive, the data is forwarded unchanged
+  _requestTime = millis();
+  _waitForResponse = true;
+  _fileRequested = true;
+  Application.getMK20Stack()->openSDFileForWrite(_targetFilePath, _fileSize, false, _compression);
+}
+
+bool UploadFileToSDCard::write(AsyncWebServerRequest *request, const uint8_t *data, size_t size) {
+  if (_failed || _finished) {
+	return false;
+  }
+
+  //Data can't overflow the ring buffer as long as we don't acknowledge more than we have sent to MK20
+  if (size > (UPLOAD_RING_BUFFER_SIZE - _ringBufferFill)) {
+	EventLogger::log("Upload ring buffer overflow, free: %d, received: %d", UPLOAD_RING_BUFFER_SIZE - _ringBufferFill, size);
+	_failed = true;
+	return false;
+  }
+
+  size_t contiguous = UPLOAD_RING_BUFFER_SIZE - _ringBufferHead;
+  if (size <= contiguous) {
+	memcpy(&_ringBuffer[_ringBufferHead], data, size);
+  } else {
+	memcpy(&_ringBuffer[_ringBufferHead], data, contiguous);
+	memcpy(_ringBuffer, &data[contiguous], size - contiguous);
+  }
+  _ringBufferHead = (_ringBufferHead + size) % UPLOAD_RING_BUFFER_SIZE;
+  _ringBufferFill += size;
+  _bytesReceived += size;
+
+  //Don't open the receive window again until the data has been sent to MK20
+  request->client()->ackLater();
+
+  _requestTime = millis();
+  return true;
+}
+
+void UploadFileToSDCard::finish() {
+  EventLogger::log("Upload received completely, %d bytes", _bytesReceived);
+  _finished = true;
+}
+
+void UploadFileToSDCard::onClientDisconnected() {
+  _request = NULL;
+
+  if (!_finished) {
+	EventLogger::log("Upload client disconnected after %d bytes", _bytesReceived);
+	_failed = true;
+  }
+}
+
+void UploadFileToSDCard::sendResponse(bool success) {
+  //The web server answers itself if the upload failed before the request body has been received
+  if (!_responsePending || _request == NULL) {
+	return;
+  }
+  _responsePending = false;
+
+  AsyncWebServerResponse *response = NULL;
+  if (success) {
+	response = _request->beginResponse(200, "text/json", "{\"success\":\"true\"}");
+  } else {
+	response = _request->beginResponse(500, "text/json", "{\"success\":\"false\",\"error\":\"Upload failed\"}");
+  }
+  response->addHeader("Access-Control-Allow-Origin", "*");
+  _request->send(response);
+}
+
+void UploadFileToSDCard::loop() {
+  if (_failed) {
+	//Have MK20 remove the partial file, a truncated job must not show up on SD card
+	if (_fileRequested) {
+	  Application.getMK20Stack()->closeSDFile(true);
+	  _fileRequested = false;
+	  _fileOpen = false;
+	}
+	sendResponse(false);
+	exit();
+	return;
+  }
+
+  if (_closing) {
+	if (_waitForResponse) {
+	  if (millis() - _requestTime > kUploadTimeout) {
+		EventLogger::log("Upload timeout, MK20 did not confirm closing the file");
+		_failed = true;
+	  }
+	  return;
+	}
+
+	//MK20 confirmed the file has been stored completely
+	EventLogger::log("Upload complete");
+	sendResponse(true);
+	exit();
+	return;
+  }
+
+  //Just send data once the file is open and MK20 processed the last chunk
+  if (!_fileOpen || _waitForResponse) {
+	if (millis() - _requestTime > kUploadTimeout) {
+	  EventLogger::log("Upload timeout");
+	  _failed = true;
+	}
+	return;
+  }
+
+  if (_ringBufferFill > 0) {
+	uint8_t buffer[UPLOAD_CHUNK_SIZE];
+	uint16_t size = _ringBufferFill > UPLOAD_CHUNK_SIZE ? UPLOAD_CHUNK_SIZE : _ringBufferFill;
+	for (uint16_t i = 0; i < size; i++) {
+	  buffer[i] = _ringBuffer[_ringBufferTail];
+	  _ringBufferTail = (_ringBufferTail + 1) % UPLOAD_RING_BUFFER_SIZE;
+	}
+	_ringBufferFill -= size;
+
+	_requestTime = millis();
+	_waitForResponse = true;
+	Application.getMK20Stack()->sendSDFileData(buffer, size);
+
+	//Data has been handed over, let the client send more
+	if (_request != NULL) {
+	  _request->client()->ack(size);
+	}
+	return;
+  }
+
+  if (_finished) {
+	//File is completely transferred, wait for MK20 to confirm it has been stored before answering the request
+	_closing = true;
+	_requestTime = millis();
+	_waitForResponse = true;
+	Application.getMK20Stack()->closeSDFile();
+  } else if (millis() - _requestTime > kUploadTimeout) {
+	EventLogger::log("Upload timeout, no data received");
+	_failed = true;
+  }
+}
+
+bool UploadFileToSDCard::handlesTask(TaskID taskID) {
+  if (taskID == TaskID::FileOpenForWrite) {
+	return true;
+  } else if (taskID == TaskID::FileSaveData) {
+	return true;
+  } else if (taskID == TaskID::FileClose) {
+	return true;
+  }
+
+  return false;
+}
+
+bool UploadFileToSDCard::runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success) {
+  if (header.getCurrentTask() == TaskID::FileOpenForWrite) {
+	_waitForResponse = false;
+	if (header.commType == ResponseSuccess) {
+	  _fileOpen = true;
+	} else if (header.commType == ResponseFailed) {
+	  EventLogger::log("MK20 could not open file for upload: %s", _targetFilePath.c_str());
+	  _fileRequested = false;
+	  _fileOpen = false;
+	  _failed = true;
+	}
+  } else if (header.getCurrentTask() == TaskID::FileSaveData) {
+	_waitForResponse = false;
+	if (header.commType == ResponseFailed) {
+	  EventLogger::log("MK20 could not write upload data: %s", _targetFilePath.c_str());
+	  _failed = true;
+	}
+  } else if (header.getCurrentTask() == TaskID::FileClose) {
+	//MK20 closed the file, it removes it itself if it's incomplete
+	_waitForResponse = false;
+	_fileRequested = false;
+	_fileOpen = false;
+	if (header.commType == ResponseFailed) {
+	  EventLogger::log("MK20 could not store upload: %s", _targetFilePath.c_str());
+	  _failed = true;
+	}
+  }
+
+  return true;
+}
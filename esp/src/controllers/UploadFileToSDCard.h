@@ -0,0 +1,96 @@
+/*
+ * Receives a file uploaded to the web server and streams it to SD card via
+ * CommStack. Data is buffered in a ring buffer and TCP data is only acknowledged
+ * once it has been sent to MK20, so the TCP receive window throttles the client.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef ESP_UPLOADFILETOSDCARD_H
+#define ESP_UPLOADFILETOSDCARD_H
+
+#include "core/Mode.h"
+#include <ESPAsyncWebServer.h>
+
+//Must be larger than the TCP receive window (4 * MSS = 5840 bytes with lwIP defaults) as the client may send up to a
+//full window of data before it has to wait for acknowledgements
+#define UPLOAD_RING_BUFFER_SIZE 8192
+
+//Number of bytes sent to MK20 in one FileSaveData request
+#define UPLOAD_CHUNK_SIZE 128
+
+//Uploads with this suffix are LZ compressed (see utils/lztool), MK20 inflates them and stores them without the suffix
+#define UPLOAD_LZ_SUFFIX ".lz"
+
+class UploadFileToSDCard : public Mode {
+ public:
+  UploadFileToSDCard(AsyncWebServerRequest *request, const String &targetFilePath, size_t fileSize);
+  ~UploadFileToSDCard();
+
+  void loop();
+  void onWillStart();
+
+  bool runTask(CommHeader &header, const uint8_t *data, size_t dataSize, uint8_t *responseData, uint16_t *responseDataSize, bool *sendResponse, bool *success);
+  virtual bool handlesTask(TaskID taskID);
+  String getName();
+
+#pragma mark Upload data
+  //Called by the web server with the next part of the request body. Returns false if the data could not be buffered
+  bool write(AsyncWebServerRequest *request, const uint8_t *data, size_t size);
+  //Called by the web server once the request body has been received completely
+  void finish();
+  //Called by the web server if the client disconnected, no more data will arrive
+  void onClientDisconnected();
+  //Called by the web server once the request body has been received, the HTTP response is sent after MK20 closed the file
+  void respondWhenClosed() { _responsePending = true; };
+  bool hasFailed() const { return _failed; };
+  AsyncWebServerRequest *getRequest() const { return _request; };
+
+  //Returns the upload currently running, or NULL
+  static UploadFileToSDCard *getActiveUpload() { return _activeUpload; };
+  //MK20 stores files with 8.3 names only, returns false if a component of the path would be rejected
+  static bool isValidTargetPath(const String &path);
+
+ private:
+  String _targetFilePath;
+  size_t _fileSize;
+  Compression _compression;
+  size_t _bytesReceived;
+  bool _waitForResponse;
+  bool _fileRequested;
+  bool _fileOpen;
+  bool _closing;
+  bool _finished;
+  bool _failed;
+  bool _responsePending;
+  AsyncWebServerRequest *_request;
+  uint8_t _ringBuffer[UPLOAD_RING_BUFFER_SIZE];
+  uint16_t _ringBufferHead;
+  uint16_t _ringBufferTail;
+  uint16_t _ringBufferFill;
+  unsigned long _requestTime;
+
+  void sendResponse(bool success);
+
+  static UploadFileToSDCard *_activeUpload;
+};
+
+#endif //ESP_UPLOADFILETOSDCARD_H
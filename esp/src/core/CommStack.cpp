@@ -292,7 +292,7 @@ bool CommStack::sendMessage(CommHeader &header, size_t contentLength, const uint
   //Calculate size of packet (header + data)
   size_t size = contentLength + sizeof(CommHeader);
 
-  EventLogger::log("Sending message with taskID: %d, content length: %d, total size: %d", header.getCurrentTask(), contentLength, size);
+  EVENT_LOG(Comm, Debug, "Sending message with taskID: %d, content length: %d, total size: %d", header.getCurrentTask(), contentLength, size);
 
   //Prepare packet in memory
   memcpy(_sendBuffer, &header, sizeof(CommHeader));
@@ -318,8 +318,8 @@ bool CommStack::requestTask(TaskID task, const JsonObject &object) {
   char buffer[length];
   object.printTo(buffer, length);
 
-  EventLogger::log("Sending JSON for Task %d with length: %d", task, length);
-  EventLogger::log(buffer);
+  EVENT_LOG(Comm, Debug, "Sending JSON for Task %d with length: %d", task, length);
+  EVENT_LOG(Comm, Debug, "%s", buffer);
 
   return requestTask(task, length, (uint8_t *) buffer);
 }
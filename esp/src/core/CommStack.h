@@ -44,7 +44,8 @@
 
 enum class Compression : uint8_t {
   None = 1,
-  RLE16 = 2
+  RLE16 = 2,
+  LZ = 3
 };
 
 enum CommType : uint8_t {
@@ -95,7 +96,9 @@ enum class TaskID : uint8_t {
   ShowWiFiInfo = 34,
   SetPassword = 35,
   SaveMaterials = 36,
-  CancelDownload = 37
+  CancelDownload = 37,
+  PrinterState = 38,
+  Metrics = 39
 };
 
 struct CommHeader {
@@ -59,6 +59,7 @@ class Mode {
 #pragma mark Misc
   virtual String getName() = 0;
   virtual void setNextMode(Mode *mode);
+  Mode *getNextMode() const { return _nextMode; };
 
 #pragma mark Internally used
  protected:
@@ -35,50 +35,325 @@
 
 extern AsyncEventSource events;
 
+LogLevel EventLogger::_levels[(uint8_t) LogModule::Count] = {
+	LogLevel::Info,		//App
+	LogLevel::Info,		//Comm
+	LogLevel::Info,		//Transfer
+	LogLevel::Info,		//Firmware
+	LogLevel::Info		//Web
+};
+uint8_t EventLogger::_ringBuffer[EVENT_LOGGER_BUFFER_SIZE];
+size_t EventLogger::_ringBufferHead = 0;
+size_t EventLogger::_ringBufferTail = 0;
+size_t EventLogger::_ringBufferFill = 0;
+uint16_t EventLogger::_dropped = 0;
+
+//Parses a conversion specification after '%', returns the conversion character.
+//length is the number of 'l' modifiers, stars the number of '*' width/precision arguments
+static char parseSpec(const char *&p, uint8_t &length, uint8_t &stars) {
+  length = 0;
+  stars = 0;
+  while (*p && strchr("-+ #0", *p)) p++;
+  if (*p == '*') {
+	stars++;
+	p++;
+  } else {
+	while (isdigit(*p)) p++;
+  }
+  if (*p == '.') {
+	p++;
+	if (*p == '*') {
+	  stars++;
+	  p++;
+	} else {
+	  while (isdigit(*p)) p++;
+	}
+  }
+  while (*p && strchr("lhzjtL", *p)) {
+	if (*p == 'l') length++;
+	p++;
+  }
+  return *p;
+}
+
 void EventLogger::log(char *msg, ...) {
+  //The message may live in a temporary buffer, so format it right away and copy the result
+  va_list ap;
+  char buffer[EVENT_LOGGER_MAX_RECORD_SIZE];
+
+  va_start(ap, msg);
+  vsnprintf(buffer, sizeof buffer, msg, ap);
+  va_end(ap);
+
+  log("%s", buffer);
+}
+
+void EventLogger::log(const char *msg, ...) {
+  if (!isEnabled(LogModule::App, LogLevel::Info)) return;
 
   va_list ap;
-  char buffer[256];
+  va_start(ap, msg);
+  record(msg, ap);
+  va_end(ap);
+}
 
+void EventLogger::log(LogModule module, LogLevel level, const char *msg, ...) {
+  if (!isEnabled(module, level)) return;
+
+  va_list ap;
   va_start(ap, msg);
-  int ret = vsnprintf(buffer, sizeof buffer, msg, ap);
+  record(msg, ap);
   va_end(ap);
+}
+
+void EventLogger::setLevel(LogModule module, LogLevel level) {
+  _levels[(uint8_t) module] = level;
+}
+
+//Appends raw argument data to a record, returns false if it does not fit
+static bool put(uint8_t *record, size_t &size, const void *data, size_t length) {
+  if (size + length > EVENT_LOGGER_MAX_RECORD_SIZE) return false;
+  memcpy(&record[size], data, length);
+  size += length;
+  return true;
+}
+
+//Reads raw argument data from a record, returns false if the record has been truncated
+static bool get(const uint8_t *record, size_t size, size_t &offset, void *data, size_t length) {
+  if (offset + length > size) return false;
+  memcpy(data, &record[offset], length);
+  offset += length;
+  return true;
+}
 
-  events.send(buffer);
+void EventLogger::record(const char *msg, va_list args) {
+  //Record layout: size (1 byte), format string pointer, raw arguments. Strings are copied,
+  //arguments that don't fit are dropped and the message is cut off there when formatted
+  uint8_t record[EVENT_LOGGER_MAX_RECORD_SIZE];
+  size_t size = 1;
+  bool fits = put(record, size, &msg, sizeof(msg));
 
-  //Serial.println(buffer);
+  for (const char *p = msg; *p && fits; p++) {
+	if (*p != '%') continue;
+	p++;
 
+	uint8_t length, stars;
+	char conversion = parseSpec(p, length, stars);
+	if (conversion == 0) break;
 
-//  int len = strlen(buffer);
-//  Application.getMK20Stack()->requestTask(TaskID::DebugLog,(size_t)(len+1),(uint8_t*)&buffer[0]);
+	//Width and precision given as arguments
+	for (uint8_t i = 0; i < stars && fits; i++) {
+	  int value = va_arg(args, int);
+	  fits = put(record, size, &value, sizeof(value));
+	}
+	if (!fits) break;
 
+	switch (conversion) {
+	  case 'd':
+	  case 'i':
+	  case 'u':
+	  case 'x':
+	  case 'X':
+	  case 'o':
+	  case 'c':
+	  case 'p':
+		if (length >= 2) {
+		  long long value = va_arg(args, long long);
+		  fits = put(record, size, &value, sizeof(value));
+		} else {
+		  //int, long and pointers are all 32 bits wide on the ESP8266
+		  uint32_t value = va_arg(args, uint32_t);
+		  fits = put(record, size, &value, sizeof(value));
+		}
+		break;
+	  case 'f':
+	  case 'F':
+	  case 'e':
+	  case 'E':
+	  case 'g':
+	  case 'G': {
+		double value = va_arg(args, double);
+		fits = put(record, size, &value, sizeof(value));
+		break;
+	  }
+	  case 's': {
+		const char *value = va_arg(args, const char *);
+		if (value == NULL) value = "(null)";
+		if (size >= sizeof(record)) {
+		  fits = false;
+		  break;
+		}
+		size_t stringLength = strnlen(value, sizeof(record) - size - 1);
+		fits = value[stringLength] == 0;
+		memcpy(&record[size], value, stringLength);
+		size += stringLength;
+		record[size++] = 0;
+		break;
+	  }
+	  default:
+		break;
+	}
+  }
+
+  record[0] = size;
+
+  if (_ringBufferFill + size > EVENT_LOGGER_BUFFER_SIZE) {
+	_dropped++;
+	return;
+  }
+
+  writeRing(record, size);
 }
 
-void EventLogger::log(const char *msg, ...) {
+void EventLogger::writeRing(const uint8_t *data, size_t size) {
+  size_t count = EVENT_LOGGER_BUFFER_SIZE - _ringBufferHead;
+  if (count > size) count = size;
+  memcpy(&_ringBuffer[_ringBufferHead], data, count);
+  memcpy(&_ringBuffer[0], data + count, size - count);
 
-  va_list ap;
-  char buffer[256];
+  _ringBufferHead = (_ringBufferHead + size) % EVENT_LOGGER_BUFFER_SIZE;
+  _ringBufferFill += size;
+}
 
-  va_start(ap, msg);
-  int ret = vsnprintf(buffer, sizeof buffer, msg, ap);
-  va_end(ap);
+void EventLogger::readRing(size_t offset, uint8_t *data, size_t size) {
+  size_t start = (_ringBufferTail + offset) % EVENT_LOGGER_BUFFER_SIZE;
+  size_t count = EVENT_LOGGER_BUFFER_SIZE - start;
+  if (count > size) count = size;
+  memcpy(data, &_ringBuffer[start], count);
+  memcpy(data + count, &_ringBuffer[0], size - count);
+}
+
+size_t EventLogger::format(const uint8_t *record, size_t size, char *buffer, size_t bufferSize) {
+  const char *msg;
+  size_t offset = 1;
+  size_t length = 0;
+  bool complete = get(record, size, offset, &msg, sizeof(msg));
+
+  for (const char *p = msg; complete && *p && length < bufferSize - 1; p++) {
+	if (*p != '%') {
+	  buffer[length++] = *p;
+	  continue;
+	}
 
-  events.send(buffer);
+	const char *specStart = p;
+	p++;
+	uint8_t modifiers, stars;
+	char conversion = parseSpec(p, modifiers, stars);
+	if (conversion == 0) break;
+	if (conversion == '%') {
+	  buffer[length++] = '%';
+	  continue;
+	}
+
+	//Copy the conversion specification, replacing '*' with the recorded values
+	char spec[32];
+	size_t specLength = 0;
+	for (const char *s = specStart; s <= p && specLength < sizeof(spec) - 12; s++) {
+	  if (*s == '*') {
+		int value = 0;
+		complete = complete && get(record, size, offset, &value, sizeof(value));
+		specLength += sprintf(&spec[specLength], "%d", value);
+	  } else {
+		spec[specLength++] = *s;
+	  }
+	}
+	spec[specLength] = 0;
+	if (!complete) break;
+
+	char *out = &buffer[length];
+	size_t available = bufferSize - length;
+	int written = 0;
+
+	switch (conversion) {
+	  case 'd':
+	  case 'i':
+	  case 'u':
+	  case 'x':
+	  case 'X':
+	  case 'o':
+	  case 'c':
+	  case 'p':
+		if (modifiers >= 2) {
+		  long long value;
+		  complete = get(record, size, offset, &value, sizeof(value));
+		  if (complete) written = snprintf(out, available, spec, value);
+		} else {
+		  uint32_t value;
+		  complete = get(record, size, offset, &value, sizeof(value));
+		  if (complete) written = snprintf(out, available, spec, value);
+		}
+		break;
+	  case 'f':
+	  case 'F':
+	  case 'e':
+	  case 'E':
+	  case 'g':
+	  case 'G': {
+		double value;
+		complete = get(record, size, offset, &value, sizeof(value));
+		if (complete) written = snprintf(out, available, spec, value);
+		break;
+	  }
+	  case 's': {
+		complete = offset < size;
+		if (!complete) break;
+		const char *value = (const char *) &record[offset];
+		offset += strlen(value) + 1;
+		written = snprintf(out, available, spec, value);
+		break;
+	  }
+	  default:
+		break;
+	}
+
+	if (written > 0) {
+	  length += (size_t) written < available ? written : available - 1;
+	}
+  }
+
+  buffer[length] = 0;
+  return length;
+}
+
+void EventLogger::flush() {
+  if (_ringBufferFill == 0 && _dropped == 0) return;
+
+  //Nobody is listening, don't spend time formatting
+  if (events.count() == 0) {
+	_ringBufferHead = _ringBufferTail = _ringBufferFill = 0;
+	_dropped = 0;
+	return;
+  }
+
+  static char batch[EVENT_LOGGER_BATCH_SIZE];
+  size_t batchLength = 0;
+
+  if (_dropped > 0) {
+	batchLength = snprintf(batch, sizeof batch, "%d log messages dropped", _dropped);
+	_dropped = 0;
+  }
 
-  //Serial.println(buffer);
+  //Collect as many messages as fit into one event, separated by newlines
+  while (_ringBufferFill > 0) {
+	uint8_t record[EVENT_LOGGER_MAX_RECORD_SIZE];
+	readRing(0, record, 1);
+	size_t size = record[0];
+	readRing(0, record, size);
 
-  //int len = strlen(buffer);
-  //Application.getMK20Stack()->requestTask(TaskID::DebugLog,(size_t)(len+1),(uint8_t*)&buffer[0]);
+	char line[256];
+	size_t lineLength = format(record, size, line, sizeof line);
+	size_t separator = batchLength > 0 ? 1 : 0;
+	if (batchLength > 0 && batchLength + separator + lineLength >= sizeof batch) break;
 
-  /*
-  va_list args;
-  va_start(args, msg);
+	if (separator) batch[batchLength++] = '\n';
+	lineLength = min(lineLength, sizeof batch - batchLength - 1);
+	memcpy(&batch[batchLength], line, lineLength);
+	batchLength += lineLength;
 
-  while (1) {
-    char ch = va_arg(args, int);
-    if (!ch) break;
-    events.send(&ch);
+	_ringBufferTail = (_ringBufferTail + size) % EVENT_LOGGER_BUFFER_SIZE;
+	_ringBufferFill -= size;
   }
-  */
 
+  batch[batchLength] = 0;
+  events.send(batch);
 }
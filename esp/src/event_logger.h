@@ -31,10 +31,56 @@
 
 #include <Arduino.h>
 
+//Log messages are stored in binary form (format string pointer and raw arguments)
+//and formatted when they are sent to /events clients from the main loop
+#define EVENT_LOGGER_BUFFER_SIZE 2048
+#define EVENT_LOGGER_MAX_RECORD_SIZE 128
+#define EVENT_LOGGER_BATCH_SIZE 512
+
+enum class LogModule : uint8_t {
+  App = 0,
+  Comm,
+  Transfer,
+  Firmware,
+  Web,
+  Count
+};
+
+enum class LogLevel : uint8_t {
+  Off = 0,
+  Error,
+  Info,
+  Debug
+};
+
+//Checks the level before evaluating any arguments, use this in hot paths
+#define EVENT_LOG(module, level, ...) do { if (EventLogger::isEnabled(LogModule::module, LogLevel::level)) EventLogger::log(LogModule::module, LogLevel::level, __VA_ARGS__); } while (0)
+
 class EventLogger {
  public:
+  //Non-const messages are copied, const messages must be string literals (use "%s" for other strings)
   static void log(char *msg, ...);
   static void log(const char *msg, ...);
+  static void log(LogModule module, LogLevel level, const char *msg, ...);
+
+  static bool isEnabled(LogModule module, LogLevel level) { return level <= _levels[(uint8_t) module]; }
+  static void setLevel(LogModule module, LogLevel level);
+
+  //Formats pending messages and sends them to /events clients, called from the main loop
+  static void flush();
+
+ private:
+  static void record(const char *msg, va_list args);
+  static size_t format(const uint8_t *record, size_t size, char *buffer, size_t bufferSize);
+  static void writeRing(const uint8_t *data, size_t size);
+  static void readRing(size_t offset, uint8_t *data, size_t size);
+
+  static LogLevel _levels[(uint8_t) LogModule::Count];
+  static uint8_t _ringBuffer[EVENT_LOGGER_BUFFER_SIZE];
+  static size_t _ringBufferHead;
+  static size_t _ringBufferTail;
+  static size_t _ringBufferFill;
+  static uint16_t _dropped;
 };
 
 #endif
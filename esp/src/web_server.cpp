@@ -36,10 +36,12 @@
 #include "config.h"
 #include "event_logger.h"
 #include "controllers/MK20FirmwareUpdate.h"
+#include "controllers/MK20FirmwareStreamUpdate.h"
 #include "controllers/ESPFirmwareUpdate.h"
 #include "controllers/ManageWifi.h"
 #include "controllers/DownloadFileToSPIFFs.h"
 #include "controllers/PushFileToSDCard.h"
+#include "controllers/UploadFileToSDCard.h"
 #include "core/Mode.h"
 #include "controllers/Idle.h"
 #include "Application.h"
@@ -49,6 +51,7 @@
 
 AsyncWebServer server(80);
 AsyncEventSource events("/events");
+AsyncEventSource stateEvents("/state");
 
 WebServer webserver;
 extern Config config;
@@ -81,6 +84,16 @@ void doUpdateConfig(AsyncWebServerRequest *request) {
   ESP.restart();
 }
 
+//Target path of an /upload request, MK20 expects absolute paths
+String getUploadPath(AsyncWebServerRequest *request) {
+  String path = request->getParam("path")->value();
+  if (!path.startsWith("/")) {
+	path = "/" + path;
+  }
+
+  return path;
+}
+
 bool WebServer::validateAuthentication(AsyncWebServerRequest *request) {
   if (config.data.locked == false) {
 	EventLogger::log("Authentication not enabled");
@@ -99,6 +112,14 @@ bool WebServer::validateAuthentication(AsyncWebServerRequest *request) {
   return true;
 }
 
+bool WebServer::isAuthenticated(AsyncWebServerRequest *request) {
+  //Same as validateAuthentication but without sending a response, used while request bodies are received
+  if (config.data.locked == false) {
+	return true;
+  }
+  return request->authenticate("printrbot", config.data.password);
+}
+
 void WebServer::addOptionsRequest(String path) {
   server.on(path.c_str(), HTTP_OPTIONS, [](AsyncWebServerRequest *request) {
 	AsyncWebServerResponse *response = request->beginResponse(200, "text/json");
@@ -110,6 +131,30 @@ void WebServer::addOptionsRequest(String path) {
   });
 }
 
+void WebServer::addPrinterState(JsonObject &object, uint8_t fields) {
+  PrinterState *state = Application.getPrinterState();
+  if (fields & PRINTER_STATE_PRINTING) object["printing"] = (bool) state->printing;
+  if (fields & PRINTER_STATE_STAT) object["stat"] = state->stat;
+  if (fields & PRINTER_STATE_PROGRESS) object["progress"] = (float) state->progress / 100.0f;
+  if (fields & PRINTER_STATE_NOZZLE_TEMP) object["nozzle_temp"] = (float) state->nozzleTemperature / 10.0f;
+  if (fields & PRINTER_STATE_LINE) object["line"] = state->line;
+  if (fields & PRINTER_STATE_TOTAL_LINES) object["total_lines"] = state->totalLines;
+  if (fields & PRINTER_STATE_JOB) object["job"] = (const char *) state->job;
+}
+
+void WebServer::sendPrinterState(uint8_t fields) {
+  //Nobody is listening, don't waste time on building JSON
+  if (stateEvents.count() == 0) return;
+
+  StaticJsonBuffer<JSON_OBJECT_SIZE(7)> jsonBuffer;
+  JsonObject &root = jsonBuffer.createObject();
+  addPrinterState(root, fields);
+
+  char buffer[160];
+  root.printTo(buffer, sizeof(buffer));
+  stateEvents.send(buffer, "state");
+}
+
 void WebServer::begin() {
 
   server.addHandler(&events);
@@ -118,6 +163,19 @@ void WebServer::begin() {
 	client->send("Printrbot Event Monitor");
   });
 
+  //Printer state is pushed to subscribers, new ones get the full state first and changed fields afterwards
+  server.addHandler(&stateEvents);
+
+  stateEvents.onConnect([](AsyncEventSourceClient *client) {
+	StaticJsonBuffer<JSON_OBJECT_SIZE(7)> jsonBuffer;
+	JsonObject &root = jsonBuffer.createObject();
+	webserver.addPrinterState(root, PRINTER_STATE_ALL);
+
+	char buffer[160];
+	root.printTo(buffer, sizeof(buffer));
+	client->send(buffer, "state");
+  });
+
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
 	  //String html =
 	String html = "<html>\
@@ -141,7 +199,7 @@ void WebServer::begin() {
   webserver.addOptionsRequest("/update_esp");
   server.on("/update_esp", HTTP_GET, [](AsyncWebServerRequest *request) {
 	AsyncWebParameter *url = request->getParam("url");
-	EventLogger::log(url->value().c_str());
+	EventLogger::log("%s", url->value().c_str());
 	Mode *espFU = new ESPFirmwareUpdate(url->value().c_str());
 	Application.pushMode(espFU);
 	request->send(200, "text/plain", "\nupdate started, please wait...\n\n");
@@ -152,10 +210,8 @@ void WebServer::begin() {
 	String mk20FirmwareFile("/mk20.bin");
 	FirmwareUpdateInfo *updateInfo = Application.getFirmwareUpdateInfo();
 	if (updateInfo != NULL) {
-	  DownloadFileToSPIFFs *downloadMK20Firmware = new DownloadFileToSPIFFs(updateInfo->mk20_url, mk20FirmwareFile);
-	  MK20FirmwareUpdate *mk20UpdateFirmware = new MK20FirmwareUpdate(mk20FirmwareFile);
-	  downloadMK20Firmware->setNextMode(mk20UpdateFirmware);
-	  Application.pushMode(downloadMK20Firmware);
+	  MK20FirmwareStreamUpdate *mk20UpdateFirmware = new MK20FirmwareStreamUpdate(updateInfo->mk20_url, mk20FirmwareFile);
+	  Application.pushMode(mk20UpdateFirmware);
 	  request->send(200, "text/plain", "\nupdate of MK20 started, please wait...\n\n");
 	} else {
 	  request->send(200, "text/plain", "\nupdate of MK20 failed, please wait until firmware data have been loaded and try again...\n\n");
@@ -195,7 +251,7 @@ void WebServer::begin() {
 	}
 
 	if (response != NULL) {
-	  EventLogger::log(config.data.name);
+	  EventLogger::log("%s", config.data.name);
 	  response->addHeader("Access-Control-Allow-Origin", "*");
 	  request->send(response);
 	}
@@ -223,6 +279,9 @@ void WebServer::begin() {
 	root["softapip"] = WiFi.softAPIP().toString();
 	root["serialnr"] = Application.getSystemInfo()->serialNumber;
 
+	JsonObject &printer = root.createNestedObject("printer");
+	webserver.addPrinterState(printer, PRINTER_STATE_ALL);
+
 	if (Application.getFirmwareUpdateInfo() != NULL) {
 	  root["fw_update"] = true;
 	  root["fw_info_sent"] = Application.firmwareUpdateNotified();
@@ -235,6 +294,46 @@ void WebServer::begin() {
 	request->send(response);
   });
 
+  webserver.addOptionsRequest("/metrics");
+  server.on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request) {
+	//Validate request
+	if (!webserver.validateAuthentication(request)) {
+	  return;
+	}
+
+	Metrics *metrics = Application.getMetrics();
+	if (metrics == NULL) {
+	  request->send(503, "text/plain", "No metrics received from MK20 yet");
+	  return;
+	}
+
+	AsyncJsonResponse *response = new AsyncJsonResponse();
+	response->addHeader("Access-Control-Allow-Origin", "*");
+
+	JsonObject &root = response->getRoot();
+	root["age"] = (millis() - Application.getMetricsTime()) / 1000;
+	root["uptime"] = metrics->uptime;
+	root["missed_deadlines"] = metrics->missedDeadlines;
+
+	//Durations are given in microseconds
+	JsonObject &sections = root.createNestedObject("sections");
+	for (int i = 0; i < (int) ProfileSection::Count; i++) {
+	  JsonObject &section = sections.createNestedObject(profileSectionNames[i]);
+	  section["count"] = metrics->sections[i].count;
+	  section["p50"] = metrics->sections[i].p50;
+	  section["p99"] = metrics->sections[i].p99;
+	  section["max"] = metrics->sections[i].max;
+	}
+
+	JsonObject &counters = root.createNestedObject("counters");
+	for (int i = 0; i < (int) ProfileCounter::Count; i++) {
+	  counters[profileCounterNames[i]] = metrics->counters[i];
+	}
+
+	response->setLength();
+	request->send(response);
+  });
+
   webserver.addOptionsRequest("/info");
   server.on("/info", HTTP_GET, [](AsyncWebServerRequest *request) {
 	//	String info = brain.getInfo();
@@ -255,7 +354,7 @@ void WebServer::begin() {
   webserver.addOptionsRequest("/test");
   server.on("/test", HTTP_GET, [](AsyncWebServerRequest *request) {
 	AsyncWebServerResponse *response = request->beginResponse(200, "text/json", "{\"sup\":\"yo\"}");
-	EventLogger::log(config.data.name);
+	EventLogger::log("%s", config.data.name);
 	response->addHeader("Access-Control-Allow-Origin", "*");
 	request->send(response);
   });
@@ -286,7 +385,7 @@ void WebServer::begin() {
 	}
 
 	if (response != NULL) {
-	  EventLogger::log(config.data.name);
+	  EventLogger::log("%s", config.data.name);
 	  response->addHeader("Access-Control-Allow-Origin", "*");
 	  request->send(response);
 	}
@@ -344,7 +443,7 @@ void WebServer::begin() {
 
 	  root["url"] = url->value();
 	  root["type"] = ftype->value();
-	  EventLogger::log(ftype->value().c_str());
+	  EventLogger::log("%s", ftype->value().c_str());
 	  // project index
 	  if (strcmp("project", ftype->value().c_str()) == 0) {
 		EventLogger::log("Fetching Project");
@@ -380,6 +479,75 @@ void WebServer::begin() {
 	}
   });
 
+  //Upload a file from the local network directly to SD card, i.e. curl --data-binary @job.gcode
+  //-H "Content-Type: application/octet-stream" http://<printer>/upload?path=/jobs/job.gco
+  //MK20 stores files with 8.3 names only, other paths are rejected with 400 before anything is sent to MK20.
+  //The body is streamed to MK20 while it is received, it's never stored in SPIFFS. The response is sent
+  //once MK20 confirmed the file has been stored, partial files are removed if the upload fails
+  webserver.addOptionsRequest("/upload");
+  server.on("/upload", HTTP_POST, [](AsyncWebServerRequest *request) {
+	//Called once the request body has been received completely
+	if (!webserver.validateAuthentication(request)) {
+	  return;
+	}
+
+	AsyncWebServerResponse *response = NULL;
+	UploadFileToSDCard *upload = UploadFileToSDCard::getActiveUpload();
+	if (!request->hasParam("path")) {
+	  response = request->beginResponse(400, "text/json", "{\"success\":\"false\",\"error\":\"Missing path\"}");
+	} else if (!UploadFileToSDCard::isValidTargetPath(getUploadPath(request))) {
+	  response = request->beginResponse(400, "text/json", "{\"success\":\"false\",\"error\":\"Invalid path, use 8.3 names only\"}");
+	} else if (upload == NULL || upload->getRequest() != request || upload->hasFailed()) {
+	  response = request->beginResponse(500, "text/json", "{\"success\":\"false\",\"error\":\"Upload failed\"}");
+	} else {
+	  //The upload answers the request once MK20 acknowledged closing the file
+	  upload->respondWhenClosed();
+	  return;
+	}
+
+	response->addHeader("Access-Control-Allow-Origin", "*");
+	request->send(response);
+  }, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+	if (index == 0) {
+	  if (!webserver.isAuthenticated(request) || !request->hasParam("path")) {
+		return;
+	  }
+
+	  //Only one transfer at a time, and not while ESP is downloading or updating firmware
+	  Mode *currentMode = Application.currentMode();
+	  if (UploadFileToSDCard::getActiveUpload() != NULL || (currentMode != NULL && currentMode->getName() != "Idle")) {
+		EventLogger::log("Upload rejected, busy");
+		return;
+	  }
+
+	  String path = getUploadPath(request);
+	  if (!UploadFileToSDCard::isValidTargetPath(path)) {
+		EventLogger::log("Upload rejected, invalid path: %s", path.c_str());
+		return;
+	  }
+
+	  EventLogger::log("Upload started, path: %s, size: %d", path.c_str(), total);
+	  UploadFileToSDCard *upload = new UploadFileToSDCard(request, path, total);
+	  request->onDisconnect([request]() {
+		UploadFileToSDCard *upload = UploadFileToSDCard::getActiveUpload();
+		if (upload != NULL && upload->getRequest() == request) {
+		  upload->onClientDisconnected();
+		}
+	  });
+	  Application.pushMode(upload);
+	}
+
+	UploadFileToSDCard *upload = UploadFileToSDCard::getActiveUpload();
+	if (upload == NULL || upload->getRequest() != request) {
+	  return;
+	}
+
+	upload->write(request, data, len);
+	if (index + len >= total) {
+	  upload->finish();
+	}
+  });
+
   webserver.addOptionsRequest("/updateconfig");
   server.on("/updateconfig", HTTP_POST, [](AsyncWebServerRequest *request) {
 	//Validate request
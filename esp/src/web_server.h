@@ -36,15 +36,19 @@
 //#include <WebSocketsServer.h>
 #include <FS.h>
 #include <ESPAsyncWebServer.h>
+#include <ArduinoJson.h>
 
 class WebServer {
  public:
   WebServer();
   void begin();
   void update();
+  void sendPrinterState(uint8_t fields);
 
  private:
+  void addPrinterState(JsonObject &object, uint8_t fields);
   bool validateAuthentication(AsyncWebServerRequest *request);
+  bool isAuthenticated(AsyncWebServerRequest *request);
   void addOptionsRequest(String path);
 };
 
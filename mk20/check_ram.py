@@ -0,0 +1,32 @@
+#
+# Post link check of the static RAM of the firmware, registered with extra_scripts in platformio.ini.
+# Buffers sized in src/framework/core/MemoryConfig.h are checked against their own budget at compile
+# time, this catches everything else that ends up in .data and .bss
+#
+
+import subprocess
+import sys
+
+Import("env")
+
+# The MK20DX256 has 64 KB of RAM. Scenes, layer lists, JSON documents and the stack need what is left over
+RAM_SIZE = 64 * 1024
+RAM_RESERVED = 12 * 1024
+RAM_STATIC_LIMIT = RAM_SIZE - RAM_RESERVED
+
+
+def check_ram(source, target, env):
+    output = subprocess.check_output([env.subst("$SIZETOOL"), "-A", str(target[0])]).decode()
+    used = 0
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0] in (".data", ".bss", ".usbdescriptortable", ".dmabuffers"):
+            used += int(fields[1])
+
+    print("Static RAM: %d of %d bytes, %d bytes left for heap and stack" % (used, RAM_STATIC_LIMIT, RAM_SIZE - used))
+    if used > RAM_STATIC_LIMIT:
+        sys.stderr.write("Error: static RAM exceeds the limit by %d bytes, see check_ram.py\n" % (used - RAM_STATIC_LIMIT))
+        env.Exit(1)
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", check_ram)
@@ -119,6 +119,22 @@ boolean File::seek(uint32_t pos) {
   return _file->seekSet(pos);
 }
 
+boolean File::preallocate(uint32_t size) {
+  if (! _file) return false;
+
+  return _file->preallocate(size);
+}
+
+void File::setReadAhead(uint8_t blocks) {
+  if (_file)
+    _file->setReadAhead(blocks);
+}
+
+void File::setWriteThrough(boolean value) {
+  if (_file)
+    _file->setWriteThrough(value);
+}
+
 uint32_t File::position() {
   if (! _file) return -1;
   return _file->curPosition();
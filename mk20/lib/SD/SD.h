@@ -26,6 +26,9 @@
 #define FILE_READ O_READ
 #define FILE_WRITE (O_READ | O_WRITE | O_CREAT)
 
+// Number of bytes written to a streamed download between checkpoint syncs
+#define FILE_SYNC_INTERVAL 32768
+
 class File : public Stream {
  private:
   char _name[13]; // our name
@@ -43,6 +46,13 @@ public:
   virtual void flush();
   int read(void *buf, uint16_t nbyte);
   boolean seek(uint32_t pos);
+  // Reserve a contiguous run of clusters for an empty file before
+  // writing size bytes sequentially (see SdFile::preallocate).
+  boolean preallocate(uint32_t size);
+  // Cache hints: blocks fetched ahead on a read miss for sequential
+  // readers and write-through instead of write-back for data blocks.
+  void setReadAhead(uint8_t blocks);
+  void setWriteThrough(boolean value);
   uint32_t position();
   uint32_t size();
   void close();
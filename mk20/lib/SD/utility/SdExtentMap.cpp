@@ -0,0 +1,142 @@
+/* Arduino SdFat Library
+ * Copyright (C) 2009 by William Greiman
+ *
+ * This file is part of the Arduino SdFat Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino SdFat Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "SdFat.h"
+#if SD_EXTENT_MAP_FILES
+//------------------------------------------------------------------------------
+// extent map cache shared by all SdFile instances
+uint16_t SdExtentMap::useCounter_ = 0;
+SdExtentMap SdExtentMap::maps_[SD_EXTENT_MAP_FILES];
+//------------------------------------------------------------------------------
+// walk the FAT chain once and store it as contiguous runs
+uint8_t SdExtentMap::build(SdVolume* vol, uint32_t firstCluster) {
+  firstCluster_ = 0;
+  runs_[0].index = 0;
+  runs_[0].cluster = firstCluster;
+  runCount_ = 1;
+
+  uint32_t c = firstCluster;
+  for (uint32_t index = 1; ; index++) {
+    uint32_t next;
+    if (!vol->fatGet(c, &next)) return false;
+
+    if (vol->isEOC(next)) {
+      clusterCount_ = index;
+      break;
+    }
+    if (next != (c + 1)) {
+      // fragmented - start a new run or stop if the map is full
+      if (runCount_ == SD_EXTENT_MAP_RUNS) {
+        clusterCount_ = index;
+        break;
+      }
+      runs_[runCount_].index = index;
+      runs_[runCount_].cluster = next;
+      runCount_++;
+    }
+    c = next;
+  }
+  firstCluster_ = firstCluster;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+ * Look up a cluster of the file.
+ *
+ * \param[in] index Index of the cluster within the file, must be less
+ * than clusterCount().
+ *
+ * \return The cluster number.
+ */
+uint32_t SdExtentMap::cluster(uint32_t index) const {
+  // binary search for the last run starting at or before index
+  uint8_t lo = 0;
+  uint8_t hi = runCount_ - 1;
+  while (lo < hi) {
+    uint8_t mid = (lo + hi + 1) >> 1;
+    if (runs_[mid].index <= index) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return runs_[lo].cluster + (index - runs_[lo].index);
+}
+//------------------------------------------------------------------------------
+/**
+ * Find the extent map of a file without building it.
+ *
+ * \param[in] firstCluster The first cluster of the file.
+ *
+ * \return The map or NULL if the file has no map.
+ */
+SdExtentMap* SdExtentMap::find(uint32_t firstCluster) {
+  if (firstCluster == 0) return NULL;
+  for (uint8_t i = 0; i < SD_EXTENT_MAP_FILES; i++) {
+    if (maps_[i].firstCluster_ == firstCluster) {
+      maps_[i].lastUse_ = ++useCounter_;
+      return &maps_[i];
+    }
+  }
+  return NULL;
+}
+//------------------------------------------------------------------------------
+/**
+ * Return the extent map of a file, building it if required.  The least
+ * recently used map is replaced if all maps are in use.
+ *
+ * \param[in] vol The volume containing the file.
+ * \param[in] firstCluster The first cluster of the file.
+ *
+ * \return The map or NULL for an empty file or an I/O error.
+ */
+SdExtentMap* SdExtentMap::get(SdVolume* vol, uint32_t firstCluster) {
+  SdExtentMap* map = find(firstCluster);
+  if (map || firstCluster == 0) return map;
+
+  // pick a free map or the least recently used one
+  map = &maps_[0];
+  for (uint8_t i = 0; i < SD_EXTENT_MAP_FILES; i++) {
+    if (maps_[i].firstCluster_ == 0) {
+      map = &maps_[i];
+      break;
+    }
+    if ((uint16_t)(useCounter_ - maps_[i].lastUse_) >
+        (uint16_t)(useCounter_ - map->lastUse_)) {
+      map = &maps_[i];
+    }
+  }
+  if (!map->build(vol, firstCluster)) return NULL;
+  map->lastUse_ = ++useCounter_;
+  return map;
+}
+//------------------------------------------------------------------------------
+/**
+ * Drop the extent map of a file.  Must be called before clusters of the
+ * file's chain are freed.
+ *
+ * \param[in] firstCluster The first cluster of the file.
+ */
+void SdExtentMap::invalidate(uint32_t firstCluster) {
+  if (firstCluster == 0) return;
+  for (uint8_t i = 0; i < SD_EXTENT_MAP_FILES; i++) {
+    if (maps_[i].firstCluster_ == firstCluster) maps_[i].firstCluster_ = 0;
+  }
+}
+#endif  // SD_EXTENT_MAP_FILES
@@ -33,6 +33,38 @@
  */
 #define ALLOW_DEPRECATED_FUNCTIONS 1
 //------------------------------------------------------------------------------
+/**
+ * Number of files whose cluster chain is kept as an extent map for fast
+ * seeks.  Each map uses 8 * SD_EXTENT_MAP_RUNS + 16 bytes of RAM.
+ * Set to zero to disable extent maps.
+ */
+#ifndef SD_EXTENT_MAP_FILES
+#define SD_EXTENT_MAP_FILES 4
+#endif
+/**
+ * Maximum number of contiguous cluster runs stored in one extent map.
+ * Clusters beyond the last stored run are found by following the FAT.
+ */
+#ifndef SD_EXTENT_MAP_RUNS
+#define SD_EXTENT_MAP_RUNS 8
+#endif
+/**
+ * Number of 512 byte cache blocks reserved for FAT blocks.  FAT blocks
+ * have their own pool so FAT lookups don't evict file data and directory
+ * blocks.  Must be at least one.
+ */
+#ifndef SD_CACHE_FAT_BLOCKS
+#define SD_CACHE_FAT_BLOCKS 2
+#endif
+/**
+ * Number of 512 byte cache blocks for directory and file data blocks.
+ * Also limits the read-ahead depth to SD_CACHE_DATA_BLOCKS - 1.  Must be
+ * at least one.
+ */
+#ifndef SD_CACHE_DATA_BLOCKS
+#define SD_CACHE_DATA_BLOCKS 6
+#endif
+//------------------------------------------------------------------------------
 // forward declaration since SdVolume is used in SdFile
 class SdVolume;
 //==============================================================================
@@ -218,12 +250,18 @@ class SdFile : public Print {
   uint8_t isRoot(void) const {
     return type_ == FAT_FILE_TYPE_ROOT16 || type_ == FAT_FILE_TYPE_ROOT32;
   }
+  /** \return True if this file has a preallocated contiguous cluster run. */
+  uint8_t isPreallocated(void) const {return flags_ & F_FILE_PREALLOCATED;}
+  /** \return True if data written to this file bypasses the write-back
+   * cache. */
+  uint8_t isWriteThrough(void) const {return flags_ & F_FILE_WRITE_THROUGH;}
   void ls(uint8_t flags = 0, uint8_t indent = 0);
   uint8_t makeDir(SdFile* dir, const char* dirName);
   uint8_t open(SdFile* dirFile, uint16_t index, uint8_t oflag);
   uint8_t open(SdFile* dirFile, const char* fileName, uint8_t oflag);
 
   uint8_t openRoot(SdVolume* vol);
+  uint8_t preallocate(uint32_t size);
   static void printDirName(const dir_t& dir, uint8_t width);
   static void printFatDate(uint16_t fatDate);
   static void printFatTime(uint16_t fatTime);
@@ -239,6 +277,8 @@ class SdFile : public Print {
     return read(&b, 1) == 1 ? b : -1;
   }
   int16_t read(void* buf, uint16_t nbyte);
+  /** \return Number of blocks read ahead on a cache miss. */
+  uint8_t readAhead(void) const {return readAhead_;}
   int8_t readDir(dir_t* dir);
   static uint8_t remove(SdFile* dirFile, const char* fileName);
   uint8_t remove(void);
@@ -258,6 +298,26 @@ class SdFile : public Print {
    */
   uint8_t seekEnd(void) {return seekSet(fileSize_);}
   uint8_t seekSet(uint32_t pos);
+  /**
+   * Hint for sequential reads.  On a cache miss up to \a blocks following
+   * blocks of the same cluster are fetched with one multiple block read.
+   * Use zero, the default, for random access.
+   */
+  void setReadAhead(uint8_t blocks) {
+    if (isFile()) readAhead_ = blocks;
+  }
+  /**
+   * Write data blocks of this file to the SD at the end of each write()
+   * instead of keeping them in the write-back cache until evicted or
+   * synced.  The directory entry is still only updated by sync().
+   */
+  void setWriteThrough(uint8_t value) {
+    if (value) {
+      flags_ |= F_FILE_WRITE_THROUGH;
+    } else {
+      flags_ &= ~F_FILE_WRITE_THROUGH;
+    }
+  }
   /**
    * Use unbuffered reads to access this file.  Used with Wave
    * Shield ISR.  Used with Sd2Card::partialBlockRead() in WaveRP.
@@ -369,14 +429,19 @@ class SdFile : public Print {
   // should be 0XF
   static uint8_t const F_OFLAG = (O_ACCMODE | O_APPEND | O_SYNC);
   // available bits
-  static uint8_t const F_UNUSED = 0X30;
+  static uint8_t const F_UNUSED = 0;
+  // flush data blocks at the end of each write()
+  static uint8_t const F_FILE_WRITE_THROUGH = 0X20;
+  // clusters up to allocEnd_ are a contiguous run reserved by preallocate()
+  static uint8_t const F_FILE_PREALLOCATED = 0X10;
   // use unbuffered SD read
   static uint8_t const F_FILE_UNBUFFERED_READ = 0X40;
   // sync of directory entry required
   static uint8_t const F_FILE_DIR_DIRTY = 0X80;
 
 // make sure F_OFLAG is ok
-#if ((F_UNUSED | F_FILE_UNBUFFERED_READ | F_FILE_DIR_DIRTY) & F_OFLAG)
+#if ((F_UNUSED | F_FILE_PREALLOCATED | F_FILE_WRITE_THROUGH \
+      | F_FILE_UNBUFFERED_READ | F_FILE_DIR_DIRTY) & F_OFLAG)
 #error flags_ bits conflict
 #endif  // flags_ bits
 
@@ -389,12 +454,15 @@ class SdFile : public Print {
   uint8_t   dirIndex_;      // index of entry in dirBlock 0 <= dirIndex_ <= 0XF
   uint32_t  fileSize_;      // file size in bytes
   uint32_t  firstCluster_;  // first cluster of file
+  uint32_t  allocEnd_;      // last cluster of a preallocated contiguous run
+  uint8_t   readAhead_;     // blocks to read ahead on a cache miss
   SdVolume* vol_;           // volume where file is located
 
   // private functions
   uint8_t addCluster(void);
   uint8_t addDirCluster(void);
   dir_t* cacheDirEntry(uint8_t action);
+  uint8_t freePreallocated(void);
   static void (*dateTime_)(uint16_t* date, uint16_t* time);
   static uint8_t make83Name(const char* str, uint8_t* name);
   uint8_t openCachedEntry(uint8_t cacheIndex, uint8_t oflags);
@@ -419,6 +487,21 @@ union cache_t {
            /** Used to access to a cached FAT boot sector. */
   fbs_t    fbs;
 };
+/**
+ * \brief Counters for one pool of the block cache
+ */
+struct cache_stats_t {
+           /** Requests served from the cache. */
+  uint32_t hits;
+           /** Requests that had to read or allocate a block. */
+  uint32_t misses;
+           /** Slots reused for another block. */
+  uint32_t evictions;
+           /** Dirty blocks written to the SD, mirror FAT not counted. */
+  uint32_t writes;
+           /** Blocks fetched by read-ahead before being requested. */
+  uint32_t readAhead;
+};
 //------------------------------------------------------------------------------
 /**
  * \class SdVolume
@@ -433,9 +516,18 @@ class SdVolume {
    */
   static uint8_t* cacheClear(void) {
     cacheFlush();
-    cacheBlockNumber_ = 0XFFFFFFFF;
-    return cacheBuffer_.data;
+    cacheSlot_->block = cacheBlockNumber_ = 0XFFFFFFFF;
+    return cacheBuffer_->data;
   }
+  /** Cache pool for FAT blocks. See cacheStats(). */
+  static uint8_t const CACHE_POOL_FAT = 0;
+  /** Cache pool for directory and file data blocks. See cacheStats(). */
+  static uint8_t const CACHE_POOL_DATA = 1;
+  /** \return Hit, miss and eviction counters of a cache pool. */
+  static const cache_stats_t& cacheStats(uint8_t pool) {
+    return cacheStats_[pool];
+  }
+  static void cacheStatsReset(void);
   /**
    * Initialize a FAT volume.  Try partition one first then try super
    * floppy format.
@@ -489,17 +581,31 @@ class SdVolume {
   private:
   // Allow SdFile access to SdVolume private data.
   friend class SdFile;
+  friend class SdExtentMap;
 
   // value for action argument in cacheRawBlock to indicate read from cache
   static uint8_t const CACHE_FOR_READ = 0;
   // value for action argument in cacheRawBlock to indicate cache dirty
   static uint8_t const CACHE_FOR_WRITE = 1;
 
-  static cache_t cacheBuffer_;        // 512 byte cache for device blocks
-  static uint32_t cacheBlockNumber_;  // Logical number of block in the cache
+  // one 512 byte cache block, FAT pool slots come first
+  struct cache_slot_t {
+    cache_t buffer;      // data of the cached device block
+    uint32_t block;      // logical block number or 0XFFFFFFFF if unused
+    uint32_t mirror;     // block number for mirror FAT or zero
+    uint16_t lastUse;    // LRU stamp
+    uint8_t dirty;       // cacheFlush() will write block if true
+  };
+  static uint8_t const CACHE_SLOT_COUNT =
+    SD_CACHE_FAT_BLOCKS + SD_CACHE_DATA_BLOCKS;
+
+  static cache_slot_t cacheSlots_[CACHE_SLOT_COUNT];  // FAT pool, data pool
+  static cache_slot_t* cacheSlot_;    // most recently accessed slot
+  static cache_t* cacheBuffer_;       // buffer of cacheSlot_
+  static uint32_t cacheBlockNumber_;  // Logical number of block in cacheSlot_
+  static uint16_t cacheUseCounter_;   // LRU clock
+  static cache_stats_t cacheStats_[2];  // counters for FAT and data pool
   static Sd2Card* sdCard_;            // Sd2Card object for cache
-  static uint8_t cacheDirty_;         // cacheFlush() will write block if true
-  static uint32_t cacheMirrorBlock_;  // block number for mirror FAT
 //
   uint32_t allocSearchStart_;   // start cluster for alloc search
   uint8_t blocksPerCluster_;    // cluster size in blocks
@@ -520,9 +626,21 @@ class SdVolume {
            return dataStartBlock_ + ((cluster - 2) << clusterSizeShift_);}
   uint32_t blockNumber(uint32_t cluster, uint32_t position) const {
            return clusterStartBlock(cluster) + blockOfCluster(position);}
+  static uint8_t cacheContains(uint32_t blockNumber) {
+    return cacheFind(blockNumber) != NULL;
+  }
+  static cache_slot_t* cacheFind(uint32_t blockNumber);
   static uint8_t cacheFlush(void);
-  static uint8_t cacheRawBlock(uint32_t blockNumber, uint8_t action);
-  static void cacheSetDirty(void) {cacheDirty_ |= CACHE_FOR_WRITE;}
+  static uint8_t cacheFlushSlot(cache_slot_t* slot);
+  static void cacheInvalidate(uint32_t blockNumber);
+  static uint8_t cacheNewBlock(uint32_t blockNumber);
+  static uint8_t cacheRawBlock(uint32_t blockNumber, uint8_t action,
+    uint8_t pool = CACHE_POOL_DATA);
+  static uint8_t cacheReadAhead(uint32_t blockNumber, uint8_t count);
+  static void cacheRelease(void);
+  static void cacheSelect(cache_slot_t* slot);
+  static void cacheSetDirty(void) {cacheSlot_->dirty |= CACHE_FOR_WRITE;}
+  static cache_slot_t* cacheVictim(uint8_t pool);
   static uint8_t cacheZeroBlock(uint32_t blockNumber);
   uint8_t chainSize(uint32_t beginCluster, uint32_t* size) const;
   uint8_t fatGet(uint32_t cluster, uint32_t* value) const;
@@ -544,4 +662,44 @@ class SdVolume {
     return sdCard_->writeBlock(block, dst);
   }
 };
+#if SD_EXTENT_MAP_FILES
+//==============================================================================
+// SdExtentMap class
+/**
+ * \class SdExtentMap
+ * \brief Cached cluster chain of a file stored as contiguous runs.
+ *
+ * Maps are keyed by the first cluster of a file so all open SdFile
+ * instances of the same file share one map.  A map is built on the first
+ * seek of a read-only file and turns the cluster lookup into a binary
+ * search over its runs instead of a walk along the FAT chain.
+ */
+class SdExtentMap {
+ public:
+  static SdExtentMap* find(uint32_t firstCluster);
+  static SdExtentMap* get(SdVolume* vol, uint32_t firstCluster);
+  static void invalidate(uint32_t firstCluster);
+  /** \return The number of clusters, counted from the start of the file,
+   * covered by this map. */
+  uint32_t clusterCount(void) const {return clusterCount_;}
+  uint32_t cluster(uint32_t index) const;
+ private:
+  // a run starts at cluster index of the file and continues contiguously
+  // up to the start of the next run
+  struct run_t {
+    uint32_t index;    // index of the run's first cluster within the file
+    uint32_t cluster;  // cluster number of the run's first cluster
+  };
+  uint8_t build(SdVolume* vol, uint32_t firstCluster);
+
+  uint32_t firstCluster_;  // key, zero for an unused map
+  uint32_t clusterCount_;  // clusters covered by runs_
+  uint16_t lastUse_;       // use stamp for LRU replacement
+  uint8_t  runCount_;      // number of valid entries in runs_
+  run_t    runs_[SD_EXTENT_MAP_RUNS];
+
+  static uint16_t useCounter_;
+  static SdExtentMap maps_[SD_EXTENT_MAP_FILES];
+};
+#endif  // SD_EXTENT_MAP_FILES
 #endif  // SdFat_h
@@ -60,7 +60,7 @@ uint8_t SdFile::addDirCluster(void) {
 // return pointer to cached entry or null for failure
 dir_t* SdFile::cacheDirEntry(uint8_t action) {
   if (!SdVolume::cacheRawBlock(dirBlock_, action)) return NULL;
-  return SdVolume::cacheBuffer_.dir + dirIndex_;
+  return SdVolume::cacheBuffer_->dir + dirIndex_;
 }
 //------------------------------------------------------------------------------
 /**
@@ -72,6 +72,7 @@ dir_t* SdFile::cacheDirEntry(uint8_t action) {
  * Reasons for failure include no file is open or an I/O error.
  */
 uint8_t SdFile::close(void) {
+  if (!freePreallocated()) return false;
   if (!sync())return false;
   type_ = FAT_FILE_TYPE_CLOSED;
   return true;
@@ -147,6 +148,32 @@ uint8_t SdFile::createContiguous(SdFile* dirFile,
   return sync();
 }
 //------------------------------------------------------------------------------
+// return the unused tail of a preallocated cluster run to the FAT
+uint8_t SdFile::freePreallocated(void) {
+  if (!(flags_ & F_FILE_PREALLOCATED)) return true;
+  flags_ &= ~F_FILE_PREALLOCATED;
+
+#if SD_EXTENT_MAP_FILES
+  SdExtentMap::invalidate(firstCluster_);
+#endif  // SD_EXTENT_MAP_FILES
+
+  if (fileSize_ == 0) {
+    // nothing written - release the whole run
+    if (!vol_->freeChain(firstCluster_)) return false;
+    firstCluster_ = 0;
+    curCluster_ = 0;
+    flags_ |= F_FILE_DIR_DIRTY;
+    return true;
+  }
+  // last cluster that holds file data
+  uint32_t last = firstCluster_ + ((fileSize_ - 1) >> (vol_->clusterSizeShift_ + 9));
+  if (last < allocEnd_) {
+    if (!vol_->freeChain(last + 1)) return false;
+    if (!vol_->fatPutEOC(last)) return false;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
 /**
  * Return a files directory entry
  *
@@ -314,7 +341,7 @@ uint8_t SdFile::makeDir(SdFile* dir, const char* dirName) {
   if (!SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE)) return false;
 
   // copy '.' to block
-  memcpy(&SdVolume::cacheBuffer_.dir[0], &d, sizeof(d));
+  memcpy(&SdVolume::cacheBuffer_->dir[0], &d, sizeof(d));
 
   // make entry for '..'
   d.name[1] = '.';
@@ -326,7 +353,7 @@ uint8_t SdFile::makeDir(SdFile* dir, const char* dirName) {
     d.firstClusterHigh = dir->firstCluster_ >> 16;
   }
   // copy '..' to block
-  memcpy(&SdVolume::cacheBuffer_.dir[1], &d, sizeof(d));
+  memcpy(&SdVolume::cacheBuffer_->dir[1], &d, sizeof(d));
 
   // set position after '..'
   curPosition_ = 2 * sizeof(d);
@@ -433,7 +460,7 @@ uint8_t SdFile::open(SdFile* dirFile, const char* fileName, uint8_t oflag) {
 
     // use first entry in cluster
     dirIndex_ = 0;
-    p = SdVolume::cacheBuffer_.dir;
+    p = SdVolume::cacheBuffer_->dir;
   }
   // initialize as empty file
   memset(p, 0, sizeof(dir_t));
@@ -501,7 +528,7 @@ uint8_t SdFile::open(SdFile* dirFile, uint16_t index, uint8_t oflag) {
 // open a cached directory entry. Assumes vol_ is initializes
 uint8_t SdFile::openCachedEntry(uint8_t dirIndex, uint8_t oflag) {
   // location of entry in cache
-  dir_t* p = SdVolume::cacheBuffer_.dir + dirIndex;
+  dir_t* p = SdVolume::cacheBuffer_->dir + dirIndex;
 
   // write or truncate is an error for a directory or read-only file
   if (p->attributes & (DIR_ATT_READ_ONLY | DIR_ATT_DIRECTORY)) {
@@ -527,6 +554,7 @@ uint8_t SdFile::openCachedEntry(uint8_t dirIndex, uint8_t oflag) {
   }
   // save open flags for read/write
   flags_ = oflag & (O_ACCMODE | O_SYNC | O_APPEND);
+  readAhead_ = 0;
 
   // set to start of file
   curCluster_ = 0;
@@ -566,6 +594,7 @@ uint8_t SdFile::openRoot(SdVolume* vol) {
   vol_ = vol;
   // read only
   flags_ = O_READ;
+  readAhead_ = 0;
 
   // set to start of file
   curCluster_ = 0;
@@ -577,6 +606,47 @@ uint8_t SdFile::openRoot(SdVolume* vol) {
   return true;
 }
 //------------------------------------------------------------------------------
+/**
+ * Reserve a contiguous run of clusters for an empty file that is about to be
+ * written sequentially.
+ *
+ * The FAT chain is linked up front so write() can step from cluster to
+ * cluster without reading or updating FAT blocks, and every data block write
+ * goes straight to the card. The file size is not changed, it still grows
+ * with write(). Clusters that have not been written to are returned to the
+ * FAT by close() or truncate().
+ *
+ * \param[in] size The expected final file size in bytes.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ * Reasons for failure include the file is not open for write, the file
+ * already has data, there is no contiguous free space of \a size bytes
+ * or an I/O error. The file is still usable for normal writes if
+ * preallocate() fails.
+ */
+uint8_t SdFile::preallocate(uint32_t size) {
+  // error if not a normal file or is read-only
+  if (!isFile() || !(flags_ & O_WRITE)) return false;
+
+  // only empty files, i.e. freshly created or truncated ones
+  if (size == 0 || firstCluster_ != 0) return false;
+
+  // calculate number of clusters needed
+  uint32_t count = ((size - 1) >> (vol_->clusterSizeShift_ + 9)) + 1;
+
+  // allocate and link clusters
+  uint32_t cluster = 0;
+  if (!vol_->allocContiguous(count, &cluster)) return false;
+  firstCluster_ = cluster;
+  allocEnd_ = cluster + count - 1;
+  curCluster_ = 0;
+  flags_ |= F_FILE_PREALLOCATED | F_FILE_DIR_DIRTY;
+
+  // commit FAT and directory entry before data blocks are written
+  return sync();
+}
+//------------------------------------------------------------------------------
 /** %Print the name field of a directory entry in 8.3 format to Serial.
  *
  * \param[in] dir The directory structure containing the name.
@@ -681,6 +751,14 @@ int16_t SdFile::read(void* buf, uint16_t nbyte) {
           // use first cluster in file
           curCluster_ = firstCluster_;
         } else {
+#if SD_EXTENT_MAP_FILES
+          // use the extent map of this file if a seek has built one
+          SdExtentMap* map = SdExtentMap::find(firstCluster_);
+          uint32_t index = curPosition_ >> (vol_->clusterSizeShift_ + 9);
+          if (map && index < map->clusterCount()) {
+            curCluster_ = map->cluster(index);
+          } else
+#endif  // SD_EXTENT_MAP_FILES
           // get next cluster from FAT
           if (!vol_->fatGet(curCluster_, &curCluster_)) return -1;
         }
@@ -692,15 +770,28 @@ int16_t SdFile::read(void* buf, uint16_t nbyte) {
     // amount to be read from current block
     if (n > (512 - offset)) n = 512 - offset;
 
-    // no buffering needed if n == 512 or user requests no buffering
-    if ((unbufferedRead() || n == 512) &&
-      block != SdVolume::cacheBlockNumber_) {
+    // no buffering needed if n == 512 or user requests no buffering,
+    // sequential readers go through the cache to read ahead
+    if ((unbufferedRead() || (n == 512 && !readAhead_)) &&
+      !SdVolume::cacheContains(block)) {
       if (!vol_->readData(block, offset, n, dst)) return -1;
       dst += n;
+    } else if (readAhead_ && type_ == FAT_FILE_TYPE_NORMAL) {
+      // fetch following blocks of this cluster that belong to the file
+      uint32_t ahead = vol_->blocksPerCluster_ - 1
+        - vol_->blockOfCluster(curPosition_);
+      uint32_t left = ((fileSize_ - 1) >> 9) - (curPosition_ >> 9);
+      if (ahead > left) ahead = left;
+      if (ahead > readAhead_) ahead = readAhead_;
+      if (!SdVolume::cacheReadAhead(block, ahead)) return -1;
+      uint8_t* src = SdVolume::cacheBuffer_->data + offset;
+      uint8_t* end = src + n;
+      while (src != end) *dst++ = *src++;
+      if ((offset + n) == 512) SdVolume::cacheRelease();
     } else {
       // read block to cache and copy data to caller
       if (!SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_READ)) return -1;
-      uint8_t* src = SdVolume::cacheBuffer_.data + offset;
+      uint8_t* src = SdVolume::cacheBuffer_->data + offset;
       uint8_t* end = src + n;
       while (src != end) *dst++ = *src++;
     }
@@ -754,7 +845,7 @@ dir_t* SdFile::readDirCache(void) {
   curPosition_ += 31;
 
   // return pointer to entry
-  return (SdVolume::cacheBuffer_.dir + i);
+  return (SdVolume::cacheBuffer_->dir + i);
 }
 //------------------------------------------------------------------------------
 /**
@@ -931,6 +1022,24 @@ uint8_t SdFile::seekSet(uint32_t pos) {
   uint32_t nCur = (curPosition_ - 1) >> (vol_->clusterSizeShift_ + 9);
   uint32_t nNew = (pos - 1) >> (vol_->clusterSizeShift_ + 9);
 
+#if SD_EXTENT_MAP_FILES
+  // read-only files jump to the cluster via their extent map
+  if (isFile() && !(flags_ & O_WRITE) && (nNew != nCur || curPosition_ == 0)) {
+    SdExtentMap* map = SdExtentMap::get(vol_, firstCluster_);
+    if (map) {
+      // follow the FAT for clusters beyond the end of the map
+      uint32_t index = nNew < map->clusterCount() ?
+                         nNew : map->clusterCount() - 1;
+      curCluster_ = map->cluster(index);
+      for (nNew -= index; nNew; nNew--) {
+        if (!vol_->fatGet(curCluster_, &curCluster_)) return false;
+      }
+      curPosition_ = pos;
+      return true;
+    }
+  }
+#endif  // SD_EXTENT_MAP_FILES
+
   if (nNew < nCur || curPosition_ == 0) {
     // must follow chain from first cluster
     curCluster_ = firstCluster_;
@@ -1069,9 +1178,17 @@ uint8_t SdFile::truncate(uint32_t length) {
   // error if length is greater than current size
   if (length > fileSize_) return false;
 
+  // give back clusters reserved beyond the current size
+  if (!freePreallocated()) return false;
+
   // fileSize and length are zero - nothing to do
   if (fileSize_ == 0) return true;
 
+#if SD_EXTENT_MAP_FILES
+  // the chain is about to change
+  SdExtentMap::invalidate(firstCluster_);
+#endif  // SD_EXTENT_MAP_FILES
+
   // remember position for seek after truncation
   uint32_t newPos = curPosition_ > length ? length : curPosition_;
 
@@ -1148,6 +1265,9 @@ size_t SdFile::write(const void* buf, uint16_t nbyte) {
         } else {
           curCluster_ = firstCluster_;
         }
+      } else if ((flags_ & F_FILE_PREALLOCATED) && curCluster_ < allocEnd_) {
+        // next cluster of the reserved run - no FAT access required
+        curCluster_++;
       } else {
         uint32_t next;
         if (!vol_->fatGet(curCluster_, &next)) return false;
@@ -1170,26 +1290,35 @@ size_t SdFile::write(const void* buf, uint16_t nbyte) {
     if (n == 512) {
       // full block - don't need to use cache
       // invalidate cache if block is in cache
-      if (SdVolume::cacheBlockNumber_ == block) {
-        SdVolume::cacheBlockNumber_ = 0XFFFFFFFF;
-      }
+      SdVolume::cacheInvalidate(block);
       if (!vol_->writeBlock(block, src)) goto writeErrorReturn;
       src += 512;
     } else {
       if (blockOffset == 0 && curPosition_ >= fileSize_) {
         // start of new block don't need to read into cache
-        if (!SdVolume::cacheFlush()) goto writeErrorReturn;
-        SdVolume::cacheBlockNumber_ = block;
-        SdVolume::cacheSetDirty();
+        if (!SdVolume::cacheNewBlock(block)) goto writeErrorReturn;
       } else {
         // rewrite part of block
         if (!SdVolume::cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE)) {
           goto writeErrorReturn;
         }
       }
-      uint8_t* dst = SdVolume::cacheBuffer_.data + blockOffset;
+      uint8_t* dst = SdVolume::cacheBuffer_->data + blockOffset;
       uint8_t* end = dst + n;
       while (dst != end) *dst++ = *src++;
+
+      if ((blockOffset + n) == 512) {
+        // block complete - write it and free the slot for other streams
+        if (!SdVolume::cacheFlushSlot(SdVolume::cacheSlot_)) {
+          goto writeErrorReturn;
+        }
+        SdVolume::cacheRelease();
+      } else if (flags_ & F_FILE_WRITE_THROUGH) {
+        // write-through files don't leave dirty data blocks behind
+        if (!SdVolume::cacheFlushSlot(SdVolume::cacheSlot_)) {
+          goto writeErrorReturn;
+        }
+      }
     }
     nToWrite -= n;
     curPosition_ += n;
@@ -19,13 +19,17 @@
  */
 #include "SdFat.h"
 //------------------------------------------------------------------------------
-// raw block cache
+// raw block cache, slots are marked unused by init()
+SdVolume::cache_slot_t SdVolume::cacheSlots_[CACHE_SLOT_COUNT];
+SdVolume::cache_slot_t* SdVolume::cacheSlot_ =
+  &SdVolume::cacheSlots_[SD_CACHE_FAT_BLOCKS];
+cache_t* SdVolume::cacheBuffer_ =
+  &SdVolume::cacheSlots_[SD_CACHE_FAT_BLOCKS].buffer;
 // init cacheBlockNumber_to invalid SD block number
 uint32_t SdVolume::cacheBlockNumber_ = 0XFFFFFFFF;
-cache_t  SdVolume::cacheBuffer_;     // 512 byte cache for Sd2Card
+uint16_t SdVolume::cacheUseCounter_ = 0;
+cache_stats_t SdVolume::cacheStats_[2];
 Sd2Card* SdVolume::sdCard_;          // pointer to SD card object
-uint8_t  SdVolume::cacheDirty_ = 0;  // cacheFlush() will write block if true
-uint32_t SdVolume::cacheMirrorBlock_ = 0;  // mirror  block for second FAT
 //------------------------------------------------------------------------------
 // find a contiguous group of clusters
 uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
@@ -96,43 +100,184 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
   return true;
 }
 //------------------------------------------------------------------------------
+// return the slot holding blockNumber or NULL if not cached
+SdVolume::cache_slot_t* SdVolume::cacheFind(uint32_t blockNumber) {
+  if (cacheBlockNumber_ == blockNumber) return cacheSlot_;
+  for (uint8_t i = 0; i < CACHE_SLOT_COUNT; i++) {
+    if (cacheSlots_[i].block == blockNumber) return &cacheSlots_[i];
+  }
+  return NULL;
+}
+//------------------------------------------------------------------------------
+// write all dirty blocks to the SD
 uint8_t SdVolume::cacheFlush(void) {
-  if (cacheDirty_) {
-    if (!sdCard_->writeBlock(cacheBlockNumber_, cacheBuffer_.data)) {
+  for (uint8_t i = 0; i < CACHE_SLOT_COUNT; i++) {
+    if (!cacheFlushSlot(&cacheSlots_[i])) return false;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+uint8_t SdVolume::cacheFlushSlot(cache_slot_t* slot) {
+  if (slot->dirty) {
+    if (!sdCard_->writeBlock(slot->block, slot->buffer.data)) {
       return false;
     }
     // mirror FAT tables
-    if (cacheMirrorBlock_) {
-      if (!sdCard_->writeBlock(cacheMirrorBlock_, cacheBuffer_.data)) {
+    if (slot->mirror) {
+      if (!sdCard_->writeBlock(slot->mirror, slot->buffer.data)) {
         return false;
       }
-      cacheMirrorBlock_ = 0;
+      slot->mirror = 0;
     }
-    cacheDirty_ = 0;
+    slot->dirty = 0;
+    cacheStats_[slot < &cacheSlots_[SD_CACHE_FAT_BLOCKS] ?
+      CACHE_POOL_FAT : CACHE_POOL_DATA].writes++;
   }
   return true;
 }
 //------------------------------------------------------------------------------
-uint8_t SdVolume::cacheRawBlock(uint32_t blockNumber, uint8_t action) {
-  if (cacheBlockNumber_ != blockNumber) {
-    if (!cacheFlush()) return false;
-    if (!sdCard_->readBlock(blockNumber, cacheBuffer_.data)) return false;
-    cacheBlockNumber_ = blockNumber;
+// drop a block that is about to be overwritten on the SD without the cache
+void SdVolume::cacheInvalidate(uint32_t blockNumber) {
+  cache_slot_t* slot = cacheFind(blockNumber);
+  if (!slot) return;
+  slot->block = 0XFFFFFFFF;
+  slot->mirror = 0;
+  slot->dirty = 0;
+  if (slot == cacheSlot_) cacheBlockNumber_ = 0XFFFFFFFF;
+}
+//------------------------------------------------------------------------------
+// cache blockNumber for write without reading it, contents are undefined
+uint8_t SdVolume::cacheNewBlock(uint32_t blockNumber) {
+  cache_slot_t* slot = cacheFind(blockNumber);
+  if (slot) {
+    cacheStats_[CACHE_POOL_DATA].hits++;
+  } else {
+    slot = cacheVictim(CACHE_POOL_DATA);
+    if (!cacheFlushSlot(slot)) return false;
+    slot->block = blockNumber;
+    cacheStats_[CACHE_POOL_DATA].misses++;
+  }
+  cacheSelect(slot);
+  cacheSetDirty();
+  return true;
+}
+//------------------------------------------------------------------------------
+uint8_t SdVolume::cacheRawBlock(uint32_t blockNumber, uint8_t action,
+  uint8_t pool) {
+  cache_slot_t* slot = cacheFind(blockNumber);
+  if (slot) {
+    cacheStats_[pool].hits++;
+  } else {
+    slot = cacheVictim(pool);
+    if (!cacheFlushSlot(slot)) return false;
+    slot->block = 0XFFFFFFFF;
+    if (!sdCard_->readBlock(blockNumber, slot->buffer.data)) return false;
+    slot->block = blockNumber;
+    cacheStats_[pool].misses++;
+  }
+  cacheSelect(slot);
+  slot->dirty |= action;
+  return true;
+}
+//------------------------------------------------------------------------------
+// cache a data block and up to count following blocks with a single
+// multiple block read.  The read stops at the first block already cached.
+uint8_t SdVolume::cacheReadAhead(uint32_t blockNumber, uint8_t count) {
+  if (count > (SD_CACHE_DATA_BLOCKS - 1)) count = SD_CACHE_DATA_BLOCKS - 1;
+  if (count == 0 || cacheContains(blockNumber)) {
+    return cacheRawBlock(blockNumber, CACHE_FOR_READ);
+  }
+  for (uint8_t i = 1; i <= count; i++) {
+    if (cacheContains(blockNumber + i)) {
+      count = i - 1;
+      break;
+    }
+  }
+  // claim slots, newer stamps for blocks further ahead so the block
+  // requested now is evicted first
+  cache_slot_t* slots[SD_CACHE_DATA_BLOCKS];
+  for (uint8_t i = 0; i <= count; i++) {
+    slots[i] = cacheVictim(CACHE_POOL_DATA);
+    if (!cacheFlushSlot(slots[i])) goto fail;
+    slots[i]->block = blockNumber + i;
+    slots[i]->lastUse = ++cacheUseCounter_;
+  }
+  if (!sdCard_->readStart(blockNumber)) goto fail;
+  for (uint8_t i = 0; i <= count; i++) {
+    if (!sdCard_->readData(slots[i]->buffer.data)) {
+      sdCard_->readStop();
+      goto fail;
+    }
   }
-  cacheDirty_ |= action;
+  if (!sdCard_->readStop()) goto fail;
+
+  cacheStats_[CACHE_POOL_DATA].misses++;
+  cacheStats_[CACHE_POOL_DATA].readAhead += count;
+  cacheSlot_ = slots[0];
+  cacheBuffer_ = &slots[0]->buffer;
+  cacheBlockNumber_ = blockNumber;
   return true;
+
+ fail:
+  // drop the claimed slots, none of them holds valid data
+  for (uint8_t i = 0; i <= count; i++) {
+    cacheInvalidate(blockNumber + i);
+  }
+  return false;
+}
+//------------------------------------------------------------------------------
+// free the current slot if it is clean, used by sequential readers once a
+// block is consumed so it doesn't push read-ahead blocks out of the pool
+void SdVolume::cacheRelease(void) {
+  if (cacheSlot_->dirty) return;
+  cacheSlot_->block = cacheBlockNumber_ = 0XFFFFFFFF;
+}
+//------------------------------------------------------------------------------
+// make slot the current cache block
+void SdVolume::cacheSelect(cache_slot_t* slot) {
+  slot->lastUse = ++cacheUseCounter_;
+  cacheSlot_ = slot;
+  cacheBuffer_ = &slot->buffer;
+  cacheBlockNumber_ = slot->block;
+}
+//------------------------------------------------------------------------------
+/** Clear the hit, miss and eviction counters of both cache pools. */
+void SdVolume::cacheStatsReset(void) {
+  memset(cacheStats_, 0, sizeof(cacheStats_));
+}
+//------------------------------------------------------------------------------
+// pick an unused or the least recently used slot of a pool
+SdVolume::cache_slot_t* SdVolume::cacheVictim(uint8_t pool) {
+  cache_slot_t* slot;
+  cache_slot_t* end;
+  if (pool == CACHE_POOL_FAT) {
+    slot = &cacheSlots_[0];
+    end = &cacheSlots_[SD_CACHE_FAT_BLOCKS];
+  } else {
+    slot = &cacheSlots_[SD_CACHE_FAT_BLOCKS];
+    end = &cacheSlots_[CACHE_SLOT_COUNT];
+  }
+  cache_slot_t* victim = slot;
+  for (; slot != end; slot++) {
+    if (slot->block == 0XFFFFFFFF) return slot;
+    if ((uint16_t)(cacheUseCounter_ - slot->lastUse) >
+        (uint16_t)(cacheUseCounter_ - victim->lastUse)) {
+      victim = slot;
+    }
+  }
+  cacheStats_[pool].evictions++;
+  if (victim == cacheSlot_) cacheBlockNumber_ = 0XFFFFFFFF;
+  return victim;
 }
 //------------------------------------------------------------------------------
 // cache a zero block for blockNumber
 uint8_t SdVolume::cacheZeroBlock(uint32_t blockNumber) {
-  if (!cacheFlush()) return false;
+  if (!cacheNewBlock(blockNumber)) return false;
 
-  // loop take less flash than memset(cacheBuffer_.data, 0, 512);
+  // loop take less flash than memset(cacheBuffer_->data, 0, 512);
   for (uint16_t i = 0; i < 512; i++) {
-    cacheBuffer_.data[i] = 0;
+    cacheBuffer_->data[i] = 0;
   }
-  cacheBlockNumber_ = blockNumber;
-  cacheSetDirty();
   return true;
 }
 //------------------------------------------------------------------------------
@@ -152,13 +297,11 @@ uint8_t SdVolume::fatGet(uint32_t cluster, uint32_t* value) const {
   if (cluster > (clusterCount_ + 1)) return false;
   uint32_t lba = fatStartBlock_;
   lba += fatType_ == 16 ? cluster >> 8 : cluster >> 7;
-  if (lba != cacheBlockNumber_) {
-    if (!cacheRawBlock(lba, CACHE_FOR_READ)) return false;
-  }
+  if (!cacheRawBlock(lba, CACHE_FOR_READ, CACHE_POOL_FAT)) return false;
   if (fatType_ == 16) {
-    *value = cacheBuffer_.fat16[cluster & 0XFF];
+    *value = cacheBuffer_->fat16[cluster & 0XFF];
   } else {
-    *value = cacheBuffer_.fat32[cluster & 0X7F] & FAT32MASK;
+    *value = cacheBuffer_->fat32[cluster & 0X7F] & FAT32MASK;
   }
   return true;
 }
@@ -175,19 +318,16 @@ uint8_t SdVolume::fatPut(uint32_t cluster, uint32_t value) {
   uint32_t lba = fatStartBlock_;
   lba += fatType_ == 16 ? cluster >> 8 : cluster >> 7;
 
-  if (lba != cacheBlockNumber_) {
-    if (!cacheRawBlock(lba, CACHE_FOR_READ)) return false;
-  }
+  if (!cacheRawBlock(lba, CACHE_FOR_WRITE, CACHE_POOL_FAT)) return false;
+
   // store entry
   if (fatType_ == 16) {
-    cacheBuffer_.fat16[cluster & 0XFF] = value;
+    cacheBuffer_->fat16[cluster & 0XFF] = value;
   } else {
-    cacheBuffer_.fat32[cluster & 0X7F] = value;
+    cacheBuffer_->fat32[cluster & 0X7F] = value;
   }
-  cacheSetDirty();
-
   // mirror second FAT
-  if (fatCount_ > 1) cacheMirrorBlock_ = lba + blocksPerFat_;
+  if (fatCount_ > 1) cacheSlot_->mirror = lba + blocksPerFat_;
   return true;
 }
 //------------------------------------------------------------------------------
@@ -227,12 +367,19 @@ uint8_t SdVolume::freeChain(uint32_t cluster) {
 uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
   uint32_t volumeStartBlock = 0;
   sdCard_ = dev;
+  // forget blocks of a previous card
+  for (uint8_t i = 0; i < CACHE_SLOT_COUNT; i++) {
+    cacheSlots_[i].block = 0XFFFFFFFF;
+    cacheSlots_[i].mirror = 0;
+    cacheSlots_[i].dirty = 0;
+  }
+  cacheBlockNumber_ = 0XFFFFFFFF;
   // if part == 0 assume super floppy with FAT boot sector in block zero
   // if part > 0 assume mbr volume with partition table
   if (part) {
     if (part > 4)return false;
     if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ)) return false;
-    part_t* p = &cacheBuffer_.mbr.part[part-1];
+    part_t* p = &cacheBuffer_->mbr.part[part-1];
     if ((p->boot & 0X7F) !=0  ||
       p->totalSectors < 100 ||
       p->firstSector == 0) {
@@ -242,7 +389,7 @@ uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
     volumeStartBlock = p->firstSector;
   }
   if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ)) return false;
-  bpb_t* bpb = &cacheBuffer_.fbs.bpb;
+  bpb_t* bpb = &cacheBuffer_->fbs.bpb;
   if (bpb->bytesPerSector != 512 ||
     bpb->fatCount == 0 ||
     bpb->reservedSectorCount == 0 ||
@@ -56,6 +56,8 @@ Printr::Printr() :
   _setupCode = new MemoryStream(64);
   _waiting = false;
   _waitStart = 0;
+  _printStream = NULL;
+  _lzPrintStream = NULL;
 
   _printrCurrentStatus = PRINTR_STATUS_INITIALIZING;
   _currentMode == PrintrMode::ImmediateMode;
@@ -66,6 +68,9 @@ Printr::Printr() :
 Printr::~Printr() {
   delete _setupCode;
   delete _currentLineBuffer;
+  if (_lzPrintStream != NULL) {
+	delete _lzPrintStream;
+  }
 }
 
 void Printr::init() {
@@ -226,7 +231,7 @@ void Printr::sendCommands() {
 	  } else {
 		//Setup buffer has been sent, switch to file
 		if (_printFile) {
-		  if (queryCurrentLine(&_printFile, _lastSentProgramLine)) {
+		  if (queryCurrentLine(_printStream, _lastSentProgramLine)) {
 			PRINTER_SPAM("Print-Mode: Queried new line from print file: %s", _currentLineBuffer->c_str());
 			_lastSentProgramLine++;
 		  }
@@ -309,18 +314,36 @@ void Printr::stopAndFlush() {
 
 int Printr::startJob(String filePath) {
   PRINTER_NOTICE("Printing file: %s", filePath.c_str());
+  _jobFilePath = filePath;
   _printFile = SD.open(filePath.c_str(), FILE_READ);
+  _printFile.setReadAhead(PRINTR_FILE_READ_AHEAD);
+
+  //Jobs may be stored LZ compressed, they are decompressed while printing
+  if (_lzPrintStream != NULL) {
+	delete _lzPrintStream;
+	_lzPrintStream = NULL;
+  }
+  uint8_t magic[LZ_MAGIC_SIZE];
+  int numMagicBytes = _printFile.read(magic, LZ_MAGIC_SIZE);
+  _printFile.seek(0);
+  if (numMagicBytes == LZ_MAGIC_SIZE && LZDecoder::isCompressed(magic, LZ_MAGIC_SIZE)) {
+	PRINTER_NOTICE("File is LZ compressed");
+	_lzPrintStream = new LZStream(&_printFile);
+	_printStream = _lzPrintStream;
+  } else {
+	_printStream = &_printFile;
+  }
 
   _totalProgramLines = -1;
   _progress = 0.0;
 
   // read json header (if available)
   char i[2];
-  _printFile.read(&i, 2);
+  _printStream->readBytes(i, 2);
   if (i[0] == ';' && i[1] == '{') {
 	// found json string in header, parse it now
-	_printFile.seek(1);
-	String js = _printFile.readStringUntil('\n', 200);
+	String js = "{";
+	js += _printStream->readStringUntil('\n', 200);
 
 	StaticJsonBuffer<512> jb;
 	JsonObject &h = jb.parseObject(js);
@@ -456,6 +479,11 @@ void Printr::programEnd(bool success) {
   reset();
 
   _printFile.close();
+  _printStream = NULL;
+  if (_lzPrintStream != NULL) {
+	delete _lzPrintStream;
+	_lzPrintStream = NULL;
+  }
   _printing = false;
   _lastSentProgramLine = 0;
   _processedProgramLine = 0;
@@ -39,6 +39,7 @@
 #include "SD.h"
 #include "framework/core/SceneController.h"
 #include "framework/core/MemoryStream.h"
+#include "framework/core/LZStream.h"
 
 struct PrintrBuffer {
   char line_buff[512];
@@ -48,6 +49,9 @@ struct PrintrBuffer {
   }
 };
 
+//Blocks read ahead while streaming the job file, see File::setReadAhead
+#define PRINTR_FILE_READ_AHEAD 1
+
 #define PRINTR_STATUS_OK 0
 #define PRINTR_STATUS_INITIALIZING 15
 
@@ -94,6 +98,11 @@ class Printr {
   String getFilamentLength() { return String(String(_printFilamentLength) + String("mm")); };
   String getSupport() { return _printSupport ? String("Yes") : String("No"); };
   String getPrintTime() { return _printTimeReadable; }
+  String getJobFilePath() { return _jobFilePath; };
+  float getProgress() { return _progress; };
+  int getCurrentLine() { return _processedProgramLine; };
+  float getNozzleTemperature() { return _hotend1Temp; };
+  int getStat() { return _stat; };
 
   void reset();
 
@@ -138,12 +147,16 @@ class Printr {
   String _printResolution;
   String _printInfill;
   String _printTimeReadable;
+  String _jobFilePath;
 
   int _lastSentProgramLine;
   float _progress;
   bool _sendNext;
   bool _printing;
   File _printFile;
+  //Stream the job is read from, the file itself or a decompressing stream on top of it
+  Stream *_printStream;
+  LZStream *_lzPrintStream;
   bool _homeX;
   bool _homeY;
   bool _homeZ;
@@ -41,6 +41,14 @@
 #include "../../errors.h"
 #include "../../jobs/ReceiveSDCardFile.h"
 #include "EventLogger.h"
+#include "Profiler.h"
+
+//Printer state is pushed to the ESP at most every PRINTER_STATE_INTERVAL ms, all fields every PRINTER_STATE_FULL_INTERVAL ms
+#define PRINTER_STATE_INTERVAL 500
+#define PRINTER_STATE_FULL_INTERVAL 10000
+
+//Profiler metrics are pushed to the ESP every METRICS_INTERVAL ms
+#define METRICS_INTERVAL 5000
 
 ApplicationClass Application;
 
@@ -48,7 +56,14 @@ extern Printr printr;
 
 ApplicationClass::ApplicationClass() {
   _firstSceneLoop = true;
+  _sceneTransition = SceneTransition::None;
+  _lastIOService = 0;
+  _lastDeadlineReport = 0;
+  _missedDeadlines = 0;
+  _worstIOServiceGap = 0;
   _touched = false;
+  _touchEvent.velocityX = 0;
+  _touchEvent.velocityY = 0;
   _nextScene = NULL;
   _currentScene = NULL;
   _lastTime = 0;
@@ -57,6 +72,10 @@ ApplicationClass::ApplicationClass() {
   _esp = new CommStack(&Serial3, this);
   _espOK = false;
   _lastESPPing = 0;
+  memset(&_printerState, 0, sizeof(PrinterState));
+  _lastPrinterStateSent = 0;
+  _lastPrinterStateFull = 0;
+  _lastMetricsSent = 0;
   _currentJob = NULL;
   _nextJob = NULL;
   memset(_serialNumber, 0, 37);
@@ -73,35 +92,26 @@ void ApplicationClass::handleTouches() {
   //Get current scene controller
   SceneController *sceneController = _currentScene;
 
-  //Touches infinite state machine
-  if (Touch.touched()) {
-	//Get touch point and transform due to screen rotation
-	TS_Point point = Touch.getPoint();
-	swap(point.x, point.y);
-	point.y = 240 - point.y;
-
-	if (_touched) {
-	  if (point.x != _lastTouchPoint.x || point.y != _lastTouchPoint.y) {
-		//LOG("Touch Moved");
-		//Move event
-		sceneController->handleTouchMoved(point, _lastTouchPoint);
-	  }
-	} else {
+  //Touch events are sampled into the queue by serviceIO, so moves aren't lost while the loop is busy drawing
+  while (TouchQueue.pop(_touchEvent)) {
+	if (_touchEvent.type == TouchEventType::Down) {
 	  //LOG("Touch down");
-	  //Touch down event
-	  sceneController->handleTouchDown(point);
+	  sceneController->handleTouchDown(_touchEvent.point);
 	  _touched = true;
-	}
-
-	_lastTouchPoint = point;
-  } else {
-	if (_touched) {
+	} else if (_touchEvent.type == TouchEventType::Move) {
+	  //LOG("Touch Moved");
+	  if (_touched) {
+		sceneController->handleTouchMoved(_touchEvent.point, _lastTouchPoint);
+	  }
+	} else if (_touchEvent.type == TouchEventType::Up) {
 	  //LOG("Touch up");
-	  //Touch up event
-	  sceneController->handleTouchUp(_lastTouchPoint);
+	  if (_touched) {
+		sceneController->handleTouchUp(_touchEvent.point);
+	  }
+	  _touched = false;
 	}
 
-	_touched = false;
+	_lastTouchPoint = _touchEvent.point;
   }
 }
 
@@ -116,6 +126,8 @@ void ApplicationClass::setup() {
   pinMode(PRINTER_ACTIVE, OUTPUT);
   digitalWrite(PRINTER_ACTIVE, HIGH);
 
+  Profiler.begin();
+
   printr.init();
 
   pinMode(CODE_INDICATOR_1, OUTPUT);
@@ -140,6 +152,86 @@ void ApplicationClass::pingESP() {
   _esp->requestTask(TaskID::Ping, sizeof(int) + 36, package);
 }
 
+void ApplicationClass::syncMetrics() {
+  if (!_espOK || (millis() - _lastMetricsSent) < METRICS_INTERVAL) return;
+  _lastMetricsSent = millis();
+
+  Metrics metrics;
+  Profiler.getMetrics(&metrics);
+  _esp->requestTask(TaskID::Metrics, sizeof(Metrics), (uint8_t *) &metrics);
+}
+
+void ApplicationClass::syncPrinterState() {
+  if (!_espOK || (millis() - _lastPrinterStateSent) < PRINTER_STATE_INTERVAL) return;
+  _lastPrinterStateSent = millis();
+
+  PrinterState state;
+  memset(&state, 0, sizeof(PrinterState));
+  state.printing = printr.isPrinting() ? 1 : 0;
+  state.stat = (uint8_t) printr.getStat();
+  state.progress = (uint16_t) (constrain(printr.getProgress(), 0.0f, 1.0f) * 10000.0f);
+  state.nozzleTemperature = (int16_t) (printr.getNozzleTemperature() * 10.0f);
+  state.line = printr.getCurrentLine();
+  state.totalLines = printr.getTotalJobLines();
+  if (state.printing) {
+	strncpy(state.job, printr.getJobFilePath().c_str(), sizeof(state.job) - 1);
+  }
+
+  uint8_t fields = 0;
+  if (state.printing != _printerState.printing) fields |= PRINTER_STATE_PRINTING;
+  if (state.stat != _printerState.stat) fields |= PRINTER_STATE_STAT;
+  if (state.progress != _printerState.progress) fields |= PRINTER_STATE_PROGRESS;
+  if (state.nozzleTemperature != _printerState.nozzleTemperature) fields |= PRINTER_STATE_NOZZLE_TEMP;
+  if (state.line != _printerState.line) fields |= PRINTER_STATE_LINE;
+  if (state.totalLines != _printerState.totalLines) fields |= PRINTER_STATE_TOTAL_LINES;
+  if (strcmp(state.job, _printerState.job) != 0) fields |= PRINTER_STATE_JOB;
+
+  //Resend everything from time to time so the ESP recovers from lost packages or a reset
+  if ((millis() - _lastPrinterStateFull) > PRINTER_STATE_FULL_INTERVAL) {
+	fields = PRINTER_STATE_ALL;
+	_lastPrinterStateFull = millis();
+  }
+  if (fields == 0) return;
+
+  //Only changed fields are sent, in the order of their bits
+  uint8_t package[1 + sizeof(PrinterState)];
+  size_t size = 0;
+  package[size++] = fields;
+  if (fields & PRINTER_STATE_PRINTING) {
+	memcpy(&package[size], &state.printing, sizeof(state.printing));
+	size += sizeof(state.printing);
+  }
+  if (fields & PRINTER_STATE_STAT) {
+	memcpy(&package[size], &state.stat, sizeof(state.stat));
+	size += sizeof(state.stat);
+  }
+  if (fields & PRINTER_STATE_PROGRESS) {
+	memcpy(&package[size], &state.progress, sizeof(state.progress));
+	size += sizeof(state.progress);
+  }
+  if (fields & PRINTER_STATE_NOZZLE_TEMP) {
+	memcpy(&package[size], &state.nozzleTemperature, sizeof(state.nozzleTemperature));
+	size += sizeof(state.nozzleTemperature);
+  }
+  if (fields & PRINTER_STATE_LINE) {
+	memcpy(&package[size], &state.line, sizeof(state.line));
+	size += sizeof(state.line);
+  }
+  if (fields & PRINTER_STATE_TOTAL_LINES) {
+	memcpy(&package[size], &state.totalLines, sizeof(state.totalLines));
+	size += sizeof(state.totalLines);
+  }
+  if (fields & PRINTER_STATE_JOB) {
+	size_t length = strlen(state.job) + 1;
+	memcpy(&package[size], state.job, length);
+	size += length;
+  }
+
+  if (_esp->requestTask(TaskID::PrinterState, size, package)) {
+	memcpy(&_printerState, &state, sizeof(PrinterState));
+  }
+}
+
 const char *ApplicationClass::getSerialNumber() {
   if (strlen(_serialNumber) < 36) {
 	String path = "/serial";
@@ -164,6 +256,8 @@ void ApplicationClass::resetESP() {
 }
 
 void ApplicationClass::loop() {
+  uint32_t loopStart = Profiler.cycles();
+
   //Peridically send ping to ESP
   if (!_espOK) {
 	if ((millis() - _lastESPPing) > 5000) {
@@ -172,19 +266,22 @@ void ApplicationClass::loop() {
 	}
   }
 
-  //Process Communication with ESP
-  _esp->process();
+  serviceIO();
 
-  //run the loop on printr
-  _esp->beginBlockPort();
-  printr.loop();
-  _esp->endBlockPort();
+  //Push changed printer state to the ESP
+  syncPrinterState();
+
+  //Push profiler metrics to the ESP
+  syncMetrics();
 
   //Run Animations
   Animator.update();
 
   StatusLED.loop();
 
+  //Send queued log messages
+  EventLogger.loop();
+
   //Clear the display
   //Display.clear();
 
@@ -211,6 +308,7 @@ void ApplicationClass::loop() {
   }
 
   if (_currentJob != NULL) {
+	PROFILE_SCOPE(Jobs);
 	_esp->beginBlockPort();
 	_currentJob->loop();
 	_esp->endBlockPort();
@@ -225,25 +323,48 @@ void ApplicationClass::loop() {
 	}
   }
 
+  serviceIOIfDue();
+
   //UI Handling
+  //Scene transitions are spread over several loop iterations so communication and printing keep running
   if (_nextScene != NULL) {
-	_esp->beginBlockPort();
-
-	//Shut down display to hide the build process of the layout (which is step by step and looks flashy)
-	Display.fadeOut();
+	if (_sceneTransition == SceneTransition::None || _sceneTransition == SceneTransition::FadingIn) {
+	  _sceneTransition = SceneTransition::Preparing;
+	}
 
-	//Clear the display
-	Display.clear();
+	if (_sceneTransition == SceneTransition::Preparing) {
+	  _esp->beginBlockPort();
+	  bool prepared = _nextScene->prepare();
+	  _esp->endBlockPort();
 
-	if (_currentScene != NULL) {
-	  delete _currentScene;
+	  if (prepared) {
+		//Shut down display to hide the build process of the layout (which is step by step and looks flashy)
+		Display.fadeTo(0, SCENE_FADE_DURATION);
+		_sceneTransition = SceneTransition::FadingOut;
+	  }
 	}
 
-	_currentScene = _nextScene;
-	_nextScene = NULL;
-	_firstSceneLoop = true;
+	if (_sceneTransition == SceneTransition::FadingOut && !Display.isFading()) {
+	  _esp->beginBlockPort();
 
-	_esp->endBlockPort();
+	  //Clear the display
+	  Display.clear();
+
+	  if (_currentScene != NULL) {
+		delete _currentScene;
+	  }
+
+	  //The views and layers of the old scene are gone, layers it added to the display without deleting them are
+	  //released with the arena, too
+	  SceneArena.reset();
+
+	  _currentScene = _nextScene;
+	  _nextScene = NULL;
+	  _firstSceneLoop = true;
+	  _sceneTransition = SceneTransition::FadingIn;
+
+	  _esp->endBlockPort();
+	}
   }
 
   //Run current controller
@@ -263,7 +384,9 @@ void ApplicationClass::loop() {
 	  sceneController->setupDisplay();
 
 	  LOG_VALUE("Appearing scene", sceneController->getName());
+	  SceneArena.open();
 	  sceneController->onWillAppear();
+	  SceneArena.close();
 	  LOG("Scene appeared");
 
 /*			Display.fillRect(0,0,50,240,Application.getTheme()->getPrimaryColor());
@@ -277,8 +400,14 @@ void ApplicationClass::loop() {
 	  _esp->endBlockPort();
 	}
 
-	//Touch handling
-	handleTouches();
+	//Touch handling, the scene that is fading out doesn't receive touches anymore
+	if (_sceneTransition != SceneTransition::FadingOut) {
+	  PROFILE_SCOPE(Touch);
+	  handleTouches();
+	} else {
+	  TouchQueue.clear();
+	  _touched = false;
+	}
 
 	//Calculate Delta Time
 	unsigned long currentTime = millis();
@@ -290,11 +419,16 @@ void ApplicationClass::loop() {
 	}
 
 	//Run the scenes loop function
-	_esp->beginBlockPort();
-	sceneController->loop();
-	_esp->endBlockPort();
+	{
+	  PROFILE_SCOPE(Scene);
+	  _esp->beginBlockPort();
+	  sceneController->loop();
+	  _esp->endBlockPort();
+	}
 	_lastTime = millis();
 
+	serviceIOIfDue();
+
 	bool willRefresh = Display.willRefresh();
 	if (willRefresh) {
 	  //This should be a good idea as it marks MK20 to be unable to receive data, but this does not work at the moment
@@ -302,19 +436,26 @@ void ApplicationClass::loop() {
 	}
 
 	//Relayout screen tiles
-	Display.layoutIfNeeded();
+	{
+	  PROFILE_SCOPE(Layout);
+	  Display.layoutIfNeeded();
+	}
 
 	if (_firstSceneLoop) {
 	  //Inform scene controller that it's visible now
 	  _currentScene->onDidAppear();
 	}
 
-	//Update display
-	Display.dispatch();
+	//Update display, the first frame of a scene is drawn completely as the backlight is faded in afterwards
+	{
+	  PROFILE_SCOPE(Dispatch);
+	  Display.dispatch(_firstSceneLoop ? 0 : DISPLAY_DISPATCH_BUDGET);
+	}
 
-	if (_firstSceneLoop) {
+	if (_firstSceneLoop && _sceneTransition == SceneTransition::FadingIn) {
 	  //Set display brightness to full to show what's been built up since we shut down the display
-	  Display.fadeIn();
+	  Display.fadeTo(DISPLAY_BRIGHTNESS_MAX, SCENE_FADE_DURATION);
+	  _sceneTransition = SceneTransition::None;
 	}
 
 	if (willRefresh) {
@@ -323,8 +464,13 @@ void ApplicationClass::loop() {
 	}
 
 	_firstSceneLoop = false;
+
+	serviceIOIfDue();
   }
 
+  //Loop time is the work done in this iteration, without the idle delay
+  Profiler.record(ProfileSection::Loop, Profiler.cycles() - loopStart);
+
   //Delay for a few ms if no animation is running
   if (!Animator.hasActiveAnimations()) {
 	//delay(16);
@@ -332,6 +478,46 @@ void ApplicationClass::loop() {
 
 }
 
+void ApplicationClass::serviceIO() {
+  unsigned long currentTime = micros();
+  if (_lastIOService > 0) {
+	uint32_t gap = currentTime - _lastIOService;
+	if (gap > _worstIOServiceGap) _worstIOServiceGap = gap;
+	if (gap > IO_SERVICE_DEADLINE) {
+	  _missedDeadlines++;
+	  if (millis() - _lastDeadlineReport > 1000) {
+		PRINTER_WARNING("Printer I/O serviced after %lu us, %lu deadlines missed", gap, _missedDeadlines);
+		_lastDeadlineReport = millis();
+	  }
+	}
+  }
+
+  //Process Communication with ESP
+  {
+	PROFILE_SCOPE(CommStack);
+	_esp->process();
+  }
+
+  //run the loop on printr
+  {
+	PROFILE_SCOPE(Printer);
+	_esp->beginBlockPort();
+	printr.loop();
+	_esp->endBlockPort();
+  }
+
+  //Sample the touch screen, this only talks to the controller while the screen is touched
+  TouchQueue.sample();
+
+  _lastIOService = micros();
+}
+
+void ApplicationClass::serviceIOIfDue() {
+  if (micros() - _lastIOService >= IO_SERVICE_INTERVAL) {
+	serviceIO();
+  }
+}
+
 void ApplicationClass::pushScene(SceneController *scene, bool cancelModal) {
   if (_currentScene != NULL && _currentScene->isModal() && cancelModal == false) {
 	//Don't push this scene as the current screen is modal and should not be canceled
@@ -340,6 +526,14 @@ void ApplicationClass::pushScene(SceneController *scene, bool cancelModal) {
 
   LOG_VALUE("Pushing scene", scene->getName());
 
+  //A scene pushed while another one is still preparing replaces it
+  if (_nextScene != NULL && _nextScene != scene) {
+	delete _nextScene;
+	if (_sceneTransition == SceneTransition::FadingOut) {
+	  _sceneTransition = SceneTransition::Preparing;
+	}
+  }
+
   _nextScene = scene;
 }
 
@@ -365,6 +559,7 @@ CommStack *ApplicationClass::getESPStack() {
 }
 
 void ApplicationClass::onCommStackError() {
+  Profiler.count(ProfileCounter::CommStackErrors);
   StatusLED.pulse(0.5, false);
 }
 
@@ -46,6 +46,9 @@
 #include <SoftwareSerial.h>
 #include "BackgroundJob.h"
 #include "EventLogger.h"
+#include "Profiler.h"
+#include "TouchQueue.h"
+#include "SceneArena.h"
 
 #define STRINGIZE_DETAIL(x) #x
 #define STRINGIZE(x) STRINGIZE_DETAIL(x)
@@ -54,7 +57,7 @@
 
 //#define DEBUG_LOGS
 #ifdef DEBUG_LOGS
-#define LOG(m) DebugSerial.println(logString(m));DebugSerial.flush();
+#define LOG(m) EventLogger.log(LOG_FLOW,LOG_ALWAYS,"%s",logString(m));
 #define LOG_VALUE(m,v) DebugSerial.print(logError(m));DebugSerial.println(v);Serial.flush();
 #else
 #define LOG(m)
@@ -64,6 +67,23 @@
 #define FIRMWARE_VERSION "0.16"
 #define FIRMWARE_BUILDNR 109
 
+//Loop scheduling (in microseconds): printer and ESP I/O take precedence and are serviced again between UI stages
+//once the interval passed, longer gaps count as missed deadlines. Display updates stop after their budget and resume
+//in the next loop
+#define IO_SERVICE_INTERVAL 2000
+#define IO_SERVICE_DEADLINE 10000
+#define DISPLAY_DISPATCH_BUDGET 6000
+
+//Duration of backlight fades when switching scenes, in seconds
+#define SCENE_FADE_DURATION 0.13f
+
+enum class SceneTransition : uint8_t {
+  None = 0,
+  Preparing = 1,    //Next scene loads its resources, the current one is still shown
+  FadingOut = 2,
+  FadingIn = 3
+};
+
 enum class NetworkMode : uint8_t {
   Unconnected = 0,
   Client = 1,
@@ -82,6 +102,26 @@ struct SystemInfo {
   bool hasPassword;
 };
 
+//Fields of PrinterState that changed, the MK20 only sends flagged fields (in bit order) after a leading fields byte
+#define PRINTER_STATE_PRINTING 0x01
+#define PRINTER_STATE_STAT 0x02
+#define PRINTER_STATE_PROGRESS 0x04
+#define PRINTER_STATE_NOZZLE_TEMP 0x08
+#define PRINTER_STATE_LINE 0x10
+#define PRINTER_STATE_TOTAL_LINES 0x20
+#define PRINTER_STATE_JOB 0x40
+#define PRINTER_STATE_ALL 0x7F
+
+struct PrinterState {
+  uint8_t printing;
+  uint8_t stat;
+  uint16_t progress;          //0.01%
+  int16_t nozzleTemperature;  //0.1 degrees celsius
+  int32_t line;
+  int32_t totalLines;
+  char job[32];
+};
+
 class SceneController;
 class View;
 
@@ -108,6 +148,8 @@ class ApplicationClass : public CommStackDelegate {
 
 #pragma mark Touch Handling
   void handleTouches();
+  //Event that is currently dispatched to the scene
+  TouchEvent &getTouchEvent() { return _touchEvent; };
 
 #pragma mark Color Theme
   ColorTheme *getTheme();
@@ -121,15 +163,22 @@ class ApplicationClass : public CommStackDelegate {
 #pragma mark Misc
   void sendScreenshot();
 
+#pragma mark Printer State
+  PrinterState *getPrinterState() { return &_printerState; };
+
 #pragma mark Time Management
   float getDeltaTime();
+  uint32_t getMissedDeadlines() { return _missedDeadlines; };
+  uint32_t getWorstIOServiceGap() { return _worstIOServiceGap; };
 
 #pragma mark Member Variables
  private:
   bool _firstSceneLoop;
+  SceneTransition _sceneTransition;
   ColorTheme _theme;
   bool _touched;
   TS_Point _lastTouchPoint;
+  TouchEvent _touchEvent;
   SceneController *_nextScene;
   SceneController *_currentScene;
   unsigned long _lastTime;
@@ -138,6 +187,18 @@ class ApplicationClass : public CommStackDelegate {
   int _buildNumber;
   bool _espOK;
   unsigned long _lastESPPing;
+  PrinterState _printerState;
+  unsigned long _lastPrinterStateSent;
+  unsigned long _lastPrinterStateFull;
+  void syncPrinterState();
+  unsigned long _lastMetricsSent;
+  void syncMetrics();
+  unsigned long _lastIOService;
+  unsigned long _lastDeadlineReport;
+  uint32_t _missedDeadlines;
+  uint32_t _worstIOServiceGap;
+  void serviceIO();
+  void serviceIOIfDue();
   BackgroundJob *_currentJob;
   BackgroundJob *_nextJob;
   char _serialNumber[37];
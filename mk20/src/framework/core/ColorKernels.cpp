@@ -0,0 +1,199 @@
+/*
+ * RGB565 pixel kernels (darken, lighten, blend, tint, grayscale) shared by
+ * PHDisplay and ImageBuffer. Pixels are processed in pairs: each color channel
+ * of two pixels sits in the two 16 bit halves of a 32 bit word, so a single
+ * multiply scales both pixels without soft float and without carries crossing
+ * into the other half. Channels are expanded to 8 bit before they are scaled
+ * and truncated back like the RGB565 macro.
+ *
+ * Scales and alphas are 8.8 fixed point, 0 to 256.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ColorKernels.h"
+
+#define LANES_5 0x001F001F
+#define LANES_6 0x003F003F
+#define LANES_8 0x00FF00FF
+
+//Bias of 1/8 LSB when scaling, keeps darken identical to the float code shadows were drawn with before
+#define SCALE_BIAS 0x00200020
+
+struct ChannelPair {
+  uint32_t r;
+  uint32_t g;
+  uint32_t b;
+};
+
+static inline uint32_t load(const uint16_t *pixels) {
+  uint32_t pair;
+  memcpy(&pair, pixels, sizeof(pair));
+  return pair;
+}
+
+static inline void store(uint16_t *pixels, uint32_t pair) {
+  memcpy(pixels, &pair, sizeof(pair));
+}
+
+static inline uint32_t splat(uint16_t color) {
+  return color | ((uint32_t) color << 16);
+}
+
+//Split two RGB565 pixels into 8 bit channel lanes, rounded like ((v * 255) / 31)
+static inline ChannelPair expand(uint32_t pair) {
+  ChannelPair c;
+  c.r = ((((pair >> 11) & LANES_5) * 527 + 0x00170017) >> 6) & LANES_8;
+  c.g = ((((pair >> 5) & LANES_6) * 259 + 0x00210021) >> 6) & LANES_8;
+  c.b = (((pair & LANES_5) * 527 + 0x00170017) >> 6) & LANES_8;
+  return c;
+}
+
+//Truncate 8 bit channel lanes back to two RGB565 pixels
+static inline uint32_t pack(const ChannelPair &c) {
+  return (((c.r >> 3) & LANES_5) << 11) | (((c.g >> 2) & LANES_6) << 5) | ((c.b >> 3) & LANES_5);
+}
+
+//Each lane holds at most 255 * 256 + bias, so the products never carry into the upper pixel
+static inline uint32_t scaleLanes(uint32_t lanes, uint32_t scale) {
+  return ((lanes * scale + SCALE_BIAS) >> 8) & LANES_8;
+}
+
+static inline uint32_t darkenPair(uint32_t pair, uint32_t scale) {
+  ChannelPair c = expand(pair);
+  c.r = scaleLanes(c.r, scale);
+  c.g = scaleLanes(c.g, scale);
+  c.b = scaleLanes(c.b, scale);
+  return pack(c);
+}
+
+static inline uint32_t lightenPair(uint32_t pair, uint32_t amount) {
+  //Darken the distance to white
+  ChannelPair c = expand(pair);
+  c.r = LANES_8 - scaleLanes(LANES_8 - c.r, 256 - amount);
+  c.g = LANES_8 - scaleLanes(LANES_8 - c.g, 256 - amount);
+  c.b = LANES_8 - scaleLanes(LANES_8 - c.b, 256 - amount);
+  return pack(c);
+}
+
+static inline uint32_t blendPair(uint32_t pair, uint32_t source, uint32_t alpha) {
+  //Weights add up to 256, the sum of both products fits a lane
+  ChannelPair c = expand(pair);
+  ChannelPair s = expand(source);
+  c.r = ((s.r * alpha + c.r * (256 - alpha)) >> 8) & LANES_8;
+  c.g = ((s.g * alpha + c.g * (256 - alpha)) >> 8) & LANES_8;
+  c.b = ((s.b * alpha + c.b * (256 - alpha)) >> 8) & LANES_8;
+  return pack(c);
+}
+
+static inline uint32_t grayscalePair(uint32_t pair) {
+  //BT.601 luma with weights adding up to 256
+  ChannelPair c = expand(pair);
+  uint32_t y = ((c.r * 77 + c.g * 150 + c.b * 29) >> 8) & LANES_8;
+  c.r = c.g = c.b = y;
+  return pack(c);
+}
+
+uint16_t ColorKernels::darken(uint16_t color, uint16_t scale) {
+  return (uint16_t) darkenPair(color, scale);
+}
+
+uint16_t ColorKernels::lighten(uint16_t color, uint16_t amount) {
+  return (uint16_t) lightenPair(color, amount);
+}
+
+uint16_t ColorKernels::blend(uint16_t color, uint16_t source, uint16_t alpha) {
+  return (uint16_t) blendPair(color, source, alpha);
+}
+
+uint16_t ColorKernels::grayscale(uint16_t color) {
+  return (uint16_t) grayscalePair(color);
+}
+
+void ColorKernels::darken(uint16_t *pixels, size_t count, uint16_t scale) {
+  size_t i = 0;
+  for (; i + 1 < count; i += 2) {
+	store(&pixels[i], darkenPair(load(&pixels[i]), scale));
+  }
+  if (i < count) {
+	pixels[i] = darken(pixels[i], scale);
+  }
+}
+
+void ColorKernels::darken(uint16_t *pixels, size_t count, uint16_t scale, uint16_t keepColor) {
+  size_t i = 0;
+  uint32_t keep = splat(keepColor);
+  for (; i + 1 < count; i += 2) {
+	uint32_t pair = load(&pixels[i]);
+	uint32_t result = darkenPair(pair, scale);
+
+	//Put back the halves that matched keepColor
+	uint32_t match = pair ^ keep;
+	uint32_t mask = 0;
+	if ((match & 0xFFFF) == 0) mask |= 0x0000FFFF;
+	if ((match >> 16) == 0) mask |= 0xFFFF0000;
+	store(&pixels[i], (result & ~mask) | (pair & mask));
+  }
+  if (i < count && pixels[i] != keepColor) {
+	pixels[i] = darken(pixels[i], scale);
+  }
+}
+
+void ColorKernels::lighten(uint16_t *pixels, size_t count, uint16_t amount) {
+  size_t i = 0;
+  for (; i + 1 < count; i += 2) {
+	store(&pixels[i], lightenPair(load(&pixels[i]), amount));
+  }
+  if (i < count) {
+	pixels[i] = lighten(pixels[i], amount);
+  }
+}
+
+void ColorKernels::blend(uint16_t *pixels, const uint16_t *source, size_t count, uint16_t alpha) {
+  size_t i = 0;
+  for (; i + 1 < count; i += 2) {
+	store(&pixels[i], blendPair(load(&pixels[i]), load(&source[i]), alpha));
+  }
+  if (i < count) {
+	pixels[i] = blend(pixels[i], source[i], alpha);
+  }
+}
+
+void ColorKernels::tint(uint16_t *pixels, size_t count, uint16_t color, uint16_t amount) {
+  size_t i = 0;
+  uint32_t source = splat(color);
+  for (; i + 1 < count; i += 2) {
+	store(&pixels[i], blendPair(load(&pixels[i]), source, amount));
+  }
+  if (i < count) {
+	pixels[i] = blend(pixels[i], color, amount);
+  }
+}
+
+void ColorKernels::grayscale(uint16_t *pixels, size_t count) {
+  size_t i = 0;
+  for (; i + 1 < count; i += 2) {
+	store(&pixels[i], grayscalePair(load(&pixels[i])));
+  }
+  if (i < count) {
+	pixels[i] = grayscale(pixels[i]);
+  }
+}
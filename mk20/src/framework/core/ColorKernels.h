@@ -0,0 +1,57 @@
+/*
+ * RGB565 pixel kernels (darken, lighten, blend, tint, grayscale) shared by
+ * PHDisplay and ImageBuffer. Pixels are processed in pairs: each color channel
+ * of two pixels sits in the two 16 bit halves of a 32 bit word, so a single
+ * multiply scales both pixels without soft float and without carries crossing
+ * into the other half. Channels are expanded to 8 bit before they are scaled
+ * and truncated back like the RGB565 macro.
+ *
+ * Scales and alphas are 8.8 fixed point, 0 to 256.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_COLORKERNELS_H
+#define MK20_COLORKERNELS_H
+
+#include <Arduino.h>
+
+//Scale used for shadowed (pressed) bitmaps, 70% brightness
+#define COLOR_SHADOW_SCALE 179
+
+class ColorKernels {
+ public:
+  static uint16_t darken(uint16_t color, uint16_t scale);
+  static uint16_t lighten(uint16_t color, uint16_t amount);
+  static uint16_t blend(uint16_t color, uint16_t source, uint16_t alpha);
+  static uint16_t grayscale(uint16_t color);
+
+  //Darken all pixels, pixels of keepColor are left untouched
+  static void darken(uint16_t *pixels, size_t count, uint16_t scale);
+  static void darken(uint16_t *pixels, size_t count, uint16_t scale, uint16_t keepColor);
+  static void lighten(uint16_t *pixels, size_t count, uint16_t amount);
+  //pixels = source * alpha + pixels * (256 - alpha)
+  static void blend(uint16_t *pixels, const uint16_t *source, size_t count, uint16_t alpha);
+  static void tint(uint16_t *pixels, size_t count, uint16_t color, uint16_t amount);
+  static void grayscale(uint16_t *pixels, size_t count);
+};
+
+#endif //MK20_COLORKERNELS_H
@@ -28,97 +28,113 @@
 
 #include "EventLogger.h"
 #include "HAL.h"
+#include "Application.h"
 
 EventLoggerClass::EventLoggerClass() {
   _logLevel = LOG_WARNING;
   _contexts = LOG_FLOW;
+  _forwardLevel = LOG_WARNING;
+  _dropped = 0;
+  _lastForward = 0;
 }
 
 void EventLoggerClass::log(uint8_t logContext, uint8_t logLevel, char * msg, ...) {
   if (logContext & _contexts && logLevel >= _logLevel) {
     va_list ap;
-    char buffer[256];
-
     va_start(ap, msg);
-    int ret = vsnprintf(buffer, sizeof buffer, msg, ap);
+    queue(logLevel, msg, ap);
     va_end(ap);
-
-    if (logLevel == LOG_NOTICE) {
-      DebugSerial.print("Notice: ");
-    } else if (logLevel == LOG_WARNING) {
-      DebugSerial.print("Warning: ");
-    } else if (logLevel == LOG_ERROR) {
-      DebugSerial.print("Error: ");
-    } else {
-      DebugSerial.print("Log: ");
-    }
-
-    if (strlen(buffer) > 0 && buffer[strlen(buffer)-1] == '\n') {
-      //We already have a newline in the buffer
-      DebugSerial.print(buffer);
-    } else {
-      DebugSerial.println(buffer);
-    }
-
-    DebugSerial.flush();
   }
-
-
-  //Serial.println(buffer);
-  //Serial.print(0);
-
-
-//  int len = strlen(buffer);
-//  Application.getMK20Stack()->requestTask(TaskID::DebugLog,(size_t)(len+1),(uint8_t*)&buffer[0]);
-
 }
 
 void EventLoggerClass::log(uint8_t logContext, uint8_t logLevel, const char * msg, ...) {
   if (logContext & _contexts && logLevel >= _logLevel) {
     va_list ap;
-    char buffer[256];
-
     va_start(ap, msg);
-    int ret = vsnprintf(buffer, sizeof buffer, msg, ap);
+    queue(logLevel, msg, ap);
     va_end(ap);
+  }
+}
 
-    if (logLevel == LOG_NOTICE) {
-      DebugSerial.print("Notice: ");
-    } else if (logLevel == LOG_WARNING) {
-      DebugSerial.print("Warning: ");
-    } else if (logLevel == LOG_ERROR) {
-      DebugSerial.print("Error: ");
-    } else {
-      DebugSerial.print("Log: ");
-    }
+void EventLoggerClass::queue(uint8_t logLevel, const char *msg, va_list args) {
+  char buffer[256];
+  int length;
+
+  if (logLevel == LOG_NOTICE) {
+    length = snprintf(buffer, sizeof buffer, "Notice: ");
+  } else if (logLevel == LOG_WARNING) {
+    length = snprintf(buffer, sizeof buffer, "Warning: ");
+  } else if (logLevel == LOG_ERROR) {
+    length = snprintf(buffer, sizeof buffer, "Error: ");
+  } else {
+    length = snprintf(buffer, sizeof buffer, "Log: ");
+  }
 
-    if (strlen(buffer) > 0 && buffer[strlen(buffer)-1] == '\n') {
-      //We already have a newline in the buffer
-      DebugSerial.print(buffer);
-    } else {
-      DebugSerial.println(buffer);
-    }
+  vsnprintf(&buffer[length], sizeof buffer - length, msg, args);
+  length = strlen(buffer);
+
+  //Every message ends with exactly one newline
+  if (length == 0 || buffer[length - 1] != '\n') {
+    if (length >= (int) sizeof buffer - 2) length = sizeof buffer - 3;
+    buffer[length++] = '\r';
+    buffer[length++] = '\n';
+    buffer[length] = 0;
+  }
 
-    DebugSerial.flush();
+  if (!_queue.write(buffer, length)) {
+    _dropped++;
   }
 
-  //Serial.println(buffer);
-  //Serial.print(0);
+  if (logLevel >= _forwardLevel && !_espQueue.write(buffer, length)) {
+    _dropped++;
+  }
+}
 
-  //Serial.println(buffer);
+void EventLoggerClass::loop() {
+  if (_dropped > 0) {
+    char buffer[48];
+    int length = snprintf(buffer, sizeof buffer, "Warning: %d log messages dropped\r\n", _dropped);
+    if (_queue.write(buffer, length)) {
+      _dropped = 0;
+    }
+  }
 
-  //int len = strlen(buffer);
-  //Application.getMK20Stack()->requestTask(TaskID::DebugLog,(size_t)(len+1),(uint8_t*)&buffer[0]);
+  //Only fill the transmit buffer of the UART, its TX interrupt sends the data in the background.
+  //Software serial is bit-banged, so just send a few bytes each loop
+#ifdef DEBUG_USE_SOFTWARE_SERIAL
+  int count = EVENTLOGGER_SOFTWARE_SERIAL_CHUNK;
+#else
+  int count = DebugSerial.availableForWrite();
+#endif
+  if (count > _queue.used()) count = _queue.used();
+
+  for (int i = 0; i < count; i++) {
+    DebugSerial.write(_queue.peek(i));
+  }
+  _queue.consume(count);
 
-  /*
-  va_list args;
-  va_start(args, msg);
+  forwardToESP();
+}
 
-  while (1) {
-    char ch = va_arg(args, int);
-    if (!ch) break;
-    events.send(&ch);
+void EventLoggerClass::forwardToESP() {
+  uint16_t used = _espQueue.used();
+  if (used == 0) return;
+  if (used < EVENTLOGGER_ESP_BATCH_SIZE && millis() - _lastForward < EVENTLOGGER_ESP_BATCH_INTERVAL) return;
+
+  CommStack *esp = Application.getESPStack();
+  if (esp == NULL) return;
+
+  //Send complete lines only, unless a single line is longer than a batch
+  uint16_t size = used < EVENTLOGGER_ESP_BATCH_SIZE ? used : EVENTLOGGER_ESP_BATCH_SIZE;
+  uint16_t batchSize = 0;
+  char batch[EVENTLOGGER_ESP_BATCH_SIZE];
+  for (uint16_t i = 0; i < size; i++) {
+    batch[i] = _espQueue.peek(i);
+    if (batch[i] == '\n') batchSize = i + 1;
   }
-  */
+  if (batchSize == 0) batchSize = size;
 
+  esp->requestTask(TaskID::DebugLog, batchSize, (const uint8_t *) batch);
+  _espQueue.consume(batchSize);
+  _lastForward = millis();
 }
@@ -43,20 +43,91 @@
 #define LOG_COMMSTACK 8
 #define LOG_PRINTER 16
 
-#define COMMSTACK_NOTICE(X, ...) EventLogger.log(LOG_COMMSTACK,LOG_NOTICE,X,##__VA_ARGS__)
-#define COMMSTACK_WARNING(X, ...) EventLogger.log(LOG_COMMSTACK,LOG_WARNING,X,##__VA_ARGS__)
-#define COMMSTACK_ERROR(X, ...) EventLogger.log(LOG_COMMSTACK,LOG_ERROR,X,##__VA_ARGS__)
-#define COMMSTACK_SPAM(X, ...) EventLogger.log(LOG_COMMSTACK,LOG_SPAM,X,##__VA_ARGS__)
+//Messages below this level are removed at compile time, override with a build flag
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_NOTICE
+#endif
 
-#define FLOW_NOTICE(X, ...) EventLogger.log(LOG_FLOW,LOG_NOTICE,X,##__VA_ARGS__)
-#define FLOW_ERROR(X, ...) EventLogger.log(LOG_FLOW,LOG_ERROR,X,##__VA_ARGS__)
+//Queue sizes must be a power of two
+#define EVENTLOGGER_QUEUE_SIZE 1024
+#define EVENTLOGGER_ESP_QUEUE_SIZE 512
+#define EVENTLOGGER_ESP_BATCH_SIZE 200
+#define EVENTLOGGER_ESP_BATCH_INTERVAL 1000
+#define EVENTLOGGER_SOFTWARE_SERIAL_CHUNK 16
+
+#define LOG_ELIDED(X, ...) do {} while (0)
+
+#if LOG_COMPILE_LEVEL <= LOG_SPAM
+#define COMMSTACK_SPAM(X, ...) EventLogger.log(LOG_COMMSTACK,LOG_SPAM,X,##__VA_ARGS__)
 #define FLOW_SPAM(X, ...) EventLogger.log(LOG_FLOW,LOG_SPAM,X,##__VA_ARGS__)
-#define FLOW_ALWAYS(X, ...) EventLogger.log(LOG_FLOW,LOG_ALWAYS,X,##__VA_ARGS__)
+#define PRINTER_SPAM(X, ...) EventLogger.log(LOG_PRINTER,LOG_SPAM,X,##__VA_ARGS__)
+#else
+#define COMMSTACK_SPAM LOG_ELIDED
+#define FLOW_SPAM LOG_ELIDED
+#define PRINTER_SPAM LOG_ELIDED
+#endif
 
+#if LOG_COMPILE_LEVEL <= LOG_NOTICE
+#define COMMSTACK_NOTICE(X, ...) EventLogger.log(LOG_COMMSTACK,LOG_NOTICE,X,##__VA_ARGS__)
+#define FLOW_NOTICE(X, ...) EventLogger.log(LOG_FLOW,LOG_NOTICE,X,##__VA_ARGS__)
 #define PRINTER_NOTICE(X, ...) EventLogger.log(LOG_PRINTER,LOG_NOTICE,X,##__VA_ARGS__)
+#else
+#define COMMSTACK_NOTICE LOG_ELIDED
+#define FLOW_NOTICE LOG_ELIDED
+#define PRINTER_NOTICE LOG_ELIDED
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_WARNING
+#define COMMSTACK_WARNING(X, ...) EventLogger.log(LOG_COMMSTACK,LOG_WARNING,X,##__VA_ARGS__)
 #define PRINTER_WARNING(X, ...) EventLogger.log(LOG_PRINTER,LOG_WARNING,X,##__VA_ARGS__)
+#else
+#define COMMSTACK_WARNING LOG_ELIDED
+#define PRINTER_WARNING LOG_ELIDED
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_ERROR
+#define COMMSTACK_ERROR(X, ...) EventLogger.log(LOG_COMMSTACK,LOG_ERROR,X,##__VA_ARGS__)
+#define FLOW_ERROR(X, ...) EventLogger.log(LOG_FLOW,LOG_ERROR,X,##__VA_ARGS__)
 #define PRINTER_ERROR(X, ...) EventLogger.log(LOG_PRINTER,LOG_ERROR,X,##__VA_ARGS__)
-#define PRINTER_SPAM(X, ...) EventLogger.log(LOG_PRINTER,LOG_SPAM,X,##__VA_ARGS__)
+#else
+#define COMMSTACK_ERROR LOG_ELIDED
+#define FLOW_ERROR LOG_ELIDED
+#define PRINTER_ERROR LOG_ELIDED
+#endif
+
+#define FLOW_ALWAYS(X, ...) EventLogger.log(LOG_FLOW,LOG_ALWAYS,X,##__VA_ARGS__)
+
+//Lock-free byte queue for exactly one producer and one consumer
+template<uint16_t SIZE>
+class LogQueue {
+ public:
+  LogQueue() : _head(0), _tail(0) {};
+  uint16_t used() const { return (_head - _tail) & (SIZE - 1); };
+  uint16_t available() const { return SIZE - 1 - used(); };
+  char peek(uint16_t offset) const { return _buffer[(_tail + offset) & (SIZE - 1)]; };
+
+  bool write(const char *data, uint16_t size) {
+    if (size > available()) return false;
+    uint16_t head = _head;
+    for (uint16_t i = 0; i < size; i++) {
+      _buffer[(head + i) & (SIZE - 1)] = data[i];
+    }
+    //Data has to be in place before the consumer sees the new head
+    __asm__ volatile ("" ::: "memory");
+    _head = (head + size) & (SIZE - 1);
+    return true;
+  };
+
+  void consume(uint16_t size) {
+    __asm__ volatile ("" ::: "memory");
+    _tail = (_tail + size) & (SIZE - 1);
+  };
+
+ private:
+  char _buffer[SIZE];
+  volatile uint16_t _head;
+  volatile uint16_t _tail;
+};
 
 class EventLoggerClass {
  public:
@@ -65,10 +136,22 @@ class EventLoggerClass {
   void log(uint8_t logContext, uint8_t logLevel, const char *msg, ...);
   void setLogLevel(uint8_t logLevel) { _logLevel = logLevel; };
   void setLogContexts(uint8_t contextFlags) { _contexts = contextFlags; };
+  void setForwardLevel(uint8_t logLevel) { _forwardLevel = logLevel; };
+
+  //Moves queued messages to the debug port and ESP without blocking, called from the main loop
+  void loop();
 
  private:
+  void queue(uint8_t logLevel, const char *msg, va_list args);
+  void forwardToESP();
+
   uint8_t _logLevel;
   uint8_t _contexts;
+  uint8_t _forwardLevel;
+  uint16_t _dropped;
+  unsigned long _lastForward;
+  LogQueue<EVENTLOGGER_QUEUE_SIZE> _queue;
+  LogQueue<EVENTLOGGER_ESP_QUEUE_SIZE> _espQueue;
 };
 
 #endif //MK20_EVENTLOGGER_H
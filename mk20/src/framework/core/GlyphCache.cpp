@@ -0,0 +1,178 @@
+/*
+ * Cache of rasterized font glyphs for PHDisplay. Glyphs of ILI9341_t3 fonts are
+ * decoded once into horizontal runs and kept in a fixed pool, so text can be
+ * blitted span by span instead of decoding and drawing every font bit.
+ *
+ * Span format per glyph, records ordered top to bottom:
+ *   1 byte number of rows the record repeats for (at least 1)
+ *   1 byte number of runs in the row
+ *   2 bytes per run: x offset and length in pixels
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "GlyphCache.h"
+
+//Bit readers for the packed font format, same as the ones used by ILI9341_t3
+static uint32_t fetchbit(const uint8_t *p, uint32_t index) {
+  return (p[index >> 3] >> (7 - (index & 7))) & 1;
+}
+
+static uint32_t fetchbits_unsigned(const uint8_t *p, uint32_t index, uint32_t required) {
+  uint32_t val = 0;
+  do {
+	uint8_t b = p[index >> 3];
+	uint32_t avail = 8 - (index & 7);
+	if (avail <= required) {
+	  val <<= avail;
+	  val |= b & ((1 << avail) - 1);
+	  index += avail;
+	  required -= avail;
+	} else {
+	  b >>= avail - required;
+	  val <<= required;
+	  val |= b & ((1 << required) - 1);
+	  break;
+	}
+  } while (required);
+  return val;
+}
+
+static int32_t fetchbits_signed(const uint8_t *p, uint32_t index, uint32_t required) {
+  uint32_t val = fetchbits_unsigned(p, index, required);
+  if (val & (1 << (required - 1))) {
+	return (int32_t) val - (1 << required);
+  }
+  return (int32_t) val;
+}
+
+GlyphCache::GlyphCache() {
+  clear();
+}
+
+void GlyphCache::clear() {
+  for (int i = 0; i < GLYPH_CACHE_SLOTS; i++) {
+	_glyphs[i].font = NULL;
+  }
+  _poolUsed = 0;
+}
+
+const Glyph *GlyphCache::glyph(const ILI9341_t3_font_t *font, unsigned int c) {
+  //Direct mapped, a colliding glyph replaces the old one and its spans stay in the pool until it's cleared
+  uint32_t slot = (c + ((uintptr_t) font >> 2) * 31) % GLYPH_CACHE_SLOTS;
+  Glyph *glyph = &_glyphs[slot];
+  if (glyph->font == font && glyph->code == c) {
+	return glyph;
+  }
+
+  glyph->font = NULL;
+  if (!decode(font, c, glyph)) {
+	//Pool is full, start over. Any glyph returned before is invalid now
+	clear();
+	if (!decode(font, c, glyph)) {
+	  return NULL;
+	}
+  }
+
+  glyph->font = font;
+  glyph->code = c;
+  return glyph;
+}
+
+bool GlyphCache::decode(const ILI9341_t3_font_t *font, unsigned int c, Glyph *glyph) {
+  uint32_t bitoffset;
+  if (c >= font->index1_first && c <= font->index1_last) {
+	bitoffset = c - font->index1_first;
+	bitoffset *= font->bits_index;
+  } else if (c >= font->index2_first && c <= font->index2_last) {
+	bitoffset = c - font->index2_first + font->index1_last - font->index1_first + 1;
+	bitoffset *= font->bits_index;
+  } else {
+	//Sparse unicode is not supported by ILI9341_t3 either, store an empty glyph
+	bitoffset = UINT32_MAX;
+  }
+
+  const uint8_t *data = NULL;
+  if (bitoffset != UINT32_MAX) {
+	data = font->data + fetchbits_unsigned(font->index, bitoffset, font->bits_index);
+	if (fetchbits_unsigned(data, 0, 3) != 0) data = NULL;
+  }
+
+  if (data == NULL) {
+	glyph->width = glyph->height = 0;
+	glyph->xoffset = glyph->yoffset = 0;
+	glyph->delta = 0;
+	glyph->spans = _poolUsed;
+	return true;
+  }
+
+  uint32_t width = fetchbits_unsigned(data, 3, font->bits_width);
+  bitoffset = font->bits_width + 3;
+  uint32_t height = fetchbits_unsigned(data, bitoffset, font->bits_height);
+  bitoffset += font->bits_height;
+  int32_t xoffset = fetchbits_signed(data, bitoffset, font->bits_xoffset);
+  bitoffset += font->bits_xoffset;
+  int32_t yoffset = fetchbits_signed(data, bitoffset, font->bits_yoffset);
+  bitoffset += font->bits_yoffset;
+  uint32_t delta = fetchbits_unsigned(data, bitoffset, font->bits_delta);
+  bitoffset += font->bits_delta;
+
+  uint16_t pos = _poolUsed;
+  uint32_t linecount = height;
+  while (linecount) {
+	//Rows are either stored once or with a 3 bit repeat count
+	uint32_t repeat = 1;
+	if (fetchbit(data, bitoffset++)) {
+	  repeat = fetchbits_unsigned(data, bitoffset, 3) + 2;
+	  bitoffset += 3;
+	}
+	if (repeat > linecount) repeat = linecount;
+
+	if (pos + 2 > GLYPH_CACHE_POOL_SIZE) return false;
+	uint16_t record = pos;
+	_pool[pos++] = repeat;
+	_pool[pos++] = 0;
+
+	uint32_t run = 0;
+	for (uint32_t x = 0; x <= width; x++) {
+	  if (x < width && fetchbit(data, bitoffset + x)) {
+		run++;
+	  } else if (run > 0) {
+		if (pos + 2 > GLYPH_CACHE_POOL_SIZE) return false;
+		_pool[pos++] = x - run;
+		_pool[pos++] = run;
+		_pool[record + 1]++;
+		run = 0;
+	  }
+	}
+	bitoffset += width;
+	linecount -= repeat;
+  }
+
+  glyph->width = width;
+  glyph->height = height;
+  glyph->xoffset = xoffset;
+  glyph->yoffset = yoffset;
+  glyph->delta = delta;
+  glyph->spans = _poolUsed;
+  _poolUsed = pos;
+  return true;
+}
@@ -0,0 +1,67 @@
+/*
+ * Cache of rasterized font glyphs for PHDisplay. Glyphs of ILI9341_t3 fonts are
+ * decoded once into horizontal runs and kept in a fixed pool, so text can be
+ * blitted span by span instead of decoding and drawing every font bit.
+ *
+ * Span format per glyph, records ordered top to bottom:
+ *   1 byte number of rows the record repeats for (at least 1)
+ *   1 byte number of runs in the row
+ *   2 bytes per run: x offset and length in pixels
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_GLYPHCACHE_H
+#define MK20_GLYPHCACHE_H
+
+#include <Arduino.h>
+#include "ILI9341_t3.h"
+#include "MemoryConfig.h"
+
+struct Glyph {
+  const ILI9341_t3_font_t *font;
+  uint16_t code;
+  uint16_t spans;       //Offset of the span records in the pool
+  uint8_t width;
+  uint8_t height;
+  int8_t xoffset;
+  int8_t yoffset;
+  uint8_t delta;
+};
+
+class GlyphCache {
+ public:
+  GlyphCache();
+
+  //Returns the cached glyph or decodes it, NULL if the font has no (supported) glyph for c
+  const Glyph *glyph(const ILI9341_t3_font_t *font, unsigned int c);
+  const uint8_t *spans(const Glyph *glyph) const { return &_pool[glyph->spans]; };
+  void clear();
+
+ private:
+  bool decode(const ILI9341_t3_font_t *font, unsigned int c, Glyph *glyph);
+
+  Glyph _glyphs[GLYPH_CACHE_SLOTS];
+  uint8_t _pool[GLYPH_CACHE_POOL_SIZE];
+  uint16_t _poolUsed;
+};
+
+#endif //MK20_GLYPHCACHE_H
@@ -29,6 +29,7 @@
 
 #include "ImageBuffer.h"
 #include "Application.h"
+#include "ColorKernels.h"
 
 ImageBuffer::ImageBuffer(uint16_t* buffer, uint16_t width, uint16_t height)
 {
@@ -38,17 +39,20 @@ ImageBuffer::ImageBuffer(uint16_t* buffer, uint16_t width, uint16_t height)
 	_height = height;
 	_tx = 0;
 	_ty = 0;
+	_alpha = 256;
 }
 
 
 ImageBuffer::ImageBuffer(uint16_t width, uint16_t height)
 {
 	_data = (uint16_t*)malloc(sizeof(uint16_t)*width*height);
+	Profiler.count(ProfileCounter::Allocations);
 	_width = width;
 	_height = height;
 	_manageBuffer = true;
 	_tx = 0;
 	_ty = 0;
+	_alpha = 256;
 }
 
 
@@ -71,17 +75,40 @@ void ImageBuffer::drawPixel(int16_t x, int16_t y, uint16_t color)
 	if (y >= _height) return;
 	if (y < 0) return;
 
+	if (_alpha < 256)
+	{
+		color = ColorKernels::blend(_data[x*_height+y],color,_alpha);
+	}
+
 	_data[x*_height+y] = color;
 }
 
 
 void ImageBuffer::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color)
 {
-	for (int x1=x;x1<x+w;x1++)
+	//Clip to the buffer once, then fill whole columns (pixels are stored column by column)
+	int x0 = max(x + _tx, 0);
+	int y0 = max(y + _ty, 0);
+	int x1 = min(x + _tx + w, (int)_width);
+	int y1 = min(y + _ty + h, (int)_height);
+	if (x0 >= x1 || y0 >= y1) return;
+
+	for (int xb=x0;xb<x1;xb++)
 	{
-		for (int y1=y;y1<y+h;y1++)
+		uint16_t *column = &_data[xb*_height];
+		if (_alpha < 256)
+		{
+			for (int yb=y0;yb<y1;yb++)
+			{
+				column[yb] = ColorKernels::blend(column[yb],color,_alpha);
+			}
+		}
+		else
 		{
-			drawPixel(x1,y1,color);
+			for (int yb=y0;yb<y1;yb++)
+			{
+				column[yb] = color;
+			}
 		}
 	}
 }
@@ -105,18 +132,12 @@ void ImageBuffer::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t
 
 void ImageBuffer::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
 {
-	for (int x1=x;x1<x+w;x1++)
-	{
-		drawPixel(x1,y,color);
-	}
+	fillRect(x,y,w,1,color);
 }
 
 void ImageBuffer::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
 {
-	for (int y1=y;y1<y+h;y1++)
-	{
-		drawPixel(x,y1,color);
-	}
+	fillRect(x,y,1,h,color);
 }
 
 
@@ -128,7 +149,7 @@ void ImageBuffer::drawBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, con
 		for (uint16_t yb=0;yb<h;yb++)
 		{
 			uint16_t color = bitmap[(xb+xs)*hs+(yb+ys)];
-			drawPixel(xb,yb,color);
+			drawPixel(x+xb,y+yb,color);
 		}
 	}
 }
@@ -149,6 +170,23 @@ void ImageBuffer::drawFileBitmapByColumn(uint16_t x, uint16_t y, uint16_t w, uin
 	}
 }
 
+void ImageBuffer::drawShadowedFileBitmapByColumn(uint16_t x, uint16_t y, uint16_t w, uint16_t h, File *file, uint16_t xs,
+                                                 uint16_t ys, uint16_t ws, uint16_t hs, uint16_t backgroundColor, uint32_t byteOffset)
+{
+	uint16_t buffer[320];
+	for (uint16_t xb=0;xb<w;xb++)
+	{
+		file->seek((((xb+xs)*hs)*sizeof(uint16_t))+byteOffset);
+		file->read(buffer,sizeof(uint16_t)*hs);
+		ColorKernels::darken(&buffer[ys],h,COLOR_SHADOW_SCALE,backgroundColor);
+
+		for (uint16_t yb=0;yb<h;yb++)
+		{
+			drawPixel(x+xb,y+yb,buffer[yb+ys]);
+		}
+	}
+}
+
 void ImageBuffer::drawMaskedBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *bitmap, uint16_t xs,
                                    uint16_t ys, uint16_t ws, uint16_t hs, uint16_t foregroundColor,
                                    uint16_t backgroundColor)
@@ -168,7 +206,7 @@ void ImageBuffer::drawMaskedBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t
 				color = backgroundColor;
 			}
 
-			drawPixel(xb,yb,color);
+			drawPixel(x+xb,y+yb,color);
 		}
 	}
 }
@@ -179,3 +217,17 @@ void ImageBuffer::setTranslation(int16_t tx, int16_t ty)
 	_tx = tx;
 	_ty = ty;
 }
+
+void ImageBuffer::clear(uint16_t color)
+{
+	uint32_t count = (uint32_t)_width*_height;
+	for (uint32_t i=0;i<count;i++)
+	{
+		_data[i] = color;
+	}
+}
+
+void ImageBuffer::setAlpha(uint16_t alpha)
+{
+	_alpha = alpha;
+}
@@ -48,8 +48,13 @@ class ImageBuffer {
   virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
   virtual void drawBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *bitmap, uint16_t xs, uint16_t ys, uint16_t ws, uint16_t hs);
   virtual void drawFileBitmapByColumn(uint16_t x, uint16_t y, uint16_t w, uint16_t h, File *file, uint16_t xs, uint16_t ys, uint16_t ws, uint16_t hs, uint32_t byteOffset = 0);
+  virtual void drawShadowedFileBitmapByColumn(uint16_t x, uint16_t y, uint16_t w, uint16_t h, File *file, uint16_t xs, uint16_t ys, uint16_t ws, uint16_t hs, uint16_t backgroundColor, uint32_t byteOffset = 0);
   virtual void drawMaskedBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *bitmap, uint16_t xs, uint16_t ys, uint16_t ws, uint16_t hs, uint16_t foregroundColor, uint16_t backgroundColor);
   virtual void setTranslation(int16_t tx, int16_t ty);
+  virtual void clear(uint16_t color);
+
+  //Pixels drawn with alpha < 256 are blended over the buffer contents (256 = opaque)
+  virtual void setAlpha(uint16_t alpha);
 
 #pragma mark Getter/Setter
   virtual uint16_t *getData() const { return _data; };
@@ -62,8 +67,9 @@ class ImageBuffer {
   uint16_t _width;
   uint16_t _height;
   bool _manageBuffer;
-  uint16_t _tx;
-  uint16_t _ty;
+  int16_t _tx;
+  int16_t _ty;
+  uint16_t _alpha;
 };
 
 #endif //TEENSY_IMAGEBUFFER_H
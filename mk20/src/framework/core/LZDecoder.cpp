@@ -0,0 +1,110 @@
+/*
+ * Streaming decoder for LZ compressed files and file transfers. Decodes data in
+ * arbitrary sized chunks with a fixed 2 KB history window, so packets received
+ * via CommStack or blocks read from SD can be fed as they arrive.
+ *
+ * Stream format (see utils/lztool for the encoder):
+ *   4 bytes magic "PBLZ"
+ *   groups of one flag byte followed by 8 items, flag bits used LSB first
+ *   flag bit 0: literal byte
+ *   flag bit 1: match, 16 bit big endian token with 11 bit distance - 1 and
+ *               5 bit length - 3, copied from the last 2048 decoded bytes
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "LZDecoder.h"
+
+#define LZ_WINDOW_MASK (LZ_WINDOW_SIZE - 1)
+#define LZ_LENGTH_MASK ((1 << LZ_LENGTH_BITS) - 1)
+
+LZDecoder::LZDecoder() {
+  reset();
+}
+
+void LZDecoder::reset() {
+  memset(_window, 0, sizeof(_window));
+  _windowPos = 0;
+  _magicPos = 0;
+  _flags = 0;
+  _flagBits = 0;
+  _tokenHigh = 0;
+  _hasTokenHigh = false;
+  _matchDistance = 0;
+  _matchLeft = 0;
+  _error = false;
+}
+
+bool LZDecoder::isCompressed(const uint8_t *data, size_t size) {
+  if (size < LZ_MAGIC_SIZE) return false;
+  return memcmp(data, LZ_MAGIC, LZ_MAGIC_SIZE) == 0;
+}
+
+size_t LZDecoder::decode(const uint8_t *input, size_t inputSize, size_t *consumed, uint8_t *output, size_t outputSize) {
+  size_t in = 0;
+  size_t out = 0;
+
+  while (out < outputSize && !_error) {
+	//Copy pending bytes of a match first, it may span several calls
+	if (_matchLeft > 0) {
+	  uint8_t b = _window[(_windowPos - _matchDistance) & LZ_WINDOW_MASK];
+	  _window[_windowPos] = b;
+	  _windowPos = (_windowPos + 1) & LZ_WINDOW_MASK;
+	  output[out++] = b;
+	  _matchLeft--;
+	  continue;
+	}
+
+	if (in >= inputSize) break;
+	uint8_t b = input[in++];
+
+	if (_magicPos < LZ_MAGIC_SIZE) {
+	  if (b != LZ_MAGIC[_magicPos]) {
+		_error = true;
+	  }
+	  _magicPos++;
+	} else if (_flagBits == 0) {
+	  _flags = b;
+	  _flagBits = 8;
+	} else if ((_flags & 1) == 0) {
+	  //Literal
+	  _window[_windowPos] = b;
+	  _windowPos = (_windowPos + 1) & LZ_WINDOW_MASK;
+	  output[out++] = b;
+	  _flags >>= 1;
+	  _flagBits--;
+	} else if (!_hasTokenHigh) {
+	  //First byte of a match token, the second one may be in the next packet
+	  _tokenHigh = b;
+	  _hasTokenHigh = true;
+	} else {
+	  uint16_t token = (_tokenHigh << 8) | b;
+	  _hasTokenHigh = false;
+	  _matchDistance = (token >> LZ_LENGTH_BITS) + 1;
+	  _matchLeft = (token & LZ_LENGTH_MASK) + LZ_MIN_MATCH;
+	  _flags >>= 1;
+	  _flagBits--;
+	}
+  }
+
+  *consumed = in;
+  return out;
+}
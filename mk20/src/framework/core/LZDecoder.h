@@ -0,0 +1,71 @@
+/*
+ * Streaming decoder for LZ compressed files and file transfers. Decodes data in
+ * arbitrary sized chunks with a fixed 2 KB history window, so packets received
+ * via CommStack or blocks read from SD can be fed as they arrive.
+ *
+ * Stream format (see utils/lztool for the encoder):
+ *   4 bytes magic "PBLZ"
+ *   groups of one flag byte followed by 8 items, flag bits used LSB first
+ *   flag bit 0: literal byte
+ *   flag bit 1: match, 16 bit big endian token with 11 bit distance - 1 and
+ *               5 bit length - 3, copied from the last 2048 decoded bytes
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_LZDECODER_H
+#define MK20_LZDECODER_H
+
+#include <Arduino.h>
+
+#define LZ_WINDOW_BITS 11
+#define LZ_LENGTH_BITS 5
+#define LZ_MIN_MATCH 3
+#define LZ_WINDOW_SIZE (1 << LZ_WINDOW_BITS)
+#define LZ_MAGIC "PBLZ"
+#define LZ_MAGIC_SIZE 4
+
+class LZDecoder {
+ public:
+  LZDecoder();
+
+  void reset();
+  //Decode up to outputSize bytes from input. consumed returns the number of input bytes used, call again
+  //with the rest of the input (or the next chunk) until it returns 0
+  size_t decode(const uint8_t *input, size_t inputSize, size_t *consumed, uint8_t *output, size_t outputSize);
+  bool hasError() const { return _error; };
+
+  static bool isCompressed(const uint8_t *data, size_t size);
+
+ private:
+  uint8_t _window[LZ_WINDOW_SIZE];
+  uint16_t _windowPos;
+  uint8_t _magicPos;
+  uint8_t _flags;
+  uint8_t _flagBits;
+  uint8_t _tokenHigh;
+  bool _hasTokenHigh;
+  uint16_t _matchDistance;
+  uint8_t _matchLeft;
+  bool _error;
+};
+
+#endif //MK20_LZDECODER_H
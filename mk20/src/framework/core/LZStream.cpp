@@ -0,0 +1,95 @@
+/*
+ * LZStream reads an LZ compressed file and provides the decompressed data through
+ * the Stream protocol, so compressed job files stored on SD can be fed line by line
+ * to the printer without being inflated on the card first
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "LZStream.h"
+
+LZStream::LZStream(File *source) :
+	_source(source),
+	_inputLength(0),
+	_inputPos(0),
+	_outputLength(0),
+	_outputPos(0) {
+}
+
+bool LZStream::fill() {
+  while (_outputPos >= _outputLength) {
+	if (_decoder.hasError()) {
+	  return false;
+	}
+
+	//Pending bytes of a match are returned even if the input is exhausted
+	size_t consumed;
+	_outputLength = _decoder.decode(&_input[_inputPos], _inputLength - _inputPos, &consumed, _output, LZSTREAM_OUTPUT_SIZE);
+	_outputPos = 0;
+	_inputPos += consumed;
+	if (_outputLength > 0) {
+	  break;
+	}
+
+	//Decoder needs more input
+	int numBytesRead = _source->read(_input, LZSTREAM_INPUT_SIZE);
+	if (numBytesRead <= 0) {
+	  //End of file
+	  return false;
+	}
+	_inputLength = numBytesRead;
+	_inputPos = 0;
+  }
+
+  return true;
+}
+
+size_t LZStream::write(uint8_t byte) {
+  //Read only
+  return 0;
+}
+
+int LZStream::read() {
+  if (!fill()) {
+	return -1;
+  }
+
+  return _output[_outputPos++];
+}
+
+int LZStream::available() {
+  if (!fill()) {
+	return 0;
+  }
+
+  return _outputLength - _outputPos;
+}
+
+int LZStream::peek() {
+  if (!fill()) {
+	return -1;
+  }
+
+  return _output[_outputPos];
+}
+
+void LZStream::flush() {
+}
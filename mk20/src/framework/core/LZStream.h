@@ -0,0 +1,61 @@
+/*
+ * LZStream reads an LZ compressed file and provides the decompressed data through
+ * the Stream protocol, so compressed job files stored on SD can be fed line by line
+ * to the printer without being inflated on the card first
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_LZSTREAM_H
+#define MK20_LZSTREAM_H
+
+#include <Stream.h>
+#include "SD.h"
+#include "LZDecoder.h"
+
+#define LZSTREAM_INPUT_SIZE 64
+#define LZSTREAM_OUTPUT_SIZE 128
+
+class LZStream : public Stream {
+ public:
+  LZStream(File *source);
+
+  virtual size_t write(uint8_t byte);
+  virtual int read();
+  virtual int available();
+  virtual int peek();
+  virtual void flush();
+
+ private:
+  bool fill();
+
+ private:
+  File *_source;
+  LZDecoder _decoder;
+  uint8_t _input[LZSTREAM_INPUT_SIZE];
+  uint8_t _inputLength;
+  uint8_t _inputPos;
+  uint8_t _output[LZSTREAM_OUTPUT_SIZE];
+  uint8_t _outputLength;
+  uint8_t _outputPos;
+};
+
+#endif //MK20_LZSTREAM_H
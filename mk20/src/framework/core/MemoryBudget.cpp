@@ -0,0 +1,41 @@
+/*
+ * Compile time check of the RAM taken by the buffers configured in MemoryConfig.h
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "MemoryConfig.h"
+#include "SceneArena.h"
+#include "MemoryPool.h"
+#include "GlyphCache.h"
+#include "LZStream.h"
+#include "../layers/GapLayer.h"
+#include "SD.h"
+
+static constexpr size_t sceneBytes = sizeof(SceneArenaClass) + sizeof(MemoryPool<sizeof(GapLayer), RECTANGLE_LAYER_POOL_SIZE>);
+static constexpr size_t displayBytes = sizeof(GlyphCache) + COMPOSE_BUFFER_PIXELS * sizeof(uint16_t);
+static constexpr size_t sdBytes = (SD_CACHE_FAT_BLOCKS + SD_CACHE_DATA_BLOCKS) * 512;
+
+//A file received with LZ compression and a compressed job being printed each have a window
+static constexpr size_t lzBytes = sizeof(LZDecoder) + sizeof(LZStream);
+
+static_assert(sceneBytes + displayBytes + sdBytes + lzBytes <= MEMORY_BUFFER_BUDGET,
+			  "Buffers configured in MemoryConfig.h exceed MEMORY_BUFFER_BUDGET");
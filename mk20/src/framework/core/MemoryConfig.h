@@ -0,0 +1,75 @@
+/*
+ * Sizes of the fixed buffers and inline lists of the firmware. Everything that takes
+ * a noticeable share of the 64 KB RAM is configured here, MemoryBudget.cpp adds it up
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_MEMORYCONFIG_H
+#define MK20_MEMORYCONFIG_H
+
+//RAM the buffers below may take together, whether they are static or allocated once and kept. The build fails if
+//they exceed it (see MemoryBudget.cpp), so a larger buffer has to be paid for by a smaller one
+#ifndef MEMORY_BUFFER_BUDGET
+#define MEMORY_BUFFER_BUDGET (32 * 1024)
+#endif
+
+//Scenes
+
+//Views and layers of a scene are allocated from the arena while the scene builds its view tree
+#ifndef SCENE_ARENA_SIZE
+#define SCENE_ARENA_SIZE 6144
+#endif
+
+//Number of rectangle and gap layers served from a fixed pool, more are allocated on the heap. The calibrate scene
+//takes 64 with the old and the new layout alive, see test/host/scene_soak.cpp
+#ifndef RECTANGLE_LAYER_POOL_SIZE
+#define RECTANGLE_LAYER_POOL_SIZE 80
+#endif
+
+//Views of a scene kept inline before the list grows onto the heap
+#define SCENE_INLINE_VIEWS 16
+
+//Layers split by the layout have two sublayers, the common case stays off the heap
+#define LAYER_INLINE_SUBLAYERS 2
+
+//Layers of a scene kept inline by the display before the list grows onto the heap
+#define DISPLAY_INLINE_LAYERS 32
+
+//Display
+
+//Decoded glyphs (16 bytes each) and the pool with their span records
+#ifndef GLYPH_CACHE_SLOTS
+#define GLYPH_CACHE_SLOTS 128
+#endif
+#ifndef GLYPH_CACHE_POOL_SIZE
+#define GLYPH_CACHE_POOL_SIZE 3072
+#endif
+
+//Scratch buffer used to compose overlapping layers offscreen (in pixels, 4 KB), allocated on first use and kept
+#ifndef COMPOSE_BUFFER_PIXELS
+#define COMPOSE_BUFFER_PIXELS 2048
+#endif
+
+//The SD block cache is part of lib/SD, set SD_CACHE_FAT_BLOCKS and SD_CACHE_DATA_BLOCKS with build flags to change it
+//The receive buffer of the ESP connection (Serial3) is part of the Teensy core, it's set in platformio.ini
+
+#endif //MK20_MEMORYCONFIG_H
@@ -0,0 +1,84 @@
+/*
+ * Fixed size block pool for objects that are created and destroyed frequently,
+ * blocks are reused so these objects don't fragment the heap
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_MEMORYPOOL_H
+#define MK20_MEMORYPOOL_H
+
+#include <Arduino.h>
+
+//There is no constructor on purpose, pools are declared static and zero initialized storage is a valid empty pool
+//before static constructors run (i.e. for layers created by global objects)
+template<size_t BlockSize, int BlockCount>
+class MemoryPool {
+ public:
+  //Returns NULL if all blocks are in use
+  void *allocate() {
+	Block *block = _free;
+	if (block != NULL) {
+	  _free = block->next;
+	} else if (_allocated < BlockCount) {
+	  block = &_blocks[_allocated++];
+	} else {
+	  return NULL;
+	}
+
+	_used++;
+	if (_used > _highWaterMark) _highWaterMark = _used;
+	return block;
+  };
+
+  //Returns false if the pointer has not been allocated by this pool
+  bool release(void *pointer) {
+	if (!owns(pointer)) return false;
+
+	Block *block = (Block *) pointer;
+	block->next = _free;
+	_free = block;
+	_used--;
+	return true;
+  };
+
+  bool owns(void *pointer) const {
+	return pointer >= (void *) &_blocks[0] && pointer < (void *) &_blocks[BlockCount];
+  };
+
+  int getUsed() const { return _used; };
+  int getHighWaterMark() const { return _highWaterMark; };
+  int getCapacity() const { return BlockCount; };
+
+ private:
+  union Block {
+	Block *next;
+	uint8_t data[BlockSize];
+  } __attribute__((aligned(8)));
+
+  Block _blocks[BlockCount];
+  Block *_free;
+  int _allocated;
+  int _used;
+  int _highWaterMark;
+};
+
+#endif //MK20_MEMORYPOOL_H
@@ -36,6 +36,7 @@
 #include <Wiring.h>
 #include <Arduino.h>
 #include "SD.h"
+#include "ColorKernels.h"
 
 #define SPICLOCK 30000000
 
@@ -48,6 +49,13 @@ PHDisplay::PHDisplay(uint8_t _CS, uint8_t _DC, uint8_t _RST, uint8_t _MOSI, uint
   _needsLayout = false;
   _needsDisplay = false;
   _fixedBackgroundLayer = NULL;
+  _lockBuffer = NULL;
+  _composeBuffer = NULL;
+  _composeForegroundLayers = 0;
+  _composeLayersValid = false;
+  _brightness = 0;
+  _brightnessAnimation = NULL;
+  _dispatchPosition = 0;
 
   debug = false;
   _transparentText = false;
@@ -61,7 +69,11 @@ void PHDisplay::addLayer(Layer *layer) {
   layer->setNeedsDisplay();
   if (debug) LOG("Adding Layer");
 //    _backgroundLayer->splitWithRect(layer->getFrame());
-  _layers.push(layer);
+  if (!_layers.push(layer)) {
+	//The layer belongs to its view, it is just not displayed
+	FLOW_ERROR("PHDisplay: Could not add layer, out of memory");
+	return;
+  }
   if (debug) LOG("Adding Layers done");
 
   _needsLayout = true;
@@ -98,6 +110,7 @@ void PHDisplay::clear() {
   _autoLayout = true;
   _fixedBackgroundLayer = NULL;
   _scrollOffset = 0;
+  _dispatchPosition = 0;
 }
 
 void PHDisplay::cropRectToScreen(Rect &rect) {
@@ -121,6 +134,9 @@ void PHDisplay::layoutIfNeeded() {
 
   LOG("Layout if needed");
 
+  //The background is rebuilt, so an unfinished pass has to start over
+  _dispatchPosition = 0;
+
   //Now delete the old background layer and swap foreground to background
   delete _backgroundLayer;
   _backgroundLayer = _foregroundLayer;
@@ -171,24 +187,62 @@ void PHDisplay::layoutIfNeeded() {
   _needsLayout = false;
 }
 
-void PHDisplay::dispatch() {
+void PHDisplay::dispatch(uint32_t budget) {
   if (!_needsDisplay) return;
 
-  //LOG("Sending background to display");
-  if (_fixedBackgroundLayer != NULL) {
-	_fixedBackgroundLayer->display();
-  } else {
-	if (_autoLayout) {
-	  _foregroundLayer->display(_backgroundLayer);
+  //Position 0 is the background, layers follow. With a budget (in microseconds) the pass stops after the first
+  //layer that exceeds it and resumes from there with the next call
+  uint32_t start = micros();
+
+  if (_dispatchPosition == 0) {
+	//LOG("Sending background to display");
+	if (_fixedBackgroundLayer != NULL) {
+	  _fixedBackgroundLayer->display();
+	} else {
+	  if (_autoLayout) {
+		_foregroundLayer->display(_backgroundLayer);
+	  }
 	}
+	_dispatchPosition++;
+	if (budget > 0 && micros() - start >= budget) return;
   }
 
   //LOG("Sending layer to display");
-  for (int i = 0; i < _layers.count(); i++) {
+  while (_dispatchPosition <= _layers.count()) {
+	int i = _dispatchPosition - 1;
+	_dispatchPosition++;
+
 	Layer *layer = _layers.at(i);
-	layer->display();
+	if (layer->isLeaf() && !layer->needsDisplay()) continue;
+
+	if (layer->getContext() == DisplayContext::Scrolling && layer->isVisible()) {
+	  //Overlapping or translucent layers are composed offscreen and sent in one go
+	  Rect frame = layer->getFrame();
+	  Rect visibleFrame = visibleRect();
+	  frame = Rect::Intersect(frame, visibleFrame);
+	  if (needsCompositing(frame)) {
+		composeRect(frame);
+		layer->resetNeedsDisplay();
+
+		//Layers completely inside the composed rect are done, too
+		for (int j = i + 1; j < _layers.count(); j++) {
+		  Layer *other = _layers.at(j);
+		  Rect otherFrame = other->getFrame();
+		  if (other->getContext() == DisplayContext::Scrolling && otherFrame.left() >= frame.left() && otherFrame.right() <= frame.right() && otherFrame.top() >= frame.top() && otherFrame.bottom() <= frame.bottom()) {
+			other->resetNeedsDisplay();
+		  }
+		}
+	  } else {
+		layer->display();
+	  }
+	} else {
+	  layer->display();
+	}
+
+	if (budget > 0 && micros() - start >= budget) return;
   }
 
+  _dispatchPosition = 0;
   _needsDisplay = false;
 }
 
@@ -202,6 +256,8 @@ void PHDisplay::drawBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const
 	return;
   }
 
+  Profiler.count(ProfileCounter::SPIBytes, w * h * sizeof(uint16_t));
+
   for (uint16_t xb = 0; xb < w; xb++) {
 	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
 	setAddr(x + xb, y, x + xb, y + h - 1);
@@ -228,6 +284,8 @@ void PHDisplay::drawMaskedBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h,
 	return;
   }
 
+  Profiler.count(ProfileCounter::SPIBytes, w * h * sizeof(uint16_t));
+
   //TODO: This code will fail if ys > 0 and hs < h as it's not implemented correctly. As it's not needed by the current firmware I leave this comment and resolve it later
   for (uint16_t xb = 0; xb < w; xb++) {
 	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
@@ -266,6 +324,8 @@ void PHDisplay::drawFileBitmapByColumn(uint16_t x, uint16_t y, uint16_t w, uint1
 	return;
   }
 
+  Profiler.count(ProfileCounter::SPIBytes, w * h * sizeof(uint16_t));
+
   //TODO: This code will fail if ys > 0 and hs < h as it's not implemented correctly. As it's not needed by the current firmware I leave this comment and resolve it later
   uint16_t buffer[320];
   for (uint16_t xb = 0; xb < w; xb++) {
@@ -294,10 +354,12 @@ void PHDisplay::drawFileBitmapByColumn(uint16_t x, uint16_t y, uint16_t w, uint1
 void PHDisplay::drawShadowedFileBitmapByColumn(uint16_t x, uint16_t y, uint16_t w, uint16_t h, File *file, uint16_t xs,
 											   uint16_t ys, uint16_t ws, uint16_t hs, uint16_t backgroundColor, uint32_t byteOffset) {
   if (_lockBuffer != NULL) {
-	_lockBuffer->drawFileBitmapByColumn(x, y, w, h, file, xs, ys, ws, hs, byteOffset);
+	_lockBuffer->drawShadowedFileBitmapByColumn(x, y, w, h, file, xs, ys, ws, hs, backgroundColor, byteOffset);
 	return;
   }
 
+  Profiler.count(ProfileCounter::SPIBytes, w * h * sizeof(uint16_t));
+
   //TODO: This code will fail if ys > 0 and hs < h as it's not implemented correctly. As it's not needed by the current firmware I leave this comment and resolve it later
   uint16_t buffer[320];
   for (uint16_t xb = 0; xb < w; xb++) {
@@ -305,32 +367,21 @@ void PHDisplay::drawShadowedFileBitmapByColumn(uint16_t x, uint16_t y, uint16_t
 
 	file->read(buffer, sizeof(uint16_t) * hs);
 
+	//Only dampen colors if other than background color (we don't want the rects to be visible with round buttons)
+	ColorKernels::darken(&buffer[ys], h, COLOR_SHADOW_SCALE, backgroundColor);
+
 	SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
 	setAddr(x + xb, y, x + xb, y + h - 1);
 	writecommand_cont(ILI9341_RAMWR);
 
 	for (uint16_t yb = 0; yb < h; yb++) {
-	  uint16_t color = buffer[yb + ys];
-
-	  //Only dampen colors if other than background color (we don't want the rects to be visible with round buttons)
-	  if (color != backgroundColor) {
-		float r = (float) (((((color >> 11) & 0x1F) * 527) + 23) >> 6);
-		float g = (float) (((((color >> 5) & 0x3F) * 259) + 33) >> 6);
-		float b = (float) ((((color & 0x1F) * 527) + 23) >> 6);
-		r *= 0.7;
-		g *= 0.7;
-		b *= 0.7;
-		color = (uint16_t)RGB565((uint8_t) r, (uint8_t) g, (uint8_t) b);
-	  }
-
 	  if (yb == h - 1) {
 		//Last pixel
-		writedata16_last(color);
+		writedata16_last(buffer[yb + ys]);
 	  } else {
 		//All other pixels
-		writedata16_cont(color);
+		writedata16_cont(buffer[yb + ys]);
 	  }
-	  //drawPixel(x+xb,y+yb,buffer[xb+xs]);
 	}
 	SPI.endTransaction();
   }
@@ -342,6 +393,8 @@ void PHDisplay::setNeedsLayout() {
 
 void PHDisplay::setNeedsDisplay() {
   _needsDisplay = true;
+  //Restart an unfinished pass, layers that are already drawn are skipped
+  _dispatchPosition = 0;
 }
 
 bool PHDisplay::willRefresh() {
@@ -355,31 +408,15 @@ void PHDisplay::invalidateRect(Rect &invalidationRect, int scrollOffset, int del
   if (deltaScrollOffset > 0) {
 	int so = mapScrollOffset(scrollOffset - invalidationRect.width - 1);
 	Display.setScroll(so);
-
-	if (_autoLayout) {
-	  _foregroundLayer->invalidateRect(invalidationRect);
-	}
-
-	//LOG("Sending layer to display");
-	for (int i = 0; i < _layers.count(); i++) {
-	  Layer *layer = _layers.at(i);
-	  if (layer->getContext() == DisplayContext::Fixed) continue;
-	  layer->invalidateRect(invalidationRect);
-	}
   } else {
 	int so = mapScrollOffset(scrollOffset);
 	Display.setScroll(so);
+  }
 
-	if (_autoLayout) {
-	  _foregroundLayer->invalidateRect(invalidationRect);
-	}
-
-	//LOG("Sending layer to display");
-	for (int i = 0; i < _layers.count(); i++) {
-	  Layer *layer = _layers.at(i);
-	  if (layer->getContext() == DisplayContext::Fixed) continue;
-	  layer->invalidateRect(invalidationRect);
-	}
+  if (needsCompositing(invalidationRect)) {
+	composeRect(invalidationRect);
+  } else {
+	drawInvalidatedRect(invalidationRect);
   }
 
   //fillRect(dirtyRect.x,0,dirtyRect.width,dirtyRect.height,color);
@@ -515,10 +552,12 @@ void PHDisplay::drawPixel(int16_t x, int16_t y, uint16_t color) {
   }
 
   if (_clipRect == NULL) {
+	Profiler.count(ProfileCounter::SPIBytes, sizeof(uint16_t));
 	ILI9341_t3::drawPixel(x, y, color);
   } else {
 	if (x >= _clipRect->left() && x <= _clipRect->right()) {
 	  if (y >= _clipRect->top() && y <= _clipRect->bottom()) {
+		Profiler.count(ProfileCounter::SPIBytes, sizeof(uint16_t));
 		ILI9341_t3::drawPixel(x, y, color);
 	  }
 	}
@@ -528,12 +567,12 @@ void PHDisplay::drawPixel(int16_t x, int16_t y, uint16_t color) {
 void PHDisplay::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
   //Locked with image buffer, draw into the buffer
   if (_lockBuffer != NULL) {
-	LOG("fillRect on buffer");
 	_lockBuffer->fillRect(x, y, w, h, color);
 	return;
   }
 
   if (_clipRect == NULL) {
+	Profiler.count(ProfileCounter::SPIBytes, w * h * sizeof(uint16_t));
 	ILI9341_t3::fillRect(x, y, w, h, color);
   } else {
 /*        if (x < _clipRect->left()) x = _clipRect->left();
@@ -544,6 +583,7 @@ void PHDisplay::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t co
 	Rect frame = Rect(x, y, w, h);
 	frame = Rect::Intersect(frame, *_clipRect);
 
+	Profiler.count(ProfileCounter::SPIBytes, frame.width * frame.height * sizeof(uint16_t));
 	ILI9341_t3::fillRect(frame.x, frame.y, frame.width, frame.height, color);
   }
 }
@@ -608,6 +648,212 @@ void PHDisplay::drawFontBits(uint32_t bits, uint32_t numbits, uint32_t x, uint32
   } while (repeat);
 }
 
+size_t PHDisplay::write(uint8_t c) {
+  //Built in font and line feeds are handled by ILI9341_t3
+  if (font == NULL || c == '\n') {
+	return ILI9341_t3::write(c);
+  }
+
+  const Glyph *glyph = _glyphCache.glyph(font, c);
+  if (glyph == NULL) {
+	//Glyph does not fit into the cache, draw it bit by bit
+	return ILI9341_t3::write(c);
+  }
+
+  //Not part of the font, ILI9341_t3 skips these without moving the cursor
+  if (glyph->height == 0 && glyph->delta == 0) return 1;
+
+  if (_textRotation == 90 || _textRotation == 270) {
+	drawVerticalGlyph(glyph);
+  } else {
+	drawGlyph(glyph);
+  }
+  return 1;
+}
+
+void PHDisplay::drawGlyph(const Glyph *glyph) {
+  //Cursor handling is the same as in ILI9341_t3::drawFontChar
+  if (cursor_x < 0) cursor_x = 0;
+  int32_t origin_x = cursor_x + glyph->xoffset;
+  if (origin_x < 0) {
+	cursor_x -= glyph->xoffset;
+	origin_x = 0;
+  }
+  if (origin_x + glyph->width > _width) {
+	if (!wrap) return;
+	origin_x = 0;
+	if (glyph->xoffset >= 0) {
+	  cursor_x = 0;
+	} else {
+	  cursor_x = -glyph->xoffset;
+	}
+	cursor_y += font->line_space;
+  }
+  if (cursor_y >= _height) return;
+  int32_t advance_x = cursor_x;
+  cursor_x += glyph->delta;
+
+  int32_t origin_y = cursor_y + font->cap_height - glyph->height - glyph->yoffset;
+  const uint8_t *record = _glyphCache.spans(glyph);
+
+  if (_transparentText || _lockBuffer != NULL) {
+	if (!_transparentText) {
+	  //Fill the advance and the glyph box, the runs are drawn on top
+	  fillGlyphRect(advance_x, cursor_y, glyph->delta, font->cap_height, textbgcolor);
+	  fillGlyphRect(origin_x, origin_y, glyph->width, glyph->height, textbgcolor);
+	}
+
+	int32_t y = origin_y;
+	while (y < origin_y + glyph->height) {
+	  uint8_t rows = record[0];
+	  const uint8_t *run = &record[2];
+	  for (int i = 0; i < record[1]; i++, run += 2) {
+		fillGlyphRect(origin_x + run[0], y, run[1], rows, textcolor);
+	  }
+	  record = run;
+	  y += rows;
+	}
+	return;
+  }
+
+  //Opaque text is sent as one address window covering the advance and the glyph box
+  int32_t x0 = advance_x < origin_x ? advance_x : origin_x;
+  int32_t x1 = advance_x + glyph->delta > origin_x + glyph->width ? advance_x + glyph->delta : origin_x + glyph->width;
+  int32_t y0 = cursor_y < origin_y ? cursor_y : origin_y;
+  int32_t y1 = cursor_y + font->cap_height > origin_y + glyph->height ? cursor_y + font->cap_height : origin_y + glyph->height;
+  int32_t top = y0;
+  if (!clipGlyphRect(x0, y0, x1, y1)) return;
+
+  uint32_t remaining = (x1 - x0) * (y1 - y0);
+  Profiler.count(ProfileCounter::SPIBytes, remaining * sizeof(uint16_t));
+  SPI.beginTransaction(SPISettings(SPICLOCK, MSBFIRST, SPI_MODE0));
+  setAddr(x0, y0, x1 - 1, y1 - 1);
+  writecommand_cont(ILI9341_RAMWR);
+
+  const uint8_t *row = NULL;
+  int32_t rowEnd = origin_y;
+  for (int32_t y = top; y < y1; y++) {
+	//Move to the record of this row, rows above or below the glyph have no runs
+	uint8_t runs = 0;
+	if (y >= origin_y && y < origin_y + glyph->height) {
+	  while (y >= rowEnd) {
+		row = record;
+		rowEnd += record[0];
+		record += 2 + 2 * record[1];
+	  }
+	  runs = row[1];
+	}
+	if (y < y0) continue;
+
+	int32_t x = x0;
+	const uint8_t *run = runs ? &row[2] : NULL;
+	for (int i = 0; i < runs; i++, run += 2) {
+	  int32_t start = origin_x + run[0];
+	  int32_t end = start + run[1];
+	  if (start < x) start = x;
+	  if (end > x1) end = x1;
+	  if (start >= end) continue;
+
+	  writeGlyphPixels(textbgcolor, start - x, remaining);
+	  writeGlyphPixels(textcolor, end - start, remaining);
+	  x = end;
+	}
+	writeGlyphPixels(textbgcolor, x1 - x, remaining);
+  }
+
+  SPI.endTransaction();
+}
+
+void PHDisplay::drawVerticalGlyph(const Glyph *glyph) {
+  //Cursor handling is the same as in ILI9341_t3::drawVerticalFontChar, vertical text is always transparent
+  if (cursor_x < 0) cursor_x = 0;
+  int32_t origin_y = cursor_y - glyph->xoffset;
+  if (_textRotation == 90) {
+	origin_y = cursor_y + glyph->xoffset;
+  }
+  int32_t origin_x = cursor_x + font->cap_height - glyph->height - glyph->yoffset;
+  if (origin_x < 0) {
+	cursor_x -= glyph->xoffset;
+	origin_x = 0;
+  }
+  if (origin_x + glyph->width > _width) {
+	if (!wrap) return;
+	origin_x = 0;
+	if (glyph->xoffset >= 0) {
+	  cursor_x = 0;
+	} else {
+	  cursor_x = -glyph->xoffset;
+	}
+	cursor_x += font->line_space;
+  }
+  if (cursor_y >= _height) return;
+
+  if (_textRotation == 90) {
+	cursor_y += glyph->delta;
+  } else {
+	cursor_y -= glyph->delta;
+  }
+
+  //Glyph rows become columns, runs become vertical lines
+  const uint8_t *record = _glyphCache.spans(glyph);
+  int32_t y = 0;
+  while (y < glyph->height) {
+	uint8_t rows = record[0];
+	const uint8_t *run = &record[2];
+	for (int i = 0; i < record[1]; i++, run += 2) {
+	  if (_textRotation == 90) {
+		fillGlyphRect(origin_x - y - rows + 1, origin_y + run[0], rows, run[1], textcolor);
+	  } else {
+		fillGlyphRect(origin_x + y, origin_y - run[0] - run[1] + 1, rows, run[1], textcolor);
+	  }
+	}
+	record = run;
+	y += rows;
+  }
+}
+
+void PHDisplay::fillGlyphRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color) {
+  if (w <= 0 || h <= 0) return;
+
+  int32_t x1 = x + w;
+  int32_t y1 = y + h;
+  if (!clipGlyphRect(x, y, x1, y1)) return;
+
+  //Locked with image buffer, draw into the buffer
+  if (_lockBuffer != NULL) {
+	_lockBuffer->fillRect(x, y, x1 - x, y1 - y, color);
+	return;
+  }
+
+  Profiler.count(ProfileCounter::SPIBytes, (x1 - x) * (y1 - y) * sizeof(uint16_t));
+  ILI9341_t3::fillRect(x, y, x1 - x, y1 - y, color);
+}
+
+bool PHDisplay::clipGlyphRect(int32_t &x0, int32_t &y0, int32_t &x1, int32_t &y1) {
+  //Clip to the screen and the clipping rect, right and bottom are exclusive
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  if (x1 > _width) x1 = _width;
+  if (y1 > _height) y1 = _height;
+  if (_clipRect != NULL) {
+	if (x0 < _clipRect->left()) x0 = _clipRect->left();
+	if (y0 < _clipRect->top()) y0 = _clipRect->top();
+	if (x1 > _clipRect->right()) x1 = _clipRect->right();
+	if (y1 > _clipRect->bottom()) y1 = _clipRect->bottom();
+  }
+  return x0 < x1 && y0 < y1;
+}
+
+void PHDisplay::writeGlyphPixels(uint16_t color, int32_t count, uint32_t &remaining) {
+  while (count-- > 0) {
+	if (--remaining > 0) {
+	  writedata16_cont(color);
+	} else {
+	  writedata16_last(color);
+	}
+  }
+}
+
 void PHDisplay::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
   //Locked with image buffer, draw into the buffer
   if (_lockBuffer != NULL) {
@@ -617,11 +863,13 @@ void PHDisplay::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
 
   //This function is used by a lot of draw functions
   if (_clipRect == NULL) {
+	Profiler.count(ProfileCounter::SPIBytes, w * sizeof(uint16_t));
 	ILI9341_t3::drawFastHLine(x, y, w, color);
   } else {
 	Rect frame = Rect(x, y, w, 1);
 	frame = Rect::Intersect(frame, *_clipRect);
 
+	Profiler.count(ProfileCounter::SPIBytes, frame.width * sizeof(uint16_t));
 	ILI9341_t3::drawFastHLine(frame.x, frame.y, frame.width, color);
   }
 }
@@ -640,19 +888,62 @@ void PHDisplay::fadeOut() {
 	return;
   }
 
-  for (int i = 128; i >= 0; i--) {
-	analogWrite(TFT_BACKLIGHT_PWM, i);
+  for (int i = DISPLAY_BRIGHTNESS_MAX; i >= 0; i--) {
+	setBrightness(i);
 	delay(1);
   }
 }
 
 void PHDisplay::fadeIn() {
-  for (int i = 0; i <= 128; i++) {
-	analogWrite(TFT_BACKLIGHT_PWM, i);
+  for (int i = 0; i <= DISPLAY_BRIGHTNESS_MAX; i++) {
+	setBrightness(i);
 	delay(1);
   }
 }
 
+void PHDisplay::fadeTo(uint8_t brightness, float duration) {
+  //Keep the display lit in debug mode
+  if (debug) brightness = DISPLAY_BRIGHTNESS_MAX;
+
+  if (_brightnessAnimation != NULL) {
+	_brightnessAnimation->stop();
+	_brightnessAnimation = NULL;
+  }
+
+  //Animations without a change in value never finish, so don't start them
+  if (brightness == _brightness) return;
+
+  Animation *animation = Animator.getAnimationSlot();
+  if (animation == NULL) {
+	setBrightness(brightness);
+	return;
+  }
+
+  animation->init("brightness", _brightness, brightness, duration);
+  addAnimation(animation);
+  _brightnessAnimation = animation;
+}
+
+void PHDisplay::setBrightness(uint8_t brightness) {
+  _brightness = brightness;
+  analogWrite(TFT_BACKLIGHT_PWM, brightness);
+}
+
+void PHDisplay::animationUpdated(Animation *animation, float currentValue, float deltaValue, float timeLeft) {
+  if (animation != _brightnessAnimation) return;
+
+  uint8_t brightness = (uint8_t) roundf(currentValue);
+  if (brightness != _brightness) {
+	setBrightness(brightness);
+  }
+}
+
+void PHDisplay::animationFinished(Animation *animation) {
+  if (animation == _brightnessAnimation) {
+	_brightnessAnimation = NULL;
+  }
+}
+
 void PHDisplay::debugLayer(Layer *layer, bool fill, uint16_t color, bool waitForTap) {
   if (fill) {
 	fillRect(layer->getFrame().x
@@ -680,18 +971,14 @@ void PHDisplay::waitForTap() {
 }
 
 void PHDisplay::lockBuffer(ImageBuffer *imageBuffer) {
-  LOG("Locking Buffer");
   _lockBuffer = imageBuffer;
 }
 
 void PHDisplay::unlock() {
-  LOG("Releasing Buffer");
   _lockBuffer = NULL;
 }
 
 Rect PHDisplay::prepareRenderFrame(const Rect proposedRenderFrame, DisplayContext context) {
-  if (_lockBuffer != NULL) return proposedRenderFrame;
-
   Rect frame = proposedRenderFrame;
   //Map layer frame to display space
   if (context == DisplayContext::Scrolling) {
@@ -710,6 +997,14 @@ Rect PHDisplay::prepareRenderFrame(const Rect proposedRenderFrame, DisplayContex
 void PHDisplay::invalidateRect(Rect invalidationRect) {
   LOG_VALUE("Invalidating Rect", invalidationRect.toString());
 
+  if (needsCompositing(invalidationRect)) {
+	composeRect(invalidationRect);
+  } else {
+	drawInvalidatedRect(invalidationRect);
+  }
+}
+
+void PHDisplay::drawInvalidatedRect(Rect &invalidationRect) {
   if (_autoLayout) {
 	_foregroundLayer->invalidateRect(invalidationRect);
   }
@@ -722,6 +1017,129 @@ void PHDisplay::invalidateRect(Rect invalidationRect) {
   }
 }
 
+bool PHDisplay::needsCompositing(Rect &rect) {
+  _composeLayersValid = false;
+
+  //Composing needs the foreground layer to paint everything not covered by layers
+  if (!_autoLayout || _fixedBackgroundLayer != NULL) return false;
+  if (rect.width <= 0 || rect.height <= 0) return false;
+
+  //Collect the layers within the rect once, the check below and composeRect only look at these. Composing with all
+  //layers is always right, so do that if the list can't grow
+  _composeLayers.clear();
+  _composeRect = rect;
+  if (!collectComposeLayers(_foregroundLayer, rect)) return true;
+  _composeForegroundLayers = _composeLayers.count();
+
+  for (int i = 0; i < _layers.count(); i++) {
+	Layer *layer = _layers.at(i);
+	if (layer->getContext() == DisplayContext::Fixed || !layer->isVisible()) continue;
+	Rect frame = layer->getFrame();
+	if (!frame.intersectsRect(rect) && layer->isLeaf()) continue;
+	if (!_composeLayers.push(layer)) return true;
+  }
+  _composeLayersValid = true;
+
+  //Translucent layers or layers drawn on top of each other within the rect
+  for (int i = _composeForegroundLayers; i < _composeLayers.count(); i++) {
+	Layer *layer = _composeLayers.at(i);
+	Rect frame = layer->getFrame();
+	if (!frame.intersectsRect(rect)) continue;
+	if (layer->getAlpha() < 256) return true;
+
+	Rect clippedFrame = Rect::Intersect(frame, rect);
+	for (int j = i + 1; j < _composeLayers.count(); j++) {
+	  Rect otherFrame = _composeLayers.at(j)->getFrame();
+	  if (clippedFrame.intersectsRect(otherFrame)) return true;
+	}
+  }
+
+  return false;
+}
+
+bool PHDisplay::collectComposeLayers(Layer *layer, Rect &rect) {
+  //Same walk as Layer::invalidateRect, leaves outside the rect would not draw anything
+  if (!layer->isVisible()) return true;
+
+  LayerList *sublayers = layer->getSublayers();
+  if (sublayers->count() <= 0) {
+	Rect frame = layer->getFrame();
+	if (!frame.intersectsRect(rect)) return true;
+	return _composeLayers.push(layer);
+  }
+
+  for (int i = 0; i < sublayers->count(); i++) {
+	if (!collectComposeLayers(sublayers->at(i), rect)) return false;
+  }
+
+  return true;
+}
+
+void PHDisplay::composeRect(Rect &rect) {
+  //The layer list is only good for the rect needsCompositing has just been called with
+  if (!(_composeRect == rect)) {
+	_composeLayersValid = false;
+  }
+
+  if (_composeBuffer == NULL) {
+	_composeBuffer = (uint16_t *) malloc(sizeof(uint16_t) * COMPOSE_BUFFER_PIXELS);
+	Profiler.count(ProfileCounter::Allocations);
+  }
+
+  int stripWidth = COMPOSE_BUFFER_PIXELS / rect.height;
+  if (_composeBuffer == NULL || stripWidth <= 0) {
+	drawInvalidatedRect(rect);
+	return;
+  }
+
+  //Compose in strips of full columns that fit the buffer and don't wrap around the layout width
+  int layoutWidth = getLayoutWidth();
+  int x = rect.x;
+  while (x < rect.right()) {
+	int width = min(stripWidth, rect.right() - x);
+	int layoutEnd = (x / layoutWidth + 1) * layoutWidth;
+	if (x + width > layoutEnd) width = layoutEnd - x;
+
+	Rect strip(x, rect.y, width, rect.height);
+	composeStrip(strip);
+	x += width;
+  }
+
+  _composeLayersValid = false;
+}
+
+void PHDisplay::composeStrip(Rect &strip) {
+  Rect renderFrame = prepareRenderFrame(strip, DisplayContext::Scrolling);
+
+  //Layers keep drawing in screen space, the translation maps that into the buffer
+  ImageBuffer buffer(_composeBuffer, strip.width, strip.height);
+  buffer.clear(_foregroundLayer->getBackgroundColor());
+  buffer.setTranslation(-renderFrame.x, -renderFrame.y);
+
+  lockBuffer(&buffer);
+  if (_composeLayersValid) {
+	//Only layers that intersect the strip draw into it, layers with sublayers check theirs
+	for (int i = 0; i < _composeLayers.count(); i++) {
+	  Layer *layer = _composeLayers.at(i);
+	  Rect frame = layer->getFrame();
+	  if (layer->isLeaf() && !frame.intersectsRect(strip)) continue;
+	  buffer.setAlpha(i < _composeForegroundLayers ? 256 : layer->getAlpha());
+	  layer->invalidateRect(strip);
+	}
+  } else {
+	_foregroundLayer->invalidateRect(strip);
+	for (int i = 0; i < _layers.count(); i++) {
+	  Layer *layer = _layers.at(i);
+	  if (layer->getContext() == DisplayContext::Fixed) continue;
+	  buffer.setAlpha(layer->getAlpha());
+	  layer->invalidateRect(strip);
+	}
+  }
+  unlock();
+
+  drawImageBuffer(&buffer, renderFrame);
+}
+
 void PHDisplay::drawImageBuffer(ImageBuffer *imageBuffer, Rect renderFrame) {
   drawBitmap(renderFrame.x, renderFrame.y, renderFrame.width, renderFrame.height, imageBuffer->getData(), 0, 0, imageBuffer->getWidth(), imageBuffer->getHeight());
   //fillRect(renderFrame.x,renderFrame.y,renderFrame.width,renderFrame.height,ILI9341_PINK);
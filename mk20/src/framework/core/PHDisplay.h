@@ -34,15 +34,21 @@
 #define TEENSYCMAKE_PHDISPLAY_H
 
 #include "ILI9341_t3.h"
-#include "StackArray.h"
+#include "SmallVector.h"
+#include "MemoryConfig.h"
 #include "../layers/Layer.h"
 #include "../layers/RectangleLayer.h"
 #include "SD.h"
 #include "../../framework/core/ImageBuffer.h"
 #include "UIBitmap.h"
 #include "../../UIBitmaps.h"
+#include "GlyphCache.h"
+#include "../animation/Animator.h"
 
-class PHDisplay : public ILI9341_t3 {
+//Backlight PWM value of a fully lit display
+#define DISPLAY_BRIGHTNESS_MAX 128
+
+class PHDisplay : public ILI9341_t3, public AnimatableObject {
 #pragma mark Constructor
  public:
   PHDisplay(uint8_t _CS, uint8_t _DC, uint8_t _RST = 255, uint8_t _MOSI = 11, uint8_t _SCLK = 13, uint8_t _MISO = 12);
@@ -57,7 +63,8 @@ class PHDisplay : public ILI9341_t3 {
   virtual void setNeedsDisplay();
   virtual bool willRefresh();
   virtual void layoutIfNeeded();
-  virtual void dispatch();
+  //Budget in microseconds, 0 draws everything. willRefresh stays true until a pass is complete
+  virtual void dispatch(uint32_t budget = 0);
   virtual void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
   virtual void drawBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint16_t *bitmap, uint16_t xs, uint16_t ys, uint16_t ws, uint16_t hs);
   virtual void drawFileBitmapByColumn(uint16_t x, uint16_t y, uint16_t w, uint16_t h, File *file, uint16_t xs, uint16_t ys, uint16_t ws, uint16_t hs, uint32_t byteOffset = 0);
@@ -79,17 +86,40 @@ class PHDisplay : public ILI9341_t3 {
   virtual void drawImageBuffer(ImageBuffer *imageBuffer, Rect renderFrame);
   virtual void disableAutoLayout();   //Use clear to enable auto layout again
 
+#pragma mark Text Rendering
+  virtual size_t write(uint8_t c) override;
+  GlyphCache *getGlyphCache() { return &_glyphCache; };
+
 #pragma mark Render To Buffer
   virtual void lockBuffer(ImageBuffer *imageBuffer);
   virtual void unlock();
 
+#pragma mark Compositing
+  bool needsCompositing(Rect &rect);
+  void composeRect(Rect &rect);
+
  protected:
   virtual void drawFontBits(uint32_t bits, uint32_t numbits, uint32_t x, uint32_t y, uint32_t repeat) override;
+  void drawGlyph(const Glyph *glyph);
+  void drawVerticalGlyph(const Glyph *glyph);
+  void fillGlyphRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color);
+  bool clipGlyphRect(int32_t &x0, int32_t &y0, int32_t &x1, int32_t &y1);
+  void writeGlyphPixels(uint16_t color, int32_t count, uint32_t &remaining);
+  void composeStrip(Rect &strip);
+  bool collectComposeLayers(Layer *layer, Rect &rect);
+  void drawInvalidatedRect(Rect &invalidationRect);
 
 #pragma Display Brightness
  public:
   virtual void fadeOut();
   virtual void fadeIn();
+  //Animates the backlight without blocking the loop, Animator drives the fade
+  virtual void fadeTo(uint8_t brightness, float duration);
+  virtual bool isFading() { return _brightnessAnimation != NULL; };
+  virtual void setBrightness(uint8_t brightness);
+  virtual uint8_t getBrightness() { return _brightness; };
+  virtual void animationUpdated(Animation *animation, float currentValue, float deltaValue, float timeLeft) override;
+  virtual void animationFinished(Animation *animation) override;
 
 #pragma mark Scrolling
  public:
@@ -112,16 +142,25 @@ class PHDisplay : public ILI9341_t3 {
   uint16_t _scrollInsetRight;
   RectangleLayer *_backgroundLayer;
   RectangleLayer *_foregroundLayer;
-  StackArray<Layer *> _layers;
-  StackArray<Layer *> _presentationLayers;
+  SmallVector<Layer *, DISPLAY_INLINE_LAYERS> _layers;
   bool _needsLayout;
   bool _needsDisplay;
+  int _dispatchPosition;
   float _scrollOffset;
   Rect *_clipRect;
   uint16_t _backgroundColor;
   Layer *_fixedBackgroundLayer;
   ImageBuffer *_lockBuffer;
+  uint16_t *_composeBuffer;
+  //Layers that intersect the rect needsCompositing has been called with, the parts of the foreground layer first
+  SmallVector<Layer *, DISPLAY_INLINE_LAYERS> _composeLayers;
+  int _composeForegroundLayers;
+  Rect _composeRect;
+  bool _composeLayersValid;
   bool _autoLayout;
+  GlyphCache _glyphCache;
+  uint8_t _brightness;
+  Animation *_brightnessAnimation;
 
 };
 
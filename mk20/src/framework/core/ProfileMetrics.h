@@ -0,0 +1,77 @@
+/*
+ * Profiler sections, counters and the metrics snapshot MK20 sends to ESP with
+ * TaskID::Metrics. ESP includes this header from the MK20 source tree, so both
+ * sides share the layout of the snapshot and the names used by /metrics.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PRINTRHUB_PROFILEMETRICS_H
+#define PRINTRHUB_PROFILEMETRICS_H
+
+#include <stdint.h>
+
+//New sections and counters are added before Count, together with their name below
+enum class ProfileSection : uint8_t {
+  Loop = 0,
+  CommStack = 1,
+  Printer = 2,
+  Jobs = 3,
+  Scene = 4,
+  Layout = 5,
+  Dispatch = 6,
+  Touch = 7,
+  Count = 8
+};
+
+enum class ProfileCounter : uint8_t {
+  Allocations = 0,
+  SDBlockReads = 1,
+  SPIBytes = 2,
+  CommStackErrors = 3,
+  Count = 4
+};
+
+static const char *const profileSectionNames[] = {"loop", "commstack", "printer", "jobs", "scene", "layout", "dispatch", "touch"};
+static const char *const profileCounterNames[] = {"allocations", "sd_block_reads", "spi_bytes", "commstack_errors"};
+
+static_assert(sizeof(profileSectionNames) / sizeof(profileSectionNames[0]) == (int) ProfileSection::Count, "Every profile section needs a name");
+static_assert(sizeof(profileCounterNames) / sizeof(profileCounterNames[0]) == (int) ProfileCounter::Count, "Every profile counter needs a name");
+
+//Durations in microseconds
+struct SectionMetrics {
+  uint32_t count;
+  uint32_t p50;
+  uint32_t p99;
+  uint32_t max;
+};
+
+//Snapshot sent to the ESP with TaskID::Metrics, it has to fit into a single CommStack packet
+struct Metrics {
+  uint32_t uptime;            //Seconds
+  uint32_t missedDeadlines;
+  SectionMetrics sections[(int) ProfileSection::Count];
+  uint32_t counters[(int) ProfileCounter::Count];
+};
+
+static_assert(sizeof(Metrics) <= 247, "Metrics don't fit into a CommStack packet");
+
+#endif //PRINTRHUB_PROFILEMETRICS_H
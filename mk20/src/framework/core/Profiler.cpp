@@ -0,0 +1,132 @@
+/*
+ * Lightweight profiler for the main loop, see Profiler.h
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Profiler.h"
+#include "Application.h"
+#include "SD.h"
+
+ProfilerClass Profiler;
+
+#define CYCLES_PER_MICROSECOND (F_CPU / 1000000)
+
+ProfilerClass::ProfilerClass() {
+  _sdBlockReadsBase = 0;
+  memset(_buckets, 0, sizeof(_buckets));
+  memset(_count, 0, sizeof(_count));
+  memset(_maxCycles, 0, sizeof(_maxCycles));
+  memset(_counters, 0, sizeof(_counters));
+}
+
+void ProfilerClass::begin() {
+  //Enable the DWT cycle counter, it's not running unless a debugger is attached
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+}
+
+void ProfilerClass::reset() {
+  memset(_buckets, 0, sizeof(_buckets));
+  memset(_count, 0, sizeof(_count));
+  memset(_maxCycles, 0, sizeof(_maxCycles));
+  memset(_counters, 0, sizeof(_counters));
+  _sdBlockReadsBase = Sd2Card::blocksRead();
+}
+
+void ProfilerClass::record(ProfileSection section, uint32_t cycles) {
+  int s = (int) section;
+  uint32_t micros = cycles / CYCLES_PER_MICROSECOND;
+
+  int bucket = micros == 0 ? 0 : 32 - __builtin_clz(micros);
+  if (bucket >= PROFILER_BUCKETS) bucket = PROFILER_BUCKETS - 1;
+
+  _buckets[s][bucket]++;
+  _count[s]++;
+  if (cycles > _maxCycles[s]) _maxCycles[s] = cycles;
+}
+
+uint32_t ProfilerClass::percentile(ProfileSection section, uint32_t permille) {
+  int s = (int) section;
+  if (_count[s] == 0) return 0;
+
+  uint32_t max = _maxCycles[s] / CYCLES_PER_MICROSECOND;
+  uint32_t rank = ((uint64_t) _count[s] * permille + 999) / 1000;
+  uint32_t total = 0;
+  for (int i = 0; i < PROFILER_BUCKETS - 1; i++) {
+	total += _buckets[s][i];
+	if (total >= rank) {
+	  uint32_t upper = 1UL << i;
+	  return upper < max ? upper : max;
+	}
+  }
+
+  return max;
+}
+
+SectionMetrics ProfilerClass::getSectionMetrics(ProfileSection section) {
+  SectionMetrics metrics;
+  metrics.count = _count[(int) section];
+  metrics.p50 = percentile(section, 500);
+  metrics.p99 = percentile(section, 990);
+  metrics.max = _maxCycles[(int) section] / CYCLES_PER_MICROSECOND;
+  return metrics;
+}
+
+uint32_t ProfilerClass::getCounter(ProfileCounter counter) {
+  //SD blocks are counted by the card driver
+  if (counter == ProfileCounter::SDBlockReads) {
+	return Sd2Card::blocksRead() - _sdBlockReadsBase;
+  }
+  //SPI traffic is shared by display and SD card
+  if (counter == ProfileCounter::SPIBytes) {
+	return _counters[(int) counter] + (Sd2Card::blocksRead() - _sdBlockReadsBase) * 512;
+  }
+  return _counters[(int) counter];
+}
+
+void ProfilerClass::getMetrics(Metrics *metrics) {
+  metrics->uptime = millis() / 1000;
+  metrics->missedDeadlines = Application.getMissedDeadlines();
+  for (int i = 0; i < (int) ProfileSection::Count; i++) {
+	metrics->sections[i] = getSectionMetrics((ProfileSection) i);
+  }
+  for (int i = 0; i < (int) ProfileCounter::Count; i++) {
+	metrics->counters[i] = getCounter((ProfileCounter) i);
+  }
+}
+
+const char *ProfilerClass::getSectionName(ProfileSection section) {
+  return profileSectionNames[(int) section];
+}
+
+const char *ProfilerClass::getCounterName(ProfileCounter counter) {
+  return profileCounterNames[(int) counter];
+}
+
+ProfileScope::ProfileScope(ProfileSection section) :
+	_section(section),
+	_start(ARM_DWT_CYCCNT) {
+}
+
+ProfileScope::~ProfileScope() {
+  Profiler.record(_section, ARM_DWT_CYCCNT - _start);
+}
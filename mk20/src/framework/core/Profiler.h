@@ -0,0 +1,79 @@
+/*
+ * Lightweight profiler for the main loop. Scoped timers read the Cortex-M4 DWT
+ * cycle counter and feed a log2 histogram per section, from which p50 and p99
+ * are estimated (upper bound of the bucket). Counters track allocations, SD block
+ * reads, SPI traffic and CommStack errors.
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_PROFILER_H
+#define MK20_PROFILER_H
+
+#include <Arduino.h>
+#include "ProfileMetrics.h"
+
+//Buckets hold durations of [2^(n-1), 2^n) microseconds, the last one everything above
+#define PROFILER_BUCKETS 16
+
+class ProfilerClass {
+ public:
+  ProfilerClass();
+  void begin();
+  void reset();
+
+  uint32_t cycles() { return ARM_DWT_CYCCNT; };
+  void record(ProfileSection section, uint32_t cycles);
+  void count(ProfileCounter counter, uint32_t amount = 1) { _counters[(int) counter] += amount; };
+
+  SectionMetrics getSectionMetrics(ProfileSection section);
+  uint32_t getCounter(ProfileCounter counter);
+  void getMetrics(Metrics *metrics);
+
+  static const char *getSectionName(ProfileSection section);
+  static const char *getCounterName(ProfileCounter counter);
+
+ private:
+  uint32_t percentile(ProfileSection section, uint32_t permille);
+
+  uint32_t _buckets[(int) ProfileSection::Count][PROFILER_BUCKETS];
+  uint32_t _count[(int) ProfileSection::Count];
+  uint32_t _maxCycles[(int) ProfileSection::Count];
+  uint32_t _counters[(int) ProfileCounter::Count];
+  uint32_t _sdBlockReadsBase;
+};
+
+//Records the time until the end of the enclosing block
+class ProfileScope {
+ public:
+  ProfileScope(ProfileSection section);
+  ~ProfileScope();
+
+ private:
+  ProfileSection _section;
+  uint32_t _start;
+};
+
+#define PROFILE_SCOPE(section) ProfileScope profileScope##section(ProfileSection::section)
+
+extern ProfilerClass Profiler;
+
+#endif //MK20_PROFILER_H
@@ -0,0 +1,50 @@
+/*
+ * Arena for the views and layers of a scene. While the scene builds its view tree
+ * objects are allocated from the arena one after another, the arena is released
+ * in one go when the scene is deleted
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "SceneArena.h"
+
+SceneArenaClass SceneArena;
+
+void *SceneArenaClass::allocate(size_t size) {
+  if (!_open) return NULL;
+
+  //Keep every allocation 8 byte aligned
+  size = (size + 7) & ~7;
+  if (_used + size > SCENE_ARENA_SIZE) return NULL;
+
+  void *pointer = &_buffer[_used];
+  _used += size;
+  if (_used > _highWaterMark) _highWaterMark = _used;
+  return pointer;
+}
+
+bool SceneArenaClass::owns(void *pointer) const {
+  return pointer >= (void *) &_buffer[0] && pointer < (void *) &_buffer[SCENE_ARENA_SIZE];
+}
+
+void SceneArenaClass::reset() {
+  _used = 0;
+}
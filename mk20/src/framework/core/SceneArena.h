@@ -0,0 +1,60 @@
+/*
+ * Arena for the views and layers of a scene. While the scene builds its view tree
+ * objects are allocated from the arena one after another, the arena is released
+ * in one go when the scene is deleted
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_SCENEARENA_H
+#define MK20_SCENEARENA_H
+
+#include <Arduino.h>
+#include "MemoryConfig.h"
+
+//There is no constructor on purpose, zero initialized storage is a valid closed and empty arena
+class SceneArenaClass {
+ public:
+  //Allocations are only served from the arena between open and close
+  void open() { _open = true; };
+  void close() { _open = false; };
+
+  //Returns NULL if the arena is closed or full
+  void *allocate(size_t size);
+  bool owns(void *pointer) const;
+
+  //Only call this if all objects allocated in the arena are gone
+  void reset();
+
+  size_t getUsed() const { return _used; };
+  size_t getHighWaterMark() const { return _highWaterMark; };
+  size_t getCapacity() const { return SCENE_ARENA_SIZE; };
+
+ private:
+  uint8_t _buffer[SCENE_ARENA_SIZE] __attribute__((aligned(8)));
+  size_t _used;
+  size_t _highWaterMark;
+  bool _open;
+};
+
+extern SceneArenaClass SceneArena;
+
+#endif //MK20_SCENEARENA_H
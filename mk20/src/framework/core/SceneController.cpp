@@ -37,6 +37,8 @@ SceneController::SceneController() {
   _currentTouchedView = NULL;
   _scrollOffset = 0;
   _scrollSnap = 0;
+  _scrollVelocity = 0;
+  _scrolling = false;
   _decelerationRate = 270.0f * 7;   //Pixels per Second
   _scrollAnimation = NULL;
   _lastScrollTime = 0;
@@ -49,13 +51,20 @@ SceneController::~SceneController() {
   }
 }
 
+void SceneController::addView(View *view) {
+  //Scenes keep pointers to their views, so it is not deleted, it is just not shown
+  if (!_views.push(view)) {
+	FLOW_ERROR("SceneController: Could not add view, out of memory");
+  }
+}
+
 bool SceneController::isModal() {
   //Default is that this scene can be replaced by pushing another one on the stack
   return false;
 }
 
 void SceneController::loop() {
-  if (Touch.touched()) return;
+  if (TouchQueue.isTouched()) return;
 
   if (_scrollSnap == 0) {
 	if (_scrollVelocity > 0) {
@@ -76,6 +85,10 @@ void SceneController::loop() {
   }
 }
 
+bool SceneController::prepare() {
+  return true;
+}
+
 void SceneController::onWillAppear() {
   //Clear display - override if you want a nice transition effect
 //	uint16_t backgroundColor = Application.getTheme()->getBackgroundColor(ColorTheme::Default);
@@ -119,6 +132,7 @@ bool SceneController::runTask(CommHeader &header, const uint8_t *data, size_t da
 void SceneController::handleTouchDown(TS_Point &point) {
   //Stop scrolling immediately
   _scrollVelocity = 0;
+  _scrolling = false;
 
   if (_scrollAnimation != NULL) {
 	_scrollAnimation->stop();
@@ -166,8 +180,17 @@ void SceneController::handleTouchUp(TS_Point &point) {
 	_currentTouchedView = NULL;
   }
 
-  //We don not need a finishing animation if we don't have any velocity to work with
-  if (_scrollVelocity == 0) {
+  //We don not need a finishing animation if the touch didn't scroll
+  if (!_scrolling) {
+	return;
+  }
+  _scrolling = false;
+
+  //Fling with the velocity the finger had when it was lifted, it's zero if it rested before
+  _scrollVelocity = Application.getTouchEvent().velocityX;
+
+  //Without snapping the scene loop decelerates the scrolling
+  if (_scrollSnap == 0) {
 	return;
   }
 
@@ -283,13 +306,9 @@ void SceneController::handleTouchMoved(TS_Point point, TS_Point oldPoint) {
 
   LOG("Handle Scrolling");
 
-  //Handle Scrolling
-  _scrollVelocity = 0;
-  if (Application.getDeltaTime() > 0) {
-	if (Application.getDeltaTime() > 0) {
-	  _scrollVelocity = (point.x - oldPoint.x) / Application.getDeltaTime();
-	}
-  }
+  //Handle Scrolling, the velocity is calculated from the timestamps of the touch samples
+  _scrolling = true;
+  _scrollVelocity = Application.getTouchEvent().velocityX;
 
   LOG_VALUE("Point.X: ", point.x);
   LOG_VALUE("OldPoint.X: ", oldPoint.x);
@@ -37,6 +37,10 @@
 #include "Application.h"
 #include "../../framework/animation/Animation.h"
 #include "CommStack.h"
+#include "SmallVector.h"
+#include "MemoryConfig.h"
+
+typedef SmallVector<View *, SCENE_INLINE_VIEWS> ViewList;
 
 typedef enum SnapMode {
   Disabled = 0,
@@ -56,6 +60,8 @@ class SceneController : public AnimatableObject {
 
 #pragma mark Application Flow
   virtual void loop();
+  //Called once per loop while the previous scene is still shown, return false until all resources are loaded
+  virtual bool prepare();
   virtual void onWillAppear();
   virtual void onDidAppear();
   virtual void setupDisplay();
@@ -68,8 +74,8 @@ class SceneController : public AnimatableObject {
   virtual String getName() = 0;
 
 #pragma mark View Management
-  virtual StackArray<View *> *getViews() { return &_views; };
-  virtual void addView(View *view) { _views.push(view); };
+  virtual ViewList *getViews() { return &_views; };
+  virtual void addView(View *view);
   virtual View *getView(uint16_t n) { return _views.at(n); };
 
 #pragma mark Touch Handling
@@ -97,10 +103,11 @@ class SceneController : public AnimatableObject {
 
 #pragma mark Member Variables
  private:
-  StackArray<View *> _views;
+  ViewList _views;
   View *_currentTouchedView;
   float _scrollOffset;
   float _scrollVelocity;
+  bool _scrolling;
   float _scrollSnap;
   SnapMode _snapMode;
   float _decelerationRate;
@@ -0,0 +1,122 @@
+/*
+ * Vector with inline storage for the first N elements, only grows onto the
+ * heap (or the supplied allocator) if it holds more. Used for the layer and
+ * view lists that typically hold a handful of elements
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_SMALLVECTOR_H
+#define MK20_SMALLVECTOR_H
+
+#include <Arduino.h>
+
+//Enable to check indices of at(), pop() and peek(), out of range accesses are reported on the serial port
+//#define SMALLVECTOR_BOUNDS_CHECK
+
+struct HeapAllocator {
+  static void *allocate(size_t size) { return malloc(size); };
+  static void release(void *pointer) { free(pointer); };
+};
+
+//Elements are moved with memcpy when the storage grows, T has to be trivially copyable (i.e. pointers)
+template<typename T, int N, typename Allocator = HeapAllocator>
+class SmallVector {
+ public:
+  SmallVector() : _data(_inline), _count(0), _capacity(N) {};
+  ~SmallVector() { release(); };
+
+  //Returns false if the storage could not grow, the element is not added then
+  bool push(const T item) {
+	if (_count == _capacity && !grow()) return false;
+	_data[_count++] = item;
+	return true;
+  };
+
+  //Empty vectors return a default item, with or without bounds checking
+  T pop() {
+	if (!checkIndex(_count - 1) || _count == 0) return T();
+	return _data[--_count];
+  };
+
+  T peek() const {
+	if (!checkIndex(_count - 1) || _count == 0) return T();
+	return _data[_count - 1];
+  };
+
+  T at(int n) const {
+	if (!checkIndex(n)) return T();
+	return _data[n];
+  };
+
+  bool isEmpty() const { return _count == 0; };
+  int count() const { return _count; };
+  int capacity() const { return _capacity; };
+
+  //Keeps the grown storage for reuse unless shrink is set
+  void clear(const bool shrink = false) {
+	_count = 0;
+	if (shrink) release();
+  };
+
+ private:
+  //Not copyable, _data may point into the object itself
+  SmallVector(const SmallVector &);
+  SmallVector &operator=(const SmallVector &);
+
+  bool grow() {
+	int capacity = _capacity * 2;
+	T *data = (T *) Allocator::allocate(sizeof(T) * capacity);
+	if (data == NULL) return false;
+
+	memcpy(data, _data, sizeof(T) * _count);
+	if (_data != _inline) Allocator::release(_data);
+	_data = data;
+	_capacity = capacity;
+	return true;
+  };
+
+  void release() {
+	if (_data != _inline) {
+	  Allocator::release(_data);
+	  _data = _inline;
+	  _capacity = N;
+	  if (_count > N) _count = N;
+	}
+  };
+
+  bool checkIndex(int n) const {
+#ifdef SMALLVECTOR_BOUNDS_CHECK
+	if (n < 0 || n >= _count) {
+	  Serial.printf("SmallVector: index %d out of range, count %d\n", n, _count);
+	  return false;
+	}
+#endif
+	return true;
+  };
+
+  T _inline[N];
+  T *_data;
+  int _count;
+  int _capacity;
+};
+
+#endif //MK20_SMALLVECTOR_H
@@ -0,0 +1,143 @@
+/*
+ * Queue of touch events sampled from the FT6206 touch controller. The INT line
+ * of the controller tells when a finger is down, the controller is only read
+ * via I2C while a touch is active
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "TouchQueue.h"
+
+extern Adafruit_FT6206 Touch;
+
+TouchQueueClass TouchQueue;
+
+//Weight of the newest sample in the smoothed velocity
+#define TOUCH_VELOCITY_SMOOTHING 0.6f
+
+TouchQueueClass::TouchQueueClass() {
+  _head = 0;
+  _tail = 0;
+  _interruptPin = 0;
+  _lineChanged = false;
+  _lineChangeTime = 0;
+  _touched = false;
+  _lastSampleTime = 0;
+  _lastMoveTime = 0;
+  _velocityX = 0;
+  _velocityY = 0;
+}
+
+void TouchQueueClass::begin(uint8_t interruptPin) {
+  _interruptPin = interruptPin;
+  attachInterrupt(interruptPin, TouchQueueClass::onInterrupt, CHANGE);
+}
+
+void TouchQueueClass::onInterrupt() {
+  //Just remember the time of the edge, I2C is read in the main loop
+  TouchQueue._lineChangeTime = micros();
+  TouchQueue._lineChanged = true;
+}
+
+void TouchQueueClass::sample() {
+  //The controller keeps INT low as long as the screen is touched
+  bool active = digitalRead(_interruptPin) == LOW;
+  if (!active && !_touched) {
+	_lineChanged = false;
+	return;
+  }
+
+  uint32_t now = micros();
+  uint32_t time = now;
+  noInterrupts();
+  bool lineChanged = _lineChanged;
+  if (lineChanged) time = _lineChangeTime;
+  _lineChanged = false;
+  interrupts();
+
+  //Finger lifted, we know that without asking the controller
+  if (!active) {
+	if (time - _lastMoveTime > TOUCH_FLING_TIMEOUT) {
+	  _velocityX = 0;
+	  _velocityY = 0;
+	}
+	push(TouchEventType::Up, _lastPoint, time);
+	_touched = false;
+	return;
+  }
+
+  if (_touched && !lineChanged && (now - _lastSampleTime) < TOUCH_SAMPLE_INTERVAL) return;
+  _lastSampleTime = now;
+
+  uint16_t x, y;
+  if (!Touch.readData(&x, &y)) return;
+
+  //Transform due to screen rotation
+  TS_Point point(y, 240 - x, 1);
+
+  if (!_touched) {
+	_touched = true;
+	_velocityX = 0;
+	_velocityY = 0;
+	_lastMoveTime = time;
+	push(TouchEventType::Down, point, time);
+  } else if (point.x != _lastPoint.x || point.y != _lastPoint.y) {
+	float dt = (float) (time - _lastMoveTime) / 1000000.0f;
+	if (dt > 0) {
+	  _velocityX = TOUCH_VELOCITY_SMOOTHING * ((point.x - _lastPoint.x) / dt) + (1.0f - TOUCH_VELOCITY_SMOOTHING) * _velocityX;
+	  _velocityY = TOUCH_VELOCITY_SMOOTHING * ((point.y - _lastPoint.y) / dt) + (1.0f - TOUCH_VELOCITY_SMOOTHING) * _velocityY;
+	}
+	_lastMoveTime = time;
+	push(TouchEventType::Move, point, time);
+  }
+
+  _lastPoint = point;
+}
+
+void TouchQueueClass::push(TouchEventType type, TS_Point &point, uint32_t time) {
+  uint8_t next = (_head + 1) % TOUCH_QUEUE_SIZE;
+  if (next == _tail) {
+	//Queue is full, a move replaces the newest event if that's a move too, otherwise the oldest event is dropped
+	uint8_t last = (_head + TOUCH_QUEUE_SIZE - 1) % TOUCH_QUEUE_SIZE;
+	if (type == TouchEventType::Move && _events[last].type == TouchEventType::Move) {
+	  _head = last;
+	  next = (_head + 1) % TOUCH_QUEUE_SIZE;
+	} else {
+	  _tail = (_tail + 1) % TOUCH_QUEUE_SIZE;
+	}
+  }
+
+  TouchEvent &event = _events[_head];
+  event.type = type;
+  event.point = point;
+  event.time = time;
+  event.velocityX = _velocityX;
+  event.velocityY = _velocityY;
+  _head = next;
+}
+
+bool TouchQueueClass::pop(TouchEvent &event) {
+  if (_head == _tail) return false;
+
+  event = _events[_tail];
+  _tail = (_tail + 1) % TOUCH_QUEUE_SIZE;
+  return true;
+}
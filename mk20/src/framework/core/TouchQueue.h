@@ -0,0 +1,87 @@
+/*
+ * Queue of touch events sampled from the FT6206 touch controller. The INT line
+ * of the controller tells when a finger is down, the controller is only read
+ * via I2C while a touch is active
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_TOUCHQUEUE_H
+#define MK20_TOUCHQUEUE_H
+
+#include <Arduino.h>
+#include "Adafruit_FT6206.h"
+
+#define TOUCH_QUEUE_SIZE 32
+
+//Minimum time between two I2C reads of the touch position in microseconds, the FT6206 reports at about 100Hz
+#define TOUCH_SAMPLE_INTERVAL 8000
+
+//If the finger rested longer than this before lifting (microseconds) it doesn't fling
+#define TOUCH_FLING_TIMEOUT 60000
+
+enum class TouchEventType : uint8_t {
+  Down = 0,
+  Move = 1,
+  Up = 2
+};
+
+struct TouchEvent {
+  TouchEventType type;
+  TS_Point point;
+  uint32_t time;              //Microseconds
+  float velocityX;            //Pixels per second
+  float velocityY;
+};
+
+class TouchQueueClass {
+ public:
+  TouchQueueClass();
+  void begin(uint8_t interruptPin);
+
+  //Reads the controller if a touch is active and queues the resulting events
+  void sample();
+  bool pop(TouchEvent &event);
+  void clear() { _tail = _head; };
+  bool isEmpty() { return _head == _tail; };
+  bool isTouched() { return _touched; };
+
+ private:
+  static void onInterrupt();
+  void push(TouchEventType type, TS_Point &point, uint32_t time);
+
+  TouchEvent _events[TOUCH_QUEUE_SIZE];
+  uint8_t _head;
+  uint8_t _tail;
+  uint8_t _interruptPin;
+  volatile bool _lineChanged;
+  volatile uint32_t _lineChangeTime;
+  bool _touched;
+  TS_Point _lastPoint;
+  uint32_t _lastSampleTime;
+  uint32_t _lastMoveTime;
+  float _velocityX;
+  float _velocityY;
+};
+
+extern TouchQueueClass TouchQueue;
+
+#endif //MK20_TOUCHQUEUE_H
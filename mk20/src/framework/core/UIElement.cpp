@@ -30,6 +30,21 @@
  */
 
 #include "UIElement.h"
+#include "SceneArena.h"
+
+void *UIElement::operator new(size_t size) {
+  void *pointer = SceneArena.allocate(size);
+  if (pointer != NULL) return pointer;
+
+  return malloc(size);
+}
+
+void UIElement::operator delete(void *pointer) {
+  //Arena memory is released in one go when the scene is gone
+  if (SceneArena.owns(pointer)) return;
+
+  free(pointer);
+}
 
 Rect &UIElement::getFrame() {
   return _frame;
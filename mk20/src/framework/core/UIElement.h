@@ -144,6 +144,10 @@ typedef enum DisplayContext {
 
 class UIElement {
  public:
+  //Views and layers are allocated from the scene arena while a scene builds its view tree
+  static void *operator new(size_t size);
+  static void operator delete(void *pointer);
+
   virtual void setFrame(Rect frame, bool updateLayout = true);
   void setFrame(uint16_t x, uint16_t y, uint16_t width, uint16_t height, bool updateLayout);
   Rect &getFrame();
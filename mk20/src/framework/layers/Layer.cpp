@@ -37,10 +37,11 @@ Layer::Layer() :
 	_strokeColor(ILI9341_BLACK),
 	_backgroundColor(ILI9341_BLACK),
 	_strokeWidth(0),
-	_sublayers(NULL),
+	_alpha(256),
 	_needsDisplay(true),
 	_visible(true) {
   ::globalLayersCreated++;
+  Profiler.count(ProfileCounter::Allocations);
 
   uniqueId = ::globalLayerId++;
 
@@ -50,7 +51,6 @@ Layer::Layer() :
 Layer::Layer(Rect frame) :
 	Layer() {
   _frame = frame;
-  _sublayers = NULL;
 }
 
 Layer::~Layer() {
@@ -59,17 +59,12 @@ Layer::~Layer() {
   ::globalLayersDeleted++;
 
   removeAllSublayers();
-
-  if (_sublayers != NULL) {
-	delete _sublayers;
-	_sublayers = NULL;
-  }
 }
 
 void Layer::setBackgroundColor(const uint16_t &color) {
-  if (_sublayers != NULL && _sublayers->count() > 0) {
-	for (int i = 0; i < _sublayers->count(); i++) {
-	  Layer *sublayer = _sublayers->at(i);
+  if (_sublayers.count() > 0) {
+	for (int i = 0; i < _sublayers.count(); i++) {
+	  Layer *sublayer = _sublayers.at(i);
 	  sublayer->setBackgroundColor(color);
 	}
   }
@@ -97,10 +92,18 @@ uint8_t Layer::getStrokeWidth() const {
   return _strokeWidth;
 }
 
+void Layer::setAlpha(const uint16_t alpha) {
+  if (_alpha == alpha) return;
+  _alpha = alpha;
+  setNeedsDisplay();
+}
+
+uint16_t Layer::getAlpha() const {
+  return _alpha;
+}
+
 bool Layer::isLeaf() {
-  if (_sublayers == NULL) return true;
-  if (_sublayers->count() <= 0) return true;
-  return false;
+  return _sublayers.count() <= 0;
 }
 
 void Layer::splitVertically(int x, Layer **left, Layer **right) {
@@ -130,10 +133,10 @@ void Layer::splitVertically(int x, Layer **left, Layer **right) {
 
 void Layer::log() {
   LOG_VALUE("Layer: ", _frame.toString());
-  if (_sublayers != NULL && _sublayers->count() > 0) {
-	LOG_VALUE("Children: ", _sublayers->count());
-	for (int i = 0; i < _sublayers->count(); i++) {
-	  Layer *sublayer = _sublayers->at(i);
+  if (_sublayers.count() > 0) {
+	LOG_VALUE("Children: ", _sublayers.count());
+	for (int i = 0; i < _sublayers.count(); i++) {
+	  Layer *sublayer = _sublayers.at(i);
 	  sublayer->log();
 	}
   }
@@ -168,107 +171,88 @@ void Layer::splitHorizontally(int y, Layer **top, Layer **bottom) {
   }
 }
 
-void Layer::splitWithRect(Rect &rect) {
-  if (Display.debug)  LOG("splitWithRect:001");
-  if (!isLeaf()) {
-	if (Display.debug) LOG("Has Sublayer, split sublayers");
-	if (Display.debug) LOG("splitWithRect:002");
-	//This layer has sublayers, so we have to split the sublayers
-	for (int i = 0; i < _sublayers->count(); i++) {
-	  if (Display.debug) LOG("splitSublayer");
-	  Layer *layer = _sublayers->at(i);
-	  layer->splitWithRect(rect);
-	}
-  } else {
-	if (Display.debug) LOG("splitWithRect:003");
-	//This is a leaf layer, do the actual work.
-	if (!_frame.intersectsRect(rect)) return;
-
-	if (Display.debug) {
-	  Display.fillRect(0, 0, 320, 240, ILI9341_BLACK);
-	  Display.fillRect(_frame.x + getOriginX(), _frame.y, _frame.width, _frame.height, ILI9341_ORANGE);
-	  Display.drawRect(rect.x + getOriginX(), rect.y, rect.width, rect.height, ILI9341_GREEN);
-
-	  Display.setCursor(10, 10);
-	  Display.println(_frame.toString());
-	  Display.println(rect.toString());
-
-	  while (!Touch.touched()) {
-		delay(10);
-	  }
-	  while (Touch.touched()) {
-		delay(10);
-	  };
-	}
-
-	if (Display.debug) LOG("splitWithRect:004");
-
-	//Split the left edge (contains x does not include the "outline"
-	Layer *left = NULL;
-	Layer *right = NULL;
-	Layer *top = NULL;
-	Layer *bottom = NULL;
-	if (_frame.containsX(rect.left())) {
-	  if (Display.debug) LOG("splitWithRect:005");
-	  splitVertically(rect.left(), &left, &right);
-
-	  if (Display.debug) {
-		Display.debugLayer(left, true, ILI9341_RED, true);
-		Display.debugLayer(right, true, ILI9341_BLUE, true);
-	  }
-
-	  addSublayer(left);
-	  addSublayer(right);
+//Parts of frame around rect in the order they are cut off, left, right, top and bottom. What is left in the middle is
+//kept as the last part unless the bottom has been cut off or it does not touch rect anymore (empty rects). A frame
+//that is not cut at all is returned as it is
+static int partsAroundRect(Rect frame, Rect &rect, Rect *parts) {
+  int count = 0;
+  if (frame.containsX(rect.left())) {
+	parts[count++] = Rect(frame.x, frame.y, rect.left() - frame.x, frame.height);
+	frame.setLeft(rect.left());
+  }
+  if (frame.intersectsRect(rect) && frame.containsX(rect.right())) {
+	parts[count++] = Rect(rect.right(), frame.y, frame.right() - rect.right(), frame.height);
+	frame.setRight(rect.right());
+  }
+  if (frame.intersectsRect(rect) && frame.containsY(rect.top())) {
+	parts[count++] = Rect(frame.x, frame.y, frame.width, rect.top() - frame.y);
+	frame.setTop(rect.top());
+  }
+  if (frame.intersectsRect(rect) && frame.containsY(rect.bottom())) {
+	parts[count++] = Rect(frame.x, rect.bottom(), frame.width, frame.bottom() - rect.bottom());
+	return count;
+  }
 
-	  if (Display.debug) LOG("splitWithRect:006");
-	  right->splitWithRect(rect);
-	} else if (_frame.containsX(rect.right())) {
-	  if (Display.debug) LOG("splitWithRect:007");
-	  splitVertically(rect.right(), &left, &right);
+  parts[count++] = frame;
+  return count;
+}
 
-	  if (Display.debug) {
-		Display.debugLayer(left, true, ILI9341_RED, true);
-		Display.debugLayer(right, true, ILI9341_BLUE, true);
-	  }
+static Layer *createPart(Layer *layer, Rect frame) {
+  Layer *part = new GapLayer(frame);
+  part->setBackgroundColor(layer->getBackgroundColor());
+  part->setContext(layer->getContext());
+  return part;
+}
 
-	  addSublayer(left);
-	  addSublayer(right);
+void Layer::splitWithRect(Rect &rect) {
+  Rect parts[4];
 
-	  if (Display.debug) LOG("splitWithRect:008");
+  if (isLeaf()) {
+	//This layer is split for the first time, it becomes the parent of its parts
+	if (!_frame.intersectsRect(rect)) return;
 
-	  left->splitWithRect(rect);
-	} else if (_frame.containsY(rect.top())) {
-	  if (Display.debug) LOG("splitWithRect:009");
-	  splitHorizontally(rect.top(), &top, &bottom);
+	int numParts = partsAroundRect(_frame, rect, parts);
+	if (numParts == 1 && parts[0] == _frame) return;
 
-	  if (Display.debug) {
-		Display.debugLayer(top, true, ILI9341_RED, true);
-		Display.debugLayer(bottom, true, ILI9341_BLUE, true);
-	  }
+	for (int i = 0; i < numParts; i++) {
+	  //Out of memory, whatever could not be added is deleted and this part of the layout stays as it is
+	  if (!addSublayer(createPart(this, parts[i]))) return;
+	}
+	return;
+  }
 
-	  addSublayer(top);
-	  addSublayer(bottom);
+  //Sublayers are kept flat, a leaf that is split is replaced by its parts so there are no layers in between that are
+  //never drawn. Parts don't overlap rect, only the sublayers that have been there before have to be looked at
+  int count = _sublayers.count();
+  for (int i = 0; i < count; i++) {
+	Layer *layer = _sublayers.at(i);
+	if (!layer->isLeaf()) {
+	  layer->splitWithRect(rect);
+	  continue;
+	}
 
-	  if (Display.debug) LOG("splitWithRect:010");
-	  bottom->splitWithRect(rect);
-	} else if (_frame.containsY(rect.bottom())) {
-	  if (Display.debug) LOG("splitWithRect:011");
-	  splitHorizontally(rect.bottom(), NULL, &bottom);
+	Rect frame = layer->getFrame();
+	if (!frame.intersectsRect(rect)) continue;
 
-	  if (Display.debug) {
-		Display.debugLayer(bottom, true, ILI9341_RED, true);
-	  }
+	int numParts = partsAroundRect(frame, rect, parts);
+	if (numParts == 1 && parts[0] == frame) continue;
 
-	  addSublayer(bottom);
+	if (Display.debug) {
+	  Display.debugLayer(layer, true, ILI9341_ORANGE, false);
+	  Display.drawRect(rect.x + getOriginX(), rect.y, rect.width, rect.height, ILI9341_GREEN);
+	  Display.waitForTap();
+	}
 
-	  if (Display.debug) LOG("splitWithRect:012");
-	  //top->splitWithRect(rect);
+	//The leaf takes the first part, the others are added
+	layer->setFrame(parts[0], false);
+	for (int part = 1; part < numParts; part++) {
+	  if (!addSublayer(createPart(layer, parts[part]))) return;
 	}
   }
 }
 
 void Layer::display(Layer *backgroundLayer) {
-  if (_sublayers == NULL || _sublayers->count() <= 0) {
+  if (_sublayers.count() <= 0) {
 	Rect renderFrame = getRenderFrame();
 	if (backgroundLayer == NULL) {
 	  //LOG("No comparison layer found, just draw the layer");
@@ -302,9 +286,9 @@ void Layer::display(Layer *backgroundLayer) {
   }
 
   //LOG("Sublayers");
-  for (int i = 0; i < _sublayers->count(); i++) {
+  for (int i = 0; i < _sublayers.count(); i++) {
 	//LOG_VALUE("Drawing sublayer at",i);
-	Layer *layer = _sublayers->at(i);
+	Layer *layer = _sublayers.at(i);
 	layer->display(backgroundLayer);
   }
 }
@@ -312,7 +296,7 @@ void Layer::display(Layer *backgroundLayer) {
 void Layer::invalidateRect(Rect &invalidationRect) {
   if (!isVisible()) return;
 
-  if (_sublayers == NULL || _sublayers->count() <= 0) {
+  if (_sublayers.count() <= 0) {
 	if (_frame.intersectsRect(invalidationRect)) {
 	  //LOG_VALUE("Invalidated Layer:",_frame.toString());
 
@@ -323,33 +307,34 @@ void Layer::invalidateRect(Rect &invalidationRect) {
   }
 
   //LOG("Sublayers");
-  for (int i = 0; i < _sublayers->count(); i++) {
+  for (int i = 0; i < _sublayers.count(); i++) {
 	//LOG_VALUE("Drawing sublayer at",i);
-	Layer *layer = _sublayers->at(i);
+	Layer *layer = _sublayers.at(i);
 	layer->invalidateRect(invalidationRect);
   }
 }
 
-void Layer::addSublayer(Layer *layer) {
-  getSublayers()->push(layer);
+bool Layer::addSublayer(Layer *layer) {
+  if (!_sublayers.push(layer)) {
+	FLOW_ERROR("Layer: Could not add sublayer, out of memory");
+	delete layer;
+	return false;
+  }
+
+  return true;
 }
 
-StackArray<Layer *> *Layer::getSublayers() {
-  if (_sublayers == NULL) {
-	_sublayers = new StackArray<Layer *>();
-  }
-  return _sublayers;
+LayerList *Layer::getSublayers() {
+  return &_sublayers;
 }
 
 void Layer::removeAllSublayers() {
-  if (_sublayers == NULL) return;
-
-  while (_sublayers->count() > 0) {
-	Layer *layer = _sublayers->pop();
+  while (_sublayers.count() > 0) {
+	Layer *layer = _sublayers.pop();
 	delete layer;
   }
 
-  _sublayers->clear();
+  _sublayers.clear();
 }
 
 void Layer::setFrame(Rect frame, bool updateLayout) {
@@ -366,12 +351,10 @@ Rect Layer::prepareRenderFrame(const Rect proposedRenderFrame) {
 }
 
 Layer *Layer::subLayerWithRect(Rect frame) {
-  if (_sublayers == NULL) return NULL;
-
   Layer *foundLayer = NULL;
 
-  for (int i = 0; i < _sublayers->count(); i++) {
-	Layer *layer = _sublayers->at(i);
+  for (int i = 0; i < _sublayers.count(); i++) {
+	Layer *layer = _sublayers.at(i);
 	if (layer->isLeaf()) {
 	  //Check this frame as this is a leaf layer
 	  if (layer->getFrame() == frame) {
@@ -390,9 +373,9 @@ Layer *Layer::subLayerWithRect(Rect frame) {
 
 void Layer::setNeedsDisplay() {
   //LOG_VALUE("NEEDS DISPLAY: ",_name);
-  if (_sublayers != NULL && _sublayers->count() > 0) {
-	for (int i = 0; i < _sublayers->count(); i++) {
-	  Layer *sublayer = _sublayers->at(i);
+  if (_sublayers.count() > 0) {
+	for (int i = 0; i < _sublayers.count(); i++) {
+	  Layer *sublayer = _sublayers.at(i);
 	  sublayer->setNeedsDisplay();
 	}
   }
@@ -403,6 +386,17 @@ void Layer::setNeedsDisplay() {
   Display.setNeedsDisplay();
 }
 
+void Layer::resetNeedsDisplay() {
+  if (_sublayers.count() > 0) {
+	for (int i = 0; i < _sublayers.count(); i++) {
+	  Layer *sublayer = _sublayers.at(i);
+	  sublayer->resetNeedsDisplay();
+	}
+  }
+
+  _needsDisplay = false;
+}
+
 void Layer::draw(Rect &invalidationRect) {
   _needsDisplay = false;
 }
@@ -33,7 +33,11 @@
 #define TEENSYCMAKE_LAYER_H
 
 #include "../core/UIElement.h"
-#include "../core/StackArray.h"
+#include "../core/SmallVector.h"
+#include "../core/MemoryConfig.h"
+
+class Layer;
+typedef SmallVector<Layer *, LAYER_INLINE_SUBLAYERS> LayerList;
 
 class Layer : public UIElement {
 #pragma mark Constructor
@@ -52,7 +56,12 @@ class Layer : public UIElement {
   void setStrokeWidth(const uint8_t strokeWidth);
   uint8_t getStrokeWidth() const;
 
+  //Alpha is applied when the layer is composited offscreen, 256 is opaque
+  void setAlpha(const uint16_t alpha);
+  uint16_t getAlpha() const;
+
 #pragma mark Layout Management
+  //Cuts the leaves under rect into the parts around it, they are kept as direct sublayers of this layer
   void splitWithRect(Rect &rect);
   void splitVertically(int x, Layer **left, Layer **right);
   void splitHorizontally(int y, Layer **top, Layer **bottom);
@@ -60,14 +69,17 @@ class Layer : public UIElement {
   uint16_t getOriginX();
 
 #pragma mark Layer Hierarchy
-  void addSublayer(Layer *layer);
-  StackArray<Layer *> *getSublayers();
+  //Returns false if the layer could not be added, it is deleted then
+  bool addSublayer(Layer *layer);
+  LayerList *getSublayers();
   bool isLeaf();
   void removeAllSublayers();
   virtual Layer *subLayerWithRect(Rect frame);
 
 #pragma mark Draw and Display
   virtual void setNeedsDisplay();
+  bool needsDisplay() const { return _needsDisplay; };
+  void resetNeedsDisplay();
   virtual void draw(Rect &invalidationRect);
   void display(Layer *backgroundLayer = NULL);
   Rect getRenderFrame();
@@ -86,9 +98,10 @@ class Layer : public UIElement {
   uint16_t _backgroundColor;
   uint16_t _strokeColor;
   uint8_t _strokeWidth;
+  uint16_t _alpha;
   bool _needsDisplay;
   int uniqueId;
-  StackArray<Layer *> *_sublayers;
+  LayerList _sublayers;
   bool _visible;
 };
 
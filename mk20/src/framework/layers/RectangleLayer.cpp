@@ -31,6 +31,34 @@
 
 #include "RectangleLayer.h"
 #include "../core/Application.h"
+#include "../core/MemoryPool.h"
+#include "GapLayer.h"
+
+static MemoryPool<sizeof(GapLayer), RECTANGLE_LAYER_POOL_SIZE> rectangleLayerPool;
+
+void *RectangleLayer::operator new(size_t size) {
+  if (size <= sizeof(GapLayer)) {
+	void *pointer = rectangleLayerPool.allocate();
+	if (pointer != NULL) return pointer;
+  }
+
+  //Display buffers outlive scenes, so these are never allocated from the scene arena
+  return malloc(size);
+}
+
+void RectangleLayer::operator delete(void *pointer) {
+  if (rectangleLayerPool.release(pointer)) return;
+
+  free(pointer);
+}
+
+int RectangleLayer::getPoolUsed() {
+  return rectangleLayerPool.getUsed();
+}
+
+int RectangleLayer::getPoolHighWaterMark() {
+  return rectangleLayerPool.getHighWaterMark();
+}
 
 RectangleLayer::RectangleLayer(Rect frame) :
 	Layer(frame) {
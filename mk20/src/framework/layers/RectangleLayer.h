@@ -33,6 +33,7 @@
 #define TEENSYCMAKE_RECTANGLELAYER_H
 
 #include "Layer.h"
+#include "../core/MemoryConfig.h"
 
 class RectangleLayer : public Layer {
 #pragma mark Constructor
@@ -40,6 +41,12 @@ class RectangleLayer : public Layer {
   RectangleLayer(Rect frame);
   virtual ~RectangleLayer();
 
+  //Gap layers are created and deleted with every relayout, they are kept in a pool to not fragment the heap
+  static void *operator new(size_t size);
+  static void operator delete(void *pointer);
+  static int getPoolUsed();
+  static int getPoolHighWaterMark();
+
 #pragma mark Layer
   virtual void draw(Rect &invalidationRect) override;
 };
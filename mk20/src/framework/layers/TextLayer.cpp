@@ -33,16 +33,35 @@
 #include "TextLayer.h"
 #include "../core/Application.h"
 
+TextLayer::TextLayer() :
+	_metricsValid(false),
+	_multiline(false),
+	_textWidth(0),
+	_glyphOffsets(NULL),
+	_glyphOffsetsSize(0) {
+}
+
 TextLayer::TextLayer(Rect frame) :
 	Layer(frame),
 	_textAlign(TEXTALIGN_LEFT),
 	_verticalTextAlign(TEXTALIGN_CENTERED),
-	_padding(0) {
+	_padding(0),
+	_metricsValid(false),
+	_multiline(false),
+	_textWidth(0),
+	_glyphOffsets(NULL),
+	_glyphOffsetsSize(0) {
   _backgroundColor = Application.getTheme()->getColor(BackgroundColor);
   _foregroundColor = Application.getTheme()->getColor(TextColor);
   _font = (ILI9341_t3_font_t * ) & PTSansNarrow_20;
 }
 
+TextLayer::~TextLayer() {
+  if (_glyphOffsets != NULL) {
+	delete[] _glyphOffsets;
+  }
+}
+
 void TextLayer::setTextAlign(uint8_t textAlign) {
   if (_textAlign == textAlign) return;
   _textAlign = textAlign;
@@ -97,11 +116,11 @@ void TextLayer::draw(Rect &invalidationRect) {
   frame.width -= 2;
 
   if (_textAlign == TEXTALIGN_CENTERED) {
-	uint32_t width = Display.textWidth(_font, _text);
+	uint32_t width = getTextWidth();
 	frame.x += (frame.width - width) / 2;
 	frame.width = width;
   } else if (_textAlign == TEXTALIGN_RIGHT) {
-	uint32_t width = Display.textWidth(_font, _text);
+	uint32_t width = getTextWidth();
 	frame.x += (frame.width - width);
 	frame.width = width;
   }
@@ -135,8 +154,7 @@ void TextLayer::draw(Rect &invalidationRect) {
   Display.setFont(*_font);
   Display.setTextColor(_foregroundColor, _backgroundColor);
   Display.setTransparentText(false);
-  Display.setCursor(frame.x, frame.y);
-  Display.print(_text);
+  printVisibleText(frame, renderFrame);
 
   //Fill the rest of the text layer
   Display.fillRect(Display.getCursorX(), frame.top(),
@@ -147,5 +165,75 @@ void TextLayer::draw(Rect &invalidationRect) {
 
 void TextLayer::setText(const String &text) {
   _text = text;
+  invalidateMetrics();
   setNeedsDisplay();
+}
+
+void TextLayer::setFont(const ILI9341_t3_font_t *font) {
+  if (_font == font) return;
+  _font = font;
+  invalidateMetrics();
+}
+
+uint16_t TextLayer::getTextWidth() {
+  updateMetrics();
+  return _textWidth;
+}
+
+void TextLayer::updateMetrics() {
+  if (_metricsValid) return;
+
+  unsigned int length = _text.length();
+  if (_glyphOffsetsSize < length + 1) {
+	if (_glyphOffsets != NULL) {
+	  delete[] _glyphOffsets;
+	}
+	_glyphOffsetsSize = length + 1;
+	_glyphOffsets = new uint16_t[_glyphOffsetsSize];
+  }
+
+  //Same measurement as ILI9341_t3::textWidth, but advances come from the glyph cache
+  GlyphCache *glyphCache = Display.getGlyphCache();
+  uint16_t x = 0;
+  _textWidth = 0;
+  _multiline = false;
+  for (unsigned int i = 0; i < length; i++) {
+	_glyphOffsets[i] = x;
+	char c = _text.charAt(i);
+	if (c == '\n') {
+	  _multiline = true;
+	  if (x > _textWidth) _textWidth = x;
+	  x = 0;
+	  continue;
+	}
+
+	const Glyph *glyph = glyphCache->glyph(_font, c);
+	x += glyph != NULL ? glyph->delta : Display.widthOfChar(_font, c);
+  }
+  _glyphOffsets[length] = x;
+  if (x > _textWidth) _textWidth = x;
+
+  _metricsValid = true;
+}
+
+void TextLayer::printVisibleText(Rect &frame, Rect &renderFrame) {
+  updateMetrics();
+
+  unsigned int first = 0;
+  unsigned int last = _text.length();
+  if (!_multiline) {
+	//Skip characters completely left or right of the render frame. One more on each side is kept as glyphs
+	//may overhang their advance
+	int left = renderFrame.left() - frame.x;
+	int right = renderFrame.right() - frame.x;
+	while (first < last && _glyphOffsets[first + 1] <= left) first++;
+	while (last > first && _glyphOffsets[last - 1] >= right) last--;
+	if (first > 0) first--;
+	if (last < _text.length()) last++;
+  }
+
+  Display.setCursor(frame.x + _glyphOffsets[first], frame.y);
+  for (unsigned int i = first; i < last; i++) {
+	Display.write(_text.charAt(i));
+  }
 }
\ No newline at end of file
@@ -45,16 +45,16 @@
 class TextLayer : public Layer {
 #pragma mark Constructor
  public:
-  TextLayer() {};
+  TextLayer();
   TextLayer(Rect frame);
-  virtual ~TextLayer() {};
+  virtual ~TextLayer();
 
 #pragma mark Layer
   virtual void draw(Rect &invalidationRect) override;
 
 #pragma mark Getter/Setter
   const ILI9341_t3_font_t *getFont() { return _font; }
-  void setFont(const ILI9341_t3_font_t *_font) { TextLayer::_font = _font; }
+  void setFont(const ILI9341_t3_font_t *font);
   uint16_t getForegroundColor() const { return _foregroundColor; }
   void setForegroundColor(uint16_t _foregroundColor) { TextLayer::_foregroundColor = _foregroundColor; }
   uint16_t getBackgroundColor() const { return _backgroundColor; }
@@ -68,6 +68,16 @@ class TextLayer : public Layer {
   uint8_t getPadding() const { return _padding; }
   void setPadding(uint8_t _padding) { TextLayer::_padding = _padding; }
 
+#pragma mark Text Metrics
+  //Width of the longest line, cached until text or font change
+  uint16_t getTextWidth();
+
+ protected:
+  void invalidateMetrics() { _metricsValid = false; };
+  void updateMetrics();
+  //Prints the characters of the text that may touch renderFrame, frame and renderFrame are in screen space
+  void printVisibleText(Rect &frame, Rect &renderFrame);
+
 #pragma mark Member Variables
  private:
   uint8_t _padding;
@@ -78,6 +88,11 @@ class TextLayer : public Layer {
   String _text;
   uint8_t _textAlign;
   uint8_t _verticalTextAlign;
+  bool _metricsValid;
+  bool _multiline;
+  uint16_t _textWidth;
+  uint16_t *_glyphOffsets;     //X offset of each character from the text origin, one more entry for the end
+  uint16_t _glyphOffsetsSize;
 };
 
 #endif //TEENSYCMAKE_TEXTLAYER_H
@@ -63,11 +63,11 @@ void TransparentTextLayer::draw(Rect &invalidationRect) {
   frame.width -= 2;
 
   if (_textAlign == TEXTALIGN_CENTERED) {
-	uint32_t width = Display.textWidth(_font, _text);
+	uint32_t width = getTextWidth();
 	frame.x += (frame.width - width) / 2;
 	frame.width = width;
   } else if (_textAlign == TEXTALIGN_RIGHT) {
-	uint32_t width = Display.textWidth(_font, _text);
+	uint32_t width = getTextWidth();
 	frame.x += (frame.width - width);
 	frame.width = width;
   }
@@ -81,8 +81,7 @@ void TransparentTextLayer::draw(Rect &invalidationRect) {
   Display.setFont(*_font);
   Display.setTextColor(_foregroundColor, _backgroundColor);
   Display.setTransparentText(true);
-  Display.setCursor(frame.x, frame.y);
-  Display.print(_text);
+  printVisibleText(frame, renderFrame);
 
   Display.resetClippingRect();
 }
\ No newline at end of file
@@ -75,15 +75,15 @@ void VerticalTextLayer::draw(Rect &invalidationRect) {
   frame.height -= getPadding() * 2;
 
   if (getTextAlign() == TEXTALIGN_CENTERED) {
-	uint32_t width = Display.textWidth(getFont(), getText());
+	uint32_t width = getTextWidth();
 	frame.y += (frame.height - width) / 2;
 	frame.height = width;
   } else if (getTextAlign() == TEXTALIGN_LEFT) {
-	uint32_t width = Display.textWidth(getFont(), getText());
+	uint32_t width = getTextWidth();
 	frame.y += (frame.height - width);
 	frame.height = width;
   } else if (getTextAlign() == TEXTALIGN_RIGHT) {
-	uint32_t width = Display.textWidth(getFont(), getText());
+	uint32_t width = getTextWidth();
 	frame.height = width;
   }
 
@@ -158,7 +158,10 @@ void View::display() {
 void View::addLayer(Layer *layer) {
   layer->setContext(getContext());
   layer->setVisible(isVisible());
-  _layers.push(layer);
+  if (!_layers.push(layer)) {
+	//The view keeps using the layer, it is not shown
+	FLOW_ERROR("View: Could not add layer, out of memory");
+  }
 }
 
 void View::setFrame(Rect frame, bool updateLayout) {
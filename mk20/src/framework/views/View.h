@@ -38,7 +38,7 @@
 #include "../../framework/animation/Animation.h"
 #include "../../framework/core/Object.h"
 #include "../../framework/core/UIElement.h"
-#include "../../framework/core/StackArray.h"
+#include "../../framework/core/SmallVector.h"
 #include "../../framework/layers/Layer.h"
 
 #define MINX 0
@@ -53,7 +53,7 @@ class View : public UIElement, public AnimatableObject, Object {
  public:
   virtual void setContext(const DisplayContext context) override;
 
-  ~View();
+  virtual ~View();
   View(int x, int y, int width, int height);
   View(Rect frame);
 
@@ -110,7 +110,7 @@ class View : public UIElement, public AnimatableObject, Object {
   uint16_t _borderColor;
   uint8_t _borderWidth;
   bool _needsDisplay;
-  StackArray<Layer *> _layers;
+  LayerList _layers;
   bool _userInteractionEnabled;
 };
 
@@ -1,6 +1,6 @@
 /*
  * Background job that handles receiving data via CommStack and writes them to the
- * SD card. Supports run length encoding for faster data transmission
+ * SD card. Supports run length encoding and LZ compression for faster data transmission
  *
  * Copyright (c) 2016 Printrbot Inc.
  * Author: Phillip Schuster
@@ -36,14 +36,25 @@ ReceiveSDCardFile::ReceiveSDCardFile(String localFilePath, size_t fileSize, Comp
 	_compression(compression),
 	_fileSize(fileSize),
 	_bytesLeft(fileSize),
-	_localFilePath(localFilePath) {
+	_bytesSinceSync(0),
+	_localFilePath(localFilePath),
+	_lzDecoder(NULL) {
 
+  //The decoder keeps a 2 KB history window, only allocate it for LZ transfers
+  if (_compression == Compression::LZ) {
+	_lzDecoder = new LZDecoder();
+  }
 }
 
 ReceiveSDCardFile::~ReceiveSDCardFile() {
   if (_localFile) {
 	_localFile.close();
   }
+
+  if (_lzDecoder != NULL) {
+	delete _lzDecoder;
+	_lzDecoder = NULL;
+  }
 }
 
 void ReceiveSDCardFile::onWillStart() {
@@ -53,6 +64,13 @@ void ReceiveSDCardFile::onWillStart() {
 	exit();
   } else {
 	FLOW_NOTICE("ReceiveSDCardFile: Opened file for writing: %s", _localFilePath.c_str());
+
+	//Uncompressed transfers know their final size, reserve it in one contiguous run so chunks are written without FAT updates
+	if (_compression == Compression::None && _fileSize > 0) {
+	  if (!_localFile.preallocate(_fileSize)) {
+		FLOW_NOTICE("ReceiveSDCardFile: Could not preallocate %d bytes, writing unreserved", _fileSize);
+	  }
+	}
   }
 }
 
@@ -83,12 +101,22 @@ float ReceiveSDCardFile::fractionCompleted() {
 bool ReceiveSDCardFile::writeToFile(const uint8_t *data, size_t size) {
   int numBytesWritten = _localFile.write(data, size);
   _bytesLeft -= numBytesWritten;
+  checkpoint(numBytesWritten);
 
   COMMSTACK_SPAM("ReceiveSDCardFile: Writing data to file, bytes left: %d", _bytesLeft);
 
   return true;
 }
 
+void ReceiveSDCardFile::checkpoint(size_t numBytesWritten) {
+  //Checkpoint the directory entry every now and then, everything else is synced on close
+  _bytesSinceSync += numBytesWritten;
+  if (_bytesSinceSync >= FILE_SYNC_INTERVAL) {
+	_localFile.flush();
+	_bytesSinceSync = 0;
+  }
+}
+
 bool ReceiveSDCardFile::RLE16Deflate(const uint8_t *data, size_t size) {
   //Make sure size is dividable by 3 as run length encoding 16 bit consists of 24 bit chunks
   if (size % 3 != 0) {
@@ -125,11 +153,46 @@ bool ReceiveSDCardFile::RLE16Deflate(const uint8_t *data, size_t size) {
   return true;
 }
 
+bool ReceiveSDCardFile::LZInflate(const uint8_t *data, size_t size) {
+  uint8_t buffer[256];
+  size_t offset = 0;
+
+  //The decoder keeps its state between packets, a match may continue in the next packet
+  while (true) {
+	size_t consumed;
+	size_t numBytesDecoded = _lzDecoder->decode(&data[offset], size - offset, &consumed, buffer, sizeof(buffer));
+	offset += consumed;
+
+	if (_lzDecoder->hasError()) {
+	  FLOW_ERROR("ReceiveSDCardFile: LZ data is corrupt or has no header");
+	  return false;
+	}
+
+	//Nothing decoded means all input has been consumed
+	if (numBytesDecoded == 0) {
+	  break;
+	}
+
+	size_t numBytesWritten = _localFile.write(buffer, numBytesDecoded);
+	if (numBytesWritten != numBytesDecoded) {
+	  return false;
+	}
+	checkpoint(numBytesWritten);
+
+	COMMSTACK_SPAM("ReceiveSDCardFile: Decompressed %d bytes and writing them to the file", numBytesDecoded);
+  }
+  _bytesLeft -= size;
+
+  return true;
+}
+
 bool ReceiveSDCardFile::onDataReceived(const uint8_t *data, size_t size) {
   if (_compression == Compression::None) {
 	return writeToFile(data, size);
   } else if (_compression == Compression::RLE16) {
 	return RLE16Deflate(data, size);
+  } else if (_compression == Compression::LZ) {
+	return LZInflate(data, size);
   }
 
   return true;
@@ -157,14 +220,28 @@ bool ReceiveSDCardFile::runTask(CommHeader &header, const uint8_t *data, size_t
 	}
   } else if (header.getCurrentTask() == TaskID::FileClose) {
 	if (header.commType == Request) {
-	  FLOW_NOTICE("ReceiveSDCardFile: Closed file: %s", _localFilePath.c_str());
 	  //Close local file
 	  _localFile.close();
-	  //Don't send a response
-	  *sendResponse = false;
+
+	  //A single data byte set to 1 asks us to discard the file, i.e. the transfer has been aborted
+	  bool discard = (dataSize >= 1 && data[0] == 1);
+	  bool incomplete = (_compression == Compression::None && _fileSize > 0 && _bytesLeft > 0);
+	  if (discard || incomplete) {
+		FLOW_NOTICE("ReceiveSDCardFile: Transfer aborted or incomplete, removing file: %s", _localFilePath.c_str());
+		SD.remove(_localFilePath.c_str());
+	  } else {
+		FLOW_NOTICE("ReceiveSDCardFile: Closed file: %s", _localFilePath.c_str());
+	  }
+
+	  //Let ESP know if the file has been stored completely
+	  *sendResponse = true;
+	  *responseDataSize = 0;
+	  *success = !(discard || incomplete);
 
 	  //Exit this job, we are done
 	  exit();
 	}
   }
+
+  return true;
 }
\ No newline at end of file
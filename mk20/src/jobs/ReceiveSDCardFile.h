@@ -1,6 +1,6 @@
 /*
  * Background job that handles receiving data via CommStack and writes them to the
- * SD card. Supports run length encoding for faster data transmission
+ * SD card. Supports run length encoding and LZ compression for faster data transmission
  *
  * Copyright (c) 2016 Printrbot Inc.
  * Author: Phillip Schuster
@@ -32,6 +32,7 @@
 
 #include "../framework/core/BackgroundJob.h"
 #include "SD.h"
+#include "../framework/core/LZDecoder.h"
 
 class ReceiveSDCardFile : public BackgroundJob {
  public:
@@ -39,6 +40,7 @@ class ReceiveSDCardFile : public BackgroundJob {
   ~ReceiveSDCardFile();
 
   virtual bool RLE16Deflate(const uint8_t *data, size_t size);
+  virtual bool LZInflate(const uint8_t *data, size_t size);
   virtual bool writeToFile(const uint8_t *data, size_t size);
   virtual bool onDataReceived(const uint8_t *data, size_t size);
 
@@ -54,7 +56,11 @@ class ReceiveSDCardFile : public BackgroundJob {
   Compression _compression;
   size_t _fileSize;
   size_t _bytesLeft;
+  size_t _bytesSinceSync;
   String _localFilePath;
+  LZDecoder *_lzDecoder;
+
+  void checkpoint(size_t numBytesWritten);
 };
 
 #endif //MK20_RECEIVESDCARDFILE_H
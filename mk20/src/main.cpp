@@ -8,6 +8,7 @@
 #include "scenes/projects/ProjectsScene.h"
 
 #include "framework/core/HAL.h"
+#include "framework/core/TouchQueue.h"
 #include "UIBitmaps.h"
 #include "Printr.h"
 ///#include "Bitmaps.h"
@@ -150,6 +151,9 @@ void setup(void)
     }
     LOG("Capacitive touchscreen started");
 
+    //Sample touches driven by the controllers INT line instead of polling it over I2C
+    TouchQueue.begin(TFT_TOUCH_SENSE_PIN);
+
     //Display.fillScreen(ILI9341_BLACK);
 
     //testFont();
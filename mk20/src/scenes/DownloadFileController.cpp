@@ -53,10 +53,14 @@ DownloadFileController::DownloadFileController(String url, String fileName) :
 	SidebarSceneController::SidebarSceneController(),
 	_fileSize(0),
 	_bytesRead(0),
+	_bytesSinceSync(0),
 	_previousPercent(0),
 	_url(url),
 	_fileName(fileName),
-	_nextScene(NextScene::NewProject) {
+	_nextScene(NextScene::NewProject),
+	_cacheKey(0),
+	_resumeOffset(0),
+	_validatingCache(false) {
   _localFilePath = String(IndexDb::projectFolderName) + fileName;
 }
 
@@ -64,9 +68,13 @@ DownloadFileController::DownloadFileController(String url) :
 	SidebarSceneController::SidebarSceneController(),
 	_fileSize(0),
 	_bytesRead(0),
+	_bytesSinceSync(0),
 	_previousPercent(0),
 	_url(url),
-	_nextScene(NextScene::Materials) {
+	_nextScene(NextScene::Materials),
+	_cacheKey(0),
+	_resumeOffset(0),
+	_validatingCache(false) {
   _localFilePath = String("matlib");
 }
 
@@ -75,13 +83,17 @@ DownloadFileController::DownloadFileController(String url, String localFilePath,
 	SidebarSceneController::SidebarSceneController(),
 	_fileSize(0),
 	_bytesRead(0),
+	_bytesSinceSync(0),
 	_previousPercent(0),
 	_localFilePath(localFilePath),
 	_url(url),
 	_jobFilePath(jobFilePath),
 	_project(project),
 	_job(job),
-	_nextScene(NextScene::StartPrint) {
+	_nextScene(NextScene::StartPrint),
+	_cacheKey(JobCache::keyForUrl(job.url)),
+	_resumeOffset(0),
+	_validatingCache(false) {
 
 }
 
@@ -89,12 +101,22 @@ DownloadFileController::DownloadFileController() :
 	SidebarSceneController::SidebarSceneController(),
 	_fileSize(0),
 	_bytesRead(0),
-	_previousPercent(0) {
+	_bytesSinceSync(0),
+	_previousPercent(0),
+	_cacheKey(0),
+	_resumeOffset(0),
+	_validatingCache(false) {
 
 }
 
 DownloadFileController::~DownloadFileController() {
-
+  //If the download failed we keep the partial file. The file is still open if ESP gave up before FileClose, record
+  //everything we received so ESP continues with the next byte instead of the last checkpoint
+  if (_file) {
+	_file.flush();
+	writeSidecar();
+	_file.close();
+  }
 }
 
 uint16_t DownloadFileController::getBackgroundColor() {
@@ -135,9 +157,19 @@ void DownloadFileController::onWillAppear() {
   _progressBar->setValue(0.0f);
   addView(_progressBar);
 
-  //Trigger file download
+  //Trigger file download. If we have a partial or cached job file we append a zero terminator, the number of bytes we
+  //already have and the ETag to the URL so ESP continues the download with a range request
   const char *url = _url.c_str();
-  Application.getESPStack()->requestTask(TaskID::DownloadFile, strlen(url), (uint8_t *) url);
+  if (_nextScene == NextScene::StartPrint && (loadSidecar() || loadCachedJob())) {
+	size_t urlLength = strlen(url);
+	uint8_t request[urlLength + 1 + sizeof(uint32_t) + _etag.length()];
+	memcpy(request, url, urlLength + 1);
+	memcpy(&request[urlLength + 1], &_resumeOffset, sizeof(uint32_t));
+	memcpy(&request[urlLength + 1 + sizeof(uint32_t)], _etag.c_str(), _etag.length());
+	Application.getESPStack()->requestTask(TaskID::DownloadFile, sizeof(request), request);
+  } else {
+	Application.getESPStack()->requestTask(TaskID::DownloadFile, strlen(url), (uint8_t *) url);
+  }
 
   SidebarSceneController::onWillAppear();
 }
@@ -146,9 +178,12 @@ void DownloadFileController::onSidebarButtonTouchUp() {
   //Send cancel download message to ESP to stop download
   Application.getESPStack()->requestTask(TaskID::CancelDownload);
 
-  //Close file and remove download fragments
+  //Close file and remove download fragments, a cached job that is being checked stays in the cache
   _file.close();
-  SD.remove(_localFilePath.c_str());
+  if (!_validatingCache) {
+	SD.remove(_localFilePath.c_str());
+	removeSidecar();
+  }
 
   ProjectsScene *scene = new ProjectsScene();
   Application.pushScene(scene);
@@ -165,6 +200,8 @@ bool DownloadFileController::handlesTask(TaskID taskID) {
 	case TaskID::Error:
 	case TaskID::DownloadFile:return true;
 	  break;
+	case TaskID::DownloadError:return _validatingCache;
+	  break;
 	default:return false;
   }
 }
@@ -184,7 +221,7 @@ bool DownloadFileController::runTask(CommHeader &header, const uint8_t *data, si
 	LOG("Handling GetJobWithID Task");
 
 	if (header.commType == ResponseSuccess) {
-	  if (dataSize != sizeof(uint32_t)) {
+	  if (dataSize < sizeof(uint32_t)) {
 		LOG_VALUE("Expected content of GetJobWithID to be uint32_t with the number of bytes to receive, but received a content length of", *responseDataSize);
 	  } else {
 		uint32_t contentLength;
@@ -192,18 +229,62 @@ bool DownloadFileController::runTask(CommHeader &header, const uint8_t *data, si
 		_fileSize = contentLength;
 		_bytesRead = 0;
 
+		//Newer ESP firmware sends the offset of the first byte and the ETag of the file
+		uint32_t offset = 0;
+		_etag = "";
+		if (dataSize >= 2 * sizeof(uint32_t)) {
+		  memcpy(&offset, data + sizeof(uint32_t), sizeof(uint32_t));
+		  size_t etagLength = dataSize - 2 * sizeof(uint32_t);
+		  if (etagLength <= DOWNLOAD_MAX_ETAG_LENGTH) {
+			char etag[etagLength + 1];
+			memcpy(etag, data + 2 * sizeof(uint32_t), etagLength);
+			etag[etagLength] = 0;
+			_etag = String(etag);
+		  }
+		}
+
 		LOG_VALUE("Expected file size of", _fileSize);
 
-		//Open a file on SD card
-		//char * fp[_localFilePath.length() + 1];
-		//_localFilePath.toCharArray(fp, _localFilePath.length());
-		//SD.remove(fp);
-		_file = SD.open(_localFilePath.c_str(), O_WRITE | O_CREAT | O_TRUNC);
-		if (!_file.available()) {
-		  //TODO: We should handle that. For now we will have to read data from ESP to clean the pipe but there should be better ways to handle errors
-		  //Application.getESPStack()->requestTask(Error);
-		  //return false;
+		if (offset > 0 && offset == _resumeOffset && _validatingCache && offset == _fileSize) {
+		  //The cached job is unchanged, ESP closes the file right away
+		  LOG_VALUE("Cached job is up to date, size", _fileSize);
+		  _bytesRead = offset;
+		} else if (offset > 0 && offset == _resumeOffset) {
+		  //Server accepted the range request, append to the partial file. Space has been reserved in the job cache
+		  //when the download started
+		  LOG_VALUE("Continuing download at", offset);
+		  _file = SD.open(_localFilePath.c_str(), O_WRITE);
+		  _file.seek(offset);
+		  _bytesRead = offset;
+		} else {
+		  //Make room in the job cache, this drops least recently used jobs (and the cached job if it changed)
+		  _validatingCache = false;
+		  if (_nextScene == NextScene::StartPrint) {
+			removeSidecar();
+			JobCache *jobCache = new JobCache();
+			if (!jobCache->reserve(_cacheKey, _fileSize)) {
+			  LOG_VALUE("Job does not fit into the job cache", _fileSize);
+			}
+			delete jobCache;
+		  }
+
+		  //Open a file on SD card
+		  //char * fp[_localFilePath.length() + 1];
+		  //_localFilePath.toCharArray(fp, _localFilePath.length());
+		  //SD.remove(fp);
+		  _file = SD.open(_localFilePath.c_str(), O_WRITE | O_CREAT | O_TRUNC);
+		  if (!_file.available()) {
+			//TODO: We should handle that. For now we will have to read data from ESP to clean the pipe but there should be better ways to handle errors
+			//Application.getESPStack()->requestTask(Error);
+			//return false;
+		  }
+
+		  //Reserve the whole file in one contiguous run so chunks are written without FAT updates
+		  if (!_file.preallocate(_fileSize)) {
+			LOG("Could not preallocate file, writing unreserved");
+		  }
 		}
+		_bytesSinceSync = 0;
 
 		LOG("File opened for writing. Now waiting for number of bytes to read");
 		LOG("Now Expecting file chunks with FileSaveData tasks");
@@ -226,6 +307,14 @@ bool DownloadFileController::runTask(CommHeader &header, const uint8_t *data, si
 	  //Add number of bytes received to total bytes read
 	  _bytesRead += dataSize;
 
+	  //Checkpoint the directory entry every now and then, everything else is synced on close
+	  _bytesSinceSync += dataSize;
+	  if (_bytesSinceSync >= FILE_SYNC_INTERVAL) {
+		_file.flush();
+		writeSidecar();
+		_bytesSinceSync = 0;
+	  }
+
 	  float fraction = (float) _bytesRead / (float) _fileSize;
 	  int percent = (int) (fraction * 100.0f);
 
@@ -242,6 +331,16 @@ bool DownloadFileController::runTask(CommHeader &header, const uint8_t *data, si
 	_file.close();
 
 	if (_nextScene == NextScene::StartPrint) {
+	  //Only complete downloads become cache entries, the size is verified before each print
+	  JobCache *jobCache = new JobCache();
+	  if (_bytesRead == _fileSize) {
+		jobCache->add(_cacheKey, _fileSize, _etag);
+		removeSidecar();
+	  } else {
+		LOG_VALUE("Download incomplete, bytes read", _bytesRead);
+	  }
+	  delete jobCache;
+
 	  PrintStatusScene *scene = new PrintStatusScene(_jobFilePath, _project, _job);
 	  Application.pushScene(scene);
 	}
@@ -261,6 +360,14 @@ bool DownloadFileController::runTask(CommHeader &header, const uint8_t *data, si
 	  MaterialsScene *scene = new MaterialsScene();
 	  Application.pushScene(scene);
 	}
+  } else if (header.getCurrentTask() == TaskID::DownloadError) {
+	//The cached job could not be checked with the server (i.e. we are offline), print it anyway
+	LOG("Could not check cached job, printing cached file");
+	*sendResponse = false;
+	_validatingCache = false;
+
+	PrintStatusScene *scene = new PrintStatusScene(_jobFilePath, _project, _job);
+	Application.pushScene(scene);
   } else if (header.getCurrentTask() == TaskID::SaveProjectWithID) {
 	char _fp[header.contentLength + 1];
 	memset(_fp, 0, header.contentLength + 1);
@@ -281,6 +388,80 @@ bool DownloadFileController::runTask(CommHeader &header, const uint8_t *data, si
   return true;
 }
 
+#pragma mark Resuming downloads
+
+bool DownloadFileController::loadSidecar() {
+  String sidecarFilePath = getSidecarFilePath();
+  if (!SD.exists(sidecarFilePath.c_str()) || !SD.exists(_localFilePath.c_str())) {
+	return false;
+  }
+
+  DownloadSidecar sidecar;
+  File file = SD.open(sidecarFilePath.c_str(), FILE_READ);
+  int size = file.read(&sidecar, sizeof(DownloadSidecar));
+  file.close();
+
+  //Data is appended, so the partial file must hold exactly the bytes recorded in the sidecar
+  File partialFile = SD.open(_localFilePath.c_str(), FILE_READ);
+  uint32_t partialSize = partialFile.size();
+  partialFile.close();
+
+  sidecar.etag[DOWNLOAD_MAX_ETAG_LENGTH] = 0;
+  if (size != sizeof(DownloadSidecar) || sidecar.validBytes == 0 || sidecar.validBytes > partialSize
+	  || strlen(sidecar.etag) == 0) {
+	LOG("Discarding partial download");
+	removeSidecar();
+	return false;
+  }
+
+  LOG_VALUE("Found partial download with bytes", sidecar.validBytes);
+  _resumeOffset = sidecar.validBytes;
+  _etag = String(sidecar.etag);
+  return true;
+}
+
+bool DownloadFileController::loadCachedJob() {
+  //A cached job is checked before it's printed. ESP asks for the bytes after its end if the ETag still matches, so an
+  //unchanged job takes a single request while a changed one is downloaded again
+  JobCache *jobCache = new JobCache();
+  JobCacheEntry entry;
+  bool cached = jobCache->getEntry(_cacheKey, &entry) && _localFilePath == JobCache::getFilePath(_cacheKey);
+  delete jobCache;
+
+  if (!cached || entry.size == 0 || strlen(entry.etag) == 0) {
+	return false;
+  }
+
+  LOG_VALUE("Checking cached job with ETag", entry.etag);
+  _resumeOffset = entry.size;
+  _etag = String(entry.etag);
+  _validatingCache = true;
+  return true;
+}
+
+void DownloadFileController::writeSidecar() {
+  //Without an ETag ESP can't tell if the file on the server changed, so we don't resume these downloads
+  if (_nextScene != NextScene::StartPrint || _etag.length() == 0) {
+	return;
+  }
+
+  DownloadSidecar sidecar;
+  memset(&sidecar, 0, sizeof(DownloadSidecar));
+  sidecar.validBytes = _bytesRead;
+  strncpy(sidecar.etag, _etag.c_str(), DOWNLOAD_MAX_ETAG_LENGTH);
+
+  File file = SD.open(getSidecarFilePath().c_str(), O_WRITE | O_CREAT | O_TRUNC);
+  file.write((const uint8_t *) &sidecar, sizeof(DownloadSidecar));
+  file.close();
+}
+
+void DownloadFileController::removeSidecar() {
+  String sidecarFilePath = getSidecarFilePath();
+  if (SD.exists(sidecarFilePath.c_str())) {
+	SD.remove(sidecarFilePath.c_str());
+  }
+}
+
 #pragma mark ButtonDelegate Implementation
 
 void DownloadFileController::buttonPressed(void *button) {
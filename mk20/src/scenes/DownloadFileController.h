@@ -39,6 +39,17 @@
 #include "framework/views/ProgressBar.h"
 #include "projects/ProjectsScene.h"
 #include "projects/JobsScene.h"
+#include "projects/JobCache.h"
+
+//Partial job downloads are kept together with a sidecar file (file path + extension) recording the number of bytes
+//written to SD card and the ETag of the file on the server so the download can be continued later
+#define DOWNLOAD_SIDECAR_EXTENSION ".PRT"
+#define DOWNLOAD_MAX_ETAG_LENGTH JOB_CACHE_MAX_ETAG_LENGTH
+
+typedef struct DownloadSidecar {
+  uint32_t validBytes;
+  char etag[DOWNLOAD_MAX_ETAG_LENGTH + 1];
+};
 
 typedef enum NextScene {
   StartPrint = 0,
@@ -72,12 +83,19 @@ class DownloadFileController : public SidebarSceneController {
 
   virtual void buttonPressed(void *button) override;
 
+  bool loadSidecar();
+  bool loadCachedJob();
+  void writeSidecar();
+  void removeSidecar();
+  String getSidecarFilePath() { return _localFilePath + DOWNLOAD_SIDECAR_EXTENSION; };
+
  protected:
   ProgressBar *_progressBar;
   File _file;
   uint32_t _fileSize;
   String _fileName;
   uint32_t _bytesRead;
+  uint32_t _bytesSinceSync;
   int _previousPercent;
   String _url;
   String _localFilePath;
@@ -85,6 +103,10 @@ class DownloadFileController : public SidebarSceneController {
   String _jobFilePath;
   Project _project;
   Job _job;
+  uint32_t _cacheKey;
+  uint32_t _resumeOffset;
+  String _etag;
+  bool _validatingCache;
 };
 
 #endif //TEENSY_PAUSEPRINTSCENECONTROLLER_H
@@ -0,0 +1,213 @@
+/*
+ * Content addressed cache for downloaded job files. Files are stored under a key
+ * derived from the job's download URL, so the same G-code referenced by several
+ * projects is downloaded only once. A compact manifest on SD tracks size and last
+ * use of each entry, least recently used entries are evicted to keep the cache
+ * within its size budget
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "JobCache.h"
+#include "framework/core/Application.h"
+
+JobCache::JobCache() {
+  if (!SD.exists(cacheFolderName)) {
+	SD.mkdir(cacheFolderName);
+  }
+
+  _manifestFile = SD.open(manifestFileName, O_RDWR | O_CREAT);
+
+  //Opening for write positions at the end of the file, the header is at the start
+  _manifestFile.seek(0);
+  if (_manifestFile.read(&_info, sizeof(JobCacheInfo)) != sizeof(JobCacheInfo) || _info.rev != JOB_CACHE_REV) {
+	//New or unknown manifest, start over. Files without an entry are overwritten when downloaded again
+	_info.rev = JOB_CACHE_REV;
+	_info.reserved = 0;
+	_info.entries = 0;
+	_info.clock = 0;
+	writeInfo();
+  }
+}
+
+JobCache::~JobCache() {
+  _manifestFile.close();
+}
+
+uint32_t JobCache::keyForUrl(const char *url) {
+  //32 bit FNV-1a, the hex representation fits in an 8.3 file name
+  uint32_t hash = 2166136261UL;
+  while (*url) {
+	hash ^= (uint8_t) *url++;
+	hash *= 16777619UL;
+  }
+  return hash;
+}
+
+String JobCache::getFilePath(uint32_t key) {
+  char fileName[9];
+  sprintf(fileName, "%08lX", (unsigned long) key);
+  return String(cacheFolderName) + "/" + fileName;
+}
+
+void JobCache::readEntry(uint16_t index, JobCacheEntry *entry) {
+  _manifestFile.seek(sizeof(JobCacheInfo) + index * sizeof(JobCacheEntry));
+  _manifestFile.read(entry, sizeof(JobCacheEntry));
+}
+
+void JobCache::writeEntry(uint16_t index, JobCacheEntry *entry) {
+  _manifestFile.seek(sizeof(JobCacheInfo) + index * sizeof(JobCacheEntry));
+  _manifestFile.write((uint8_t *) entry, sizeof(JobCacheEntry));
+  _manifestFile.flush();
+}
+
+void JobCache::writeInfo() {
+  _manifestFile.seek(0);
+  _manifestFile.write((uint8_t *) &_info, sizeof(JobCacheInfo));
+  _manifestFile.flush();
+}
+
+int JobCache::find(uint32_t key, JobCacheEntry *entry) {
+  for (uint16_t i = 0; i < _info.entries; i++) {
+	readEntry(i, entry);
+	if (entry->key == key) {
+	  return i;
+	}
+  }
+  return -1;
+}
+
+bool JobCache::contains(uint32_t key) {
+  JobCacheEntry entry;
+  return getEntry(key, &entry);
+}
+
+bool JobCache::getEntry(uint32_t key, JobCacheEntry *entry) {
+  if (find(key, entry) < 0) {
+	return false;
+  }
+  entry->etag[JOB_CACHE_MAX_ETAG_LENGTH] = 0;
+
+  //Make sure the file is complete
+  String path = getFilePath(key);
+  File file = SD.open(path.c_str(), FILE_READ);
+  if (!file) {
+	return false;
+  }
+  uint32_t size = file.size();
+  file.close();
+
+  if (size != entry->size) {
+	LOG_VALUE("JobCache: Size mismatch of cached file", path);
+	return false;
+  }
+  return true;
+}
+
+void JobCache::touch(uint32_t key) {
+  JobCacheEntry entry;
+  int index = find(key, &entry);
+  if (index < 0) {
+	return;
+  }
+
+  entry.lastUse = ++_info.clock;
+  writeEntry(index, &entry);
+  writeInfo();
+}
+
+void JobCache::removeAt(uint16_t index) {
+  JobCacheEntry entry;
+  readEntry(index, &entry);
+
+  String path = getFilePath(entry.key);
+  SD.remove(path.c_str());
+
+  //Fill the gap with the last entry to keep the manifest compact
+  _info.entries--;
+  if (index < _info.entries) {
+	readEntry(_info.entries, &entry);
+	writeEntry(index, &entry);
+  }
+  writeInfo();
+}
+
+void JobCache::remove(uint32_t key) {
+  JobCacheEntry entry;
+  int index = find(key, &entry);
+  if (index >= 0) {
+	removeAt(index);
+  } else {
+	String path = getFilePath(key);
+	SD.remove(path.c_str());
+  }
+}
+
+bool JobCache::reserve(uint32_t key, uint32_t size) {
+  if (size > JOB_CACHE_MAX_SIZE) {
+	return false;
+  }
+
+  //A file being replaced does not count
+  remove(key);
+
+  while (true) {
+	uint32_t totalSize = 0;
+	int lruIndex = -1;
+	uint32_t lruUse = 0;
+	JobCacheEntry entry;
+	for (uint16_t i = 0; i < _info.entries; i++) {
+	  readEntry(i, &entry);
+	  totalSize += entry.size;
+	  if (lruIndex < 0 || entry.lastUse < lruUse) {
+		lruIndex = i;
+		lruUse = entry.lastUse;
+	  }
+	}
+
+	if (totalSize + size <= JOB_CACHE_MAX_SIZE && _info.entries < JOB_CACHE_MAX_ENTRIES) {
+	  return true;
+	}
+
+	LOG_VALUE("JobCache: Evicting least recently used entry", lruIndex);
+	removeAt(lruIndex);
+  }
+}
+
+bool JobCache::add(uint32_t key, uint32_t size, const String &etag) {
+  JobCacheEntry entry;
+  int index = find(key, &entry);
+  if (index < 0) {
+	if (_info.entries >= JOB_CACHE_MAX_ENTRIES) {
+	  return false;
+	}
+	index = _info.entries++;
+  }
+
+  memset(&entry, 0, sizeof(JobCacheEntry));
+  entry.key = key;
+  entry.size = size;
+  entry.lastUse = ++_info.clock;
+  strncpy(entry.etag, etag.c_str(), JOB_CACHE_MAX_ETAG_LENGTH);
+  writeEntry(index, &entry);
+  writeInfo();
+  return true;
+}
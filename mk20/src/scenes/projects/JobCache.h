@@ -0,0 +1,85 @@
+/*
+ * Content addressed cache for downloaded job files. Files are stored under a key
+ * derived from the job's download URL, so the same G-code referenced by several
+ * projects is downloaded only once. A compact manifest on SD tracks size and last
+ * use of each entry, least recently used entries are evicted to keep the cache
+ * within its size budget
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_JOBCACHE_H
+#define MK20_JOBCACHE_H
+
+#include "SD.h"
+
+//Total size of all cached job files, least recently used files are removed when a download would exceed it.
+//Keeps the cache small enough to leave room on the card for projects, materials and firmware images
+#define JOB_CACHE_MAX_SIZE (256UL * 1024UL * 1024UL)
+#define JOB_CACHE_MAX_ENTRIES 256
+#define JOB_CACHE_REV 2
+
+//ETags longer than ESP accepts (DOWNLOADURL_MAX_ETAG_LENGTH) are never reported, so this is enough for all of them
+#define JOB_CACHE_MAX_ETAG_LENGTH 63
+
+typedef struct JobCacheInfo {
+  uint8_t rev;
+  uint8_t reserved;
+  uint16_t entries;
+  uint32_t clock;
+} JobCacheInfo;
+
+//The ETag of the file on the server when it was downloaded, a cached job is checked with it before it's printed
+typedef struct JobCacheEntry {
+  uint32_t key;
+  uint32_t size;
+  uint32_t lastUse;
+  char etag[JOB_CACHE_MAX_ETAG_LENGTH + 1];
+} JobCacheEntry;
+
+class JobCache {
+ public:
+  JobCache();
+  ~JobCache();
+  static constexpr char *cacheFolderName = "/cache";
+  static constexpr char *manifestFileName = "/cache/manifest";
+  static uint32_t keyForUrl(const char *url);
+  static String getFilePath(uint32_t key);
+  bool contains(uint32_t key);
+  bool getEntry(uint32_t key, JobCacheEntry *entry);
+  void touch(uint32_t key);
+  bool reserve(uint32_t key, uint32_t size);
+  bool add(uint32_t key, uint32_t size, const String &etag);
+  void remove(uint32_t key);
+
+ private:
+  int find(uint32_t key, JobCacheEntry *entry);
+  void readEntry(uint16_t index, JobCacheEntry *entry);
+  void writeEntry(uint16_t index, JobCacheEntry *entry);
+  void writeInfo();
+  void removeAt(uint16_t index);
+
+ private:
+  File _manifestFile;
+  JobCacheInfo _info;
+};
+
+#endif //MK20_JOBCACHE_H
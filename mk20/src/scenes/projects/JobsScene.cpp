@@ -32,6 +32,7 @@
 #include "JobsScene.h"
 #include "framework/views/LabelButton.h"
 #include "ImageView.h"
+#include "JobCache.h"
 #include "ProjectsScene.h"
 #include "SD.h"
 #include "UIBitmaps.h"
@@ -129,9 +130,25 @@ void JobsScene::onDidAppear() {
 
 void JobsScene::updateButtons() {
   float x = Display.getLayoutWidth() * lastJobIndex;
-  _jobFilePath = "/jobs/" + String(_project.index) + "/" + String(_selectedJob.index);
+
+  //Jobs are stored in the job cache, keyed by their download URL. Files downloaded into the project's job folder
+  //by earlier firmware are still used if present
+  bool available = true;
+  uint32_t key = JobCache::keyForUrl(_selectedJob.url);
+  JobCache *jobCache = new JobCache();
+  if (jobCache->contains(key)) {
+	_jobFilePath = JobCache::getFilePath(key);
+  } else {
+	_jobFilePath = "/jobs/" + String(_project.index) + "/" + String(_selectedJob.index);
+	if (!SD.exists(_jobFilePath.c_str())) {
+	  _jobFilePath = JobCache::getFilePath(key);
+	  available = false;
+	}
+  }
+  delete jobCache;
+
 //_printBtn->setFrame(Rect((x + 80), 190, uiBitmaps.btn_print_start.width, uiBitmaps.btn_print_start.height));
-  if (SD.exists(_jobFilePath.c_str())) {
+  if (available) {
 	_printBtnStart->setFrame(Rect((x + 10), 180, uiBitmaps.btn_print_start.width, uiBitmaps.btn_print_start.height));
 	_printBtnStart->setVisible(true);
 	_printBtnStart->setDelegate(this);
@@ -167,15 +184,26 @@ void JobsScene::onSidebarButtonTouchUp() {
 void JobsScene::buttonPressed(void *button) {
   if (button == _printBtnStart) {
 	LOG_VALUE("Printing Job-Nr", getPageIndex());
-	PrintStatusScene *scene = new PrintStatusScene(_jobFilePath, _project, _selectedJob);
-	Application.pushScene(scene);
+	//Mark the job as recently used so it's evicted last
+	uint32_t key = JobCache::keyForUrl(_selectedJob.url);
+	JobCache *jobCache = new JobCache();
+	JobCacheEntry entry;
+	bool checkCachedJob = jobCache->getEntry(key, &entry) && strlen(entry.etag) > 0 && _jobFilePath == JobCache::getFilePath(key);
+	jobCache->touch(key);
+	delete jobCache;
+
+	if (checkCachedJob) {
+	  //The job on the server may have changed since it has been cached, DownloadFileController checks its ETag and
+	  //prints the cached file if it's unchanged
+	  DownloadFileController *scene =
+		  new DownloadFileController(String(_selectedJob.url), _jobFilePath, _jobFilePath, _project, _selectedJob);
+	  Application.pushScene(scene);
+	} else {
+	  PrintStatusScene *scene = new PrintStatusScene(_jobFilePath, _project, _selectedJob);
+	  Application.pushScene(scene);
+	}
   } else if (button == _printBtnDownload) {
 	LOG_VALUE("Need to download file", getPageIndex());
-	// create directory if needed
-	String _jdir = String("/jobs/" + String(_project.index));
-	if (!SD.exists(_jdir.c_str())) {
-	  SD.mkdir(_jdir.c_str());
-	}
 	// return to job after done...
 	DownloadFileController *scene =
 		new DownloadFileController(String(_selectedJob.url), _jobFilePath, _jobFilePath, _project, _selectedJob);
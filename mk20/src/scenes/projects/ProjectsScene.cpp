@@ -48,9 +48,13 @@ extern int lastJobIndex;
 extern int totalProjects;
 
 ProjectsScene::ProjectsScene() : SidebarSceneController::SidebarSceneController() {
+  projectIndexDb = NULL;
 }
 
 ProjectsScene::~ProjectsScene() {
+  while (_projects.count() > 0) {
+	free(_projects.pop());
+  }
   delete projectIndexDb;
 }
 
@@ -66,17 +70,33 @@ UIBitmap *ProjectsScene::getSidebarIcon() {
   return &uiBitmaps.btn_settings;
 }
 
+bool ProjectsScene::prepare() {
+  //Read one project per loop iteration so the previous scene stays responsive
+  if (projectIndexDb == NULL) {
+	projectIndexDb = new IndexDb();
+	return false;
+  }
+
+  if (_projects.count() < projectIndexDb->getTotalProjects()) {
+	_projects.push(projectIndexDb->getProjectAt(_projects.count()));
+	return false;
+  }
+
+  return true;
+}
+
 void ProjectsScene::onWillAppear() {
 
   setScrollSnap(Display.getLayoutWidth(), SnapMode::Flick);
 
-  projectIndexDb = new IndexDb();
+  //Usually done by Application before the scene is shown
+  while (!prepare());
   //As the model views are distributed as opaque, seamless tiles we don't need auto layout as we don't have spaces where
   //background shines through
   Display.disableAutoLayout();
 
   for (uint8_t i = 0; i < projectIndexDb->getTotalProjects(); i++) {
-	Project *p = projectIndexDb->getProjectAt(i);
+	Project *p = _projects.at(i);
 	ImageView *imageView;
 	imageView = new ImageView(Rect(270 * i, 0, 270, 240), 73);
 	imageView->setImageTitle(String(p->title));
@@ -154,10 +174,10 @@ void ProjectsScene::animationFinished(Animation *animation) {
 
 void ProjectsScene::buttonPressed(void *button) {
   if (button == _openBtn) {
-	JobsScene *js = new JobsScene(*projectIndexDb->getProjectAt(getPageIndex()));
+	JobsScene *js = new JobsScene(*_projects.at(getPageIndex()));
 	Application.pushScene(js);
   } else if (button == _deleteBtn) {
-	ConfirmDeleteProject *scene = new ConfirmDeleteProject(*projectIndexDb->getProjectAt(getPageIndex()));
+	ConfirmDeleteProject *scene = new ConfirmDeleteProject(*_projects.at(getPageIndex()));
 	Application.pushScene(scene);
   }
   SidebarSceneController::buttonPressed(button);
@@ -50,6 +50,7 @@ class ProjectsScene : public SidebarSceneController {
   virtual void onSidebarButtonTouchUp() override;
   virtual UIBitmap *getSidebarBitmap() override;
   virtual UIBitmap *getSidebarIcon() override;
+  virtual bool prepare() override;
 
  private:
   virtual void onWillAppear() override;
@@ -58,6 +59,7 @@ class ProjectsScene : public SidebarSceneController {
   virtual void buttonPressed(void *button) override;
   void updateButtons();
   IndexDb *projectIndexDb;
+  StackArray<Project *> _projects;
  protected:
   BitmapButton *_openBtn;
   BitmapButton *_deleteBtn;
@@ -0,0 +1,153 @@
+/*
+ * Shows the loop profiler metrics (section timings and counters) on the
+ * display, reached from the system info screen
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ProfilerScene.h"
+#include "SystemInfoScene.h"
+#include "font_LiberationSans.h"
+#include "framework/layers/RectangleLayer.h"
+
+extern UIBitmaps uiBitmaps;
+
+//Metrics are refreshed every PROFILER_SCENE_INTERVAL ms
+#define PROFILER_SCENE_INTERVAL 1000
+
+ProfilerScene::ProfilerScene() : SidebarSceneController::SidebarSceneController() {
+}
+
+ProfilerScene::~ProfilerScene() {
+}
+
+String ProfilerScene::getName() {
+  return "ProfilerScene";
+}
+
+UIBitmap *ProfilerScene::getSidebarIcon() {
+  return &uiBitmaps.btn_exit;
+}
+
+UIBitmap *ProfilerScene::getSidebarBitmap() {
+  return &uiBitmaps.sidebar_settings;
+}
+
+uint16_t ProfilerScene::getBackgroundColor() {
+  return Application.getTheme()->getColor(BackgroundColor);
+}
+
+bool ProfilerScene::isModal() {
+  return false;
+}
+
+LabelView *ProfilerScene::addLabelView(String text, Rect frame) {
+  LabelView *labelView = new LabelView(text, frame);
+  labelView->setTextAlign(TEXTALIGN_LEFT);
+  labelView->setFont(&LiberationSans_8);
+  labelView->setBackgroundColor(getBackgroundColor());
+  addView(labelView);
+  return labelView;
+}
+
+void ProfilerScene::onWillAppear() {
+  int y = 6;
+  int xLabel = 10;
+  int labelWidth = 70;
+  int xValue = xLabel + labelWidth + 10;
+  int valueWidth = 270 - xValue - 10;
+  int labelHeight = 13;
+  int yGap = 1;
+
+  //Section timings in microseconds
+  for (int i = 0; i < (int) ProfileSection::Count; i++) {
+	addLabelView(ProfilerClass::getSectionName((ProfileSection) i), Rect(xLabel, y, labelWidth, labelHeight));
+	_sections[i] = addLabelView("", Rect(xValue, y, valueWidth, labelHeight));
+	y += labelHeight + yGap;
+  }
+
+  y += yGap * 2;
+
+  for (int i = 0; i < (int) ProfileCounter::Count; i++) {
+	addLabelView(ProfilerClass::getCounterName((ProfileCounter) i), Rect(xLabel, y, labelWidth, labelHeight));
+	_counters[i] = addLabelView("", Rect(xValue, y, valueWidth, labelHeight));
+	y += labelHeight + yGap;
+  }
+
+  addLabelView("deadlines", Rect(xLabel, y, labelWidth, labelHeight));
+  _missedDeadlines = addLabelView("", Rect(xValue, y, valueWidth, labelHeight));
+  y += labelHeight + yGap;
+
+  //High water marks of the scene arena and the layer pool
+  addLabelView("memory", Rect(xLabel, y, labelWidth, labelHeight));
+  _memory = addLabelView("", Rect(xValue, y, valueWidth, labelHeight));
+
+  _resetButton = new LabelButton("Reset", Rect(180, 216, 80, 22));
+  _resetButton->setDelegate(this);
+  addView(_resetButton);
+
+  SidebarSceneController::onWillAppear();
+
+  updateMetrics();
+}
+
+void ProfilerScene::updateMetrics() {
+  _lastUpdate = millis();
+
+  char text[48];
+  for (int i = 0; i < (int) ProfileSection::Count; i++) {
+	SectionMetrics metrics = Profiler.getSectionMetrics((ProfileSection) i);
+	snprintf(text, sizeof(text), "p50 %lu  p99 %lu  max %lu us", metrics.p50, metrics.p99, metrics.max);
+	_sections[i]->setText(text);
+  }
+
+  for (int i = 0; i < (int) ProfileCounter::Count; i++) {
+	snprintf(text, sizeof(text), "%lu", Profiler.getCounter((ProfileCounter) i));
+	_counters[i]->setText(text);
+  }
+
+  snprintf(text, sizeof(text), "%lu missed, worst gap %lu us", Application.getMissedDeadlines(), Application.getWorstIOServiceGap());
+  _missedDeadlines->setText(text);
+
+  snprintf(text, sizeof(text), "arena %u/%u  pool %d/%d", SceneArena.getHighWaterMark(), SceneArena.getCapacity(), RectangleLayer::getPoolHighWaterMark(), RECTANGLE_LAYER_POOL_SIZE);
+  _memory->setText(text);
+}
+
+void ProfilerScene::loop() {
+  if ((millis() - _lastUpdate) > PROFILER_SCENE_INTERVAL) {
+	updateMetrics();
+  }
+}
+
+void ProfilerScene::onSidebarButtonTouchUp() {
+  SystemInfoScene *scene = new SystemInfoScene();
+  Application.pushScene(scene, true);
+}
+
+void ProfilerScene::buttonPressed(void *button) {
+  if (button == _resetButton) {
+	Profiler.reset();
+	updateMetrics();
+	return;
+  }
+
+  SidebarSceneController::buttonPressed(button);
+}
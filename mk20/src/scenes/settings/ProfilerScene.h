@@ -0,0 +1,64 @@
+/*
+ * Shows the loop profiler metrics (section timings and counters) on the
+ * display, reached from the system info screen
+ *
+ * Copyright (c) 2016 Printrbot Inc.
+ * https://github.com/Printrbot/Printrhub
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MK20_PROFILERSCENE_H
+#define MK20_PROFILERSCENE_H
+
+#include "../SidebarSceneController.h"
+#include "framework/views/LabelView.h"
+#include "framework/views/LabelButton.h"
+#include "framework/core/Profiler.h"
+
+class ProfilerScene : public SidebarSceneController {
+ public:
+
+  ProfilerScene();
+  virtual ~ProfilerScene();
+  virtual void onSidebarButtonTouchUp() override;
+
+  virtual uint16_t getBackgroundColor() override;
+  virtual UIBitmap *getSidebarBitmap() override;
+  virtual UIBitmap *getSidebarIcon() override;
+
+ private:
+  virtual void onWillAppear() override;
+  String getName() override;
+  virtual void buttonPressed(void *button) override;
+  virtual void loop() override;
+  virtual bool isModal() override;
+
+  LabelView *addLabelView(String text, Rect frame);
+  void updateMetrics();
+
+ private:
+  LabelView *_sections[(int) ProfileSection::Count];
+  LabelView *_counters[(int) ProfileCounter::Count];
+  LabelView *_missedDeadlines;
+  LabelView *_memory;
+  LabelButton *_resetButton;
+  unsigned long _lastUpdate;
+};
+
+#endif //MK20_PROFILERSCENE_H
@@ -37,6 +37,7 @@
 #include "../filament/SelectFilamentAction.h"
 #include "../calibrate/CalibrateScene.h"
 #include "../settings/SettingsScene.h"
+#include "ProfilerScene.h"
 #include "font_LiberationSans.h"
 
 extern UIBitmaps uiBitmaps;
@@ -138,6 +139,11 @@ void SystemInfoScene::onWillAppear() {
   _serialNumber->setFont(&LiberationSans_8);
   y += labelHeight + yGap;
 
+  //Loop profiler
+  _profilerButton = new LabelButton("Profiler", Rect(180, 186, 80, 24));
+  _profilerButton->setDelegate(this);
+  addView(_profilerButton);
+
   SidebarSceneController::onWillAppear();
 
   //Prepare requesting data
@@ -217,6 +223,11 @@ void SystemInfoScene::onSidebarButtonTouchUp() {
 }
 
 void SystemInfoScene::buttonPressed(void *button) {
+  if (button == _profilerButton) {
+	ProfilerScene *scene = new ProfilerScene();
+	Application.pushScene(scene);
+	return;
+  }
 
   SidebarSceneController::buttonPressed(button);
 }
@@ -36,6 +36,7 @@
 #include "../SidebarSceneController.h"
 #include "framework/views/BitmapButton.h"
 #include "framework/views/LabelView.h"
+#include "framework/views/LabelButton.h"
 
 class SystemInfoScene : public SidebarSceneController {
  public:
@@ -76,6 +77,7 @@ class SystemInfoScene : public SidebarSceneController {
   LabelView *_firmwareVersion;
   LabelView *_networkModeLabel;
   LabelView *_networkMode;
+  LabelButton *_profilerButton;
   SystemInfo _systemInfo;
   bool _dataReceived;
   unsigned long _lastPing;
@@ -35,6 +35,7 @@
 #include "../../../lib/fonts/font_AwesomeF080.h"
 #include "../../../lib/fonts/font_AwesomeF000.h"
 #include "framework/views/Button.h"
+#include "framework/layers/RectangleLayer.h"
 
 const unsigned char Keyboards[] = {'A','B','C','D','E','F','G','H','I','J','K','L','M','N','O','P','Q','R','S','T','U','V','W','X','Y','Z','.',',',';','-','_','@',
                           'a','b','c','d','e','f','g','h','i','j','k','l','m','n','o','p','q','r','s','t','u','v','w','x','y','z','.',',',';','-','_','@',
@@ -47,6 +48,14 @@ VirtualKeyboardSceneController::VirtualKeyboardSceneController(VirtualKeyboardHa
 
   _currentKeyboard = 0;
 
+  //The keys leave one pixel gaps, a layer below them fills those instead of auto layout (see onWillAppear)
+  View *background = new View(Rect(0, 0, 320, 240));
+  RectangleLayer *backgroundLayer = new RectangleLayer(background->getFrame());
+  backgroundLayer->setBackgroundColor(getBackgroundColor());
+  background->addLayer(backgroundLayer);
+  background->setUserInteractionEnabled(false);
+  addView(background);
+
   uint8_t i = 0;
   for (int y = 1; y < 5; y++) {
 	for (int x = 0; x < 8; x++) {
@@ -142,6 +151,14 @@ VirtualKeyboardSceneController::~VirtualKeyboardSceneController() {
   }
 }
 
+void VirtualKeyboardSceneController::onWillAppear() {
+  //Like the projects scene the views cover the whole screen. Splitting the background around the 40 keys took more
+  //gap layers than the layer pool holds
+  Display.disableAutoLayout();
+
+  SceneController::onWillAppear();
+}
+
 uint16_t VirtualKeyboardSceneController::getBackgroundColor() {
   return Application.getTheme()->getColor(SpacerColor);
 }
@@ -151,8 +168,9 @@ String VirtualKeyboardSceneController::getName() {
 }
 
 void VirtualKeyboardSceneController::updateKeyboard() {
+  //The background is the first view, keys follow
   for (int i = 0; i < 32; i++) {
-	LabelButton *keyButton = (LabelButton *) getViews()->at(i);
+	LabelButton *keyButton = (LabelButton *) getViews()->at(i + 1);
 	keyButton->setText(String(Keyboards[_currentKeyboard * 32 + i]));
 	keyButton->setName(String(Keyboards[_currentKeyboard * 32 + i]));
 	keyButton->setNeedsDisplay();
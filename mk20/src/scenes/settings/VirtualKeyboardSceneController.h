@@ -51,6 +51,7 @@ class VirtualKeyboardSceneController : public SceneController, ButtonDelegate {
 
 #pragma mark Scene Controller
   String getName();
+  virtual void onWillAppear() override;
   virtual uint16_t getBackgroundColor() override;
 
 #pragma mark Button Delegate
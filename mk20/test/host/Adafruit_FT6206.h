@@ -0,0 +1,12 @@
+//Touch point of lib/Adafruit_FT6206, the driver itself needs the hardware
+#pragma once
+
+#include <stdint.h>
+
+class TS_Point {
+ public:
+  TS_Point(void) : x(0), y(0), z(0) {};
+  TS_Point(int16_t x, int16_t y, int16_t z) : x(x), y(y), z(z) {};
+
+  int16_t x, y, z;
+};
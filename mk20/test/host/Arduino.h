@@ -0,0 +1,36 @@
+//Minimal stand-in for the Arduino core so framework code without hardware dependencies builds on the host
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+class String : public std::string {
+ public:
+  String(const char *value = "") : std::string(value) {};
+  String(const std::string &value) : std::string(value) {};
+  String(int value) : std::string(std::to_string(value)) {};
+};
+
+class HostSerial {
+ public:
+  void printf(const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+  };
+};
+
+static HostSerial Serial __attribute__((unused));
+
+inline uint32_t millis() { return 0; }
+inline uint32_t micros() { return 0; }
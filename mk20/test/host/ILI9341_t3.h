@@ -0,0 +1,29 @@
+//Font format of lib/Display/ILI9341_t3.h, the driver itself needs the hardware
+#pragma once
+
+typedef struct {
+  const unsigned char *index;
+  const unsigned char *unicode;
+  const unsigned char *data;
+  unsigned char version;
+  unsigned char reserved;
+  unsigned char index1_first;
+  unsigned char index1_last;
+  unsigned char index2_first;
+  unsigned char index2_last;
+  unsigned char bits_index;
+  unsigned char bits_width;
+  unsigned char bits_height;
+  unsigned char bits_xoffset;
+  unsigned char bits_yoffset;
+  unsigned char bits_delta;
+  unsigned char line_space;
+  unsigned char cap_height;
+} ILI9341_t3_font_t;
+
+#define ILI9341_BLACK       0x0000
+#define ILI9341_BLUE        0x001F
+#define ILI9341_RED         0xF800
+#define ILI9341_GREEN       0x07E0
+#define ILI9341_WHITE       0xFFFF
+#define ILI9341_ORANGE      0xFD20
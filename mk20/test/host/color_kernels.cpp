@@ -0,0 +1,165 @@
+//Checks ColorKernels against the code it replaced and its own scalar kernels, and times the pixel loops.
+//- darken with COLOR_SHADOW_SCALE has to match the float shadow of PHDisplay::drawFileBitmapByColumn for all colors
+//- the pair loops (two pixels per 32 bit word) and the odd pixel at the end have to match the scalar kernels for all
+//  colors, all lengths up to 33 pixels and unaligned buffers
+//
+//Times are measured on the host and only compare the float and the pair code, use the profiler for MK20 cycles.
+
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "ColorKernels.h"
+#include "ColorTheme.h"
+
+#define NUM_COLORS 65536
+#define BENCHMARK_PIXELS (320 * 240)
+#define BENCHMARK_ROUNDS 200
+
+static int failures = 0;
+
+//The shadow code drawFileBitmapByColumn used before ColorKernels
+static uint16_t floatShadow(uint16_t color) {
+  float r = (float) (((((color >> 11) & 0x1F) * 527) + 23) >> 6);
+  float g = (float) (((((color >> 5) & 0x3F) * 259) + 33) >> 6);
+  float b = (float) ((((color & 0x1F) * 527) + 23) >> 6);
+  r *= 0.7;
+  g *= 0.7;
+  b *= 0.7;
+  return (uint16_t) RGB565((uint8_t) r, (uint8_t) g, (uint8_t) b);
+}
+
+static void fail(const char *kernel, size_t offset, size_t count, size_t pixel, uint16_t expected, uint16_t result) {
+  if (failures++ < 10) {
+	printf("FAIL  %s offset %d count %d pixel %d: expected %04X, got %04X\n", kernel, (int) offset, (int) count, (int) pixel,
+		   expected, result);
+  }
+}
+
+static void checkShadow() {
+  int mismatches = 0;
+  for (uint32_t color = 0; color < NUM_COLORS; color++) {
+	uint16_t expected = floatShadow(color);
+	uint16_t result = ColorKernels::darken((uint16_t) color, COLOR_SHADOW_SCALE);
+	if (result != expected) {
+	  fail("darken vs float shadow", 0, 1, color, expected, result);
+	  mismatches++;
+	}
+  }
+  printf("%s  darken(%d) matches the float shadow for %d of %d colors\n", mismatches == 0 ? "ok  " : "FAIL",
+		 COLOR_SHADOW_SCALE, NUM_COLORS - mismatches, NUM_COLORS);
+}
+
+//Runs the buffer kernel on pixels[offset, offset + count) and compares every pixel with the scalar kernel
+template<typename BufferKernel, typename ScalarKernel>
+static void checkBuffer(const char *name, const std::vector<uint16_t> &input, size_t offset, size_t count,
+						BufferKernel bufferKernel, ScalarKernel scalarKernel) {
+  std::vector<uint16_t> pixels(input);
+  bufferKernel(&pixels[0], offset, count);
+
+  for (size_t i = 0; i < pixels.size(); i++) {
+	bool inside = i >= offset && i < offset + count;
+	uint16_t expected = inside ? scalarKernel(input[i], i) : input[i];
+	if (pixels[i] != expected) {
+	  fail(name, offset, count, i, expected, pixels[i]);
+	  return;
+	}
+  }
+}
+
+template<typename BufferKernel, typename ScalarKernel>
+static void checkKernel(const char *name, const std::vector<uint16_t> &colors, BufferKernel bufferKernel,
+						ScalarKernel scalarKernel) {
+  int failuresBefore = failures;
+
+  //All colors in pairs, with both alignments of the pair loop
+  checkBuffer(name, colors, 0, colors.size(), bufferKernel, scalarKernel);
+  checkBuffer(name, colors, 1, colors.size() - 1, bufferKernel, scalarKernel);
+
+  //Short runs for the odd pixel at the end, starting at even and odd addresses
+  std::vector<uint16_t> shortRun(colors.begin() + 1000, colors.begin() + 1040);
+  for (size_t offset = 0; offset < 4; offset++) {
+	for (size_t count = 0; count <= 33; count++) {
+	  checkBuffer(name, shortRun, offset, count, bufferKernel, scalarKernel);
+	}
+  }
+
+  printf("%s  %s\n", failures == failuresBefore ? "ok  " : "FAIL", name);
+}
+
+static double benchmark(void (*kernel)(uint16_t *, size_t), std::vector<uint16_t> &pixels) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int round = 0; round < BENCHMARK_ROUNDS; round++) {
+	kernel(&pixels[0], pixels.size());
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / ((double) BENCHMARK_ROUNDS * pixels.size());
+}
+
+static void floatShadowPixels(uint16_t *pixels, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+	pixels[i] = floatShadow(pixels[i]);
+  }
+}
+
+static void scalarShadowPixels(uint16_t *pixels, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+	pixels[i] = ColorKernels::darken(pixels[i], COLOR_SHADOW_SCALE);
+  }
+}
+
+static void pairShadowPixels(uint16_t *pixels, size_t count) {
+  ColorKernels::darken(pixels, count, COLOR_SHADOW_SCALE);
+}
+
+int main() {
+  checkShadow();
+
+  //Every color once, followed by a second pass in a different order so each color meets other neighbours
+  std::vector<uint16_t> colors(NUM_COLORS * 2);
+  for (uint32_t i = 0; i < NUM_COLORS; i++) {
+	colors[i] = (uint16_t) i;
+	colors[NUM_COLORS + i] = (uint16_t) (i * 40503);
+  }
+  std::vector<uint16_t> sources(colors.rbegin(), colors.rend());
+
+  const uint16_t amounts[] = {0, 1, 77, 128, COLOR_SHADOW_SCALE, 255, 256};
+  char name[64];
+  for (size_t a = 0; a < sizeof(amounts) / sizeof(amounts[0]); a++) {
+	uint16_t amount = amounts[a];
+
+	snprintf(name, sizeof(name), "darken(%d)", amount);
+	checkKernel(name, colors, [=](uint16_t *p, size_t o, size_t n) { ColorKernels::darken(p + o, n, amount); },
+				[=](uint16_t c, size_t) { return ColorKernels::darken(c, amount); });
+
+	snprintf(name, sizeof(name), "darken(%d) keeping %04X", amount, colors[1010]);
+	uint16_t keepColor = colors[1010];
+	checkKernel(name, colors, [=](uint16_t *p, size_t o, size_t n) { ColorKernels::darken(p + o, n, amount, keepColor); },
+				[=](uint16_t c, size_t) { return c == keepColor ? c : ColorKernels::darken(c, amount); });
+
+	snprintf(name, sizeof(name), "lighten(%d)", amount);
+	checkKernel(name, colors, [=](uint16_t *p, size_t o, size_t n) { ColorKernels::lighten(p + o, n, amount); },
+				[=](uint16_t c, size_t) { return ColorKernels::lighten(c, amount); });
+
+	//The source buffer is indexed like the pixels, so the scalar kernel takes the same index
+	snprintf(name, sizeof(name), "blend(%d)", amount);
+	const uint16_t *source = &sources[0];
+	checkKernel(name, colors, [=](uint16_t *p, size_t o, size_t n) { ColorKernels::blend(p + o, source + o, n, amount); },
+				[=](uint16_t c, size_t i) { return ColorKernels::blend(c, source[i], amount); });
+
+	snprintf(name, sizeof(name), "tint(%d)", amount);
+	checkKernel(name, colors, [=](uint16_t *p, size_t o, size_t n) { ColorKernels::tint(p + o, n, 0x051D, amount); },
+				[=](uint16_t c, size_t) { return ColorKernels::blend(c, 0x051D, amount); });
+  }
+
+  checkKernel("grayscale", colors, [](uint16_t *p, size_t o, size_t n) { ColorKernels::grayscale(p + o, n); },
+			  [](uint16_t c, size_t) { return ColorKernels::grayscale(c); });
+
+  std::vector<uint16_t> pixels(colors.begin(), colors.begin() + BENCHMARK_PIXELS);
+  double floatTime = benchmark(floatShadowPixels, pixels);
+  double scalarTime = benchmark(scalarShadowPixels, pixels);
+  double pairTime = benchmark(pairShadowPixels, pixels);
+  printf("      shadow of a 320x240 bitmap on this host: float %.2f ns/pixel, scalar %.2f ns/pixel, pairs %.2f ns/pixel\n",
+		 floatTime, scalarTime, pairTime);
+
+  return failures == 0 ? 0 : 1;
+}
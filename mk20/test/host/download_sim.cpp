@@ -0,0 +1,450 @@
+//Runs the download of a job to SD card with the real DownloadURL and DownloadFileToSDCard of the ESP on a simulated
+//clock. The HTTP server has a bandwidth, a latency until the response arrives and a TCP window, CommStack packets
+//take their time on the UART and MK20 needs time for its run loop and SD card writes. Checks MK20 receives the file
+//unchanged and reports the throughput in MB/min. The server can drop the connection at given offsets and change the
+//file, checks that interrupted downloads are resumed with range requests and MK20 ends up with the same file, and that
+//cached jobs are only downloaded again if they changed.
+
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include "DownloadFileToSDCard.h"
+#include "Idle.h"
+
+#define FILE_SIZE (1024 * 1024)
+
+//ESP run loop without the download, i.e. web server and CommStack (microseconds)
+#define ESP_LOOP_TIME 200
+//lwIP TCP receive window of the ESP (4 * MSS)
+#define TCP_WINDOW 5840
+//MK20 reads CommStack once per run loop (microseconds), the packet waits half a loop on average
+#define MK20_LOOP_TIME 1000
+//SD card writes of MK20, a 512 byte block and a checkpoint of the directory entry and the sidecar every 32 KB
+#define SD_BLOCK_TIME 600
+#define SD_SYNC_TIME 15000
+#define SD_SYNC_INTERVAL (32 * 1024)
+//MK20 redraws the progress bar when the percentage changes
+#define PROGRESS_REDRAW_TIME 8000
+
+struct Network {
+  const char *name;
+  double bytesPerSecond;
+  unsigned long latency;
+};
+
+static const Network networks[] = {
+	{"LAN", 1000 * 1024, 10000},
+	{"Internet", 250 * 1024, 150000},
+};
+
+static bool verbose = false;
+static unsigned long now = 0;
+
+unsigned long hostMillis() { return now / 1000; }
+void hostDelay(unsigned long ms) { now += ms * 1000; }
+void hostDelayMicroseconds(unsigned int us) { now += us; }
+void hostGpioWrite(uint32_t mask, bool value) {}
+void hostGpioEnable(uint32_t mask, bool output) {}
+uint32_t hostGpioRead() { return 0; }
+
+void EventLogger::log(char *msg, ...) {
+  if (!verbose) return;
+  va_list args;
+  va_start(args, msg);
+  printf("      ");
+  vprintf(msg, args);
+  printf("\n");
+  va_end(args);
+}
+
+void EventLogger::log(const char *msg, ...) {
+  if (!verbose) return;
+  va_list args;
+  va_start(args, msg);
+  printf("      ");
+  vprintf(msg, args);
+  printf("\n");
+  va_end(args);
+}
+
+#pragma mark HTTP server
+
+static struct Server {
+  std::vector<uint8_t> content;
+  String etag;
+  const Network *network;
+  String rangeHeader;
+  String ifRangeHeader;
+  bool open;
+  uint32_t start;
+  uint32_t length;
+  int status;
+  double arrived;
+  uint32_t consumed;
+  unsigned long lastUpdate;
+  int requests;
+  int firstRangeStart;
+  std::deque<uint32_t> drops;
+  String etagAfterDrop;
+
+  //Data arrives with the bandwidth of the network as long as the TCP window is open. At the offset of the next drop
+  //the connection is closed once the client has read everything before it
+  void update() {
+	if (!open || now <= lastUpdate) return;
+	arrived += (now - lastUpdate) * network->bytesPerSecond / 1000000.0;
+	arrived = std::min(arrived, (double) std::min(length, consumed + TCP_WINDOW));
+	lastUpdate = now;
+
+	if (!drops.empty() && start + arrived >= drops.front()) {
+	  arrived = drops.front() - start;
+	  if (consumed >= arrived) {
+		open = false;
+		drops.pop_front();
+		if (etagAfterDrop.length() > 0) etag = etagAfterDrop;
+	  }
+	}
+  };
+} server;
+
+static HTTPClient *activeClient = NULL;
+static WiFiClient stream;
+
+bool HTTPClient::begin(String url) {
+  server.rangeHeader = "";
+  server.ifRangeHeader = "";
+  return true;
+}
+
+void HTTPClient::addHeader(const String &name, const String &value) {
+  if (name == "Range") server.rangeHeader = value;
+  if (name == "If-Range") server.ifRangeHeader = value;
+}
+
+void HTTPClient::collectHeaders(const char *headerKeys[], const size_t headerKeysCount) {}
+
+int HTTPClient::GET() {
+  //GET blocks until the response header has been received
+  now += server.network->latency;
+  server.requests++;
+
+  server.start = 0;
+  server.status = 200;
+  if (server.rangeHeader.length() > 0 && server.ifRangeHeader == server.etag) {
+	server.start = atol(server.rangeHeader.substr(6).c_str());
+	if (server.requests == 1) server.firstRangeStart = server.start;
+	if (server.start >= server.content.size()) {
+	  server.status = 416;
+	  return server.status;
+	}
+	server.status = 206;
+  }
+
+  server.open = true;
+  server.length = server.content.size() - server.start;
+  server.arrived = 0;
+  server.consumed = 0;
+  server.lastUpdate = now;
+  activeClient = this;
+  return server.status;
+}
+
+WiFiClient *HTTPClient::getStreamPtr() { return &stream; }
+int HTTPClient::getSize() { return server.length; }
+
+String HTTPClient::header(const char *name) {
+  if (strcmp(name, "ETag") == 0) return server.etag;
+  if (strcmp(name, "Accept-Ranges") == 0) return "bytes";
+  if (strcmp(name, "Content-Range") == 0 && server.status == 416) return "bytes */" + String((int) server.content.size());
+  return "";
+}
+
+bool HTTPClient::connected() { return server.open && server.consumed < server.length; }
+
+void HTTPClient::end() {
+  if (activeClient == this) server.open = false;
+}
+
+int WiFiClient::available() {
+  server.update();
+  return (int) server.arrived - server.consumed;
+}
+
+size_t WiFiClient::readBytes(uint8_t *buffer, size_t length) {
+  size_t size = std::min(length, (size_t) available());
+  memcpy(buffer, &server.content[server.start + server.consumed], size);
+  server.consumed += size;
+  return size;
+}
+
+#pragma mark CommStack and MK20
+
+struct Response {
+  unsigned long time;
+  TaskID task;
+};
+
+static struct MK20Model {
+  std::vector<uint8_t> file;
+  uint32_t fileSize;
+  uint32_t sidecarOffset;
+  String sidecarETag;
+  int previousPercent;
+  unsigned long uartToMK20Free;
+  unsigned long uartToESPFree;
+  unsigned long busyUntil;
+  std::deque<Response> responses;
+  int chunks;
+  bool closed;
+  bool error;
+
+  //Packets are COBS encoded with a marker, each byte takes 10 bits on the UART
+  unsigned long packetTime(size_t dataSize) {
+	size_t size = sizeof(CommHeader) + dataSize;
+	size += size / 254 + 2;
+	return (unsigned long) (size * 10 * 1000000.0 / COMMSTACK_BAUDRATE);
+  };
+
+  void saveData(const uint8_t *data, size_t size) {
+	unsigned long arrival = std::max(now, uartToMK20Free) + packetTime(size);
+	uartToMK20Free = arrival;
+
+	unsigned long cost = size * SD_BLOCK_TIME / 512;
+	if ((file.size() + size) / SD_SYNC_INTERVAL != file.size() / SD_SYNC_INTERVAL) cost += SD_SYNC_TIME;
+	file.insert(file.end(), data, data + size);
+	int percent = fileSize > 0 ? (int) ((uint64_t) file.size() * 100 / fileSize) : 0;
+	if (percent != previousPercent) cost += PROGRESS_REDRAW_TIME;
+	previousPercent = percent;
+
+	busyUntil = std::max(arrival + MK20_LOOP_TIME / 2, busyUntil) + cost;
+	unsigned long response = std::max(busyUntil, uartToESPFree) + packetTime(0);
+	uartToESPFree = response;
+	responses.push_back({response, TaskID::FileSaveData});
+	chunks++;
+  };
+} mk20;
+
+ApplicationClass Application;
+
+CommStack::CommStack(Stream *port, CommStackDelegate *delegate) : _port(port), _delegate(delegate) {}
+CommStack::~CommStack() {}
+
+bool CommStack::requestTask(TaskID task, size_t contentLength, const uint8_t *data) {
+  if (task == TaskID::FileSaveData) {
+	mk20.saveData(data, contentLength);
+  } else if (task == TaskID::DownloadError) {
+	mk20.error = true;
+  }
+  return true;
+}
+
+bool CommStack::requestTask(TaskID task) {
+  if (task == TaskID::FileClose) mk20.closed = true;
+  return true;
+}
+
+//Like DownloadFileController MK20 appends to the partial file if ESP continues at the offset of the sidecar and
+//starts over otherwise
+bool CommStack::responseTask(TaskID task, size_t contentLength, const uint8_t *data, bool success) {
+  if (task == TaskID::DownloadFile && contentLength >= 2 * sizeof(uint32_t)) {
+	uint32_t offset;
+	memcpy(&mk20.fileSize, data, sizeof(uint32_t));
+	memcpy(&offset, data + sizeof(uint32_t), sizeof(uint32_t));
+	mk20.sidecarETag = std::string((const char *) data + 2 * sizeof(uint32_t), contentLength - 2 * sizeof(uint32_t));
+	mk20.file.resize(offset > 0 && offset == mk20.sidecarOffset ? offset : 0);
+  }
+  return true;
+}
+
+void ApplicationClass::pushMode(Mode *mode) {
+  _currentMode = mode;
+  mode->onWillStart();
+}
+
+void ApplicationClass::idle() {
+  pushMode(new Idle());
+}
+
+void ApplicationClass::handleError(DownloadError error) {
+  pushMode(new Idle());
+}
+
+#pragma mark Simulation
+
+//Runs the ESP run loop until the download mode exits, returns the time it took in microseconds. With resume MK20
+//keeps its partial file and asks ESP to continue at the offset of its sidecar
+static unsigned long download(const Network &network, bool resume = false) {
+  server.network = &network;
+  server.open = false;
+  server.requests = 0;
+  server.firstRangeStart = -1;
+  std::vector<uint8_t> partialFile = mk20.file;
+  String etag = mk20.sidecarETag;
+  mk20 = MK20Model();
+  mk20.previousPercent = -1;
+  now = 0;
+
+  DownloadFileToSDCard *mode = new DownloadFileToSDCard("http://printrapp.local/job");
+  if (resume) {
+	//DownloadFileController writes the sidecar with all bytes it received when the download stopped
+	mk20.file = partialFile;
+	mk20.sidecarOffset = partialFile.size();
+	mode->setResumeOffset(mk20.sidecarOffset, etag);
+  }
+  Application.pushMode(mode);
+
+  while (Application.currentMode() == mode && now < 3600000000UL) {
+	//Responses of MK20 are handled by CommStack before the mode runs
+	while (!mk20.responses.empty() && mk20.responses.front().time <= now) {
+	  CommHeader header(mk20.responses.front().task, 0);
+	  header.commType = ResponseSuccess;
+	  mk20.responses.pop_front();
+
+	  uint8_t responseData[COMM_STACK_BUFFER_SIZE];
+	  uint16_t responseDataSize = 0;
+	  bool sendResponse = false;
+	  bool success = true;
+	  if (mode->handlesTask(header.getCurrentTask())) {
+		mode->runTask(header, NULL, 0, responseData, &responseDataSize, &sendResponse, &success);
+	  }
+	}
+
+	mode->loop();
+	now += ESP_LOOP_TIME;
+  }
+
+  return now;
+}
+
+//MK20 received a prefix of the file, nothing has been spliced in from another offset or version
+static bool isPrefix() {
+  return mk20.file.size() <= server.content.size() && std::equal(mk20.file.begin(), mk20.file.end(), server.content.begin());
+}
+
+static bool isComplete() {
+  return mk20.closed && !mk20.error && mk20.file == server.content;
+}
+
+static int resumeChecks() {
+  int failures = 0;
+  const Network &network = networks[1];
+
+  //Connection drops in the middle of chunks and ring buffer wraps, each one is continued with a range request
+  server.drops = {1000, 250001, 250002, 524288, 1000000};
+  download(network);
+  if (!isComplete() || server.requests != 6 || !server.drops.empty()) {
+	printf("FAIL  Resume after 5 dropped connections: %d of %d bytes, %d requests\n", (int) mk20.file.size(), FILE_SIZE,
+		   server.requests);
+	failures++;
+  } else {
+	printf("ok    Download resumed after 5 dropped connections, file unchanged\n");
+  }
+
+  //More drops than resume attempts, ESP gives up and MK20 keeps what it has. The next download continues with the
+  //byte after the last one MK20 received
+  server.drops = {100000, 200000, 300000, 400000, 500000, 600000, 700000};
+  download(network);
+  uint32_t received = mk20.file.size();
+  if (!mk20.error || mk20.closed || !isPrefix() || received < 600000) {
+	printf("FAIL  Giving up after %d resume attempts: %d bytes, %s\n", DOWNLOADURL_MAX_RESUME_ATTEMPTS, received,
+		   mk20.error ? "error" : "no error");
+	failures++;
+  }
+  download(network, true);
+  if (!isComplete() || server.firstRangeStart != (int) received || !server.drops.empty()) {
+	printf("FAIL  Continue download at %d: first range at %d, %d of %d bytes\n", received, server.firstRangeStart,
+		   (int) mk20.file.size(), FILE_SIZE);
+	failures++;
+  } else {
+	printf("ok    Download continued at byte %d after ESP gave up\n", received);
+  }
+
+  //The file changes while the connection is down. If-Range gets the whole file, ESP must not append it to the part
+  //MK20 already has, the next download starts over
+  server.drops = {400000};
+  server.etagAfterDrop = "\"5a1f\"";
+  download(network);
+  bool reconnectFailed = mk20.error && !mk20.closed && isPrefix() && mk20.file.size() == 400000;
+  download(network, true);
+  server.etagAfterDrop = "";
+  if (!reconnectFailed || !isComplete() || mk20.sidecarETag != server.etag) {
+	printf("FAIL  File changed during download: %d of %d bytes, ETag %s\n", (int) mk20.file.size(), FILE_SIZE,
+		   mk20.sidecarETag.c_str());
+	failures++;
+  } else {
+	printf("ok    Changed file is downloaded again\n");
+  }
+
+  //A cached job is checked by asking for the bytes after its end. If the ETag still matches there are none (416) and
+  //MK20 keeps its file
+  mk20.file = server.content;
+  mk20.sidecarETag = server.etag;
+  download(network, true);
+  if (!isComplete() || server.requests != 1 || mk20.chunks != 0 || mk20.sidecarETag != server.etag) {
+	printf("FAIL  Unchanged cached job: %d of %d bytes, %d requests, %d chunks\n", (int) mk20.file.size(), FILE_SIZE,
+		   server.requests, mk20.chunks);
+	failures++;
+  } else {
+	printf("ok    Unchanged cached job is not downloaded again\n");
+  }
+
+  //A partial file that is larger than the file on the server can't be continued (416), ESP starts over
+  mk20.file = server.content;
+  mk20.file.resize(FILE_SIZE + 1000);
+  mk20.sidecarETag = server.etag;
+  download(network, true);
+  if (!isComplete() || server.requests != 2) {
+	printf("FAIL  Unsatisfiable range: %d of %d bytes, %d requests\n", (int) mk20.file.size(), FILE_SIZE,
+		   server.requests);
+	failures++;
+  } else {
+	printf("ok    Unsatisfiable range downloads the complete file\n");
+  }
+
+  //The cached job changed on the server, it's downloaded again
+  mk20.file = server.content;
+  mk20.sidecarETag = "\"5a1d\"";
+  download(network, true);
+  if (!isComplete() || server.requests != 1 || mk20.chunks == 0) {
+	printf("FAIL  Changed cached job: %d of %d bytes, %d requests\n", (int) mk20.file.size(), FILE_SIZE,
+		   server.requests);
+	failures++;
+  } else {
+	printf("ok    Changed cached job is downloaded again\n");
+  }
+
+  return failures;
+}
+
+int main(int argc, char **argv) {
+  verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+  server.content.resize(FILE_SIZE);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < server.content.size(); i++) {
+	seed = seed * 1664525 + 1013904223;
+	server.content[i] = seed >> 24;
+  }
+  server.etag = "\"5a1e\"";
+
+  int failures = 0;
+  double throughput[2];
+  for (int i = 0; i < 2; i++) {
+	unsigned long time = download(networks[i]);
+	if (!mk20.closed || mk20.error || mk20.file != server.content) {
+	  printf("FAIL  %s download: %d of %d bytes received, file %s\n", networks[i].name, (int) mk20.file.size(),
+			 FILE_SIZE, mk20.closed ? "closed" : "not closed");
+	  failures++;
+	  continue;
+	}
+	throughput[i] = FILE_SIZE / (1024.0 * 1024.0) * 60000000.0 / time;
+  }
+  if (failures > 0) return 1;
+
+  printf("ok    %d KB job to SD card in %d byte chunks, %d chunks: %.1f MB/min on %s, %.1f MB/min on %s\n",
+		 FILE_SIZE / 1024, DOWNLOADURL_BUFFER_SIZE, mk20.chunks, throughput[0], networks[0].name, throughput[1],
+		 networks[1].name);
+
+  if (resumeChecks() > 0) return 1;
+  return 0;
+}
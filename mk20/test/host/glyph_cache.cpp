@@ -0,0 +1,227 @@
+//Renders every glyph of the fonts in lib/fonts from GlyphCache spans, the way PHDisplay::drawGlyph walks them, and
+//compares the pixels and metrics with the bit by bit rendering of ILI9341_t3::drawFontChar. Glyphs are requested
+//twice, so both decoded and cached glyphs are checked. Build with small GLYPH_CACHE_SLOTS and GLYPH_CACHE_POOL_SIZE
+//to check collisions and pool resets, too.
+
+#include <stdio.h>
+#include <vector>
+#include "GlyphCache.h"
+#include "font_LiberationSans.h"
+#include "font_LiberationSansBold.h"
+#include "font_PT_Sans-Narrow-Web-Regular.h"
+
+struct GlyphImage {
+  bool drawn;
+  int width;
+  int height;
+  int xoffset;
+  int yoffset;
+  int delta;
+  std::vector<bool> pixels;
+
+  void set(int x, int y) {
+	if (x >= 0 && x < width && y >= 0 && y < height) pixels[y * width + x] = true;
+  };
+};
+
+//Bit readers and glyph decoding of ILI9341_t3.cpp, drawFontBits writes to the image instead of the display
+static uint32_t fetchbit(const uint8_t *p, uint32_t index) {
+  if (p[index >> 3] & (1 << (7 - (index & 7)))) return 1;
+  return 0;
+}
+
+static uint32_t fetchbits_unsigned(const uint8_t *p, uint32_t index, uint32_t required) {
+  uint32_t val = 0;
+  do {
+	uint8_t b = p[index >> 3];
+	uint32_t avail = 8 - (index & 7);
+	if (avail <= required) {
+	  val <<= avail;
+	  val |= b & ((1 << avail) - 1);
+	  index += avail;
+	  required -= avail;
+	} else {
+	  b >>= avail - required;
+	  val <<= required;
+	  val |= b & ((1 << required) - 1);
+	  break;
+	}
+  } while (required);
+  return val;
+}
+
+static uint32_t fetchbits_signed(const uint8_t *p, uint32_t index, uint32_t required) {
+  uint32_t val = fetchbits_unsigned(p, index, required);
+  if (val & (1 << (required - 1))) {
+	return (int32_t) val - (1 << required);
+  }
+  return (int32_t) val;
+}
+
+static void drawFontBits(GlyphImage &image, uint32_t bits, uint32_t numbits, uint32_t x, uint32_t y, uint32_t repeat) {
+  if (bits == 0) return;
+  do {
+	uint32_t x1 = x;
+	uint32_t n = numbits;
+	do {
+	  n--;
+	  if (bits & (1 << n)) image.set(x1, y);
+	  x1++;
+	} while (n > 0);
+	y++;
+	repeat--;
+  } while (repeat);
+}
+
+static GlyphImage drawFontChar(const ILI9341_t3_font_t *font, unsigned int c) {
+  GlyphImage image;
+  image.drawn = false;
+
+  uint32_t bitoffset;
+  if (c >= font->index1_first && c <= font->index1_last) {
+	bitoffset = c - font->index1_first;
+	bitoffset *= font->bits_index;
+  } else if (c >= font->index2_first && c <= font->index2_last) {
+	bitoffset = c - font->index2_first + font->index1_last - font->index1_first + 1;
+	bitoffset *= font->bits_index;
+  } else {
+	return image;
+  }
+  const uint8_t *data = font->data + fetchbits_unsigned(font->index, bitoffset, font->bits_index);
+
+  uint32_t encoding = fetchbits_unsigned(data, 0, 3);
+  if (encoding != 0) return image;
+  image.drawn = true;
+  image.width = fetchbits_unsigned(data, 3, font->bits_width);
+  bitoffset = font->bits_width + 3;
+  image.height = fetchbits_unsigned(data, bitoffset, font->bits_height);
+  bitoffset += font->bits_height;
+  image.xoffset = fetchbits_signed(data, bitoffset, font->bits_xoffset);
+  bitoffset += font->bits_xoffset;
+  image.yoffset = fetchbits_signed(data, bitoffset, font->bits_yoffset);
+  bitoffset += font->bits_yoffset;
+  image.delta = fetchbits_unsigned(data, bitoffset, font->bits_delta);
+  bitoffset += font->bits_delta;
+  image.pixels.assign(image.width * image.height, false);
+
+  //drawFontChar loops while linecount is not 0, a repeat beyond the last row is clipped here
+  int32_t linecount = image.height;
+  uint32_t y = 0;
+  uint32_t width = image.width;
+  while (linecount > 0) {
+	uint32_t n = 1;
+	if (fetchbit(data, bitoffset++)) {
+	  n = fetchbits_unsigned(data, bitoffset, 3) + 2;
+	  bitoffset += 3;
+	}
+	uint32_t x = 0;
+	do {
+	  uint32_t xsize = width - x;
+	  if (xsize > 32) xsize = 32;
+	  uint32_t bits = fetchbits_unsigned(data, bitoffset, xsize);
+	  drawFontBits(image, bits, xsize, x, y, n);
+	  bitoffset += xsize;
+	  x += xsize;
+	} while (x < width);
+	y += n;
+	linecount -= n;
+  }
+
+  return image;
+}
+
+static GlyphImage drawCachedGlyph(GlyphCache &cache, const Glyph *glyph) {
+  GlyphImage image;
+  image.drawn = !(glyph->height == 0 && glyph->delta == 0);
+  image.width = glyph->width;
+  image.height = glyph->height;
+  image.xoffset = glyph->xoffset;
+  image.yoffset = glyph->yoffset;
+  image.delta = glyph->delta;
+  image.pixels.assign(image.width * image.height, false);
+
+  const uint8_t *record = cache.spans(glyph);
+  int y = 0;
+  while (y < glyph->height) {
+	uint8_t rows = record[0];
+	const uint8_t *run = &record[2];
+	for (int i = 0; i < record[1]; i++, run += 2) {
+	  for (int r = 0; r < rows; r++) {
+		for (int x = 0; x < run[1]; x++) {
+		  image.set(run[0] + x, y + r);
+		}
+	  }
+	}
+	record = run;
+	y += rows;
+  }
+
+  return image;
+}
+
+static bool sameImage(const GlyphImage &a, const GlyphImage &b) {
+  if (a.drawn != b.drawn) return false;
+  if (!a.drawn) return true;
+  return a.width == b.width && a.height == b.height && a.xoffset == b.xoffset && a.yoffset == b.yoffset &&
+	  a.delta == b.delta && a.pixels == b.pixels;
+}
+
+#define FONT(name) { &name, #name }
+
+struct NamedFont {
+  const ILI9341_t3_font_t *font;
+  const char *name;
+};
+
+static const NamedFont fonts[] = {
+	FONT(LiberationSans_8), FONT(LiberationSans_9), FONT(LiberationSans_10), FONT(LiberationSans_11),
+	FONT(LiberationSans_12), FONT(LiberationSans_13), FONT(LiberationSans_14), FONT(LiberationSans_16),
+	FONT(LiberationSans_18), FONT(LiberationSans_20), FONT(LiberationSans_24), FONT(LiberationSans_28),
+	FONT(LiberationSans_32), FONT(LiberationSans_40), FONT(LiberationSans_48), FONT(LiberationSans_60),
+	FONT(LiberationSans_72), FONT(LiberationSans_96),
+	FONT(LiberationSans_8_Bold), FONT(LiberationSans_9_Bold), FONT(LiberationSans_10_Bold), FONT(LiberationSans_11_Bold),
+	FONT(LiberationSans_12_Bold), FONT(LiberationSans_13_Bold), FONT(LiberationSans_14_Bold), FONT(LiberationSans_16_Bold),
+	FONT(LiberationSans_18_Bold), FONT(LiberationSans_20_Bold), FONT(LiberationSans_24_Bold), FONT(LiberationSans_28_Bold),
+	FONT(LiberationSans_32_Bold), FONT(LiberationSans_40_Bold), FONT(LiberationSans_48_Bold), FONT(LiberationSans_60_Bold),
+	FONT(LiberationSans_72_Bold), FONT(LiberationSans_96_Bold),
+	FONT(PTSansNarrow_8), FONT(PTSansNarrow_9), FONT(PTSansNarrow_10), FONT(PTSansNarrow_11),
+	FONT(PTSansNarrow_12), FONT(PTSansNarrow_13), FONT(PTSansNarrow_14), FONT(PTSansNarrow_16),
+	FONT(PTSansNarrow_18), FONT(PTSansNarrow_20), FONT(PTSansNarrow_24), FONT(PTSansNarrow_28),
+	FONT(PTSansNarrow_32), FONT(PTSansNarrow_40), FONT(PTSansNarrow_48), FONT(PTSansNarrow_60),
+	FONT(PTSansNarrow_72), FONT(PTSansNarrow_96),
+};
+
+int main() {
+  //Static like the cache in PHDisplay, it is too large for the stack with big configurations
+  static GlyphCache cache;
+  int numGlyphs = 0;
+  int numFallbacks = 0;
+  int failures = 0;
+
+  for (size_t f = 0; f < sizeof(fonts) / sizeof(fonts[0]); f++) {
+	for (int pass = 0; pass < 2; pass++) {
+	  for (unsigned int c = 0; c < 256; c++) {
+		GlyphImage direct = drawFontChar(fonts[f].font, c);
+		const Glyph *glyph = cache.glyph(fonts[f].font, c);
+		if (glyph == NULL) {
+		  //PHDisplay draws glyphs that don't fit into the pool with drawFontChar
+		  numFallbacks++;
+		  continue;
+		}
+
+		GlyphImage cached = drawCachedGlyph(cache, glyph);
+		if (!sameImage(direct, cached)) {
+		  if (failures++ < 10) {
+			printf("FAIL  %s character %d (pass %d): cached glyph differs from drawFontChar\n", fonts[f].name, c, pass);
+		  }
+		}
+		if (direct.drawn) numGlyphs++;
+	  }
+	}
+  }
+
+  printf("%s  %d glyphs of %d fonts compared with drawFontChar (%d slots, %d byte pool), %d too large for the pool\n",
+		 failures == 0 ? "ok  " : "FAIL", numGlyphs, (int) (sizeof(fonts) / sizeof(fonts[0])), GLYPH_CACHE_SLOTS,
+		 GLYPH_CACHE_POOL_SIZE, numFallbacks);
+  return failures == 0 ? 0 : 1;
+}
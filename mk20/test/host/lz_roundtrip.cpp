@@ -0,0 +1,75 @@
+//Decodes a file written by utils/lztool/lzpack.js with the firmware decoder and compares it with the original.
+//Input and output are fed in changing chunk sizes, so match tokens and matches are split across calls like
+//they are split across FileSaveData packets.
+//
+//usage: lz_roundtrip file.lz original
+
+#include <stdio.h>
+#include <vector>
+#include "LZDecoder.h"
+
+static bool readFile(const char *path, std::vector<uint8_t> &data) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) return false;
+  uint8_t buffer[4096];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+	data.insert(data.end(), buffer, buffer + size);
+  }
+  fclose(file);
+  return true;
+}
+
+static bool decodeInChunks(const std::vector<uint8_t> &packed, const std::vector<uint8_t> &original, size_t inputChunk, size_t outputChunk) {
+  LZDecoder *decoder = new LZDecoder();
+  std::vector<uint8_t> decoded;
+  std::vector<uint8_t> buffer(outputChunk);
+  size_t offset = 0;
+
+  while (offset < packed.size()) {
+	size_t size = packed.size() - offset < inputChunk ? packed.size() - offset : inputChunk;
+	size_t used = 0;
+	while (true) {
+	  size_t consumed;
+	  size_t numBytesDecoded = decoder->decode(&packed[offset + used], size - used, &consumed, &buffer[0], buffer.size());
+	  used += consumed;
+	  if (decoder->hasError() || numBytesDecoded == 0) break;
+	  decoded.insert(decoded.end(), buffer.begin(), buffer.begin() + numBytesDecoded);
+	}
+	offset += size;
+	if (decoder->hasError()) break;
+  }
+
+  bool ok = !decoder->hasError() && decoded == original;
+  delete decoder;
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+	printf("usage: lz_roundtrip file.lz original\n");
+	return 1;
+  }
+
+  std::vector<uint8_t> packed;
+  std::vector<uint8_t> original;
+  if (!readFile(argv[1], packed) || !readFile(argv[2], original)) {
+	printf("FAIL  could not read %s or %s\n", argv[1], argv[2]);
+	return 1;
+  }
+
+  //1 splits every token, 128 is the FileSaveData packet size used by ESP
+  const size_t inputChunks[] = {1, 2, 3, 7, 128, 4096};
+  const size_t outputChunks[] = {1, 5, 256};
+  for (size_t i = 0; i < sizeof(inputChunks) / sizeof(inputChunks[0]); i++) {
+	for (size_t o = 0; o < sizeof(outputChunks) / sizeof(outputChunks[0]); o++) {
+	  if (!decodeInChunks(packed, original, inputChunks[i], outputChunks[o])) {
+		printf("FAIL  %s: input chunks %d, output chunks %d\n", argv[2], (int) inputChunks[i], (int) outputChunks[o]);
+		return 1;
+	  }
+	}
+  }
+
+  printf("ok    %s: %d -> %d bytes\n", argv[2], (int) original.size(), (int) packed.size());
+  return 0;
+}
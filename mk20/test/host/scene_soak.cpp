@@ -0,0 +1,308 @@
+//Builds, lays out and tears down the scenes of the firmware many times with the real View, Layer, RectangleLayer and
+//GapLayer code and checks that the scene arena and the gap layer pool hold everything, reach a stable high-water mark
+//and are empty after every scene. A gap layer that has to be allocated on the heap fails the check.
+//
+//Frames are the ones of the scenes (bitmap sizes are close to the ones in ui.min), views get plain layers like their
+//bitmap and text layers, the progress bar gets rectangle layers. stubs/core/Application.h stands in for the display.
+
+#include <stdio.h>
+#include "Application.h"
+#include "SceneArena.h"
+#include "../../src/framework/views/View.h"
+#include "../../src/framework/layers/RectangleLayer.h"
+
+#define SOAK_ROUNDS 200
+#define SOAK_RELAYOUTS 8
+
+HostDisplay Display;
+HostTouch Touch;
+HostProfiler Profiler;
+int globalLayerId = 0;
+int globalLayersCreated = 0;
+int globalLayersDeleted = 0;
+int flowErrors = 0;
+
+enum SoakLayerType {
+  Plain,        //Bitmap and text layers
+  Filled,       //A rectangle layer
+  ProgressBar,  //A rectangle layer left and right of the value
+  FixedPlain    //Sidebar, not part of the layout
+};
+
+struct SoakView {
+  Rect frame;
+  SoakLayerType type;
+};
+
+struct SoakScene {
+  const char *name;
+  uint16_t layoutWidth;
+  bool autoLayout;
+  bool viewsInArena;    //False for scenes that create their views in the constructor
+  const SoakView *views;
+  int numViews;
+};
+
+#define SIDEBAR {Rect(0, 0, 50, 190), FixedPlain}, {Rect(0, 190, 50, 50), FixedPlain}
+
+static const SoakView settingsViews[] = {
+	SIDEBAR,
+	{Rect(22, 30, 66, 90), Plain}, {Rect(102, 30, 66, 90), Plain}, {Rect(182, 30, 66, 90), Plain},
+	{Rect(22, 130, 66, 90), Plain}, {Rect(102, 130, 66, 90), Plain}, {Rect(182, 130, 66, 90), Plain}
+};
+
+static const SoakView lightViews[] = {
+	SIDEBAR,
+	{Rect(110, 28, 50, 80), Plain}, {Rect(70, 120, 130, 30), Plain},
+	{Rect(18, 165, 50, 50), Plain}, {Rect(78, 165, 50, 50), Plain}, {Rect(138, 165, 50, 50), Plain},
+	{Rect(198, 165, 50, 50), Plain}
+};
+
+static const SoakView confirmViews[] = {
+	SIDEBAR,
+	{Rect(100, 24, 70, 70), Plain}, {Rect(34, 118, 197, 20), Plain},
+	{Rect(50, 178, 80, 40), Plain}, {Rect(137, 178, 80, 40), Plain}
+};
+
+static const SoakView errorViews[] = {
+	SIDEBAR,
+	{Rect(100, 24, 70, 70), Plain}, {Rect(34, 118, 197, 20), Plain}, {Rect(50, 178, 170, 38), Plain}
+};
+
+static const SoakView selectFilamentViews[] = {
+	SIDEBAR,
+	{Rect(85, 10, 100, 90), Plain}, {Rect(15, 112, 240, 50), Plain}, {Rect(15, 172, 240, 50), Plain}
+};
+
+static const SoakView preheatViews[] = {
+	SIDEBAR,
+	{Rect(0, 0, 270, 195), Plain}, {Rect(5, 200, 260, 20), Plain}, {Rect(0, 228, 270, 12), ProgressBar}
+};
+
+static const SoakView calibrateViews[] = {
+	SIDEBAR,
+	{Rect(16, 10, 121, 95), Plain}, {Rect(137, 75, 70, 30), Plain}, {Rect(137, 13, 113, 62), Plain},
+	{Rect(15, 112, 116, 50), Plain}, {Rect(138, 112, 116, 50), Plain}, {Rect(15, 173, 240, 50), Plain}
+};
+
+static const SoakView finishPrintViews[] = {
+	SIDEBAR,
+	{Rect(26, 18, 220, 140), Plain}, {Rect(16, 176, 240, 50), Plain}
+};
+
+//Projects, jobs and materials scroll through one full page per item and disable auto layout
+static const SoakView projectsViews[] = {
+	SIDEBAR,
+	{Rect(0, 0, 270, 240), Plain}, {Rect(270, 0, 270, 240), Plain}, {Rect(540, 0, 270, 240), Plain},
+	{Rect(810, 0, 270, 240), Plain}, {Rect(1080, 0, 270, 240), Plain}, {Rect(1350, 0, 270, 240), Plain}
+};
+
+//VirtualKeyboardSceneController, the background, 32 keys, the bottom row and the title row
+static SoakView keyboardViews[41];
+
+static void setupKeyboard() {
+  int i = 0;
+  keyboardViews[i++] = {Rect(0, 0, 320, 240), Filled};
+  for (int y = 1; y < 5; y++) {
+	for (int x = 0; x < 8; x++) {
+	  keyboardViews[i++] = {Rect(x * 40, y * 40, 39, 39), Plain};
+	}
+  }
+  keyboardViews[i++] = {Rect(0, 201, 59, 38), Plain};
+  keyboardViews[i++] = {Rect(60, 201, 59, 38), Plain};
+  keyboardViews[i++] = {Rect(121, 201, 137, 38), Plain};
+  keyboardViews[i++] = {Rect(260, 201, 59, 38), Plain};
+  keyboardViews[i++] = {Rect(0, 0, 39, 38), Plain};
+  keyboardViews[i++] = {Rect(40, 0, 88, 38), Plain};
+  keyboardViews[i++] = {Rect(128, 0, 150, 38), Plain};
+  keyboardViews[i++] = {Rect(280, 0, 39, 38), Plain};
+}
+
+#define SCENE(name, width, autoLayout, viewsInArena, views) \
+  {name, width, autoLayout, viewsInArena, views, sizeof(views) / sizeof(views[0])}
+
+static const SoakScene scenes[] = {
+	SCENE("settings", 270, true, true, settingsViews),
+	SCENE("light", 270, true, true, lightViews),
+	SCENE("confirm", 270, true, true, confirmViews),
+	SCENE("error", 270, true, true, errorViews),
+	SCENE("select filament", 270, true, true, selectFilamentViews),
+	SCENE("preheat", 270, true, true, preheatViews),
+	SCENE("calibrate", 270, true, true, calibrateViews),
+	SCENE("finish print", 270, true, true, finishPrintViews),
+	SCENE("projects", 270, false, true, projectsViews),
+	SCENE("keyboard", 320, false, false, keyboardViews)
+};
+
+#define NUM_SCENES ((int) (sizeof(scenes) / sizeof(scenes[0])))
+
+//Foreground and background layer of the display, see PHDisplay::setupBuffers and PHDisplay::layoutIfNeeded
+static RectangleLayer *foregroundLayer = NULL;
+static RectangleLayer *backgroundLayer = NULL;
+static int viewRectangleLayers = 0;
+
+static void setupBuffers() {
+  delete foregroundLayer;
+  delete backgroundLayer;
+  foregroundLayer = new RectangleLayer(Rect(0, 0, Display.getLayoutWidth(), 240));
+  backgroundLayer = new RectangleLayer(Rect(0, 0, Display.getLayoutWidth(), 240));
+}
+
+//Same steps as PHDisplay::layoutIfNeeded, the old foreground is kept as background until the next layout
+static void layout(bool autoLayout) {
+  delete backgroundLayer;
+  backgroundLayer = foregroundLayer;
+
+  Rect bounds = Rect(0, 0, Display.getLayoutWidth(), 240);
+  for (int i = 0; i < Display.layers.count(); i++) {
+	Layer *layer = Display.layers.at(i);
+	if (layer->getContext() == DisplayContext::Fixed) continue;
+
+	Rect frame = layer->getFrame();
+	if (frame.left() < bounds.left()) bounds.x = frame.x;
+	if (frame.right() > bounds.right()) bounds.width = frame.right() - bounds.left();
+	if (frame.top() < bounds.top()) bounds.y = frame.y;
+	if (frame.bottom() > bounds.bottom()) bounds.height = frame.bottom() - bounds.top();
+  }
+  bounds.width += 1;
+
+  foregroundLayer = new RectangleLayer(bounds);
+  Display.needsLayout = false;
+  if (!autoLayout) return;
+
+  for (int i = 0; i < Display.layers.count(); i++) {
+	Layer *layer = Display.layers.at(i);
+	if (layer->getContext() == DisplayContext::Fixed) continue;
+
+	Rect frame = layer->getFrame();
+	foregroundLayer->splitWithRect(frame);
+  }
+}
+
+static int countLayers(Layer *layer) {
+  int count = 1;
+  LayerList *sublayers = layer->getSublayers();
+  for (int i = 0; i < sublayers->count(); i++) {
+	count += countLayers(sublayers->at(i));
+  }
+  return count;
+}
+
+static int liveRectangleLayers() {
+  return countLayers(foregroundLayer) + countLayers(backgroundLayer) + viewRectangleLayers;
+}
+
+class SoakRectangleLayer : public RectangleLayer {
+ public:
+  SoakRectangleLayer(Rect frame) : RectangleLayer(frame) { viewRectangleLayers++; };
+  virtual ~SoakRectangleLayer() { viewRectangleLayers--; };
+};
+
+static bool check(bool condition, const char *message, int round, const SoakScene &scene) {
+  if (!condition) {
+	printf("FAIL  %s (round %d, %s scene)\n", message, round, scene.name);
+  }
+  return condition;
+}
+
+//Same order as Application::loop, a scene is built with the arena open, shown, laid out when its views move and
+//deleted after the display has been cleared
+static bool runScene(const SoakScene &scene, int round, int *peak) {
+  Display.layoutWidth = scene.layoutWidth;
+  Display.layers.clear(false);
+  setupBuffers();
+
+  SmallVector<View *, SCENE_INLINE_VIEWS> views;
+  SmallVector<Layer *, SCENE_INLINE_VIEWS> layers;
+  SceneArena.open();
+  for (int i = 0; i < scene.numViews; i++) {
+	Rect frame = scene.views[i].frame;
+	if (!scene.viewsInArena) SceneArena.close();
+	View *view = new View(frame);
+	SceneArena.open();
+	Layer *layer;
+	switch (scene.views[i].type) {
+	  case Filled:
+		layer = new SoakRectangleLayer(frame);
+		break;
+	  case ProgressBar:
+		view->addLayer(new SoakRectangleLayer(Rect(frame.x, frame.y, frame.width / 2, frame.height)));
+		layer = new SoakRectangleLayer(Rect(frame.x + frame.width / 2, frame.y, frame.width / 2, frame.height));
+		break;
+	  case FixedPlain:
+		view->setContext(DisplayContext::Fixed);
+	  default:
+		layer = new Layer(frame);
+		if (!check(SceneArena.owns(layer), "layer allocated on the heap, arena too small", round, scene)) return false;
+		break;
+	}
+	view->addLayer(layer);
+	views.push(view);
+	layers.push(layer);
+	if (!check(SceneArena.owns(view) == scene.viewsInArena, "view allocated on the heap, arena too small", round, scene)) return false;
+  }
+  for (int i = 0; i < views.count(); i++) {
+	views.at(i)->display();
+  }
+  SceneArena.close();
+
+  //Buttons move their layers while they are touched, every move relayouts the scene
+  for (int relayout = 0; relayout < SOAK_RELAYOUTS; relayout++) {
+	if (relayout > 0) {
+	  Layer *layer = layers.at(relayout % layers.count());
+	  Rect frame = layer->getFrame();
+	  frame.x += (relayout % 2) ? 2 : -2;
+	  layer->setFrame(frame);
+	}
+
+	layout(scene.autoLayout);
+
+	int live = liveRectangleLayers();
+	if (live > *peak) *peak = live;
+	if (!check(live == RectangleLayer::getPoolUsed(), "gap layers allocated on the heap, pool too small", round, scene)) return false;
+	if (!check(flowErrors == 0, "layer or view could not be added", round, scene)) return false;
+  }
+
+  //Display.clear, delete the scene and reset the arena
+  Display.layers.clear(false);
+  setupBuffers();
+  while (views.count() > 0) {
+	delete views.pop();
+  }
+  SceneArena.reset();
+
+  return check(globalLayersCreated - globalLayersDeleted == 2, "layers left after the scene has been deleted", round, scene) &&
+	  check(RectangleLayer::getPoolUsed() == 2, "gap layers left in the pool", round, scene) &&
+	  check(SceneArena.getUsed() == 0, "arena not empty after reset", round, scene);
+}
+
+int main() {
+  setupKeyboard();
+
+  //The first round sees every scene once and sets the high-water marks
+  int peaks[NUM_SCENES] = {0};
+  for (int i = 0; i < NUM_SCENES; i++) {
+	if (!runScene(scenes[i], 0, &peaks[i])) return 1;
+  }
+  size_t arenaHighWaterMark = SceneArena.getHighWaterMark();
+  int poolHighWaterMark = RectangleLayer::getPoolHighWaterMark();
+
+  for (int round = 1; round < SOAK_ROUNDS; round++) {
+	for (int i = 0; i < NUM_SCENES; i++) {
+	  int scene = (i + round) % NUM_SCENES;
+	  if (!runScene(scenes[scene], round, &peaks[scene])) return 1;
+	}
+	if (!check(SceneArena.getHighWaterMark() == arenaHighWaterMark, "arena high-water mark grew", round, scenes[0])) return 1;
+	if (!check(RectangleLayer::getPoolHighWaterMark() == poolHighWaterMark, "pool high-water mark grew", round, scenes[0])) return 1;
+  }
+
+  printf("ok    %d scenes, %d rounds, %d layouts each\n", NUM_SCENES, SOAK_ROUNDS, SOAK_RELAYOUTS);
+  printf("      arena high-water mark %d of %d bytes, layer pool %d of %d blocks\n",
+		 (int) arenaHighWaterMark, (int) SceneArena.getCapacity(), poolHighWaterMark, RECTANGLE_LAYER_POOL_SIZE);
+  printf("      rectangle layers at most:");
+  for (int i = 0; i < NUM_SCENES; i++) {
+	printf("%s %s %d", i > 0 ? "," : "", scenes[i].name, peaks[i]);
+  }
+  printf("\n");
+  return 0;
+}
@@ -0,0 +1,148 @@
+//Checks SmallVector growth past the inline storage, failing allocations, clear and the behaviour of empty vectors.
+//Built with and without SMALLVECTOR_BOUNDS_CHECK.
+
+#include <stdio.h>
+#include "SmallVector.h"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+  if (!(condition)) { \
+	printf("FAIL  %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+	failures++; \
+  }
+
+//Counts allocations and fails once the limit is reached
+struct TestAllocator {
+  static int allocations;
+  static int releases;
+  static int limit;
+
+  static void *allocate(size_t size) {
+	if (allocations - releases >= limit) return NULL;
+	allocations++;
+	return malloc(size);
+  };
+  static void release(void *pointer) {
+	releases++;
+	free(pointer);
+  };
+  static void reset(int newLimit) {
+	allocations = releases = 0;
+	limit = newLimit;
+  };
+};
+
+int TestAllocator::allocations = 0;
+int TestAllocator::releases = 0;
+int TestAllocator::limit = 0;
+
+typedef SmallVector<int, 4, TestAllocator> TestVector;
+
+static void checkGrowth() {
+  TestAllocator::reset(100);
+  {
+	TestVector vector;
+	for (int i = 0; i < 4; i++) {
+	  CHECK(vector.push(i));
+	}
+	CHECK(TestAllocator::allocations == 0);
+	CHECK(vector.capacity() == 4);
+
+	for (int i = 4; i < 100; i++) {
+	  CHECK(vector.push(i));
+	}
+	CHECK(vector.count() == 100);
+	CHECK(vector.capacity() == 128);
+	for (int i = 0; i < 100; i++) {
+	  CHECK(vector.at(i) == i);
+	}
+	CHECK(vector.peek() == 99);
+	CHECK(vector.pop() == 99);
+	CHECK(vector.count() == 99);
+  }
+  //4 -> 8 -> 16 -> 32 -> 64 -> 128, every old heap storage is released, the last one by the destructor
+  CHECK(TestAllocator::allocations == 5);
+  CHECK(TestAllocator::releases == 5);
+}
+
+static void checkFailedGrowth() {
+  TestAllocator::reset(0);
+  TestVector vector;
+  for (int i = 0; i < 4; i++) {
+	CHECK(vector.push(i));
+  }
+  CHECK(!vector.push(4));
+  CHECK(vector.count() == 4);
+  CHECK(vector.capacity() == 4);
+  for (int i = 0; i < 4; i++) {
+	CHECK(vector.at(i) == i);
+  }
+
+  //Growing works again once memory is available
+  TestAllocator::limit = 1;
+  CHECK(vector.push(4));
+  CHECK(vector.count() == 5 && vector.at(4) == 4);
+}
+
+static void checkClear() {
+  TestAllocator::reset(100);
+  TestVector vector;
+  for (int i = 0; i < 10; i++) vector.push(i);
+  CHECK(vector.capacity() == 16);
+
+  //Keeps the grown storage
+  vector.clear();
+  CHECK(vector.isEmpty());
+  CHECK(vector.capacity() == 16);
+  CHECK(TestAllocator::releases == 1);
+  for (int i = 0; i < 10; i++) vector.push(i);
+  CHECK(TestAllocator::allocations == 2);
+
+  //Goes back to the inline storage
+  vector.clear(true);
+  CHECK(vector.isEmpty());
+  CHECK(vector.capacity() == 4);
+  CHECK(TestAllocator::allocations == TestAllocator::releases);
+  for (int i = 0; i < 4; i++) vector.push(i);
+  CHECK(TestAllocator::allocations == 2);
+  CHECK(vector.at(3) == 3);
+}
+
+static void checkEmpty() {
+  TestAllocator::reset(100);
+  TestVector vector;
+  CHECK(vector.pop() == 0);
+  CHECK(vector.peek() == 0);
+  CHECK(vector.count() == 0);
+  CHECK(vector.isEmpty());
+
+  //Still usable afterwards
+  CHECK(vector.push(7));
+  CHECK(vector.count() == 1 && vector.peek() == 7);
+  CHECK(vector.pop() == 7);
+  CHECK(vector.pop() == 0);
+  CHECK(vector.count() == 0);
+
+#ifdef SMALLVECTOR_BOUNDS_CHECK
+  vector.push(1);
+  CHECK(vector.at(-1) == 0);
+  CHECK(vector.at(1) == 0);
+  CHECK(vector.at(0) == 1);
+#endif
+}
+
+int main() {
+  checkGrowth();
+  checkFailedGrowth();
+  checkClear();
+  checkEmpty();
+
+#ifdef SMALLVECTOR_BOUNDS_CHECK
+  const char *variant = "with bounds checks";
+#else
+  const char *variant = "without bounds checks";
+#endif
+  printf("%s  SmallVector %s\n", failures == 0 ? "ok  " : "FAIL", variant);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+//Stands in for src/framework/core/Application.h when framework sources are built on the host. They include it as
+//"../core/Application.h", the Makefile builds them with -I- and stubs/core first, so that include ends up here.
+//Display only keeps the layers views add and the layout width, drawing does nothing
+#pragma once
+
+#include "Arduino.h"
+#include "ILI9341_t3.h"
+#include "UIElement.h"
+#include "SmallVector.h"
+#include "MemoryConfig.h"
+
+class Layer;
+
+class HostDisplay {
+ public:
+  HostDisplay() : debug(false), layoutWidth(320), needsLayout(false) {};
+
+  void addLayer(Layer *layer) { layers.push(layer); };
+  void setNeedsLayout() { needsLayout = true; };
+  void setNeedsDisplay() {};
+  Rect prepareRenderFrame(const Rect proposedRenderFrame, DisplayContext context) { return proposedRenderFrame; };
+  Rect visibleRect() { return Rect(0, 0, layoutWidth, 240); };
+  uint16_t getLayoutWidth() { return layoutWidth; };
+  uint16_t getLayoutStart() { return 0; };
+  float getScrollOffset() { return 0; };
+
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {};
+  void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {};
+  void setCursor(int16_t x, int16_t y) {};
+  void println(const String &text) {};
+  void debugLayer(Layer *layer, bool fill, uint16_t color, bool waitForTap = true) {};
+  void waitForTap() {};
+
+  bool debug;
+  uint16_t layoutWidth;
+  bool needsLayout;
+  SmallVector<Layer *, DISPLAY_INLINE_LAYERS> layers;
+};
+
+class HostTouch {
+ public:
+  bool touched() { return false; };
+};
+
+enum class ProfileCounter : uint8_t {
+  Allocations = 0,
+};
+
+class HostProfiler {
+ public:
+  HostProfiler() : allocations(0) {};
+  void count(ProfileCounter counter) { allocations++; };
+
+  uint32_t allocations;
+};
+
+extern HostDisplay Display;
+extern HostTouch Touch;
+extern HostProfiler Profiler;
+extern int globalLayerId;
+extern int globalLayersCreated;
+extern int globalLayersDeleted;
+extern int flowErrors;
+
+inline void delay(uint32_t ms) {};
+
+#define LOG(m)
+#define LOG_VALUE(m, v)
+#define FLOW_ERROR(...) flowErrors++
@@ -0,0 +1,33 @@
+//Stands in for src/Application.h when ESP modes are built on the host. The Makefile builds them with -I- and
+//stubs/esp first, so their "Application.h" ends up here. The check implements the members
+#pragma once
+
+#include "Arduino.h"
+#include "CommStack.h"
+#include "event_logger.h"
+#include "errors.h"
+
+#define LOG(m)
+#define LOG_VALUE(m, v)
+
+class Mode;
+
+class MK20 : public CommStack {
+ public:
+  MK20() : CommStack(NULL, NULL) {};
+};
+
+class ApplicationClass {
+ public:
+  void pushMode(Mode *mode);
+  void idle();
+  void handleError(DownloadError error);
+  Mode *currentMode() { return _currentMode; };
+  MK20 *getMK20Stack() { return &_mk20; };
+
+ private:
+  Mode *_currentMode;
+  MK20 _mk20;
+};
+
+extern ApplicationClass Application;
@@ -0,0 +1,85 @@
+//Stands in for the ESP8266 Arduino core when ESP sources are built on the host. GPIO registers, pin functions and time
+//are forwarded to the host functions the check implements, delays only add up the time they would take
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+void hostGpioWrite(uint32_t mask, bool value);
+void hostGpioEnable(uint32_t mask, bool output);
+uint32_t hostGpioRead();
+void hostDelayMicroseconds(unsigned int us);
+unsigned long hostMillis();
+void hostDelay(unsigned long ms);
+
+//GPOS/GPOC set and clear outputs, GPES/GPEC enable and disable output drivers, GPI reads all inputs
+template<bool value>
+struct HostGpioOutput {
+  void operator=(uint32_t mask) { hostGpioWrite(mask, value); };
+};
+
+template<bool output>
+struct HostGpioEnable {
+  void operator=(uint32_t mask) { hostGpioEnable(mask, output); };
+};
+
+struct HostGpioInput {
+  operator uint32_t() const { return hostGpioRead(); };
+};
+
+static HostGpioOutput<true> GPOS __attribute__((unused));
+static HostGpioOutput<false> GPOC __attribute__((unused));
+static HostGpioEnable<true> GPES __attribute__((unused));
+static HostGpioEnable<false> GPEC __attribute__((unused));
+static HostGpioInput GPI __attribute__((unused));
+
+inline void pinMode(uint8_t pin, uint8_t mode) { hostGpioEnable(1 << pin, mode == OUTPUT); }
+inline void digitalWrite(uint8_t pin, uint8_t value) { hostGpioWrite(1 << pin, value != LOW); }
+inline int digitalRead(uint8_t pin) { return (hostGpioRead() >> pin) & 1; }
+inline void delayMicroseconds(unsigned int us) { hostDelayMicroseconds(us); }
+inline unsigned long millis() { return hostMillis(); }
+inline void delay(unsigned long ms) { hostDelay(ms); }
+inline void yield() {}
+
+class String : public std::string {
+ public:
+  String(const char *value = "") : std::string(value) {};
+  String(const std::string &value) : std::string(value) {};
+  String(int value) : std::string(std::to_string(value)) {};
+  String(unsigned int value) : std::string(std::to_string(value)) {};
+  String(long value) : std::string(std::to_string(value)) {};
+  String(unsigned long value) : std::string(std::to_string(value)) {};
+
+  int indexOf(char c, unsigned int from = 0) const { size_t i = find(c, from); return i == npos ? -1 : (int) i; };
+  int indexOf(const char *s, unsigned int from = 0) const { size_t i = find(s, from); return i == npos ? -1 : (int) i; };
+  String substring(unsigned int from) const { return from < size() ? substr(from) : ""; };
+  String substring(unsigned int from, unsigned int to) const { return from < to && from < size() ? substr(from, to - from) : ""; };
+  void remove(unsigned int index) { if (index < size()) erase(index); };
+  void remove(unsigned int index, unsigned int count) { if (index < size()) erase(index, count); };
+  bool startsWith(const char *prefix) const { return compare(0, strlen(prefix), prefix) == 0; };
+  bool endsWith(const char *suffix) const { size_t n = strlen(suffix); return size() >= n && compare(size() - n, n, suffix) == 0; };
+  long toInt() const { return atol(c_str()); };
+};
+
+class Stream {
+ public:
+  virtual int available() = 0;
+  virtual size_t readBytes(uint8_t *buffer, size_t length) = 0;
+};
+
+class HostESP {
+ public:
+  void wdtFeed() {};
+};
+
+static HostESP ESP __attribute__((unused));
@@ -0,0 +1,4 @@
+//Stands in for ArduinoJson, host checks don't send JSON
+#pragma once
+
+class JsonObject;
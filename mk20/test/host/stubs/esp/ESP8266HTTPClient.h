@@ -0,0 +1,23 @@
+//Stands in for ESP8266HTTPClient, the check implements the members and serves the requests
+#pragma once
+
+#include "Arduino.h"
+
+class WiFiClient : public Stream {
+ public:
+  int available();
+  size_t readBytes(uint8_t *buffer, size_t length);
+};
+
+class HTTPClient {
+ public:
+  bool begin(String url);
+  void addHeader(const String &name, const String &value);
+  void collectHeaders(const char *headerKeys[], const size_t headerKeysCount);
+  int GET();
+  WiFiClient *getStreamPtr();
+  int getSize();
+  String header(const char *name);
+  bool connected();
+  void end();
+};
@@ -0,0 +1,514 @@
+//Runs ARMDebug of the ESP (esp/lib/arm/arm_debug.cpp) against a bit level model of the SW-DP and AHB-AP of MK20:
+//line reset and JTAG-to-SWD switch, header and data parity, WAIT and FAULT acks, posted AP reads and a TAR that only
+//auto increments within 1 KB blocks. Block transfers, byte and halfword access, core registers and fault recovery are
+//checked with GPIO register and digitalWrite pins, then wire cycles and time for a 2 KB flash sector are reported.
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include "arm_debug.h"
+#include "arm_reg.h"
+#include "event_logger.h"
+
+#define RAM_START 0x1FFF8000
+#define RAM_SIZE (64 * 1024)
+#define SECTOR_SIZE 2048
+
+static bool parity(uint32_t word) {
+  return __builtin_parity(word);
+}
+
+class SwdTarget {
+ public:
+  SwdTarget() : memory(RAM_SIZE / 4) { reset(); };
+
+  void reset() {
+	phase = Lost;
+	selected = false;
+	lockedOut = true;
+	ones = 0;
+	recent = 0;
+	longRunEnd = -1;
+	ctrlStat = 0;
+	select = 0;
+	readBuffer = 0;
+	csw = 0;
+	tar = 0;
+	halted = false;
+	dcrdr = 0;
+	busy = 0;
+	waitAfterAccess = 0;
+	targetDrive = false;
+	targetValue = true;
+	cycles = 0;
+	waits = 0;
+	faults = 0;
+	contention = 0;
+	parityErrors = 0;
+	std::fill(memory.begin(), memory.end(), 0);
+	for (int i = 0; i < 32; i++) coreRegs[i] = 0;
+  };
+
+  //Level on SWDIO: target, host or the pull-up
+  bool line(bool hostOutput, bool hostValue) const {
+	if (targetDrive) return targetValue;
+	if (hostOutput) return hostValue;
+	return true;
+  };
+
+  //Rising edge of SWCLK, the host has already sampled the bit the target presented
+  void clock(bool hostOutput, bool hostValue) {
+	if (targetDrive && hostOutput) contention++;
+	bool bit = line(hostOutput, hostValue);
+	cycles++;
+
+	if (hostOutput) trackLineReset(bit);
+
+	switch (phase) {
+	  case Lost:
+		break;
+	  case Idle:
+		if (bit) {
+		  header = 1;
+		  bitIndex = 1;
+		  phase = Header;
+		}
+		break;
+	  case Header:
+		header |= bit << bitIndex;
+		if (++bitIndex == 8) startPacket();
+		break;
+	  case Turnaround:
+		//Target drives the first ack bit for the next cycle
+		targetDrive = true;
+		targetValue = ack & 1;
+		bitIndex = 0;
+		phase = Ack;
+		break;
+	  case Ack:
+		if (++bitIndex < 3) {
+		  targetValue = (ack >> bitIndex) & 1;
+		} else if (ack == 1 && readNotWrite) {
+		  bitIndex = 0;
+		  targetValue = data & 1;
+		  phase = ReadData;
+		} else {
+		  targetDrive = false;
+		  bitIndex = 0;
+		  phase = ack == 1 ? WriteTurnaround : TurnaroundBack;
+		}
+		break;
+	  case ReadData:
+		if (++bitIndex < 32) {
+		  targetValue = (data >> bitIndex) & 1;
+		} else if (bitIndex == 32) {
+		  targetValue = parity(data);
+		} else {
+		  targetDrive = false;
+		  phase = TurnaroundBack;
+		}
+		break;
+	  case TurnaroundBack:
+		phase = Idle;
+		break;
+	  case WriteTurnaround:
+		data = 0;
+		bitIndex = 0;
+		phase = WriteData;
+		break;
+	  case WriteData:
+		if (bitIndex < 32) {
+		  data |= (uint32_t) bit << bitIndex;
+		} else {
+		  if (bit != parity(data)) {
+			parityErrors++;
+		  } else {
+			write(data);
+		  }
+		  phase = Idle;
+		}
+		bitIndex++;
+		break;
+	}
+  };
+
+  uint32_t peek(uint32_t addr) const { return memory[(addr - RAM_START) / 4]; };
+
+  std::vector<uint32_t> memory;
+  uint32_t coreRegs[32];
+  bool halted;
+  int waitAfterAccess;
+  unsigned long cycles;
+  int waits;
+  int faults;
+  int contention;
+  int parityErrors;
+
+ private:
+  enum Phase { Lost, Idle, Header, Turnaround, Ack, ReadData, TurnaroundBack, WriteTurnaround, WriteData };
+
+  Phase phase;
+  bool selected;
+  bool lockedOut;
+  int ones;
+  uint16_t recent;
+  long longRunEnd;
+  uint8_t header;
+  int bitIndex;
+  bool apNotDp;
+  bool readNotWrite;
+  uint8_t addr;
+  uint8_t ack;
+  uint32_t data;
+  bool targetDrive;
+  bool targetValue;
+
+  uint32_t ctrlStat;
+  uint32_t select;
+  uint32_t readBuffer;
+  uint32_t csw;
+  uint32_t tar;
+  uint32_t dcrdr;
+  int busy;
+
+  //50 or more high cycles are a line reset, 0xE79E after one switches from JTAG to SWD
+  void trackLineReset(bool bit) {
+	recent = (recent >> 1) | (bit << 15);
+	if (recent == 0xE79E && longRunEnd == (long) cycles - 15) {
+	  selected = true;
+	  phase = Lost;
+	}
+
+	if (bit) {
+	  ones++;
+	  return;
+	}
+
+	if (ones >= 50) {
+	  longRunEnd = cycles;
+	  if (selected) {
+		phase = Idle;
+		lockedOut = true;
+	  }
+	}
+	ones = 0;
+  };
+
+  void startPacket() {
+	apNotDp = (header >> 1) & 1;
+	readNotWrite = (header >> 2) & 1;
+	addr = (header >> 1) & 0xC;
+	bool parity = apNotDp ^ readNotWrite ^ ((addr >> 2) & 1) ^ ((addr >> 3) & 1);
+	if (!(header & 1) || (header & 0x40) || !(header & 0x80) || ((header >> 5) & 1) != parity) {
+	  phase = Lost;
+	  return;
+	}
+
+	//After a line reset only IDCODE is answered
+	if (lockedOut && (apNotDp || !readNotWrite || addr != ARMDebug::IDCODE)) {
+	  phase = Lost;
+	  return;
+	}
+
+	if (apNotDp && (ctrlStat & (1 << 5))) {
+	  ack = 4;
+	  faults++;
+	} else if (apNotDp && busy > 0) {
+	  ack = 2;
+	  busy--;
+	  waits++;
+	} else {
+	  ack = 1;
+	  if (readNotWrite) data = read();
+	}
+	phase = Turnaround;
+  };
+
+  uint32_t read() {
+	if (!apNotDp) {
+	  switch (addr) {
+		case ARMDebug::IDCODE:
+		  lockedOut = false;
+		  return 0x2BA01477;
+		case ARMDebug::CTRLSTAT:
+		  return ctrlStat;
+		case ARMDebug::SELECT:
+		  return select;
+		default:
+		  return readBuffer;
+	  }
+	}
+
+	//AP reads are posted, the result shows up with the next AP read or in RDBUFF
+	uint32_t result = readBuffer;
+	readBuffer = apRead(apRegister());
+	return result;
+  };
+
+  void write(uint32_t value) {
+	if (!apNotDp) {
+	  switch (addr) {
+		case ARMDebug::ABORT:
+		  if (value & (1 << 2)) ctrlStat &= ~(1 << 5);
+		  break;
+		case ARMDebug::CTRLSTAT:
+		  ctrlStat = (ctrlStat & (1 << 5)) | (value & 0xF0000000);
+		  if (value & ARMDebug::CSYSPWRUPREQ) ctrlStat |= ARMDebug::CSYSPWRUPACK;
+		  if (value & ARMDebug::CDBGPWRUPREQ) ctrlStat |= ARMDebug::CDBGPWRUPACK;
+		  if (value & ARMDebug::CDBGRSTREQ) ctrlStat |= ARMDebug::CDBGRSTACK;
+		  break;
+		case ARMDebug::SELECT:
+		  select = value;
+		  break;
+	  }
+	  return;
+	}
+
+	apWrite(apRegister(), value);
+  };
+
+  unsigned apRegister() const { return (select & 0xF0) | addr; };
+
+  uint32_t apRead(unsigned reg) {
+	switch (reg) {
+	  case ARMDebug::MEM_CSW:
+		return csw | ARMDebug::CSW_DEVICE_EN;
+	  case ARMDebug::MEM_TAR:
+		return tar;
+	  case ARMDebug::MEM_DRW: {
+		uint32_t value = busRead(tar & ~3);
+		advance();
+		return value;
+	  }
+	  case ARMDebug::MEM_IDR:
+		return 0x24770011;
+	}
+	return 0;
+  };
+
+  void apWrite(unsigned reg, uint32_t value) {
+	switch (reg) {
+	  case ARMDebug::MEM_CSW:
+		csw = value;
+		break;
+	  case ARMDebug::MEM_TAR:
+		tar = value;
+		break;
+	  case ARMDebug::MEM_DRW: {
+		//Data is on the byte lanes of the address, only the transferred size is stored
+		unsigned size = 1 << (csw & 7);
+		if (size < 4) {
+		  uint32_t mask = ((1 << (size * 8)) - 1) << ((tar & 3) * 8);
+		  value = (busRead(tar & ~3) & ~mask) | (value & mask);
+		}
+		busWrite(tar & ~3, value);
+		advance();
+		break;
+	  }
+	}
+  };
+
+  //The bus is busy for a few AP accesses after each transfer, TAR increments wrap at 1 KB
+  void advance() {
+	busy = waitAfterAccess;
+	if (((csw >> 4) & 3) == 1) {
+	  tar = (tar & ~0x3FF) | ((tar + (1 << (csw & 7))) & 0x3FF);
+	}
+  };
+
+  uint32_t busRead(uint32_t address) {
+	if (address >= RAM_START && address < RAM_START + RAM_SIZE) return memory[(address - RAM_START) / 4];
+	if (address == REG_SCB_DHCSR) return (1 << 16) | (halted ? (1 << 17) : 0);
+	if (address == REG_SCB_DCRDR) return dcrdr;
+	if (address == REG_SCB_DCRSR) return 0;
+	ctrlStat |= 1 << 5;
+	return 0;
+  };
+
+  void busWrite(uint32_t address, uint32_t value) {
+	if (address >= RAM_START && address < RAM_START + RAM_SIZE) {
+	  memory[(address - RAM_START) / 4] = value;
+	} else if (address == REG_SCB_DHCSR) {
+	  if ((value >> 16) == 0xA05F) halted = (value & 2) != 0;
+	} else if (address == REG_SCB_DCRSR) {
+	  if (value & 0x10000) {
+		coreRegs[value & 0x1F] = dcrdr;
+	  } else {
+		dcrdr = coreRegs[value & 0x1F];
+	  }
+	} else if (address == REG_SCB_DCRDR) {
+	  dcrdr = value;
+	} else {
+	  ctrlStat |= 1 << 5;
+	}
+  };
+};
+
+static SwdTarget target;
+static uint32_t clockBit;
+static uint32_t dataBit;
+static bool clockLevel;
+static bool hostOutput;
+static bool hostValue;
+static unsigned long delayMicros;
+static unsigned maxDelay;
+
+void hostGpioWrite(uint32_t mask, bool value) {
+  if (mask & dataBit) hostValue = value;
+  if (mask & clockBit) {
+	if (value && !clockLevel) target.clock(hostOutput, hostValue);
+	clockLevel = value;
+  }
+}
+
+void hostGpioEnable(uint32_t mask, bool output) {
+  if (mask & dataBit) hostOutput = output;
+}
+
+uint32_t hostGpioRead() {
+  return target.line(hostOutput, hostValue) ? dataBit : 0;
+}
+
+void hostDelayMicroseconds(unsigned int us) {
+  delayMicros += us;
+  if (us > maxDelay) maxDelay = us;
+}
+
+void EventLogger::log(char *msg, ...) {
+  printf("      %s\n", msg);
+}
+
+void EventLogger::log(const char *msg, ...) {
+  printf("      %s\n", msg);
+}
+
+static int failures = 0;
+
+static bool check(bool condition, const char *message, const char *pins) {
+  if (!condition) {
+	printf("FAIL  %s (%s pins)\n", message, pins);
+	failures++;
+  }
+  return condition;
+}
+
+static void fillPattern(uint32_t *words, unsigned count, uint32_t seed) {
+  for (unsigned i = 0; i < count; i++) {
+	seed = seed * 1664525 + 1013904223;
+	words[i] = seed;
+  }
+}
+
+//Stores and loads a sector that crosses 1 KB blocks, the TAR of the target wraps if ARMDebug doesn't rewrite it
+static bool checkSector(ARMDebug &swd, uint32_t addr, uint32_t seed, const char *pins) {
+  uint32_t words[SECTOR_SIZE / 4];
+  uint32_t readback[SECTOR_SIZE / 4];
+  fillPattern(words, SECTOR_SIZE / 4, seed);
+
+  if (!check(swd.memStore(addr, words, SECTOR_SIZE / 4), "memStore of a sector failed", pins)) return false;
+  for (unsigned i = 0; i < SECTOR_SIZE / 4; i++) {
+	if (!check(target.peek(addr + i * 4) == words[i], "memStore wrote wrong data", pins)) return false;
+  }
+
+  if (!check(swd.memLoad(addr, readback, SECTOR_SIZE / 4), "memLoad of a sector failed", pins)) return false;
+  for (unsigned i = 0; i < SECTOR_SIZE / 4; i++) {
+	if (!check(readback[i] == words[i], "memLoad returned wrong data", pins)) return false;
+  }
+
+  fillPattern(words, SECTOR_SIZE / 4, seed + 1);
+  return check(swd.memStoreAndVerify(addr, words, SECTOR_SIZE / 4), "memStoreAndVerify failed", pins);
+}
+
+static void run(unsigned clockPin, unsigned dataPin, const char *pins) {
+  target.reset();
+  clockBit = 1 << clockPin;
+  dataBit = 1 << dataPin;
+  clockLevel = false;
+  hostOutput = false;
+  hostValue = true;
+
+  ARMDebug swd(clockPin, dataPin, ARMDebug::LOG_ERROR);
+  if (!check(swd.begin(), "begin failed", pins)) return;
+  if (!check(swd.debugHalt() && target.halted, "debugHalt failed", pins)) return;
+
+  uint32_t value = 0;
+  check(swd.regWrite(3, 0x12345678) && target.coreRegs[3] == 0x12345678, "regWrite failed", pins);
+  target.coreRegs[7] = 0xCAFEF00D;
+  check(swd.regRead(7, value) && value == 0xCAFEF00D, "regRead failed", pins);
+
+  checkSector(swd, 0x1FFFFE80, 1, pins);
+
+  uint8_t byte = 0;
+  uint16_t half = 0;
+  check(swd.memStoreByte(0x20000101, 0xAB) && (target.peek(0x20000100) & 0xFF00) == 0xAB00, "memStoreByte failed", pins);
+  check(swd.memLoadByte(0x20000101, byte) && byte == 0xAB, "memLoadByte failed", pins);
+  check(swd.memStoreHalf(0x20000202, 0xBEEF) && (target.peek(0x20000200) >> 16) == 0xBEEF, "memStoreHalf failed", pins);
+  check(swd.memLoadHalf(0x20000202, half) && half == 0xBEEF, "memLoadHalf failed", pins);
+
+  //Posted writes must survive WAIT acks
+  target.waitAfterAccess = 2;
+  checkSector(swd, 0x20001000 - 12, 2, pins);
+  check(target.waits > 0, "target never answered WAIT", pins);
+  target.waitAfterAccess = 0;
+
+  //A bus error makes AP accesses FAULT until the sticky error is cleared. The read is posted, so it's reported by
+  //the next access
+  ARMDebug::LogLevel logLevel;
+  swd.setLogLevel(ARMDebug::LOG_NONE, logLevel);
+  swd.memLoad(0x40000000, value);
+  check(!swd.memLoad(0x20000100, value) && target.faults > 0, "bus error was not reported", pins);
+  swd.setLogLevel(logLevel);
+  check(swd.memLoad(0x20000100, value) && value == target.peek(0x20000100), "no recovery after FAULT", pins);
+
+  //Delays used to be truncated to 8 bits
+  maxDelay = 0;
+  swd.setClockDelay(300, 700);
+  check(swd.getIDCODE(value) && maxDelay == 700, "clock delay was truncated", pins);
+  swd.setClockDelay(1, 2);
+
+  check(target.contention == 0, "host and target drove SWDIO at the same time", pins);
+  check(target.parityErrors == 0, "target received data with bad parity", pins);
+}
+
+//Wire cycles and time spent in clock delays for a 2 KB sector, the time GPIO access takes on ESP comes on top
+static void measure() {
+  target.reset();
+  clockBit = 1 << 5;
+  dataBit = 1 << 14;
+  clockLevel = false;
+  hostOutput = false;
+
+  ARMDebug swd(5, 14, ARMDebug::LOG_ERROR);
+  if (!swd.begin()) return;
+
+  uint32_t words[SECTOR_SIZE / 4];
+  fillPattern(words, SECTOR_SIZE / 4, 3);
+
+  const char *names[] = {"block store", "block load", "word by word store"};
+  for (int test = 0; test < 3; test++) {
+	unsigned long cycles = target.cycles;
+	delayMicros = 0;
+	if (test == 0) {
+	  swd.memStore(0x20000000, words, SECTOR_SIZE / 4);
+	} else if (test == 1) {
+	  swd.memLoad(0x20000000, words, SECTOR_SIZE / 4);
+	} else {
+	  for (unsigned i = 0; i < SECTOR_SIZE / 4; i++) swd.memStore(0x20000000 + i * 4, words[i]);
+	}
+	cycles = target.cycles - cycles;
+
+	printf("      %-18s %6lu cycles per 2 KB sector, %5.1f per word, %6.1f ms at 1/2 us delays, %4.0f kbit/s\n",
+		   names[test], cycles, (double) cycles / (SECTOR_SIZE / 4), delayMicros / 1000.0,
+		   SECTOR_SIZE * 8 * 1000.0 / delayMicros);
+  }
+}
+
+int main() {
+  run(5, 14, "GPIO register");
+  run(16, 14, "digitalWrite");
+  if (failures > 0) return 1;
+
+  printf("ok    SWD transfers, WAIT and FAULT handling with GPIO register and digitalWrite pins\n");
+  measure();
+  return 0;
+}
@@ -0,0 +1,194 @@
+// Compresses files (typically G-code jobs) with the LZ format decoded by the
+// MK20 firmware (mk20/src/framework/core/LZDecoder.h). Compressed files can be
+// sent to the MK20 with Compression::LZ or stored on SD as they are, the
+// printer decompresses them while printing.
+//
+// usage: node lzpack.js [-d] input [output]
+//        node lzpack.js --test [file...]
+//   -d      decompress instead of compress
+//   --test  round trip generated samples (and the given files) through
+//           compress and decompress, exits with 1 on the first mismatch
+//
+// Every compressed file is decoded again and compared with the input before
+// it is written. mk20/test/host decodes the output with the firmware decoder.
+
+var fs = require('fs');
+
+var MAGIC = Buffer.from('PBLZ');
+var WINDOW_BITS = 11;
+var LENGTH_BITS = 5;
+var MIN_MATCH = 3;
+var WINDOW_SIZE = 1 << WINDOW_BITS;
+var MAX_MATCH = MIN_MATCH + (1 << LENGTH_BITS) - 1;
+var HASH_SIZE = 1 << 12;
+var MAX_CHAIN = 64;
+
+function hash(data, i) {
+  return ((data[i] << 8) ^ (data[i + 1] << 4) ^ data[i + 2]) & (HASH_SIZE - 1);
+}
+
+function compress(data) {
+  var out = Buffer.alloc(MAGIC.length + data.length + Math.ceil(data.length / 8) + 1);
+  var o = MAGIC.copy(out, 0);
+  var head = new Int32Array(HASH_SIZE).fill(-1);
+  var prev = new Int32Array(WINDOW_SIZE).fill(-1);
+  var flagPos = -1;
+  var flagBit = 8;
+
+  function insert(i) {
+    if (i + MIN_MATCH > data.length) return;
+    var h = hash(data, i);
+    prev[i & (WINDOW_SIZE - 1)] = head[h];
+    head[h] = i;
+  }
+
+  function nextFlag(isMatch) {
+    if (flagBit == 8) {
+      flagPos = o++;
+      out[flagPos] = 0;
+      flagBit = 0;
+    }
+    if (isMatch) out[flagPos] |= 1 << flagBit;
+    flagBit++;
+  }
+
+  var i = 0;
+  while (i < data.length) {
+    var bestLength = 0;
+    var bestDistance = 0;
+    if (i + MIN_MATCH <= data.length) {
+      var candidate = head[hash(data, i)];
+      var maxLength = Math.min(MAX_MATCH, data.length - i);
+      for (var chain = 0; candidate >= 0 && i - candidate <= WINDOW_SIZE && chain < MAX_CHAIN; chain++) {
+        var length = 0;
+        while (length < maxLength && data[candidate + length] == data[i + length]) length++;
+        if (length > bestLength) {
+          bestLength = length;
+          bestDistance = i - candidate;
+          if (length == maxLength) break;
+        }
+        var next = prev[candidate & (WINDOW_SIZE - 1)];
+        if (next >= candidate) break;
+        candidate = next;
+      }
+    }
+
+    if (bestLength >= MIN_MATCH) {
+      nextFlag(true);
+      var token = ((bestDistance - 1) << LENGTH_BITS) | (bestLength - MIN_MATCH);
+      out[o++] = token >> 8;
+      out[o++] = token & 0xFF;
+      for (var k = 0; k < bestLength; k++) insert(i + k);
+      i += bestLength;
+    } else {
+      nextFlag(false);
+      out[o++] = data[i];
+      insert(i);
+      i++;
+    }
+  }
+
+  return out.slice(0, o);
+}
+
+function decompress(data) {
+  if (data.length < MAGIC.length || !data.slice(0, MAGIC.length).equals(MAGIC)) {
+    throw new Error('not an LZ compressed file');
+  }
+  var out = [];
+  var i = MAGIC.length;
+  while (i < data.length) {
+    var flags = data[i++];
+    for (var bit = 0; bit < 8 && i < data.length; bit++) {
+      if (flags & (1 << bit)) {
+        var token = (data[i] << 8) | data[i + 1];
+        i += 2;
+        var distance = (token >> LENGTH_BITS) + 1;
+        var length = (token & ((1 << LENGTH_BITS) - 1)) + MIN_MATCH;
+        for (var k = 0; k < length; k++) {
+          var p = out.length - distance;
+          out.push(p >= 0 ? out[p] : 0);
+        }
+      } else {
+        out.push(data[i++]);
+      }
+    }
+  }
+  return Buffer.from(out);
+}
+
+function testSamples() {
+  var samples = {};
+  var seed = 1;
+  function random() {
+    seed = (seed * 1103515245 + 12345) & 0x7FFFFFFF;
+    return seed >> 16;
+  }
+
+  samples['empty'] = Buffer.alloc(0);
+  samples['single byte'] = Buffer.from('G');
+  samples['long run'] = Buffer.alloc(10000, 'a');
+
+  var gcode = '';
+  for (var line = 0; line < 2000; line++) {
+    gcode += 'G1 X' + (random() % 200) + '.' + (random() % 100) + ' Y' + (random() % 200) + ' E' + (line / 10).toFixed(4) + '\n';
+  }
+  samples['gcode'] = Buffer.from(gcode);
+
+  var noise = Buffer.alloc(50000);
+  for (var i = 0; i < noise.length; i++) noise[i] = random() & 0xFF;
+  samples['random'] = noise;
+
+  //Repeats just inside and just outside of the window
+  [WINDOW_SIZE - 1, WINDOW_SIZE, WINDOW_SIZE + 1].forEach(function (period) {
+    var block = noise.slice(0, period);
+    samples['period ' + period] = Buffer.concat([block, block, block, block.slice(0, 100)]);
+  });
+
+  return samples;
+}
+
+function runTests(files) {
+  var samples = testSamples();
+  files.forEach(function (file) {
+    samples[file] = fs.readFileSync(file);
+  });
+
+  var failed = 0;
+  Object.keys(samples).forEach(function (name) {
+    var input = samples[name];
+    var packed = compress(input);
+    var ok = decompress(packed).equals(input);
+    if (!ok) failed++;
+    console.log((ok ? 'ok    ' : 'FAIL  ') + name + ': ' + input.length + ' -> ' + packed.length + ' bytes');
+  });
+  return failed == 0;
+}
+
+var args = process.argv.slice(2);
+if (args[0] == '--test') {
+  process.exit(runTests(args.slice(1)) ? 0 : 1);
+}
+
+var unpack = args[0] == '-d';
+if (unpack) args.shift();
+if (args.length < 1) {
+  console.log('usage: node lzpack.js [-d] input [output]');
+  process.exit(1);
+}
+
+var input = fs.readFileSync(args[0]);
+var output;
+if (unpack) {
+  output = decompress(input);
+} else {
+  output = compress(input);
+  if (!decompress(output).equals(input)) {
+    console.log('Round trip check failed, output not written');
+    process.exit(1);
+  }
+}
+
+var outputPath = args[1] || (unpack ? args[0].replace(/\.lz$/, '') : args[0] + '.lz');
+fs.writeFileSync(outputPath, output);
+console.log(args[0] + ': ' + input.length + ' -> ' + output.length + ' bytes (' + outputPath + ')');